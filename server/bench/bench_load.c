@@ -0,0 +1,793 @@
+// make bench용 부하 생성기: 가짜 MP4 픽스처를 만들고, 사용자를 시드한 뒤 혼합 시나리오를 돌려
+// 시나리오별 처리량과 p50/p99/p999 지연을 출력한다. 서버 코드에 의존하지 않는 단독 프로그램이다.
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#define BENCH_MAX_VIDEOS 1024
+#define BENCH_PASSWORD "benchpass1"
+#define BENCH_RANGE_BYTES (256 * 1024) // 탐색 한 번에 받는 Range 크기
+#define BENCH_FIXTURE_BITRATE 2000000  // 픽스처 길이(mvhd)를 정할 때 가정하는 평균 비트레이트 (bit/s)
+#define BENCH_THUMB_TIMEOUT_MS 30000
+#define BENCH_CONN_BUFFER 16384
+
+typedef struct {
+    int fd;
+    char buf[BENCH_CONN_BUFFER]; // 응답 헤더 수신용 (본문은 곧바로 소비한다)
+    size_t len;
+} conn_t;
+
+typedef struct {
+    int status;
+    size_t body_length;
+    int close;
+    long long total_length; // Content-Range의 전체 길이 (206이 아니면 0)
+    char cookie[160]; // Set-Cookie의 "이름=값" 부분
+} response_t;
+
+typedef struct worker worker_t;
+
+typedef struct {
+    const char *name;
+    // 한 번 반복한다. 자기 몫을 다 끝낸 시나리오(1회성)는 1을 돌려 멈춘다.
+    int (*step)(worker_t *w);
+    int needs_session; // 시작 전에 워커마다 로그인해 둔다
+    int once;          // 시간 제한 없이 모든 비디오를 한 번씩 처리하고 끝난다
+} scenario_t;
+
+struct worker {
+    int index;
+    conn_t conn;
+    uint64_t rng;
+    char cookie[160];
+    uint32_t *latency_us; // 요청별 지연 (분위수 계산용)
+    size_t latency_count;
+    size_t latency_capacity;
+    uint64_t requests;
+    uint64_t errors;
+    uint64_t bytes;
+    const scenario_t *scenario;
+    uint64_t deadline_us;
+};
+
+static struct sockaddr_storage g_addr;
+static socklen_t g_addr_len;
+static int g_users = 16;
+static int g_video_ids[BENCH_MAX_VIDEOS];
+static long long g_video_sizes[BENCH_MAX_VIDEOS];
+static int g_video_count;
+static atomic_int g_thumb_next;
+
+static uint64_t now_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000ULL + (uint64_t)ts.tv_nsec / 1000ULL;
+}
+
+// xorshift64*: 시드가 같으면 같은 요청 순서를 재현한다.
+static uint64_t next_random(uint64_t *state) {
+    uint64_t x = *state;
+    x ^= x >> 12;
+    x ^= x << 25;
+    x ^= x >> 27;
+    *state = x;
+    return x * 0x2545F4914F6CDD1DULL;
+}
+
+static void put_be32(unsigned char *p, uint32_t v) {
+    p[0] = (unsigned char)(v >> 24);
+    p[1] = (unsigned char)(v >> 16);
+    p[2] = (unsigned char)(v >> 8);
+    p[3] = (unsigned char)v;
+}
+
+// ftyp + moov(mvhd) + mdat으로 된 최소 MP4를 쓴다. 서버의 인덱서가 길이를 읽을 수 있으면 충분하다.
+static int write_fixture(const char *path, long long size, uint64_t seed) {
+    unsigned char head[24 + 8 + 108 + 8] = {0};
+    unsigned char *p = head;
+    put_be32(p, 24);
+    memcpy(p + 4, "ftypisom", 8);
+    put_be32(p + 12, 0x200);
+    memcpy(p + 16, "isommp41", 8);
+    p += 24;
+    put_be32(p, 8 + 108);
+    memcpy(p + 4, "moov", 4);
+    p += 8;
+    long long payload = size - (long long)sizeof(head);
+    put_be32(p, 108);
+    memcpy(p + 4, "mvhd", 4);
+    put_be32(p + 20, 1000); // timescale (ms)
+    long long duration_ms = payload * 8 * 1000 / BENCH_FIXTURE_BITRATE;
+    put_be32(p + 24, (uint32_t)(duration_ms > 1000 ? duration_ms : 1000));
+    put_be32(p + 28, 0x00010000); // rate 1.0
+    p[32] = 0x01;                 // volume 1.0
+    put_be32(p + 44, 0x00010000); // 단위 행렬
+    put_be32(p + 60, 0x00010000);
+    put_be32(p + 76, 0x40000000);
+    put_be32(p + 104, 2); // next_track_ID
+    p += 108;
+    put_be32(p, (uint32_t)(payload + 8));
+    memcpy(p + 4, "mdat", 4);
+
+    char tmp[4096];
+    if (snprintf(tmp, sizeof(tmp), "%s.tmp", path) >= (int)sizeof(tmp)) {
+        return -1;
+    }
+    FILE *fp = fopen(tmp, "wb");
+    if (!fp) {
+        return -1;
+    }
+    int rc = fwrite(head, 1, sizeof(head), fp) == sizeof(head) ? 0 : -1;
+    uint64_t state = seed | 1;
+    uint64_t block[8192];
+    for (long long left = payload; rc == 0 && left > 0;) {
+        for (size_t i = 0; i < sizeof(block) / sizeof(block[0]); ++i) {
+            block[i] = next_random(&state);
+        }
+        size_t chunk = left < (long long)sizeof(block) ? (size_t)left : sizeof(block);
+        if (fwrite(block, 1, chunk, fp) != chunk) {
+            rc = -1;
+        }
+        left -= (long long)chunk;
+    }
+    if (fclose(fp) != 0) {
+        rc = -1;
+    }
+    if (rc == 0 && rename(tmp, path) != 0) {
+        rc = -1;
+    }
+    if (rc != 0) {
+        unlink(tmp);
+    }
+    return rc;
+}
+
+// fixture DIR COUNT: 256KiB부터 16MiB까지 크기가 섞인 COUNT개의 파일을 만든다. 같은 크기로 이미 있으면 건너뛴다.
+static int cmd_fixture(const char *dir, int count, uint64_t seed) {
+    if (mkdir(dir, 0755) != 0 && errno != EEXIST) {
+        fprintf(stderr, "bench: cannot create %s: %s\n", dir, strerror(errno));
+        return 1;
+    }
+    long long total = 0;
+    for (int i = 0; i < count; ++i) {
+        char path[4096];
+        long long size = (256LL * 1024) << (i % 7);
+        snprintf(path, sizeof(path), "%s/bench-%03d.mp4", dir, i);
+        total += size;
+        struct stat st;
+        if (stat(path, &st) == 0 && st.st_size == size) {
+            continue;
+        }
+        if (write_fixture(path, size, seed + (uint64_t)i) != 0) {
+            fprintf(stderr, "bench: failed to write %s\n", path);
+            return 1;
+        }
+    }
+    printf("fixture: %d videos, %.1f MiB in %s\n", count, (double)total / (1024.0 * 1024.0), dir);
+    return 0;
+}
+
+static void conn_close(conn_t *c) {
+    if (c->fd >= 0) {
+        close(c->fd);
+    }
+    c->fd = -1;
+    c->len = 0;
+}
+
+static int conn_open(conn_t *c) {
+    conn_close(c);
+    int fd = socket(g_addr.ss_family, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        return -1;
+    }
+    if (connect(fd, (struct sockaddr *)&g_addr, g_addr_len) != 0) {
+        close(fd);
+        return -1;
+    }
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    c->fd = fd;
+    return 0;
+}
+
+static int send_all(int fd, const char *data, size_t len) {
+    while (len > 0) {
+        ssize_t n = send(fd, data, len, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return -1;
+        }
+        data += n;
+        len -= (size_t)n;
+    }
+    return 0;
+}
+
+// 대소문자를 무시하고 헤더 이름을 찾아 값의 시작을 돌려준다.
+static const char *find_header(const char *head, const char *name) {
+    size_t name_len = strlen(name);
+    for (const char *line = strstr(head, "\r\n"); line; line = strstr(line + 2, "\r\n")) {
+        const char *start = line + 2;
+        if (strncasecmp(start, name, name_len) == 0 && start[name_len] == ':') {
+            start += name_len + 1;
+            while (*start == ' ') ++start;
+            return start;
+        }
+    }
+    return NULL;
+}
+
+// 요청 하나를 보내고 응답을 끝까지 읽는다. 본문은 body_cap까지만 body에 담고 나머지는 버린다.
+static int roundtrip_once(conn_t *c, const char *request, size_t request_len, response_t *res, char *body,
+                          size_t body_cap) {
+    if (send_all(c->fd, request, request_len) != 0) {
+        return -1;
+    }
+    char *end = NULL;
+    for (;;) {
+        c->buf[c->len] = '\0';
+        end = strstr(c->buf, "\r\n\r\n");
+        if (end) {
+            break;
+        }
+        if (c->len + 1 >= sizeof(c->buf)) {
+            return -1;
+        }
+        ssize_t n = recv(c->fd, c->buf + c->len, sizeof(c->buf) - c->len - 1, 0);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return -1;
+        }
+        c->len += (size_t)n;
+    }
+    *end = '\0';
+    memset(res, 0, sizeof(*res));
+    if (sscanf(c->buf, "HTTP/1.%*d %d", &res->status) != 1) {
+        return -1;
+    }
+    const char *value = find_header(c->buf, "Content-Length");
+    res->body_length = value ? (size_t)strtoull(value, NULL, 10) : 0;
+    value = find_header(c->buf, "Connection");
+    res->close = value && strncasecmp(value, "close", 5) == 0;
+    value = find_header(c->buf, "Content-Range");
+    if (value && (value = strchr(value, '/')) != NULL) {
+        res->total_length = atoll(value + 1);
+    }
+    value = find_header(c->buf, "Set-Cookie");
+    if (value) {
+        size_t n = strcspn(value, ";\r");
+        if (n < sizeof(res->cookie)) {
+            memcpy(res->cookie, value, n);
+            res->cookie[n] = '\0';
+        }
+    }
+    size_t head_len = (size_t)(end - c->buf) + 4;
+    size_t have = c->len - head_len;
+    size_t need = res->body_length;
+    size_t used = have < need ? have : need;
+    size_t stored = used < body_cap ? used : body_cap;
+    if (body && stored > 0) {
+        memcpy(body, c->buf + head_len, stored);
+    }
+    memmove(c->buf, c->buf + head_len + used, have - used);
+    c->len = have - used;
+    need -= used;
+    char sink[65536];
+    while (need > 0) {
+        ssize_t n = recv(c->fd, sink, need < sizeof(sink) ? need : sizeof(sink), 0);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return -1;
+        }
+        if (body && stored < body_cap) {
+            size_t take = (size_t)n < body_cap - stored ? (size_t)n : body_cap - stored;
+            memcpy(body + stored, sink, take);
+            stored += take;
+        }
+        need -= (size_t)n;
+    }
+    if (body) {
+        body[stored < body_cap ? stored : body_cap - 1] = '\0';
+    }
+    if (res->close) {
+        conn_close(c);
+    }
+    return 0;
+}
+
+// 서버가 유지 연결을 먼저 닫았을 수 있으므로 재사용한 연결이 실패하면 한 번 새로 연결해 다시 보낸다.
+static int roundtrip(conn_t *c, const char *request, size_t request_len, response_t *res, char *body,
+                     size_t body_cap) {
+    int reused = c->fd >= 0;
+    if (!reused && conn_open(c) != 0) {
+        return -1;
+    }
+    if (roundtrip_once(c, request, request_len, res, body, body_cap) == 0) {
+        return 0;
+    }
+    conn_close(c);
+    if (!reused || conn_open(c) != 0) {
+        return -1;
+    }
+    if (roundtrip_once(c, request, request_len, res, body, body_cap) == 0) {
+        return 0;
+    }
+    conn_close(c);
+    return -1;
+}
+
+static size_t format_request(char *out, size_t out_len, const char *method, const char *target,
+                             const char *cookie, const char *extra, const char *body) {
+    size_t body_len = body ? strlen(body) : 0;
+    int n = snprintf(out, out_len,
+                     "%s %s HTTP/1.1\r\nHost: bench\r\n%s%s%s%s%s"
+                     "Content-Length: %zu\r\n\r\n%s",
+                     method, target, cookie && *cookie ? "Cookie: " : "", cookie && *cookie ? cookie : "",
+                     cookie && *cookie ? "\r\n" : "", body ? "Content-Type: application/json\r\n" : "",
+                     extra ? extra : "", body_len, body ? body : "");
+    return n > 0 && (size_t)n < out_len ? (size_t)n : 0;
+}
+
+static void record(worker_t *w, uint64_t started, int ok, size_t bytes) {
+    uint64_t elapsed = now_us() - started;
+    if (w->latency_count == w->latency_capacity) {
+        size_t capacity = w->latency_capacity ? w->latency_capacity * 2 : 4096;
+        uint32_t *grown = realloc(w->latency_us, capacity * sizeof(*grown));
+        if (!grown) {
+            w->errors++;
+            return;
+        }
+        w->latency_us = grown;
+        w->latency_capacity = capacity;
+    }
+    w->latency_us[w->latency_count++] = elapsed > UINT32_MAX ? UINT32_MAX : (uint32_t)elapsed;
+    w->requests++;
+    w->bytes += bytes;
+    if (!ok) {
+        w->errors++;
+    }
+}
+
+// 요청 하나를 보내고 지연을 기록한다. 전송 실패면 -1, 아니면 상태 코드.
+static int timed_request(worker_t *w, const char *method, const char *target, const char *extra,
+                         const char *body, char *out, size_t out_cap, response_t *res) {
+    char request[2048];
+    size_t len = format_request(request, sizeof(request), method, target, w->cookie, extra, body);
+    uint64_t started = now_us();
+    if (len == 0 || roundtrip(&w->conn, request, len, res, out, out_cap) != 0) {
+        record(w, started, 0, 0);
+        return -1;
+    }
+    record(w, started, res->status < 400, res->body_length);
+    return res->status;
+}
+
+static int login_as(conn_t *c, int user, char *cookie, size_t cookie_len, int *status_out) {
+    char body[160];
+    char request[512];
+    snprintf(body, sizeof(body), "{\"username\":\"bench%03d\",\"password\":\"" BENCH_PASSWORD "\"}", user);
+    size_t len = format_request(request, sizeof(request), "POST", "/api/auth/login", NULL, NULL, body);
+    response_t res;
+    if (roundtrip(c, request, len, &res, NULL, 0) != 0) {
+        return -1;
+    }
+    if (status_out) {
+        *status_out = res.status;
+    }
+    if (res.status != 200 || !res.cookie[0]) {
+        return -1;
+    }
+    snprintf(cookie, cookie_len, "%s", res.cookie);
+    return 0;
+}
+
+// 로그인 폭주: 매번 임의의 시드 사용자로 로그인한다 (비밀번호 해시 풀과 세션 생성 경로).
+static int step_login(worker_t *w) {
+    char body[160];
+    char request[512];
+    int user = (int)(next_random(&w->rng) % (uint64_t)g_users);
+    snprintf(body, sizeof(body), "{\"username\":\"bench%03d\",\"password\":\"" BENCH_PASSWORD "\"}", user);
+    size_t len = format_request(request, sizeof(request), "POST", "/api/auth/login", NULL, NULL, body);
+    response_t res;
+    uint64_t started = now_us();
+    if (roundtrip(&w->conn, request, len, &res, NULL, 0) != 0) {
+        record(w, started, 0, 0);
+        return 0;
+    }
+    record(w, started, res.status == 200, res.body_length);
+    return 0;
+}
+
+// 카탈로그 스크롤: 첫 페이지부터 nextCursor를 끝까지 따라간다. 네 번에 한 번은 제목 검색.
+static int step_browse(worker_t *w) {
+    char target[512];
+    char body[65536];
+    response_t res;
+    if (next_random(&w->rng) % 4 == 0) {
+        snprintf(target, sizeof(target), "/api/videos?limit=20&q=bench-0%u",
+                 (unsigned)(next_random(&w->rng) % 10));
+        timed_request(w, "GET", target, NULL, NULL, NULL, 0, &res);
+        return 0;
+    }
+    snprintf(target, sizeof(target), "/api/videos?limit=10");
+    for (int page = 0; page < 32; ++page) {
+        if (timed_request(w, "GET", target, NULL, NULL, body, sizeof(body), &res) != 200) {
+            break;
+        }
+        const char *cursor = strstr(body, "\"nextCursor\":\"");
+        if (!cursor) {
+            break;
+        }
+        cursor += strlen("\"nextCursor\":\"");
+        size_t n = strcspn(cursor, "\"");
+        if (n == 0 || n > 256) {
+            break;
+        }
+        snprintf(target, sizeof(target), "/api/videos?limit=10&cursor=%.*s", (int)n, cursor);
+    }
+    return 0;
+}
+
+// 임의 탐색 재생: 임의의 비디오, 임의의 위치에서 BENCH_RANGE_BYTES만큼 Range로 받는다.
+static int step_stream(worker_t *w) {
+    if (g_video_count == 0) {
+        return 1;
+    }
+    int slot = (int)(next_random(&w->rng) % (uint64_t)g_video_count);
+    long long size = g_video_sizes[slot];
+    long long start = size > BENCH_RANGE_BYTES ? (long long)(next_random(&w->rng) % (uint64_t)(size - BENCH_RANGE_BYTES)) : 0;
+    char target[128];
+    char range[96];
+    snprintf(target, sizeof(target), "/api/videos/%d/stream", g_video_ids[slot]);
+    snprintf(range, sizeof(range), "Range: bytes=%lld-%lld\r\n", start, start + BENCH_RANGE_BYTES - 1);
+    response_t res;
+    timed_request(w, "GET", target, range, NULL, NULL, 0, &res);
+    return 0;
+}
+
+// 시청 기록 갱신 폭주: 재생 중인 플레이어가 보내는 위치 보고.
+static int step_history(worker_t *w) {
+    if (g_video_count == 0) {
+        return 1;
+    }
+    int slot = (int)(next_random(&w->rng) % (uint64_t)g_video_count);
+    char target[96];
+    char body[64];
+    snprintf(target, sizeof(target), "/api/history/%d", g_video_ids[slot]);
+    snprintf(body, sizeof(body), "{\"position\":%.1f}", (double)(next_random(&w->rng) % 36000) / 10.0);
+    response_t res;
+    timed_request(w, "POST", target, NULL, body, NULL, 0, &res);
+    return 0;
+}
+
+// 썸네일 콜드 스타트: 빈 썸네일 디렉터리에서 비디오마다 200이 올 때까지 다시 묻고,
+// 첫 요청부터 준비될 때까지 걸린 시간을 한 표본으로 기록한다.
+static int step_thumbnail(worker_t *w) {
+    int slot = atomic_fetch_add(&g_thumb_next, 1);
+    if (slot >= g_video_count) {
+        return 1;
+    }
+    char target[96];
+    char request[512];
+    snprintf(target, sizeof(target), "/api/videos/%d/thumbnail", g_video_ids[slot]);
+    size_t len = format_request(request, sizeof(request), "GET", target, w->cookie, NULL, NULL);
+    uint64_t started = now_us();
+    for (;;) {
+        response_t res;
+        if (roundtrip(&w->conn, request, len, &res, NULL, 0) != 0 || (res.status != 200 && res.status != 202)) {
+            record(w, started, 0, 0);
+            return 0;
+        }
+        if (res.status == 200) {
+            record(w, started, 1, res.body_length);
+            return 0;
+        }
+        if ((now_us() - started) / 1000 > BENCH_THUMB_TIMEOUT_MS) {
+            record(w, started, 0, 0);
+            return 0;
+        }
+        struct timespec pause = {0, 20 * 1000 * 1000};
+        nanosleep(&pause, NULL);
+    }
+}
+
+static const scenario_t k_scenarios[] = {
+    {"login", step_login, 0, 0},
+    {"browse", step_browse, 1, 0},
+    {"stream", step_stream, 1, 0},
+    {"history", step_history, 1, 0},
+    {"thumbnail", step_thumbnail, 1, 1},
+};
+
+static void *worker_main(void *arg) {
+    worker_t *w = arg;
+    if (w->scenario->needs_session &&
+        login_as(&w->conn, w->index % g_users, w->cookie, sizeof(w->cookie), NULL) != 0) {
+        w->errors++;
+        return NULL;
+    }
+    while (w->scenario->once || now_us() < w->deadline_us) {
+        if (w->scenario->step(w) != 0) {
+            break;
+        }
+    }
+    conn_close(&w->conn);
+    return NULL;
+}
+
+static int compare_u32(const void *a, const void *b) {
+    uint32_t x = *(const uint32_t *)a;
+    uint32_t y = *(const uint32_t *)b;
+    return (x > y) - (x < y);
+}
+
+static double percentile_ms(const uint32_t *sorted, size_t count, double p) {
+    if (count == 0) {
+        return 0.0;
+    }
+    size_t rank = (size_t)(p * (double)count + 0.999999);
+    if (rank < 1) rank = 1;
+    if (rank > count) rank = count;
+    return (double)sorted[rank - 1] / 1000.0;
+}
+
+static int run_scenario(const scenario_t *scenario, int concurrency, int seconds, uint64_t seed) {
+    worker_t *workers = calloc((size_t)concurrency, sizeof(*workers));
+    pthread_t *threads = calloc((size_t)concurrency, sizeof(*threads));
+    if (!workers || !threads) {
+        free(workers);
+        free(threads);
+        return -1;
+    }
+    atomic_store(&g_thumb_next, 0);
+    uint64_t started = now_us();
+    int launched = 0;
+    for (int i = 0; i < concurrency; ++i) {
+        workers[i].index = i;
+        workers[i].conn.fd = -1;
+        workers[i].rng = (seed + 1) * 0x9E3779B97F4A7C15ULL + (uint64_t)i * 0xBF58476D1CE4E5B9ULL;
+        workers[i].scenario = scenario;
+        workers[i].deadline_us = started + (uint64_t)seconds * 1000000ULL;
+        if (pthread_create(&threads[i], NULL, worker_main, &workers[i]) != 0) {
+            break;
+        }
+        launched++;
+    }
+    size_t total = 0;
+    uint64_t requests = 0;
+    uint64_t errors = 0;
+    uint64_t bytes = 0;
+    for (int i = 0; i < launched; ++i) {
+        pthread_join(threads[i], NULL);
+        total += workers[i].latency_count;
+    }
+    double elapsed = (double)(now_us() - started) / 1e6;
+    uint32_t *all = malloc((total ? total : 1) * sizeof(*all));
+    size_t at = 0;
+    for (int i = 0; i < launched; ++i) {
+        if (all) {
+            memcpy(all + at, workers[i].latency_us, workers[i].latency_count * sizeof(*all));
+            at += workers[i].latency_count;
+        }
+        requests += workers[i].requests;
+        errors += workers[i].errors;
+        bytes += workers[i].bytes;
+        free(workers[i].latency_us);
+    }
+    if (all) {
+        qsort(all, at, sizeof(*all), compare_u32);
+    }
+    printf("%-10s %9llu %7llu %10.1f %9.2f %9.3f %9.3f %9.3f\n", scenario->name, (unsigned long long)requests,
+           (unsigned long long)errors, elapsed > 0 ? (double)requests / elapsed : 0.0,
+           elapsed > 0 ? (double)bytes / elapsed / (1024.0 * 1024.0) : 0.0, percentile_ms(all, at, 0.50),
+           percentile_ms(all, at, 0.99), percentile_ms(all, at, 0.999));
+    fflush(stdout);
+    free(all);
+    free(workers);
+    free(threads);
+    return launched == concurrency ? 0 : -1;
+}
+
+static int resolve(const char *host, const char *port) {
+    struct addrinfo hints = {0};
+    struct addrinfo *result = NULL;
+    hints.ai_socktype = SOCK_STREAM;
+    if (getaddrinfo(host, port, &hints, &result) != 0 || !result) {
+        return -1;
+    }
+    memcpy(&g_addr, result->ai_addr, result->ai_addrlen);
+    g_addr_len = result->ai_addrlen;
+    freeaddrinfo(result);
+    return 0;
+}
+
+// 서버가 준비될 때까지 기다린다 (최대 timeout_ms). 연결만으로는 부족하다:
+// 첫 미디어 동기화 전에는 카탈로그가 비어 있을 수 있으므로 /healthz가 200을 줄 때까지 본다.
+static int wait_for_server(int timeout_ms) {
+    uint64_t deadline = now_us() + (uint64_t)timeout_ms * 1000ULL;
+    conn_t conn = {.fd = -1};
+    char request[128];
+    size_t len = format_request(request, sizeof(request), "GET", "/healthz", NULL, NULL, NULL);
+    int status = 0;
+    while (now_us() < deadline) {
+        response_t res;
+        if (roundtrip(&conn, request, len, &res, NULL, 0) == 0) {
+            status = res.status;
+            if (status == 200) {
+                conn_close(&conn);
+                return 0;
+            }
+        }
+        struct timespec pause = {0, 100 * 1000 * 1000};
+        nanosleep(&pause, NULL);
+    }
+    conn_close(&conn);
+    if (status != 0) {
+        fprintf(stderr, "bench: /healthz still answering %d\n", status);
+    }
+    return -1;
+}
+
+// 사용자를 가입시키고(이미 있으면 그대로 둔다) 카탈로그 전체를 훑어 비디오 번호와 크기를 모은다.
+static int seed_and_index(void) {
+    conn_t conn = {.fd = -1};
+    for (int i = 0; i < g_users; ++i) {
+        char body[192];
+        char request[512];
+        snprintf(body, sizeof(body),
+                 "{\"username\":\"bench%03d\",\"password\":\"" BENCH_PASSWORD "\",\"confirmPassword\":\"" BENCH_PASSWORD
+                 "\"}",
+                 i);
+        size_t len = format_request(request, sizeof(request), "POST", "/api/auth/register", NULL, NULL, body);
+        response_t res;
+        if (roundtrip(&conn, request, len, &res, NULL, 0) != 0 || (res.status != 201 && res.status != 200 && res.status != 409)) {
+            fprintf(stderr, "bench: failed to register bench%03d (status %d)\n", i, res.status);
+            conn_close(&conn);
+            return -1;
+        }
+    }
+    char cookie[160];
+    int status = 0;
+    if (login_as(&conn, 0, cookie, sizeof(cookie), &status) != 0) {
+        fprintf(stderr, "bench: seed login failed (status %d)\n", status);
+        conn_close(&conn);
+        return -1;
+    }
+    char target[512] = "/api/videos?limit=50";
+    static char body[1 << 20];
+    g_video_count = 0;
+    for (;;) {
+        char request[1024];
+        size_t len = format_request(request, sizeof(request), "GET", target, cookie, NULL, NULL);
+        response_t res;
+        if (roundtrip(&conn, request, len, &res, body, sizeof(body)) != 0 || res.status != 200) {
+            conn_close(&conn);
+            return -1;
+        }
+        for (const char *p = strstr(body, "{\"id\":"); p && g_video_count < BENCH_MAX_VIDEOS;
+             p = strstr(p + 1, "{\"id\":")) {
+            g_video_ids[g_video_count++] = atoi(p + 6);
+        }
+        const char *cursor = strstr(body, "\"nextCursor\":\"");
+        if (!cursor || g_video_count >= BENCH_MAX_VIDEOS) {
+            break;
+        }
+        cursor += strlen("\"nextCursor\":\"");
+        snprintf(target, sizeof(target), "/api/videos?limit=50&cursor=%.*s", (int)strcspn(cursor, "\""), cursor);
+    }
+    // 목록에는 파일 크기가 없으므로 첫 바이트만 Range로 받아 Content-Range의 전체 길이를 읽는다.
+    for (int i = 0; i < g_video_count; ++i) {
+        char request[512];
+        char range_target[96];
+        snprintf(range_target, sizeof(range_target), "/api/videos/%d/stream", g_video_ids[i]);
+        size_t len = format_request(request, sizeof(request), "GET", range_target, cookie, "Range: bytes=0-0\r\n", NULL);
+        response_t res;
+        g_video_sizes[i] = 0;
+        if (roundtrip(&conn, request, len, &res, NULL, 0) == 0 && res.status == 206) {
+            g_video_sizes[i] = res.total_length;
+        }
+        if (g_video_sizes[i] <= 0) {
+            g_video_sizes[i] = 1; // 모르면 처음부터 받는다
+        }
+    }
+    conn_close(&conn);
+    printf("seeded %d users, %d videos in catalogue\n", g_users, g_video_count);
+    return 0;
+}
+
+static void usage(void) {
+    fprintf(stderr,
+            "usage: bench_load fixture DIR COUNT [SEED]\n"
+            "       bench_load run [-H host] [-p port] [-u users] [-c concurrency] [-d seconds]\n"
+            "                      [-s login,browse,stream,history,thumbnail] [-S seed]\n");
+}
+
+static int cmd_run(int argc, char **argv) {
+    const char *host = "127.0.0.1";
+    const char *port = "18080";
+    const char *only = NULL;
+    int concurrency = 8;
+    int seconds = 5;
+    uint64_t seed = 1;
+    for (int i = 0; i < argc; ++i) {
+        const char *value = i + 1 < argc ? argv[i + 1] : NULL;
+        if (!value || argv[i][0] != '-' || argv[i][2] != '\0') {
+            usage();
+            return 2;
+        }
+        switch (argv[i][1]) {
+        case 'H': host = value; break;
+        case 'p': port = value; break;
+        case 'u': g_users = atoi(value); break;
+        case 'c': concurrency = atoi(value); break;
+        case 'd': seconds = atoi(value); break;
+        case 's': only = value; break;
+        case 'S': seed = strtoull(value, NULL, 10); break;
+        default: usage(); return 2;
+        }
+        ++i;
+    }
+    if (g_users < 1) g_users = 1;
+    if (concurrency < 1) concurrency = 1;
+    if (seconds < 1) seconds = 1;
+    if (resolve(host, port) != 0 || wait_for_server(15000) != 0) {
+        fprintf(stderr, "bench: server %s:%s not reachable\n", host, port);
+        return 1;
+    }
+    if (seed_and_index() != 0) {
+        return 1;
+    }
+    printf("%d connections, %d s per scenario, seed %llu\n", concurrency, seconds, (unsigned long long)seed);
+    printf("%-10s %9s %7s %10s %9s %9s %9s %9s\n", "scenario", "requests", "errors", "req/s", "MiB/s", "p50 ms",
+           "p99 ms", "p999 ms");
+    int rc = 0;
+    for (size_t i = 0; i < sizeof(k_scenarios) / sizeof(k_scenarios[0]); ++i) {
+        if (only) {
+            size_t name_len = strlen(k_scenarios[i].name);
+            const char *hit = strstr(only, k_scenarios[i].name);
+            if (!hit || (hit != only && hit[-1] != ',') || (hit[name_len] != '\0' && hit[name_len] != ',')) {
+                continue;
+            }
+        }
+        if (run_scenario(&k_scenarios[i], concurrency, seconds, seed + i) != 0) {
+            rc = 1;
+        }
+    }
+    return rc;
+}
+
+int main(int argc, char **argv) {
+    if (argc >= 4 && strcmp(argv[1], "fixture") == 0) {
+        int count = atoi(argv[3]);
+        if (count < 1 || count > BENCH_MAX_VIDEOS) {
+            fprintf(stderr, "bench: COUNT must be 1-%d\n", BENCH_MAX_VIDEOS);
+            return 2;
+        }
+        return cmd_fixture(argv[2], count, argc >= 5 ? strtoull(argv[4], NULL, 10) : 1);
+    }
+    if (argc >= 2 && strcmp(argv[1], "run") == 0) {
+        return cmd_run(argc - 2, argv + 2);
+    }
+    usage();
+    return 2;
+}
@@ -0,0 +1,248 @@
+// 요청 경로 구성 요소별 마이크로벤치: HTTP 파서, 라우터, JSON 헬퍼를 서버 오브젝트와 그대로 링크해 잰다.
+// 배치마다 op당 시간을 재고 배치 분포의 최솟값/중앙값/p99를 출력한다 (회귀 확인용).
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "http.h"
+#include "router.h"
+#include "server.h"
+#include "utils.h"
+
+#define MICRO_BATCHES 101
+#define MICRO_BATCH_NS 2000000ULL // 배치 하나의 목표 시간 (2ms)
+#define MICRO_BUFFER_CAPACITY 8192 // http.c의 초기 버퍼 크기 (더 크면 소비 후 버퍼를 돌려준다)
+
+typedef struct {
+    const char *name;
+    void (*run)(size_t iterations);
+} micro_case_t;
+
+static volatile size_t g_sink; // 결과를 버리지 않게 해 최적화로 사라지지 않도록 한다
+static server_ctx_t g_server;
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static const char k_get_request[] =
+    "GET /api/videos/42/stream HTTP/1.1\r\n"
+    "Host: localhost:3000\r\n"
+    "User-Agent: Mozilla/5.0 (X11; Linux x86_64) AppleWebKit/537.36 (KHTML, like Gecko) Chrome/120.0 Safari/537.36\r\n"
+    "Accept: */*\r\n"
+    "Accept-Encoding: identity;q=1, *;q=0\r\n"
+    "Accept-Language: ko-KR,ko;q=0.9,en-US;q=0.8\r\n"
+    "Cookie: ott_session=3q2-7wAAAAB8d2hhdC1pcy10aGlzLXRva2VuLWZvcg\r\n"
+    "Range: bytes=1048576-\r\n"
+    "Referer: http://localhost:3000/player.html?id=42\r\n"
+    "Connection: keep-alive\r\n"
+    "\r\n";
+
+static const char k_post_request[] =
+    "POST /api/history/42 HTTP/1.1\r\n"
+    "Host: localhost:3000\r\n"
+    "Content-Type: application/json\r\n"
+    "Cookie: ott_session=3q2-7wAAAAB8d2hhdC1pcy10aGlzLXRva2VuLWZvcg\r\n"
+    "Content-Length: 18\r\n"
+    "\r\n"
+    "{\"position\":512.5}";
+
+// 연결 버퍼에 이미 도착한 요청을 파싱하고 소비한다 (recv 없이 파서만 돈다).
+static void parse_buffered(const char *raw, size_t raw_len, size_t iterations) {
+    http_buffer_t buffer = {0};
+    buffer.data = malloc(MICRO_BUFFER_CAPACITY);
+    if (!buffer.data) {
+        return;
+    }
+    buffer.capacity = MICRO_BUFFER_CAPACITY;
+    http_request_t req;
+    for (size_t i = 0; i < iterations; ++i) {
+        memcpy(buffer.data, raw, raw_len);
+        buffer.length = raw_len;
+        if (http_parse_request(-1, &req, &buffer) == 0) {
+            g_sink += req.header_count + req.body_length;
+            http_buffer_consume(&buffer, req.raw_length);
+        }
+    }
+    free(buffer.data);
+}
+
+static void bench_parse_get(size_t iterations) {
+    parse_buffered(k_get_request, sizeof(k_get_request) - 1, iterations);
+}
+
+static void bench_parse_post(size_t iterations) {
+    parse_buffered(k_post_request, sizeof(k_post_request) - 1, iterations);
+}
+
+static void noop_handler(request_ctx_t *ctx) {
+    g_sink += ctx->param_count;
+}
+
+// main.c의 라우트 테이블과 같은 패턴 (핸들러만 빈 함수)
+static const route_entry_t k_routes[] = {
+    {HTTP_POST, "/api/auth/login", noop_handler, 1},
+    {HTTP_POST, "/api/auth/register", noop_handler, 1},
+    {HTTP_POST, "/api/auth/logout", noop_handler, 1},
+    {HTTP_GET, "/api/auth/me", noop_handler, 0},
+    {HTTP_GET, "/api/videos", noop_handler, 0},
+    {HTTP_GET, "/api/videos/:id/stream", noop_handler, 0},
+    {HTTP_GET, "/api/videos/:id/thumbnail", noop_handler, 0},
+    {HTTP_GET, "/api/videos/:id/previews", noop_handler, 0},
+    {HTTP_GET, "/api/videos/:id/previews/sprite.jpg", noop_handler, 0},
+    {HTTP_GET, "/api/videos/:id/hls/master.m3u8", noop_handler, 0},
+    {HTTP_GET, "/api/videos/:id/hls/:version/:rendition/:file", noop_handler, 0},
+    {HTTP_GET, "/api/history", noop_handler, 0},
+    {HTTP_POST, "/api/history/:id", noop_handler, 0},
+    {HTTP_POST, "/api/admin/rescan", noop_handler, 1},
+    {HTTP_GET, "/api/admin/sessions", noop_handler, 0},
+    {HTTP_GET, "/api/admin/media", noop_handler, 0},
+    {HTTP_GET, "/metrics", noop_handler, 0},
+    {HTTP_GET, "/healthz", noop_handler, 0},
+};
+
+static void route_path(http_method_t method, const char *path, size_t iterations) {
+    char buffer[256];
+    snprintf(buffer, sizeof(buffer), "%s", path);
+    http_request_t req = {0};
+    req.method = method;
+    req.path = buffer;
+    req.query = buffer + strlen(buffer);
+    request_ctx_t ctx = {0};
+    ctx.server = &g_server;
+    ctx.client_fd = -1;
+    ctx.request = &req;
+    for (size_t i = 0; i < iterations; ++i) {
+        router_handle(&ctx);
+    }
+}
+
+static void bench_route_static(size_t iterations) {
+    route_path(HTTP_GET, "/api/videos", iterations);
+}
+
+static void bench_route_param(size_t iterations) {
+    route_path(HTTP_GET, "/api/videos/42/stream", iterations);
+}
+
+static void bench_route_deep(size_t iterations) {
+    route_path(HTTP_GET, "/api/videos/42/hls/1700000000/720p/segment-00042.m4s", iterations);
+}
+
+static void bench_json_escape(size_t iterations) {
+    static const char title[] = "카카오는 이제 가난하다고 \"MV\" 720p\t(Official)\\ver.2";
+    string_builder_t sb;
+    if (sb_init(&sb, 256) != 0) {
+        return;
+    }
+    for (size_t i = 0; i < iterations; ++i) {
+        sb.length = 0;
+        sb_append_json_string(&sb, title);
+    }
+    g_sink += sb.length;
+    sb_free(&sb);
+}
+
+static void bench_json_row(size_t iterations) {
+    string_builder_t sb;
+    if (sb_init(&sb, 512) != 0) {
+        return;
+    }
+    for (size_t i = 0; i < iterations; ++i) {
+        sb.length = 0;
+        int id = (int)(i & 1023);
+        sb_append(&sb, "{\"id\":%d,\"title\":", id);
+        sb_append_json_string(&sb, "green hills");
+        sb_append(&sb, ",\"duration\":%d,\"thumbnailUrl\":\"/api/videos/%d/thumbnail\""
+                       ",\"streamUrl\":\"/api/videos/%d/stream\"",
+                  600, id, id);
+    }
+    g_sink += sb.length;
+    sb_free(&sb);
+}
+
+static void bench_json_get_string(size_t iterations) {
+    static const char body[] = "{\"username\":\"bench001\",\"password\":\"correct horse battery\"}";
+    char out[128];
+    for (size_t i = 0; i < iterations; ++i) {
+        if (json_get_string(body, "password", out, sizeof(out)) == 0) {
+            g_sink += (size_t)out[0];
+        }
+    }
+}
+
+static void bench_json_get_double(size_t iterations) {
+    static const char body[] = "{\"position\":512.5,\"duration\":3600}";
+    double value = 0;
+    for (size_t i = 0; i < iterations; ++i) {
+        if (json_get_double(body, "position", &value) == 0) {
+            g_sink += (size_t)value;
+        }
+    }
+}
+
+static const micro_case_t k_cases[] = {
+    {"http_parse_request GET", bench_parse_get},
+    {"http_parse_request POST", bench_parse_post},
+    {"router_handle static", bench_route_static},
+    {"router_handle :id", bench_route_param},
+    {"router_handle hls file", bench_route_deep},
+    {"sb_append_json_string", bench_json_escape},
+    {"catalog row (sb_append)", bench_json_row},
+    {"json_get_string", bench_json_get_string},
+    {"json_get_double", bench_json_get_double},
+};
+
+static int compare_double(const void *a, const void *b) {
+    double x = *(const double *)a;
+    double y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+// 배치 하나가 MICRO_BATCH_NS 정도 걸리도록 반복 횟수를 맞춘 뒤 배치별 op당 시간을 모은다.
+static void run_case(const micro_case_t *c) {
+    size_t iterations = 64;
+    for (;;) {
+        uint64_t started = now_ns();
+        c->run(iterations);
+        uint64_t elapsed = now_ns() - started;
+        if (elapsed >= MICRO_BATCH_NS / 2 || iterations >= ((size_t)1 << 30)) {
+            if (elapsed > 0 && elapsed < MICRO_BATCH_NS) {
+                iterations = (size_t)((double)iterations * (double)MICRO_BATCH_NS / (double)elapsed);
+            }
+            break;
+        }
+        iterations *= 2;
+    }
+    double per_op[MICRO_BATCHES];
+    for (int i = 0; i < MICRO_BATCHES; ++i) {
+        uint64_t started = now_ns();
+        c->run(iterations);
+        per_op[i] = (double)(now_ns() - started) / (double)iterations;
+    }
+    qsort(per_op, MICRO_BATCHES, sizeof(per_op[0]), compare_double);
+    double median = per_op[MICRO_BATCHES / 2];
+    printf("%-26s %10.1f %10.1f %10.1f %12.2f\n", c->name, per_op[0], median, per_op[MICRO_BATCHES * 99 / 100],
+           median > 0 ? 1000.0 / median : 0.0);
+    fflush(stdout);
+}
+
+int main(int argc, char **argv) {
+    // 인자가 있으면 이름에 그 문자열이 들어간 항목만 돌린다.
+    const char *filter = argc > 1 ? argv[1] : NULL;
+    if (router_set_routes(k_routes, ARRAY_SIZE(k_routes)) != 0) {
+        fprintf(stderr, "bench_micro: failed to compile routes\n");
+        return 1;
+    }
+    printf("%-26s %10s %10s %10s %12s\n", "benchmark", "min ns/op", "p50 ns/op", "p99 ns/op", "Mops/s");
+    for (size_t i = 0; i < ARRAY_SIZE(k_cases); ++i) {
+        if (!filter || strstr(k_cases[i].name, filter)) {
+            run_case(&k_cases[i]);
+        }
+    }
+    router_shutdown();
+    return 0;
+}
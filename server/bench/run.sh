@@ -0,0 +1,35 @@
+#!/bin/sh
+# make bench가 호출한다: 픽스처를 준비하고, 빈 DB/썸네일 디렉터리로 서버를 띄운 뒤 혼합 부하를 돌린다.
+# 서버 설정(REACTOR_THREADS, WORKER_QUEUE_LIMIT 등)은 호출한 쪽 환경 변수를 그대로 물려받는다.
+set -eu
+
+cd "$(dirname "$0")/.."
+
+BENCH_BIN=${BENCH_BIN:-build/bench}
+BENCH_VIDEOS=${BENCH_VIDEOS:-24}
+BENCH_USERS=${BENCH_USERS:-16}
+BENCH_DURATION=${BENCH_DURATION:-5}
+BENCH_CONCURRENCY=${BENCH_CONCURRENCY:-8}
+BENCH_PORT=${BENCH_PORT:-18080}
+BENCH_SEED=${BENCH_SEED:-1}
+BENCH_SCENARIOS=${BENCH_SCENARIOS:-login,browse,stream,history,thumbnail}
+
+# 픽스처는 개수별로 한 번만 만들고, 상태(DB, 썸네일)는 매번 비워 콜드 스타트부터 잰다.
+media="$BENCH_BIN/media-$BENCH_VIDEOS"
+work="$BENCH_BIN/run"
+rm -rf "$work"
+mkdir -p "$work/data" "$work/thumbs"
+"$BENCH_BIN/bench_load" fixture "$media" "$BENCH_VIDEOS" "$BENCH_SEED"
+
+PORT=$BENCH_PORT MEDIA_DIR=$media DATA_DIR=$work/data THUMB_DIR=$work/thumbs \
+    ./ott_server > "$work/server.log" 2>&1 &
+server_pid=$!
+trap 'kill -INT $server_pid 2>/dev/null || true; wait $server_pid 2>/dev/null || true' EXIT INT TERM
+
+status=0
+"$BENCH_BIN/bench_load" run -p "$BENCH_PORT" -u "$BENCH_USERS" -c "$BENCH_CONCURRENCY" \
+    -d "$BENCH_DURATION" -s "$BENCH_SCENARIOS" -S "$BENCH_SEED" || status=$?
+if [ "$status" -ne 0 ]; then
+    echo "bench: load run failed; server log in $work/server.log" >&2
+fi
+exit "$status"
@@ -8,10 +8,12 @@
 #include "router.h"
 
 int auth_initialize(server_ctx_t *server);
+void auth_shutdown(server_ctx_t *server);
 void auth_handle_login(request_ctx_t *ctx);
 void auth_handle_register(request_ctx_t *ctx);
 void auth_handle_logout(request_ctx_t *ctx);
 void auth_handle_me(request_ctx_t *ctx);
+void auth_handle_session_stats(request_ctx_t *ctx);
 int auth_authenticate_request(request_ctx_t *ctx);
 int auth_hash_password(const char *password, unsigned char *salt_out, size_t salt_len,
                        unsigned char *hash_out, size_t hash_len);
@@ -0,0 +1,44 @@
+#ifndef CATALOG_CACHE_H
+#define CATALOG_CACHE_H
+
+// /api/videos 응답용 비디오별 JSON 조각과 페이지 구성 캐시 선언 (카탈로그 세대 단위로 무효화)
+
+#include <stddef.h>
+
+#define CATALOG_FRAGMENT_BUCKETS 1024
+#define CATALOG_PAGE_BUCKETS 64
+#define CATALOG_PAGE_CAPACITY 256 // 이보다 많은 페이지가 쌓이면 페이지 목록만 비운다
+#define CATALOG_CURSOR_MAX 96     // 페이지 커서 토큰 최대 길이(널 포함)
+
+// 사용자별 값(resumeSeconds)을 뺀 비디오 한 건의 JSON. 닫는 중괄호 없이 "streamUrl"까지 담는다.
+typedef struct {
+    int video_id;
+    char *json;
+    size_t length;
+} catalog_row_t;
+
+// 한 번의 db_query_videos 결과. 캐시에 넣으면 조각의 소유권이 캐시로 넘어간다.
+typedef struct {
+    catalog_row_t *rows;
+    size_t count;
+    size_t capacity;
+    int has_more;
+    char next_cursor[CATALOG_CURSOR_MAX]; // 다음 페이지 커서 토큰 (마지막 페이지면 빈 문자열)
+} catalog_page_t;
+
+// 조각 하나를 응답에 덧붙이는 콜백. 캐시 잠금 안에서 불리므로 조각 포인터를 보관하면 안 된다.
+typedef int (*catalog_emit_fn)(void *userdata, int video_id, const char *json, size_t length);
+
+int catalog_page_add_row(catalog_page_t *page, int id, const char *title,
+                         const char *filename, const char *description, int duration_seconds);
+int catalog_page_emit(const catalog_page_t *page, catalog_emit_fn emit, void *userdata);
+void catalog_page_free(catalog_page_t *page);
+
+int catalog_cache_get(unsigned long generation, const char *query, const char *cursor, int limit,
+                      catalog_emit_fn emit, void *userdata, size_t *emitted_out, int *has_more_out,
+                      char *next_cursor_out, size_t next_cursor_len);
+void catalog_cache_put(unsigned long generation, const char *query, const char *cursor, int limit,
+                       catalog_page_t *page);
+void catalog_cache_clear(void);
+
+#endif
@@ -8,12 +8,69 @@
 #include <time.h>
 #include <stddef.h>
 
+#include "mp4.h"
+
+// 미디어 동기화 배치의 항목 하나 (title이 NULL이면 삭제)
+typedef struct {
+    const char *filename;
+    const char *old_filename; // 이름 변경이면 이전 파일명: 행의 filename/title만 바꿔 id(시청 기록, 썸네일)를 유지한다
+    const char *title;
+    long long file_size;
+    long long file_mtime;
+    mp4_info_t media; // 박스 인덱서 결과 (길이, 코덱, 해상도, moov/mdat 위치)
+    int video_id; // 반영 후 채워진다: upsert로 실제 바뀐 행의 ID (그대로거나 삭제면 0)
+} db_media_change_t;
+
+// 쓰기 지연 버퍼에서 한꺼번에 반영할 시청 위치 한 건
+typedef struct {
+    int user_id;
+    int video_id;
+    double position_seconds;
+    time_t updated_at;
+} db_history_update_t;
+
+// 비디오 목록 keyset 커서: 마지막으로 보낸 행의 키 (검색이면 rank도 함께 비교한다)
+typedef struct {
+    int id;
+    double rank;
+} db_video_cursor_t;
+
+// 시청 기록 keyset 커서: (updated_at, video_id) 내림차순에서 마지막으로 보낸 행
+typedef struct {
+    char updated_at[32];
+    int video_id;
+} db_history_cursor_t;
+
+// 연결 하나가 보관하는 준비된 문장 수 (SQL 문자열 리터럴 주소를 키로 쓴다).
+// db.c의 SQL 호출부 수보다 커야 한다. 교체하지 않으므로 넘치면 db_prepare가 실패한다.
+#define DB_STMT_CACHE_SIZE 48
+
+typedef struct {
+    const char *sql;
+    sqlite3_stmt *stmt;
+} db_stmt_slot_t;
+
+// SQLite 핸들과 그 연결 전용 준비된 문장 캐시. 한 번에 한 스레드만 사용한다.
+typedef struct db_conn {
+    sqlite3 *handle;
+    db_stmt_slot_t stmts[DB_STMT_CACHE_SIZE];
+    size_t stmt_count;
+    struct db_conn *next_free; // 읽기 풀의 유휴 연결 목록
+} db_conn_t;
+
 typedef struct {
-    sqlite3 *conn;        // SQLite 핸들
-    pthread_mutex_t mutex; // 단일 연결을 여러 스레드에서 보호하기 위한 뮤텍스
+    db_conn_t writer;          // 모든 쓰기와 스키마 작업을 담당하는 단일 연결
+    pthread_mutex_t mutex;     // writer 연결 직렬화
+    db_conn_t *readers;        // WAL 동시 읽기용 읽기 전용 연결 풀
+    size_t reader_count;
+    db_conn_t *free_readers;
+    pthread_mutex_t pool_lock;
+    pthread_cond_t pool_cond;
+    int has_search_index;      // videos_fts(FTS5 trigram) 사용 가능 여부
 } db_ctx_t;
 
 int db_init(db_ctx_t *db, const char *path);
+int db_open_readers(db_ctx_t *db, const char *path, size_t count);
 void db_close(db_ctx_t *db);
 int db_run_schema(db_ctx_t *db, const char *schema_path);
 const char *db_errmsg(db_ctx_t *db);
@@ -39,27 +96,38 @@ int db_list_videos(db_ctx_t *db,
                                    const char *filename, const char *description,
                                    int duration_seconds),
                    void *userdata);
-int db_query_videos(db_ctx_t *db, const char *search_term, int limit, int offset,
+int db_query_videos(db_ctx_t *db, const char *search_term, int limit,
+                    const db_video_cursor_t *after,
                     int (*callback)(void *userdata, int id, const char *title,
                                     const char *filename, const char *description,
                                     int duration_seconds),
-                    void *userdata, int *has_more_out);
+                    void *userdata, int *has_more_out, db_video_cursor_t *last_out);
 int db_get_video_by_id(db_ctx_t *db, int video_id,
                        char *title_out, size_t title_len,
                        char *filename_out, size_t filename_len,
                        char *description_out, size_t desc_len,
                        int *duration_seconds_out);
-int db_upsert_video(db_ctx_t *db, const char *title, const char *filename,
-                    const char *description, int duration_seconds, int *video_id_out);
-int db_delete_video_by_filename(db_ctx_t *db, const char *filename);
-int db_prune_missing_videos(db_ctx_t *db, const char *const *filenames, size_t count);
+int db_list_video_fingerprints(db_ctx_t *db,
+                               int (*callback)(void *userdata, const char *filename,
+                                               long long file_size, long long file_mtime),
+                               void *userdata);
+int db_apply_media_changes(db_ctx_t *db, db_media_change_t *changes, size_t count,
+                           size_t *applied_out, unsigned long *generation_out);
+int db_get_catalog_generation(db_ctx_t *db, unsigned long *generation_out);
 
 int db_update_watch_history(db_ctx_t *db, int user_id, int video_id, double position_seconds);
+int db_flush_watch_history(db_ctx_t *db, const db_history_update_t *updates, size_t count);
 int db_get_watch_history(db_ctx_t *db, int user_id, int video_id, double *position_seconds_out);
 int db_list_watch_history(db_ctx_t *db, int user_id,
                           int (*callback)(void *userdata, int video_id, double position_seconds,
                                           const char *updated_at),
                           void *userdata);
+int db_list_watch_history_titles(db_ctx_t *db, int user_id,
+                                 const db_history_cursor_t *before, int limit,
+                                 int (*callback)(void *userdata, int video_id,
+                                                 double position_seconds,
+                                                 const char *updated_at, const char *title),
+                                 void *userdata);
 int db_get_username_by_id(db_ctx_t *db, int user_id, char *username_out, size_t len);
 
 #endif
@@ -1,15 +1,32 @@
 #ifndef FFMPEG_H
 #define FFMPEG_H
 
-// 외부 ffmpeg 실행을 통한 썸네일 생성 API
+// 외부 ffmpeg 실행을 통한 썸네일/탐색 미리보기 생성 API (백그라운드 작업 큐)
 
 #include <stddef.h>
 
 #include "server.h"
 
+typedef enum {
+    FFMPEG_JOB_POSTER,   // 목록/플레이어 포스터 한 장 (<id>.jpg)
+    FFMPEG_JOB_PREVIEWS, // 탐색 미리보기 스프라이트 + WebVTT (<id>.sprite.jpg, <id>.vtt)
+    FFMPEG_JOB_FASTSTART, // moov를 mdat 앞으로 옮겨 원본을 교체 (ffmpeg 없이 mp4.c가 처리)
+    FFMPEG_JOB_HLS,      // 비트레이트 사다리별 fMP4(CMAF) 세그먼트 + HLS 재생 목록 (<hls_dir>/<id>/)
+} ffmpeg_job_kind_t;
+
 int ffmpeg_initialize(server_ctx_t *server);
-int ffmpeg_ensure_thumbnail(server_ctx_t *server, int video_id,
-                            const char *video_path, char *thumb_path,
-                            size_t thumb_path_len);
+void ffmpeg_shutdown(void);
+// 0: 썸네일 준비됨, 1: 생성 대기 중, -1: 생성할 수 없음
+int ffmpeg_request_thumbnail(server_ctx_t *server, int video_id,
+                             const char *video_path, char *thumb_path,
+                             size_t thumb_path_len);
+int ffmpeg_request_previews(server_ctx_t *server, int video_id, int duration_seconds,
+                            const char *video_path, char *vtt_path, size_t vtt_path_len,
+                            char *sprite_path, size_t sprite_path_len);
+// HLS 패키지가 원본보다 새로우면 0과 패키지 디렉터리를 돌려준다 (반환값은 위와 같다).
+int ffmpeg_request_hls(server_ctx_t *server, int video_id, const char *video_path,
+                       char *dir_out, size_t dir_len);
+void ffmpeg_queue_video(server_ctx_t *server, int video_id, const char *video_path, int duration_seconds);
+void ffmpeg_queue_faststart(server_ctx_t *server, int video_id, const char *video_path);
 
 #endif
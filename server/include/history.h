@@ -1,10 +1,19 @@
 #ifndef HISTORY_H
 #define HISTORY_H
 
-// 시청 기록 관련 API 핸들러 선언
+// 시청 기록 관련 API 핸들러와 진행 위치 쓰기 지연 버퍼 선언
+
+#include <time.h>
 
 #include "router.h"
 
+int history_initialize(server_ctx_t *server);
+void history_shutdown(server_ctx_t *server);
+int history_overlay_user(int user_id,
+                         int (*callback)(void *userdata, int video_id, double position_seconds,
+                                         time_t updated_at),
+                         void *userdata);
+
 void history_handle_get(request_ctx_t *ctx);
 void history_handle_update(request_ctx_t *ctx);
 
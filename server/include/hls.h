@@ -0,0 +1,11 @@
+#ifndef HLS_H
+#define HLS_H
+
+// /api/videos/:id/hls/ 아래의 HLS 재생 목록과 fMP4(CMAF) 세그먼트 엔드포인트 선언
+
+#include "router.h"
+
+void hls_handle_master(request_ctx_t *ctx);
+void hls_handle_file(request_ctx_t *ctx);
+
+#endif
@@ -5,7 +5,10 @@
 
 #include <stddef.h>
 #include <stdint.h>
+#include <sys/stat.h>
 #include <sys/types.h>
+#include <sys/uio.h>
+#include <time.h>
 
 typedef enum {
     HTTP_GET,
@@ -21,29 +24,113 @@ typedef struct {
     char *value;
 } http_header_t;
 
+// 파싱 시점에 바로 색인해 두는 헤더 (http_get_header도 이 이름은 선형 탐색 없이 찾는다)
+typedef enum {
+    HTTP_HDR_CONTENT_LENGTH,
+    HTTP_HDR_TRANSFER_ENCODING,
+    HTTP_HDR_CONNECTION,
+    HTTP_HDR_COOKIE,
+    HTTP_HDR_RANGE,
+    HTTP_HDR_IF_RANGE,
+    HTTP_HDR_IF_NONE_MATCH,
+    HTTP_HDR_IF_MODIFIED_SINCE,
+    HTTP_HDR_ACCEPT_ENCODING,
+    HTTP_HDR_KNOWN_COUNT
+} http_known_header_t;
+
+// 문자열 필드는 모두 연결 수신 버퍼 안을 가리킨다 (제자리에서 널 종료). 다음 요청을 읽기 전까지만 유효하다.
 typedef struct {
     http_method_t method;
-    char path[512];
-    char query[512];
-    char http_version[16];
+    char *path;
+    char *query;        // '?' 뒤 (없으면 빈 문자열)
+    char *http_version;
     http_header_t headers[32];
     size_t header_count;
+    const char *known[HTTP_HDR_KNOWN_COUNT]; // 알려진 헤더 값 (없으면 NULL)
     char *body;
     size_t body_length;
     char *raw_data;   // 전체 요청 버퍼 (헤더+본문)
-    size_t raw_length;
-    int owns_raw_data; // 내부에서 malloc했다면 1
+    size_t raw_length; // 이번 요청이 차지하는 바이트 수 (파이프라이닝된 다음 요청은 제외)
+    int keep_alive;    // 응답 후 연결 유지를 클라이언트가 허용했는지
 } http_request_t;
 
-int http_parse_request(int fd, http_request_t *req, char *buffer, size_t bufsize);
+// 연결별 수신 버퍼: 파이프라이닝으로 미리 읽힌 다음 요청 바이트를 보존한다.
+typedef struct {
+    char *data;       // 항상 널 종료를 유지
+    size_t length;
+    size_t capacity;
+    size_t held_pos;  // 본문 널 종료를 위해 '\0'을 덮어쓴 위치
+    char held_byte;   // 그 자리에 있던 다음 요청의 첫 바이트
+    int holding;
+    size_t scan_pos;    // 헤더 끝을 이어서 찾을 위치 (이미 훑은 바이트는 다시 보지 않는다)
+    size_t header_len;  // 찾은 헤더 길이 (0이면 아직 헤더가 다 오지 않음)
+    uint64_t started_ms; // 현재 요청의 첫 바이트가 도착한 시각 (느린 클라이언트 제한용)
+} http_buffer_t;
+
+struct media_file; // media_cache.h
+
+// 헤더 송신 이후 남은 파일 본문 전송 상태 (이벤트 루프로 넘겨 논블로킹으로 이어 보낸다)
+typedef struct {
+    int file_fd;        // 전송 중인 파일 FD, 없으면 -1
+    off_t offset;       // 다음에 보낼 파일 오프셋
+    size_t remaining;   // 남은 바이트 수
+    int use_sendfile;   // sendfile 사용 여부
+    struct media_file *media; // 파일 핸들 캐시에서 빌린 핸들 (닫지 않고 반납한다), 없으면 NULL
+    off_t prefetched;   // 미리 읽기를 예약해 둔 끝 오프셋
+    uint64_t pace_rate; // 본문 송신 속도 (초당 바이트, 0이면 제한 없음)
+    uint64_t pace_burst; // 연결의 첫 스트림이면 속도 제한 없이 먼저 보낼 바이트
+} http_file_stream_t;
+
+// 파일 표현의 캐시 검증자 (조건부 요청 평가용)
+typedef struct {
+    char etag[64];          // "ino-size-mtime_ns" 형태의 강한 ETag (따옴표 포함)
+    char last_modified[32]; // IMF-fixdate
+    time_t mtime;
+} http_validator_t;
+
+// 0: 요청 완성, 1: 데이터가 더 와야 함(연결을 이벤트 루프로 돌려보낸다), -1: 오류/연결 종료
+int http_parse_request(int fd, http_request_t *req, http_buffer_t *buffer);
+void http_buffer_consume(http_buffer_t *buffer, size_t length);
+void http_buffer_free(http_buffer_t *buffer);
 const char *http_get_header(const http_request_t *req, const char *name);
+const char *http_get_known_header(const http_request_t *req, http_known_header_t id);
+int http_send_iov(int fd, struct iovec *iov, int iovcnt);
 int http_send_response(int fd, int status, const char *status_text,
                        const char *content_type, const void *body, size_t length,
-                       const char *extra_headers);
+                       const char *extra_headers, int keep_alive);
+int http_send_response_blocks(int fd, int status, const char *status_text, const char *content_type,
+                              const void *body, size_t length, const char *common_headers,
+                              const char *extra_headers, int keep_alive);
 int http_send_file_response(int fd, int status, const char *status_text,
                             const char *content_type, const char *file_path,
                             off_t offset, size_t length, int sendfile_enabled,
-                            const char *extra_headers);
+                            const char *extra_headers, int keep_alive);
+int http_begin_file_response(int fd, int status, const char *status_text,
+                             const char *content_type, const char *file_path,
+                             off_t offset, size_t length, int sendfile_enabled,
+                             const char *extra_headers, int keep_alive,
+                             http_file_stream_t *stream);
+int http_begin_media_response(int fd, int status, const char *status_text, const char *content_type,
+                              struct media_file *media, off_t offset, size_t length,
+                              const char *extra_headers, int keep_alive, http_file_stream_t *stream);
+int http_stream_send(int fd, http_file_stream_t *stream, size_t budget);
+// 캐시된 핸들의 스트림이면 방금 보낸 양을 집계하고 재생 위치 앞을 미리 읽는다.
+void http_stream_progress(http_file_stream_t *stream, size_t sent);
+void http_stream_init(http_file_stream_t *stream);
+void http_stream_close(http_file_stream_t *stream);
+void http_validator_from_stat(const struct stat *st, http_validator_t *out);
+int http_request_not_modified(const http_request_t *req, const http_validator_t *validator);
+int http_if_range_allows(const http_request_t *req, const http_validator_t *validator);
+int http_format_validator_headers(const http_validator_t *validator, const char *cache_control,
+                                  char *out, size_t out_len);
+int http_send_not_modified(int fd, const char *extra_headers, int keep_alive);
+int http_send_cacheable_file(int fd, const http_request_t *req, const char *content_type,
+                             const char *file_path, const char *cache_control,
+                             const char *extra_headers, int keep_alive);
+// 응답 헤더를 만들 때 상태와 본문 길이를 스레드별로 남긴다. 요청이 끝나면 워커가 가져가
+// 계측과 접근 로그에 넘긴다 (가져가면 지워진다; 응답을 보내지 않았으면 상태 0).
+void http_note_response(int status, size_t body_length);
+int http_take_response(size_t *body_length_out);
 void http_free_request(http_request_t *req);
 http_method_t http_method_from_string(const char *method);
 const char *http_status_text(int status);
@@ -0,0 +1,15 @@
+#ifndef LIBRARY_H
+#define LIBRARY_H
+
+// media 디렉터리와 videos 카탈로그 동기화(전체 스캔 + 증분 워처) 인터페이스
+
+#include "server.h"
+
+int library_start(server_ctx_t *server);
+int library_sync(server_ctx_t *server, int *changed_out);
+unsigned long library_generation(void);
+// 시작 후 첫 전체 동기화가 끝났으면 1 (/healthz 준비 판정)
+int library_ready(void);
+void library_stop(void);
+
+#endif
@@ -0,0 +1,28 @@
+#ifndef LOGGER_H
+#define LOGGER_H
+
+// 비동기 로거 선언: 스레드별 링 버퍼에 기록만 하고, 배경 스레드가 모아서 stderr와 접근 로그에 쓴다.
+// log_info/log_warn/log_error(utils.h)도 logger_start 이후에는 이 경로를 탄다 (그 전과 종료 후에는 바로 stderr).
+
+#include <stdint.h>
+
+#include "server.h"
+
+// 요청 하나의 접근 로그 레코드. 그대로 링에 복사되고 JSON 형식화는 배경 스레드가 한다.
+typedef struct {
+    int route_id;         // metrics 라우트 번호 (라우트 패턴으로 출력)
+    int method;           // http_method_t
+    int status;
+    int user_id;          // 0이면 로그인하지 않은 요청
+    uint64_t bytes;       // 보낸 응답 본문 바이트
+    uint64_t duration_us; // 인증부터 응답 송신(스트림이면 본문 끝)까지
+} access_log_entry_t;
+
+int logger_start(const server_ctx_t *server);
+// 이 요청을 기록할지 정한다. 접근 로그가 꺼져 있으면 0, 5xx는 표본 추출과 상관없이 1.
+int access_log_sampled(int status);
+void access_log_record(const access_log_entry_t *entry);
+// 남은 레코드를 모두 쓰고 배경 스레드를 멈춘다. 이후 로그는 바로 stderr로 간다 (exit 때도 자동 호출).
+void logger_shutdown(void);
+
+#endif
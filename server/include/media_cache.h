@@ -0,0 +1,52 @@
+#ifndef MEDIA_CACHE_H
+#define MEDIA_CACHE_H
+
+// 비디오 원본 파일 핸들 캐시 선언 (inode별 FD 공유, 비트레이트 기반 미리 읽기, 인기 타이틀 메모리 고정)
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#include "server.h"
+
+#define MEDIA_CACHE_TOP_TITLES 5
+
+typedef struct media_file media_file_t;
+
+// 타이틀 하나의 누적 전송량 (관리자 통계용)
+typedef struct {
+    int video_id;
+    uint64_t bytes_served;
+    int pinned;
+} media_title_stats_t;
+
+typedef struct {
+    size_t entries;       // 열려 있는 캐시 항목 수 (= 캐시가 가진 FD 수)
+    size_t in_use;        // 스트림이 빌려 간 항목 수
+    size_t capacity;
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t evictions;
+    uint64_t bytes_served;
+    size_t pinned_titles;
+    uint64_t pinned_bytes;
+    uint64_t pin_budget_bytes;
+    size_t top_count;
+    media_title_stats_t top[MEDIA_CACHE_TOP_TITLES]; // 전송량 순
+} media_cache_stats_t;
+
+int media_cache_initialize(server_ctx_t *server);
+// stat 결과(st)와 inode/크기/mtime이 같은 핸들을 빌려 준다. 없으면 새로 열어 캐시에 넣는다.
+// duration_seconds로 비트레이트를 추정해 미리 읽기 폭을 정한다 (모르면 0). 캐시를 쓰지 않거나 실패하면 NULL.
+media_file_t *media_cache_acquire(const char *path, const struct stat *st, int video_id, int duration_seconds);
+void media_cache_release(media_file_t *file);
+int media_file_fd(const media_file_t *file);
+off_t media_file_size(const media_file_t *file);
+// 스트림이 offset까지 보냈을 때 호출한다. sent는 직전 호출 이후 보낸 바이트 (통계용).
+// 재생 위치 앞 미리 읽기 폭의 절반 이상이 소진되면 다음 구간을 WILLNEED로 예약한다.
+void media_file_progress(media_file_t *file, off_t offset, off_t end, size_t sent, off_t *prefetched);
+void media_cache_get_stats(media_cache_stats_t *out);
+void media_cache_shutdown(void);
+
+#endif
@@ -0,0 +1,40 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+// 스레드별 카운터/지연 히스토그램과 Prometheus 텍스트 형식 /metrics 엔드포인트 선언
+
+#include <stddef.h>
+#include <stdint.h>
+
+struct request_ctx; // router.h
+
+#define METRICS_MAX_ROUTES 64
+#define METRICS_ROUTE_STATIC 0    // /api/ 밖의 정적 자산
+#define METRICS_ROUTE_UNMATCHED 1 // 라우트 테이블에 없는 /api/ 경로 (404/405)
+
+typedef enum {
+    METRICS_BODY_SENDFILE, // 워커/epoll 경로의 sendfile
+    METRICS_BODY_SPLICE,   // io_uring 경로의 파일 → 파이프 splice
+    METRICS_BODY_COPY,     // sendfile을 못 쓸 때의 pread + send
+    METRICS_BODY_KINDS
+} metrics_body_kind_t;
+
+// 라우트 패턴을 등록하고 히스토그램 번호를 돌려준다 (시작 시 router_set_routes가 호출). 가득 차면 -1.
+int metrics_register_route(const char *method, const char *pattern);
+// 라우트 번호의 패턴 문자열 (접근 로그용). 모르는 번호면 NULL.
+const char *metrics_route_pattern(int route_id);
+// 요청 하나의 처리 시간(핸들러 진입부터 응답 헤더/본문 송신까지)과 응답 상태를 기록한다.
+void metrics_observe_request(int route_id, int status, uint64_t elapsed_us);
+void metrics_add_body_bytes(metrics_body_kind_t kind, size_t bytes);
+void metrics_stream_finished(void);
+void metrics_connection_opened(void);
+void metrics_connection_closed(void);
+// 잠금을 바로 얻지 못하고 기다린 시간 (DB 쓰기 잠금, 읽기 연결 풀)
+void metrics_add_db_wait(int writer, uint64_t waited_us);
+void metrics_observe_job(int kind, uint64_t elapsed_us);
+uint64_t metrics_now_us(void);
+// GET /metrics: METRICS_TOKEN이 있으면 Authorization: Bearer로 확인한다.
+void metrics_handle_scrape(struct request_ctx *ctx);
+void metrics_shutdown(void);
+
+#endif
@@ -0,0 +1,27 @@
+#ifndef MP4_H
+#define MP4_H
+
+// MP4(ISO BMFF) 박스 헤더만 읽어 길이/코덱/해상도와 moov·mdat 위치를 알아내는 인덱서 선언
+
+#include <stddef.h>
+
+typedef struct {
+    int duration_seconds;  // mvhd 기준 (반올림)
+    int width;             // 첫 비디오 트랙의 표시 크기 (없으면 0)
+    int height;
+    char video_codec[8];   // 샘플 엔트리 4cc (avc1, hvc1, ...), 없으면 빈 문자열
+    char audio_codec[8];   // mp4a, opus, ...
+    long long moov_offset; // 최상위 moov 박스 시작 위치
+    long long moov_size;
+    long long mdat_offset; // 첫 mdat 박스 시작 위치 (없으면 -1)
+    long long mdat_size;
+    int faststart;         // moov가 mdat보다 앞에 있으면 1 (브라우저가 꼬리 Range 요청 없이 재생을 시작한다)
+} mp4_info_t;
+
+// 파일 앞뒤의 박스 헤더와 moov만 pread로 읽어 info를 채운다. mp4가 아니거나 moov가 없으면 -1.
+int mp4_probe(const char *path, mp4_info_t *info);
+// moov를 첫 mdat 앞으로 옮긴 사본을 만들어 원본과 원자적으로 바꾼다 (stco/co64 오프셋 보정).
+// 0: 옮김, 1: 이미 faststart라 할 일 없음, -1: 실패 (원본은 그대로)
+int mp4_make_faststart(const char *path);
+
+#endif
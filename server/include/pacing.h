@@ -0,0 +1,32 @@
+#ifndef PACING_H
+#define PACING_H
+
+// 스트림 본문 속도 제한 선언. 연결마다 첫 버스트만 제한 없이 보내고, 이후는 타이틀 비트레이트 × 배수로 맞춘다.
+// 가능하면 SO_MAX_PACING_RATE로 커널(fq 또는 TCP 내부 pacing)에 맡기고, 아니면 토큰 버킷으로 송신량을 나눈다.
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct {
+    uint64_t rate;        // 초당 바이트 (0이면 제한 없음)
+    uint64_t burst_left;  // 첫 버스트 중 아직 보내지 않은 바이트 (이 동안은 제한하지 않는다)
+    uint64_t tokens;      // 토큰 버킷: 지금 보낼 수 있는 바이트
+    uint64_t refilled_us; // 마지막으로 토큰을 채운 시각
+    int want_kernel;      // 버스트가 끝나면 SO_MAX_PACING_RATE를 건다
+    int kernel_applied;   // 소켓에 속도가 걸려 있어 사용자 공간에서는 나누지 않는다
+    int burst_used;       // 이 연결이 첫 버스트를 이미 받았는지 (keep-alive 다음 스트림은 버스트 없음)
+} stream_pacer_t;
+
+// 새 스트림의 속도와 첫 버스트 크기를 건다. rate가 0이면 이전 스트림의 제한만 푼다.
+void pacer_start(stream_pacer_t *pacer, int fd, uint64_t rate, uint64_t burst, int prefer_kernel);
+// 지금 보내도 되는 바이트 (budget 이하). 0이면 *wait_us 뒤에 다시 묻는다.
+size_t pacer_allowance(stream_pacer_t *pacer, uint64_t now_us, size_t budget, size_t remaining,
+                       uint64_t *wait_us);
+// 실제로 보낸 양을 반영한다. 첫 버스트가 여기서 끝나면 커널 pacing을 건다.
+void pacer_consume(stream_pacer_t *pacer, int fd, size_t sent);
+// 스트림 본문을 다 넘겼을 때 호출한다. 소켓 버퍼에 남은 본문이 계속 제한 속도로 나가도록 커널 속도는 그대로 둔다.
+void pacer_finish(stream_pacer_t *pacer);
+// 같은 연결의 다음 요청을 처리하기 전에 소켓 속도 제한을 푼다 (걸려 있지 않으면 아무 일도 하지 않는다).
+void pacer_release(stream_pacer_t *pacer, int fd);
+
+#endif
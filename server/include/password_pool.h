@@ -0,0 +1,32 @@
+#ifndef PASSWORD_POOL_H
+#define PASSWORD_POOL_H
+
+// 비밀번호 해시(PBKDF2)만 전담하는 크기 제한 스레드 풀 선언
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define PASSWORD_POOL_BUSY (-2) // 대기열이 가득 차 작업을 받지 않았다
+
+typedef struct {
+    uint64_t completed;      // 끝난 해시 수
+    uint64_t rejected;       // 대기열 초과로 거절한 수
+    uint64_t total_hash_us;  // PBKDF2 계산에 쓴 시간 합
+    uint64_t max_hash_us;
+    uint64_t total_wait_us;  // 대기열에서 기다린 시간 합
+    size_t queued;           // 지금 대기 중인 작업
+    size_t running;          // 지금 계산 중인 작업
+    size_t threads;
+    size_t queue_limit;
+    int iterations;
+} password_pool_stats_t;
+
+int password_pool_init(size_t threads, size_t queue_limit, int iterations);
+// password+salt로 PBKDF2-HMAC-SHA256을 계산해 out에 담을 때까지 기다린다.
+// 0: 성공, -1: 실패, PASSWORD_POOL_BUSY: 풀이 포화 상태라 바로 거절됨
+int password_pool_derive(const char *password, const unsigned char *salt, size_t salt_len,
+                         unsigned char *out, size_t out_len);
+void password_pool_get_stats(password_pool_stats_t *stats);
+void password_pool_shutdown(void);
+
+#endif
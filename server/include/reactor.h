@@ -0,0 +1,92 @@
+#ifndef REACTOR_H
+#define REACTOR_H
+
+// 클라이언트 연결 수명주기와 epoll/poll 이벤트 루프 선언
+
+#include <pthread.h>
+#include <signal.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "http.h"
+#include "logger.h"
+#include "pacing.h"
+#include "server.h"
+#if HAVE_IO_URING
+#include "uring.h"
+#endif
+
+typedef enum {
+    CONN_READING,    // 이벤트 루프가 요청 도착을 기다리는 중
+    CONN_DISPATCHED, // 워커 스레드가 요청을 처리하는 중
+    CONN_STREAMING   // 이벤트 루프가 쓰기 가능 이벤트마다 파일 본문을 보내는 중
+} conn_state_t;
+
+struct reactor;
+
+typedef struct connection {
+    int fd;
+    conn_state_t state;            // 현재 연결을 소유한 쪽 (루프 또는 워커)
+    struct reactor *owner;
+    http_buffer_t inbuf;           // 파이프라이닝된 다음 요청 바이트까지 보관하는 수신 버퍼
+    http_file_stream_t stream;     // 워커가 넘긴 파일 전송 상태
+    int keep_alive;                // 현재 응답을 마친 뒤 다음 요청을 기다릴지
+    unsigned requests_served;      // keep-alive 최대 요청 수 제한용
+    thread_pool_lane_t lane;       // 지금 이 연결의 작업이 줄 선 워커 lane
+    http_request_t *parsed;        // 다른 lane으로 옮기기 전에 파싱해 둔 요청 (문자열은 inbuf를 가리킨다)
+    uint64_t last_active_ms;       // 유휴 타임아웃 판정 기준 시각
+    access_log_entry_t access;     // 이벤트 루프로 넘어온 스트림의 접근 로그 (본문 전송이 끝나면 기록)
+    uint64_t access_started_us;
+    int access_pending;
+    stream_pacer_t pacer;          // 스트림 본문 속도 제한 (연결 단위: 첫 버스트는 연결당 한 번)
+    uint64_t pace_wake_ms;         // 0이 아니면 토큰이 모일 때까지 쉬는 중 (쓰기 이벤트를 걸지 않는다)
+    struct connection *pace_next;  // 리액터의 쉬는 스트림 목록
+    struct connection *prev;       // 전체 연결 목록 (유휴 정리/종료 시 정리용)
+    struct connection *next;
+#if HAVE_IO_URING
+    int pipe_fds[2];               // 파일 → 소켓 splice 중계 파이프 (-1이면 아직 없음)
+    size_t pipe_size;
+    size_t pipe_pending;           // 파이프에 들어갔지만 소켓으로 아직 못 보낸 바이트
+    unsigned uring_inflight;       // 완료를 기다리는 SQE 수 (0일 때만 다음 단계로 넘어간다)
+    int uring_failed;
+    int uring_need_poll;           // 소켓이 EAGAIN을 돌려 쓰기 가능을 기다려야 한다
+    struct connection *uring_next; // 워커가 넘긴 스트림 제출 대기 목록
+#endif
+} connection_t;
+
+typedef void (*reactor_handler_fn)(connection_t *conn);
+
+typedef struct reactor {
+    server_ctx_t *server;
+    int listen_fd;
+    int poll_fd;                  // epoll FD (poll() 환경에서는 -1)
+    int wake_fds[2];              // 워커가 루프를 깨우기 위한 self-pipe
+    pthread_mutex_t lock;         // 연결 목록과 연결 상태 전환 보호
+    connection_t *connections;
+    size_t connection_count;
+    uint64_t last_sweep_ms;
+    reactor_handler_fn handler;   // 요청이 도착한 연결을 처리할 워커 함수
+    int cpu;                      // 이 루프가 고정된 CPU (-1이면 고정하지 않고 워커를 돌아가며 쓴다)
+    size_t next_local;            // 같은 CPU에 고정된 워커에게 돌아가며 넘기기 위한 카운터
+    connection_t *paced;          // 속도 제한으로 쉬는 스트림들 (루프 스레드만 건드린다)
+#if HAVE_IO_URING
+    uring_t *ring;                // IO_BACKEND=io_uring일 때만 (NULL이면 epoll 경로)
+    int event_fd;                 // CQE 도착을 epoll에 알리는 eventfd
+    int uring_accept;             // multishot accept가 리스닝 소켓을 맡고 있는지
+    connection_t *uring_queue;    // 워커가 넘긴, 루프가 splice를 제출할 연결들 (lock 보호)
+#endif
+} reactor_t;
+
+int reactor_init(reactor_t *reactor, server_ctx_t *server, int listen_fd,
+                 reactor_handler_fn handler);
+// 호출한 스레드를 cpu에 고정하고, 이후 이 리액터의 연결은 같은 CPU의 워커 큐로 보낸다.
+int reactor_pin(reactor_t *reactor, int cpu);
+int reactor_run(reactor_t *reactor, volatile sig_atomic_t *running);
+void reactor_stream(connection_t *conn);
+void reactor_resume(connection_t *conn);
+// 워커가 파싱한 요청을 다른 lane의 큐로 다시 넘긴다. 성공하면 0이고 그 뒤로 연결을 건드리면 안 된다.
+int reactor_requeue(connection_t *conn, thread_pool_lane_t lane);
+void reactor_close(connection_t *conn);
+void reactor_destroy(reactor_t *reactor);
+
+#endif
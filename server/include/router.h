@@ -10,15 +10,21 @@ typedef struct request_ctx {
     server_ctx_t *server;      // 전역 상태 접근
     int client_fd;             // 응답을 돌려줄 소켓 FD
     http_request_t *request;   // 파싱된 HTTP 요청
+    http_file_stream_t *stream; // NULL이 아니면 파일 본문 전송을 이벤트 루프에 넘길 수 있다
+    int keep_alive;            // 응답 후 연결을 유지할지 (Connection 헤더에 반영)
     int authenticated;         // auth_authenticate_request 결과
     int user_id;
     char username[64];
     char session_token[128];
     struct route_param {
-        char key[32];
-        char value[256];
-    } params[8];               // ":id"와 같은 경로 파라미터 저장소
+        const char *key;       // 라우트 패턴의 이름 (라우터가 소유)
+        const char *value;     // 요청 경로 안의 위치 (널 종료되지 않음)
+        size_t length;
+        int int_value;         // is_int일 때 미리 변환한 값
+        int is_int;
+    } params[8];               // ":id"와 같은 경로 파라미터 (복사 없이 경로를 가리킨다)
     size_t param_count;
+    int route_id;              // 계측용 라우트 번호 (router_handle이 채운다)
 } request_ctx_t;
 
 typedef void (*route_handler_fn)(request_ctx_t *ctx);
@@ -27,12 +33,23 @@ typedef struct {
     http_method_t method;
     const char *path;        // "/api/videos/:id" 형태의 패턴
     route_handler_fn handler;
+    int bulk;                // 1이면 워커 풀 BULK lane에서 처리한다 (비밀번호 해시, 관리자 작업)
 } route_entry_t;
 
 void router_handle(request_ctx_t *ctx);
-void router_set_routes(const route_entry_t *routes, size_t count);
-const char *router_get_param(const request_ctx_t *ctx, const char *name);
+// 요청이 bulk로 표시된 라우트에 맞으면 1 (파라미터는 채우지 않는다)
+int router_route_is_bulk(http_method_t method, const char *path);
+// 라우팅 테이블을 segment 트라이로 컴파일한다. 패턴이 충돌하면 -1
+int router_set_routes(const route_entry_t *routes, size_t count);
+void router_shutdown(void);
+// 값은 널 종료되지 않으므로 길이를 함께 돌려준다.
+const char *router_get_param(const request_ctx_t *ctx, const char *name, size_t *length_out);
+// 숫자로만 된(INT_MAX 이하) 파라미터이면 0, 없거나 숫자가 아니면 -1
+int router_get_param_int(const request_ctx_t *ctx, const char *name, int *value_out);
+int router_get_query(const request_ctx_t *ctx, const char *name, char *out, size_t out_len);
+int router_get_query_int(const request_ctx_t *ctx, const char *name, int *value_out);
 int router_send_json(request_ctx_t *ctx, int status, const char *json_body, const char *extra_headers);
 int router_send_json_error(request_ctx_t *ctx, int status, const char *message);
+int router_require_admin(request_ctx_t *ctx);
 
 #endif
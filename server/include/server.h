@@ -6,6 +6,8 @@
 #include <limits.h>
 
 #include "db.h"
+#include "session_cache.h"
+#include "session_token.h"
 #include "threadpool.h"
 
 typedef struct server_ctx {
@@ -13,14 +15,49 @@ typedef struct server_ctx {
     int epoll_fd;           // 이벤트 루프에서 사용하는 epoll/poll 핸들러
     thread_pool_t pool;     // 워커 스레드 풀
     db_ctx_t db;            // SQLite 연결 래퍼
+    session_cache_t sessions; // 인증 경로용 세션 캐시 (적중 시 DB를 건드리지 않는다)
+    session_tokens_t tokens;  // 무상태 세션 모드의 서명 키와 로그아웃 폐기 목록
     char media_dir[PATH_MAX];
     char thumb_dir[PATH_MAX];
+    char hls_dir[PATH_MAX];   // HLS/CMAF 패키징 결과 (<hls_dir>/<video id>/...)
     char static_dir[PATH_MAX];
     char db_path[PATH_MAX];
     char data_dir[PATH_MAX];
     char security_headers[512]; // 모든 응답에 삽입할 보안 헤더
+    char static_cache_control[96]; // 정적 자산(HTML 제외)의 Cache-Control 값
+    char thumb_cache_control[96];  // 썸네일/미리보기 이미지의 Cache-Control 값
+    int static_cache_refresh_sec;  // 정적 자산 변경을 확인하는 주기
     int port;
     int session_ttl_hours;  // 세션 만료 시간(시간 단위)
+    int session_cache_size;    // 세션 캐시 최대 항목 수
+    int session_cache_ttl_sec; // 캐시 항목을 DB로 재검증하기까지의 시간
+    int session_stateless;     // SESSION_MODE=stateless: 쿠키가 HMAC 서명 토큰이고 DB 세션을 쓰지 않는다
+    char session_keys[1024];   // 서명 키 목록 "kid:secret,..." (첫 키로 서명)
+    int session_revocation_limit; // 무상태 모드에서 만료 전까지 들고 있을 로그아웃 토큰 수
+    int keepalive_timeout_sec;  // 유휴 keep-alive 연결을 닫기까지의 시간 (0이면 비활성)
+    int shutdown_drain_sec;     // SIGTERM 뒤 /healthz로 draining을 알리며 요청을 계속 받는 시간 (0이면 바로 종료)
+    int keepalive_max_requests; // 연결 하나가 처리할 최대 요청 수
+    int history_flush_interval_ms;  // 시청 위치 버퍼를 DB에 쓰는 주기
+    int history_flush_max_entries;  // 이 수만큼 쌓이면 주기를 기다리지 않고 쓴다
+    int thumbnail_workers;          // 썸네일을 만드는 ffmpeg 작업 스레드 수
+    int mp4_faststart;              // moov가 뒤에 있는 mp4를 백그라운드에서 faststart 배치로 고쳐 쓸지
+    int worker_queue_limit;         // 워커 풀에 대기할 수 있는 최대 요청 수
+    int media_fd_cache_size;        // 열어 둘 비디오 파일 핸들 수 (0이면 요청마다 연다)
+    int media_readahead_sec;        // 스트림이 재생 위치 앞으로 미리 읽어 둘 분량 (평균 비트레이트 기준 초)
+    int media_pin_budget_mb;        // 인기 타이틀을 mlock으로 붙잡아 둘 메모리 예산 (0이면 끔)
+    double stream_pacing_factor;    // 스트림 본문을 타이틀 평균 비트레이트의 몇 배로 보낼지 (0이면 제한 없음)
+    int stream_burst_sec;           // 연결의 첫 스트림이 속도 제한 없이 받는 분량 (비트레이트 기준 초)
+    int stream_pacing_userspace;    // SO_MAX_PACING_RATE 대신 토큰 버킷으로만 제한할지
+    int reactor_threads;            // 이벤트 루프 수 (1보다 크면 SO_REUSEPORT 리스너를 루프마다 연다)
+    int reactor_pin_cpus;           // 다중 리액터 모드에서 루프/워커를 CPU에 고정할지
+    int listen_backlog;             // listen() 대기열 길이
+    int io_uring;                   // IO_BACKEND=io_uring: accept/본문 전송에 io_uring 사용 (IO_URING=1 빌드)
+    int auth_hash_threads;          // PBKDF2 전용 스레드 수
+    int auth_hash_queue_limit;      // 해시 대기열 상한 (넘으면 로그인/가입이 바로 503)
+    char admin_token[128];  // 관리자 엔드포인트 인증 토큰 (비어 있으면 비활성)
+    char metrics_token[128]; // /metrics 스크레이프용 Bearer 토큰 (비어 있으면 인증 없이 공개)
+    char access_log_path[PATH_MAX]; // 접근 로그 파일 ("-"이면 stderr, 비어 있으면 끔)
+    int access_log_sample;          // 요청 N개 중 1개만 접근 로그에 남긴다 (5xx는 항상)
 } server_ctx_t;
 
 #endif
@@ -0,0 +1,54 @@
+#ifndef SESSION_CACHE_H
+#define SESSION_CACHE_H
+
+// 세션 토큰 → 사용자 정보를 메모리에 보관하는 샤딩된 TTL 캐시 선언
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+
+#define SESSION_CACHE_SHARDS 16
+#define SESSION_CACHE_BUCKETS 64 // 샤드당 해시 버킷 수
+
+typedef struct session_cache_entry {
+    char token[128];
+    int user_id;
+    char username[64];
+    time_t expires_at;   // DB 세션 만료 시각
+    time_t cached_until; // 캐시 항목 자체의 만료 시각 (expires_at보다 늦지 않다)
+    struct session_cache_entry *next;
+} session_cache_entry_t;
+
+typedef struct {
+    pthread_mutex_t lock;
+    session_cache_entry_t *buckets[SESSION_CACHE_BUCKETS];
+    size_t count;
+} session_cache_shard_t;
+
+typedef struct {
+    session_cache_shard_t shards[SESSION_CACHE_SHARDS];
+    size_t shard_capacity; // 샤드당 최대 항목 수
+    int ttl_sec;           // 항목을 DB와 다시 맞추기까지의 최대 시간
+    atomic_ullong hits;
+    atomic_ullong misses;
+    int initialized;
+} session_cache_t;
+
+typedef struct {
+    uint64_t hits;
+    uint64_t misses;
+    size_t entries;
+} session_cache_stats_t;
+
+int session_cache_init(session_cache_t *cache, size_t capacity, int ttl_sec);
+int session_cache_lookup(session_cache_t *cache, const char *token, time_t now,
+                         int *user_id_out, char *username_out, size_t username_len);
+void session_cache_store(session_cache_t *cache, const char *token, int user_id,
+                         const char *username, time_t expires_at, time_t now);
+void session_cache_remove(session_cache_t *cache, const char *token);
+void session_cache_get_stats(session_cache_t *cache, session_cache_stats_t *stats);
+void session_cache_destroy(session_cache_t *cache);
+
+#endif
@@ -0,0 +1,60 @@
+#ifndef SESSION_TOKEN_H
+#define SESSION_TOKEN_H
+
+// 무상태 세션 토큰 선언 (SESSION_MODE=stateless). 쿠키 자체에 사용자와 만료 시각을 담고 HMAC으로 서명해
+// 어느 노드든 DB 조회 없이 검증한다. 키는 여러 개를 두고 서명은 첫 키로, 검증은 키 ID로 고른다.
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+
+#define SESSION_TOKEN_MAX_KEYS 8
+#define SESSION_TOKEN_SECRET_MAX 64
+#define SESSION_TOKEN_USERNAME_MAX 32
+
+typedef struct {
+    uint8_t id;                               // 토큰에 실리는 키 ID (0-255)
+    unsigned char secret[SESSION_TOKEN_SECRET_MAX];
+    size_t secret_len;
+} session_token_key_t;
+
+// 로그아웃한 토큰 ID → 토큰 만료 시각. 만료가 지난 항목은 자리가 모자랄 때 정리한다.
+typedef struct {
+    uint64_t token_id; // 0이면 빈 칸
+    time_t expires_at;
+} session_token_revoked_t;
+
+typedef struct {
+    session_token_key_t keys[SESSION_TOKEN_MAX_KEYS]; // keys[0]이 서명 키
+    size_t key_count;
+    pthread_mutex_t revoked_lock;
+    session_token_revoked_t *revoked; // 개방 주소 해시 (크기는 2의 거듭제곱)
+    size_t revoked_slots;
+    size_t revoked_limit;             // 동시에 들고 있을 최대 폐기 항목 수
+    atomic_size_t revoked_count;      // 0이면 검증 때 잠금 없이 건너뛴다
+    int initialized;
+} session_tokens_t;
+
+typedef struct {
+    int user_id;
+    char username[SESSION_TOKEN_USERNAME_MAX + 1];
+    time_t expires_at;
+    uint64_t token_id;
+} session_token_claims_t;
+
+// keys_spec: "kid:secret,kid:secret,..." (첫 항목이 서명 키, 나머지는 교체 중인 이전 키로 검증만 한다)
+int session_tokens_init(session_tokens_t *tokens, const char *keys_spec, size_t revoked_limit);
+// 서명한 토큰을 out에 쓴다 (쿠키 값으로 그대로 쓸 수 있는 base64url).
+int session_token_issue(session_tokens_t *tokens, int user_id, const char *username, time_t expires_at,
+                        char *out, size_t out_len);
+// 서명, 만료, 폐기 여부를 확인한다. 유효하면 0과 claims, 아니면 -1.
+int session_token_verify(session_tokens_t *tokens, const char *token, time_t now,
+                         session_token_claims_t *claims);
+// 유효한 토큰을 만료 때까지 거부하도록 폐기 목록에 넣는다 (이 노드 한정). 목록이 가득 차면 -1.
+int session_token_revoke(session_tokens_t *tokens, const char *token, time_t now);
+size_t session_tokens_revoked_count(session_tokens_t *tokens);
+void session_tokens_destroy(session_tokens_t *tokens);
+
+#endif
@@ -0,0 +1,18 @@
+#ifndef STATIC_CACHE_H
+#define STATIC_CACHE_H
+
+// static_dir 전체를 메모리에 올려 두는 정적 자산 캐시 선언 (gzip/br 변형과 응답 헤더를 미리 만든다)
+
+#include "http.h"
+#include "server.h"
+
+#define STATIC_CACHE_MAX_FILE (1024 * 1024)        // 이보다 큰 파일은 디스크에서 보낸다
+#define STATIC_CACHE_MAX_TOTAL (32 * 1024 * 1024)  // 모든 변형을 합친 상한
+
+int static_cache_initialize(server_ctx_t *server);
+const char *static_cache_control_for(const server_ctx_t *server, const char *mime);
+// 0: 캐시에서 응답을 보냄, 1: 캐시에 없음(디스크 경로로 처리), -1: 송신 실패
+int static_cache_serve(int fd, const http_request_t *req, const char *relative_path, int keep_alive);
+void static_cache_shutdown(void);
+
+#endif
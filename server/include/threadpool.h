@@ -1,31 +1,65 @@
 #ifndef THREADPOOL_H
 #define THREADPOOL_H
 
-//FIFO 작업 큐 기반 스레드 풀 선언부
+// 워커별 lock-free 큐와 작업 훔치기(work stealing)를 쓰는 스레드 풀 선언부
 
 #include <pthread.h>
+#include <stdatomic.h>
 #include <stddef.h>
+#include <stdint.h>
 
 typedef void (*thread_job_fn)(void *arg);
 
-typedef struct thread_job {
+// 워커는 항상 INTERACTIVE 작업을 먼저 가져가고, 없을 때만 BULK 작업을 처리한다.
+typedef enum {
+    THREAD_POOL_LANE_INTERACTIVE, // 짧은 API/정적 요청
+    THREAD_POOL_LANE_BULK,        // 비밀번호 해시, 재스캔처럼 오래 걸리는 요청
+    THREAD_POOL_LANE_COUNT
+} thread_pool_lane_t;
+
+// 고정 크기 링의 칸 하나. sequence로 생산자/소비자 차례를 맞춘다 (할당 없는 작업 노드).
+typedef struct {
+    _Atomic size_t sequence;
     thread_job_fn fn;
     void *arg;
-    struct thread_job *next;
-} thread_job_t;
+} thread_pool_cell_t;
+
+// 여러 생산자/소비자가 잠금 없이 쓰는 유계 링 큐. 주인 워커와 훔치는 워커가 같은 링에서 꺼낸다.
+typedef struct {
+    thread_pool_cell_t *cells;
+    size_t mask;
+    _Alignas(64) _Atomic size_t enqueue_pos;
+    _Alignas(64) _Atomic size_t dequeue_pos;
+} thread_pool_queue_t;
+
+typedef struct {
+    thread_pool_queue_t lanes[THREAD_POOL_LANE_COUNT];
+} thread_pool_worker_t;
 
 typedef struct thread_pool {
-    pthread_mutex_t mutex;
-    pthread_cond_t cond;
-    thread_job_t *head;
-    thread_job_t *tail;
-    size_t worker_count;
-    int stop;
+    thread_pool_worker_t *queues; // 워커마다 하나
     pthread_t *workers;
+    size_t worker_count;
+    size_t queue_limit;           // 대기 중 작업 상한 (넘으면 submit이 거절한다)
+    _Atomic size_t queued;        // 큐에 들어 있는 작업 수
+    _Atomic size_t next_queue;    // 제출을 나눠 줄 다음 워커
+    _Atomic size_t next_worker_id;
+    _Atomic uint64_t rejected;    // 상한 때문에 거절한 작업 수
+    _Atomic int idle;             // 잠든 워커 수 (이 값이 0이면 submit은 잠금을 건드리지 않는다)
+    _Atomic size_t active;        // 작업을 실행 중인 워커 수 (/metrics 게이지)
+    _Atomic int stop;
+    int pin_cpus;                 // 0이 아니면 워커 i를 CPU (i % cpu_count)에 고정한다
+    long cpu_count;
+    pthread_mutex_t mutex;        // 잠들고 깨우는 데만 쓴다
+    pthread_cond_t cond;
 } thread_pool_t;
 
-int thread_pool_init(thread_pool_t *pool, size_t worker_count);
-void thread_pool_submit(thread_pool_t *pool, thread_job_fn fn, void *arg);
+int thread_pool_init(thread_pool_t *pool, size_t worker_count, size_t queue_limit, int pin_cpus);
+// 0: 큐에 넣음, -1: 대기 작업이 queue_limit에 도달해 거절됨 (호출자가 과부하 응답을 보낸다)
+int thread_pool_submit(thread_pool_t *pool, thread_pool_lane_t lane, thread_job_fn fn, void *arg);
+// preferred 워커의 큐에 먼저 넣는다 (가득 차면 다음 워커). 같은 코어의 워커로 보낼 때 쓴다.
+int thread_pool_submit_to(thread_pool_t *pool, size_t preferred, thread_pool_lane_t lane,
+                          thread_job_fn fn, void *arg);
 void thread_pool_destroy(thread_pool_t *pool);
 
 #endif
@@ -0,0 +1,44 @@
+#ifndef URING_H
+#define URING_H
+
+// liburing 없이 io_uring 시스템 콜을 직접 쓰는 최소 링 래퍼 선언 (make IO_URING=1일 때만 빌드)
+
+#include <linux/io_uring.h>
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct {
+    int fd;
+    // 제출 큐 (커널과 공유하는 mmap 영역)
+    unsigned *sq_head;
+    unsigned *sq_tail;
+    unsigned *sq_mask;
+    unsigned *sq_array;
+    unsigned sq_entries;
+    unsigned sq_local_tail;   // 아직 커널에 알리지 않은 tail
+    unsigned sq_submitted;    // 마지막으로 알린 tail
+    struct io_uring_sqe *sqes;
+    // 완료 큐
+    unsigned *cq_head;
+    unsigned *cq_tail;
+    unsigned *cq_mask;
+    struct io_uring_cqe *cqes;
+    void *sq_ptr;
+    size_t sq_len;
+    void *cq_ptr;
+    size_t cq_len;
+    size_t sqes_len;
+} uring_t;
+
+int uring_init(uring_t *ring, unsigned entries);
+// 빈 SQE를 돌려준다. 제출 큐가 가득 차면 모아 둔 것을 먼저 제출하고, 그래도 없으면 NULL
+struct io_uring_sqe *uring_get_sqe(uring_t *ring);
+// 모아 둔 SQE를 한 번의 io_uring_enter로 제출한다. 제출한 개수 또는 -1
+int uring_submit(uring_t *ring);
+int uring_register_eventfd(uring_t *ring, int event_fd);
+// 완료된 CQE가 있으면 돌려주고 없으면 NULL. 처리 후 uring_cqe_seen으로 넘긴다.
+struct io_uring_cqe *uring_peek_cqe(uring_t *ring);
+void uring_cqe_seen(uring_t *ring);
+void uring_destroy(uring_t *ring);
+
+#endif
@@ -13,8 +13,12 @@ void trim_trailing_newline(char *s);
 void get_iso8601(char *buf, size_t len, time_t ts);
 int ensure_directory(const char *path);
 char *read_file(const char *path, size_t *out_len);
+const char *mime_type_for_path(const char *path);
 int base64url_encode(const uint8_t *input, size_t input_len, char *output, size_t output_len);
+int base64url_decode(const char *input, uint8_t *output, size_t output_len);
 uint64_t get_monotonic_ms(void);
+int make_nonblocking(int fd);
+// 구현은 logger.c (logger_start 이후에는 스레드별 링 버퍼를 거쳐 배경 스레드가 쓴다)
 void log_info(const char *fmt, ...);
 void log_warn(const char *fmt, ...);
 void log_error(const char *fmt, ...);
@@ -27,6 +31,7 @@ typedef struct {
 
 int sb_init(string_builder_t *sb, size_t initial_capacity);
 int sb_append(string_builder_t *sb, const char *fmt, ...);
+int sb_append_raw(string_builder_t *sb, const char *data, size_t len);
 void sb_free(string_builder_t *sb);
 int sb_append_json_string(string_builder_t *sb, const char *value);
 int json_get_string(const char *json, const char *key, char *out, size_t out_len);
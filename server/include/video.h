@@ -1,7 +1,7 @@
 #ifndef VIDEO_H
 #define VIDEO_H
 
-// 비디오 목록/스트리밍/썸네일 관련 엔드포인트 선언
+// 비디오 목록/스트리밍/썸네일/탐색 미리보기 관련 엔드포인트 선언
 
 #include "router.h"
 
@@ -9,6 +9,10 @@ int video_initialize(server_ctx_t *server);
 void video_handle_list(request_ctx_t *ctx);
 void video_handle_stream(request_ctx_t *ctx);
 void video_handle_thumbnail(request_ctx_t *ctx);
+void video_handle_previews(request_ctx_t *ctx);
+void video_handle_preview_sprite(request_ctx_t *ctx);
+void video_handle_rescan(request_ctx_t *ctx);
+void video_handle_media_stats(request_ctx_t *ctx);
 void video_shutdown(void);
 
 #endif
@@ -15,9 +15,22 @@ CREATE TABLE IF NOT EXISTS videos (
     filename TEXT NOT NULL UNIQUE,
     description TEXT,
     duration_seconds INTEGER DEFAULT 0,
+    file_size INTEGER DEFAULT 0,
+    file_mtime INTEGER DEFAULT 0,
+    -- 박스 인덱서(mp4.c)가 채우는 값: 표시 해상도, 샘플 엔트리 4cc, 최상위 moov/mdat 위치
+    width INTEGER DEFAULT 0,
+    height INTEGER DEFAULT 0,
+    video_codec TEXT,
+    audio_codec TEXT,
+    moov_offset INTEGER DEFAULT -1,
+    mdat_offset INTEGER DEFAULT -1,
+    faststart INTEGER DEFAULT 1,
     created_at DATETIME DEFAULT CURRENT_TIMESTAMP
 );
 
+-- 검색 인덱스 videos_fts(FTS5 trigram, videos 외부 콘텐츠 + 동기화 트리거)는
+-- FTS5가 없는 SQLite에서도 기동할 수 있도록 db.c의 db_setup_search_index에서 만든다.
+
 CREATE TABLE IF NOT EXISTS watch_history (
     id INTEGER PRIMARY KEY AUTOINCREMENT,
     user_id INTEGER NOT NULL,
@@ -29,6 +42,10 @@ CREATE TABLE IF NOT EXISTS watch_history (
     FOREIGN KEY(video_id) REFERENCES videos(id) ON DELETE CASCADE
 );
 
+-- /api/history keyset 페이지네이션: 사용자별 (updated_at, video_id) 내림차순 탐색
+CREATE INDEX IF NOT EXISTS idx_watch_history_user_updated
+    ON watch_history(user_id, updated_at DESC, video_id DESC);
+
 CREATE TABLE IF NOT EXISTS sessions (
     token TEXT PRIMARY KEY,
     user_id INTEGER NOT NULL,
@@ -36,3 +53,12 @@ CREATE TABLE IF NOT EXISTS sessions (
     created_at DATETIME DEFAULT CURRENT_TIMESTAMP,
     FOREIGN KEY(user_id) REFERENCES users(id) ON DELETE CASCADE
 );
+
+-- 카탈로그 세대 번호 (X-Catalog-Generation, /api/videos의 generation). 재시작 뒤에도 같은 번호가 다른 내용을
+-- 가리키지 않도록 변경을 반영하는 트랜잭션에서 함께 올린다. 처음 만들 때는 현재 시각(초)에서 시작해
+-- DB를 새로 만들어도 이전 번호와 겹치지 않는다.
+CREATE TABLE IF NOT EXISTS catalog_state (
+    id INTEGER PRIMARY KEY CHECK (id = 1),
+    generation INTEGER NOT NULL
+);
+INSERT OR IGNORE INTO catalog_state(id, generation) VALUES (1, CAST(strftime('%s', 'now') AS INTEGER));
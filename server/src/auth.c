@@ -3,7 +3,6 @@
 
 #include <ctype.h>
 #include <openssl/crypto.h>
-#include <openssl/evp.h>
 #include <openssl/rand.h>
 #include <stdio.h>
 #include <string.h>
@@ -11,6 +10,8 @@
 
 #include "db.h"
 #include "http.h"
+#include "password_pool.h"
+#include "session_token.h"
 #include "utils.h"
 
 // 세션 쿠키 이름과 비밀번호 해시 관련 상수들
@@ -108,10 +109,12 @@ static int clear_session_cookie(request_ctx_t *ctx) {
     if (snprintf(headers, sizeof(headers), "%s%s", ctx->server->security_headers, cookie) >= (int)sizeof(headers)) {
         return -1;
     }
-    return http_send_response(ctx->client_fd, 204, http_status_text(204), NULL, NULL, 0, headers);
+    return http_send_response(ctx->client_fd, 204, http_status_text(204), NULL, NULL, 0, headers,
+                              ctx->keep_alive);
 }
 
-// PBKDF2-HMAC(SHA-256)으로 랜덤 솔트를 붙여 해시를 생성한다.
+// PBKDF2-HMAC(SHA-256)으로 랜덤 솔트를 붙여 해시를 생성한다. 계산은 해시 전용 풀에서 수행하며
+// 풀이 포화 상태면 PASSWORD_POOL_BUSY를 돌려준다.
 int auth_hash_password(const char *password, unsigned char *salt_out, size_t salt_len,
                        unsigned char *hash_out, size_t hash_len) {
     if (!password || !salt_out || !hash_out) {
@@ -120,14 +123,10 @@ int auth_hash_password(const char *password, unsigned char *salt_out, size_t sal
     if (RAND_bytes(salt_out, (int)salt_len) != 1) {
         return -1;
     }
-    if (PKCS5_PBKDF2_HMAC(password, (int)strlen(password), salt_out, (int)salt_len,
-                          AUTH_ITERATIONS, EVP_sha256(), (int)hash_len, hash_out) != 1) {
-        return -1;
-    }
-    return 0;
+    return password_pool_derive(password, salt_out, salt_len, hash_out, hash_len);
 }
 
-// 사용자가 입력한 비밀번호를 동일한 파라미터로 해시하여 기존 해시와 비교한다.
+// 사용자가 입력한 비밀번호를 동일한 파라미터로 해시하여 기존 해시와 비교한다. (풀 포화 시 PASSWORD_POOL_BUSY)
 int auth_verify_password(const char *password, const unsigned char *salt, size_t salt_len,
                          const unsigned char *expected_hash, size_t hash_len) {
     if (!password || !salt || !expected_hash) {
@@ -137,9 +136,9 @@ int auth_verify_password(const char *password, const unsigned char *salt, size_t
     if (hash_len > sizeof(computed)) {
         return -1;
     }
-    if (PKCS5_PBKDF2_HMAC(password, (int)strlen(password), salt, (int)salt_len,
-                          AUTH_ITERATIONS, EVP_sha256(), (int)hash_len, computed) != 1) {
-        return -1;
+    int rc = password_pool_derive(password, salt, salt_len, computed, hash_len);
+    if (rc != 0) {
+        return rc;
     }
     if (CRYPTO_memcmp(computed, expected_hash, hash_len) != 0) {
         return -1;
@@ -198,20 +197,88 @@ int auth_initialize(server_ctx_t *server) {
     if (!server) {
         return -1;
     }
+    // 해시 전용 풀을 먼저 띄워야 기본 계정 해시도 같은 경로로 계산된다.
+    if (password_pool_init((size_t)server->auth_hash_threads, (size_t)server->auth_hash_queue_limit,
+                           AUTH_ITERATIONS) != 0) {
+        return -1;
+    }
+    // 무상태 모드는 서명 키 없이는 세션을 발급할 수 없으므로 시작하지 않는다.
+    if (server->session_stateless) {
+        if (session_tokens_init(&server->tokens, server->session_keys,
+                                (size_t)server->session_revocation_limit) != 0) {
+            log_error("SESSION_MODE=stateless requires SESSION_KEYS as kid:secret pairs (secret 16-64 bytes)");
+            password_pool_shutdown();
+            return -1;
+        }
+        log_info("Stateless sessions enabled (%zu signing key(s), signing with kid %u)", server->tokens.key_count,
+                 (unsigned)server->tokens.keys[0].id);
+    }
     // 데이터베이스에 기본 사용자 계정을 삽입하고 만료된 세션을 정리한다.
     ensure_default_users(server);
     db_purge_expired_sessions(&server->db, time(NULL));
+    if (session_cache_init(&server->sessions, (size_t)server->session_cache_size,
+                           server->session_cache_ttl_sec) != 0) {
+        log_error("Failed to initialize session cache");
+        return -1;
+    }
     return 0;
 }
 
-// 세션 토큰을 DB에서 조회해 request_ctx에 로그인 정보를 주입한다.
+// 종료 시 해시 풀과 세션 캐시를 해제한다. 모든 워커가 멈춘 뒤에 호출해야 한다.
+void auth_shutdown(server_ctx_t *server) {
+    if (!server) return;
+    password_pool_shutdown();
+    session_cache_destroy(&server->sessions);
+    session_tokens_destroy(&server->tokens);
+}
+
+// 로그인/가입 직후 발급한 세션을 캐시에 올려 첫 요청부터 DB 조회를 건너뛴다.
+static void cache_new_session(request_ctx_t *ctx, time_t expires_at, time_t now) {
+    session_cache_store(&ctx->server->sessions, ctx->session_token, ctx->user_id, ctx->username,
+                        expires_at, now);
+}
+
+// 새 세션 토큰을 발급한다. 무상태 모드는 서명 토큰을, 아니면 랜덤 토큰을 세션 테이블에 저장한다.
+// 토큰 생성 실패는 -1, 저장 실패는 -2.
+static int issue_session(server_ctx_t *server, int user_id, const char *username, char *token, size_t len,
+                         time_t expires_at, time_t now) {
+    if (server->session_stateless) {
+        return session_token_issue(&server->tokens, user_id, username, expires_at, token, len) == 0 ? 0 : -1;
+    }
+    if (auth_generate_session_token(token, len) != 0) {
+        return -1;
+    }
+    db_purge_expired_sessions(&server->db, now);
+    return db_create_session(&server->db, token, user_id, expires_at) == 0 ? 0 : -2;
+}
+
+// 세션 토큰을 캐시 → DB 순서로 조회해 request_ctx에 로그인 정보를 주입한다.
 static int load_session(server_ctx_t *server, const char *token, request_ctx_t *ctx) {
-    time_t expires = 0;
+    time_t now = time(NULL);
+    // 무상태 모드는 서명만 확인하고 캐시/DB를 보지 않는다.
+    if (server->session_stateless) {
+        session_token_claims_t claims;
+        if (session_token_verify(&server->tokens, token, now, &claims) != 0) {
+            return -1;
+        }
+        ctx->authenticated = 1;
+        ctx->user_id = claims.user_id;
+        snprintf(ctx->username, sizeof(ctx->username), "%s", claims.username);
+        snprintf(ctx->session_token, sizeof(ctx->session_token), "%s", token);
+        return 0;
+    }
     int user_id = 0;
+    if (session_cache_lookup(&server->sessions, token, now, &user_id, ctx->username,
+                             sizeof(ctx->username)) == 0) {
+        ctx->authenticated = 1;
+        ctx->user_id = user_id;
+        snprintf(ctx->session_token, sizeof(ctx->session_token), "%s", token);
+        return 0;
+    }
+    time_t expires = 0;
     if (db_get_session(&server->db, token, &user_id, &expires) != 0) {
         return -1;
     }
-    time_t now = time(NULL);
     if (expires <= now) {
         db_delete_session(&server->db, token);
         return -1;
@@ -220,12 +287,13 @@ static int load_session(server_ctx_t *server, const char *token, request_ctx_t *
     ctx->user_id = user_id;
     snprintf(ctx->session_token, sizeof(ctx->session_token), "%s", token);
     db_get_username_by_id(&server->db, user_id, ctx->username, sizeof(ctx->username));
+    session_cache_store(&server->sessions, token, user_id, ctx->username, expires, now);
     return 0;
 }
 
 // Cookie 헤더에서 세션 토큰을 읽어 들여 인증 여부를 표시한다.
 int auth_authenticate_request(request_ctx_t *ctx) {
-    const char *cookie_header = http_get_header(ctx->request, "Cookie");
+    const char *cookie_header = http_get_known_header(ctx->request, HTTP_HDR_COOKIE);
     if (!cookie_header) {
         return 0;
     }
@@ -239,6 +307,11 @@ int auth_authenticate_request(request_ctx_t *ctx) {
     return 0;
 }
 
+// 해시 풀이 포화 상태일 때 기다리지 않고 돌려주는 응답
+static void send_auth_busy(request_ctx_t *ctx) {
+    router_send_json(ctx, 503, "{\"error\":\"Authentication is busy, retry shortly\"}", "Retry-After: 1\r\n");
+}
+
 // /api/auth/login 엔드포인트: 사용자 인증 및 세션 발급
 void auth_handle_login(request_ctx_t *ctx) {
     if (!ctx->request->body || ctx->request->body_length == 0) {
@@ -262,29 +335,32 @@ void auth_handle_login(request_ctx_t *ctx) {
         memset(password, 0, sizeof(password));
         return;
     }
-    if (auth_verify_password(password, salt, sizeof(salt), hash, sizeof(hash)) != 0) {
-        router_send_json_error(ctx, 401, "Invalid credentials");
-        memset(password, 0, sizeof(password));
+    int verified = auth_verify_password(password, salt, sizeof(salt), hash, sizeof(hash));
+    memset(password, 0, sizeof(password));
+    if (verified == PASSWORD_POOL_BUSY) {
+        send_auth_busy(ctx);
         return;
     }
-    // 새 세션 토큰을 만들어 세션 테이블에 저장한다.
-    char token[128];
-    if (auth_generate_session_token(token, sizeof(token)) != 0) {
-        router_send_json_error(ctx, 500, "Failed to generate session");
+    if (verified != 0) {
+        router_send_json_error(ctx, 401, "Invalid credentials");
         return;
     }
+    char token[128];
     time_t now = time(NULL);
-    db_purge_expired_sessions(&ctx->server->db, now);
     int max_age = ctx->server->session_ttl_hours * 3600;
     time_t expires_at = now + max_age;
-    if (db_create_session(&ctx->server->db, token, user_id, expires_at) != 0) {
-        router_send_json_error(ctx, 500, "Failed to persist session");
+    int issued = issue_session(ctx->server, user_id, username, token, sizeof(token), expires_at, now);
+    if (issued != 0) {
+        router_send_json_error(ctx, 500, issued == -1 ? "Failed to generate session" : "Failed to persist session");
         return;
     }
     ctx->authenticated = 1;
     ctx->user_id = user_id;
     snprintf(ctx->username, sizeof(ctx->username), "%s", username);
     snprintf(ctx->session_token, sizeof(ctx->session_token), "%s", token);
+    if (!ctx->server->session_stateless) {
+        cache_new_session(ctx, expires_at, now);
+    }
 
     // 클라이언트에 돌려줄 JSON 응답과 Set-Cookie 헤더 구성
     char response[256];
@@ -296,17 +372,26 @@ void auth_handle_login(request_ctx_t *ctx) {
              SESSION_COOKIE_NAME, token, max_age);
 
     router_send_json(ctx, 200, response, cookie);
-    memset(password, 0, sizeof(password));
 }
 
 // /api/auth/logout 엔드포인트: 세션 삭제 및 쿠키 정리
 void auth_handle_logout(request_ctx_t *ctx) {
-    if (ctx->session_token[0]) {
+    // 무상태 모드는 지울 행이 없으므로 토큰을 만료 때까지 이 노드의 폐기 목록에 올린다.
+    if (ctx->server->session_stateless) {
+        if (ctx->session_token[0] &&
+            session_token_revoke(&ctx->server->tokens, ctx->session_token, time(NULL)) != 0) {
+            log_warn("Session revocation list full (%zu entries); logged-out token stays valid until expiry",
+                     session_tokens_revoked_count(&ctx->server->tokens));
+        }
+    } else if (ctx->session_token[0]) {
+        // 캐시를 먼저 비워야 DB 삭제 직후의 요청이 캐시로 통과하지 않는다.
+        session_cache_remove(&ctx->server->sessions, ctx->session_token);
         db_delete_session(&ctx->server->db, ctx->session_token);
     } else {
-        const char *cookie_header = http_get_header(ctx->request, "Cookie");
+        const char *cookie_header = http_get_known_header(ctx->request, HTTP_HDR_COOKIE);
         char token[128];
         if (cookie_header && parse_cookie(cookie_header, SESSION_COOKIE_NAME, token, sizeof(token)) == 0) {
+            session_cache_remove(&ctx->server->sessions, token);
             db_delete_session(&ctx->server->db, token);
         }
     }
@@ -328,6 +413,32 @@ void auth_handle_me(request_ctx_t *ctx) {
     router_send_json(ctx, 200, body, NULL);
 }
 
+// GET /api/admin/sessions: 세션 모드, 무상태 폐기 목록 크기, 세션 캐시 적중/미스 카운터와 비밀번호 해시 풀 지표를 반환한다.
+void auth_handle_session_stats(request_ctx_t *ctx) {
+    if (router_require_admin(ctx) != 0) {
+        return;
+    }
+    session_cache_stats_t stats;
+    session_cache_get_stats(&ctx->server->sessions, &stats);
+    password_pool_stats_t hashing;
+    password_pool_get_stats(&hashing);
+    uint64_t avg_hash_us = hashing.completed ? hashing.total_hash_us / hashing.completed : 0;
+    uint64_t avg_wait_us = hashing.completed ? hashing.total_wait_us / hashing.completed : 0;
+    char body[640];
+    snprintf(body, sizeof(body),
+             "{\"mode\":\"%s\",\"revokedTokens\":%zu,\"hits\":%llu,\"misses\":%llu,\"entries\":%zu,"
+             "\"passwordHashing\":{\"iterations\":%d,\"threads\":%zu,\"queueLimit\":%zu,"
+             "\"queued\":%zu,\"running\":%zu,\"completed\":%llu,\"rejected\":%llu,"
+             "\"avgHashMs\":%.2f,\"maxHashMs\":%.2f,\"avgWaitMs\":%.2f}}",
+             ctx->server->session_stateless ? "stateless" : "db",
+             session_tokens_revoked_count(&ctx->server->tokens),
+             (unsigned long long)stats.hits, (unsigned long long)stats.misses, stats.entries,
+             hashing.iterations, hashing.threads, hashing.queue_limit, hashing.queued, hashing.running,
+             (unsigned long long)hashing.completed, (unsigned long long)hashing.rejected,
+             avg_hash_us / 1000.0, hashing.max_hash_us / 1000.0, avg_wait_us / 1000.0);
+    router_send_json(ctx, 200, body, NULL);
+}
+
 // /api/auth/register 엔드포인트: 신규 계정 생성 및 즉시 로그인 처리를 수행
 void auth_handle_register(request_ctx_t *ctx) {
     if (!ctx || !ctx->request->body) {
@@ -359,7 +470,12 @@ void auth_handle_register(request_ctx_t *ctx) {
     // 가입 시점에도 기존 로그인과 동일한 해시/세션 생성을 수행한다.
     unsigned char hash[AUTH_HASH_LEN];
     unsigned char salt[AUTH_SALT_LEN];
-    if (auth_hash_password(password, salt, sizeof(salt), hash, sizeof(hash)) != 0) {
+    int hashed = auth_hash_password(password, salt, sizeof(salt), hash, sizeof(hash));
+    if (hashed == PASSWORD_POOL_BUSY) {
+        send_auth_busy(ctx);
+        goto cleanup;
+    }
+    if (hashed != 0) {
         router_send_json_error(ctx, 500, "Failed to secure password");
         goto cleanup;
     }
@@ -374,22 +490,21 @@ void auth_handle_register(request_ctx_t *ctx) {
     }
 
     char token[128];
-    if (auth_generate_session_token(token, sizeof(token)) != 0) {
-        router_send_json_error(ctx, 500, "Failed to create session");
-        goto cleanup;
-    }
     time_t now = time(NULL);
-    db_purge_expired_sessions(&ctx->server->db, now);
     int max_age = ctx->server->session_ttl_hours * 3600;
     time_t expires_at = now + max_age;
-    if (db_create_session(&ctx->server->db, token, new_user_id, expires_at) != 0) {
-        router_send_json_error(ctx, 500, "Unable to persist session");
+    int issued = issue_session(ctx->server, new_user_id, username, token, sizeof(token), expires_at, now);
+    if (issued != 0) {
+        router_send_json_error(ctx, 500, issued == -1 ? "Failed to create session" : "Unable to persist session");
         goto cleanup;
     }
     ctx->authenticated = 1;
     ctx->user_id = new_user_id;
     snprintf(ctx->username, sizeof(ctx->username), "%s", username);
     snprintf(ctx->session_token, sizeof(ctx->session_token), "%s", token);
+    if (!ctx->server->session_stateless) {
+        cache_new_session(ctx, expires_at, now);
+    }
 
     char response[256];
     snprintf(response, sizeof(response), "{\"username\":\"%s\",\"userId\":%d}", username, new_user_id);
@@ -0,0 +1,284 @@
+// /api/videos 목록용 캐시: 비디오별 JSON 조각을 한 번만 만들고, 페이지는 조각 ID 목록으로 기억한다.
+// 모든 항목은 카탈로그 세대에 묶여 있어 라이브러리가 바뀌면 다음 저장 시 통째로 버려진다.
+#include "catalog_cache.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "utils.h"
+
+typedef struct catalog_fragment {
+    int video_id;
+    char *json;
+    size_t length;
+    struct catalog_fragment *next;
+} catalog_fragment_t;
+
+typedef struct catalog_page_entry {
+    char query[128];
+    char cursor[CATALOG_CURSOR_MAX];
+    int limit;
+    int *ids;
+    size_t count;
+    int has_more;
+    char next_cursor[CATALOG_CURSOR_MAX];
+    struct catalog_page_entry *next;
+} catalog_page_entry_t;
+
+typedef struct {
+    pthread_rwlock_t lock;
+    unsigned long generation; // 현재 항목들이 만들어진 카탈로그 세대 (0이면 비어 있음)
+    catalog_fragment_t *fragments[CATALOG_FRAGMENT_BUCKETS];
+    catalog_page_entry_t *pages[CATALOG_PAGE_BUCKETS];
+    size_t page_count;
+} catalog_cache_t;
+
+static catalog_cache_t g_cache = {.lock = PTHREAD_RWLOCK_INITIALIZER};
+
+static size_t fragment_bucket(int video_id) {
+    return ((unsigned)video_id * 2654435761u) % CATALOG_FRAGMENT_BUCKETS;
+}
+
+// 검색어/커서/limit 조합을 FNV-1a로 해시한다.
+static size_t page_bucket(const char *query, const char *cursor, int limit) {
+    uint64_t h = 1469598103934665603ULL;
+    for (const unsigned char *p = (const unsigned char *)query; *p; ++p) {
+        h ^= *p;
+        h *= 1099511628211ULL;
+    }
+    h ^= 0xFF; // 검색어와 커서 경계
+    h *= 1099511628211ULL;
+    for (const unsigned char *p = (const unsigned char *)cursor; *p; ++p) {
+        h ^= *p;
+        h *= 1099511628211ULL;
+    }
+    h ^= (uint64_t)(unsigned)limit;
+    h *= 1099511628211ULL;
+    return (size_t)(h % CATALOG_PAGE_BUCKETS);
+}
+
+static catalog_fragment_t *find_fragment(int video_id) {
+    catalog_fragment_t *f = g_cache.fragments[fragment_bucket(video_id)];
+    while (f && f->video_id != video_id) {
+        f = f->next;
+    }
+    return f;
+}
+
+static catalog_page_entry_t *find_page(const char *query, const char *cursor, int limit) {
+    catalog_page_entry_t *p = g_cache.pages[page_bucket(query, cursor, limit)];
+    while (p && (p->limit != limit || strcmp(p->cursor, cursor) != 0 || strcmp(p->query, query) != 0)) {
+        p = p->next;
+    }
+    return p;
+}
+
+// 페이지 목록만 비운다. 쓰기 잠금을 잡은 상태에서 호출한다.
+static void clear_pages_locked(void) {
+    for (size_t b = 0; b < CATALOG_PAGE_BUCKETS; ++b) {
+        catalog_page_entry_t *p = g_cache.pages[b];
+        while (p) {
+            catalog_page_entry_t *next = p->next;
+            free(p->ids);
+            free(p);
+            p = next;
+        }
+        g_cache.pages[b] = NULL;
+    }
+    g_cache.page_count = 0;
+}
+
+// 조각과 페이지를 모두 비운다. 쓰기 잠금을 잡은 상태에서 호출한다.
+static void clear_all_locked(void) {
+    clear_pages_locked();
+    for (size_t b = 0; b < CATALOG_FRAGMENT_BUCKETS; ++b) {
+        catalog_fragment_t *f = g_cache.fragments[b];
+        while (f) {
+            catalog_fragment_t *next = f->next;
+            free(f->json);
+            free(f);
+            f = next;
+        }
+        g_cache.fragments[b] = NULL;
+    }
+    g_cache.generation = 0;
+}
+
+// 비디오 한 건의 사용자 무관 JSON 조각을 만들어 페이지에 추가한다.
+int catalog_page_add_row(catalog_page_t *page, int id, const char *title,
+                         const char *filename, const char *description, int duration_seconds) {
+    if (!page) return -1;
+    if (page->count == page->capacity) {
+        size_t new_cap = page->capacity == 0 ? 16 : page->capacity * 2;
+        catalog_row_t *new_rows = realloc(page->rows, new_cap * sizeof(*new_rows));
+        if (!new_rows) {
+            return -1;
+        }
+        page->rows = new_rows;
+        page->capacity = new_cap;
+    }
+    string_builder_t sb;
+    if (sb_init(&sb, 256) != 0) {
+        return -1;
+    }
+    int error = sb_append(&sb, "{\"id\":%d,\"title\":", id) != 0 ||
+                sb_append_json_string(&sb, title) != 0 ||
+                sb_append_raw(&sb, ",\"filename\":", 12) != 0 ||
+                sb_append_json_string(&sb, filename) != 0 ||
+                sb_append_raw(&sb, ",\"description\":", 15) != 0 ||
+                sb_append_json_string(&sb, description) != 0 ||
+                sb_append(&sb, ",\"duration\":%d,\"thumbnailUrl\":\"/api/videos/%d/thumbnail\""
+                               ",\"streamUrl\":\"/api/videos/%d/stream\"",
+                          duration_seconds, id, id) != 0;
+    if (error) {
+        sb_free(&sb);
+        return -1;
+    }
+    catalog_row_t *row = &page->rows[page->count++];
+    row->video_id = id;
+    row->json = sb.data;
+    row->length = sb.length;
+    return 0;
+}
+
+// 페이지의 조각을 순서대로 콜백에 넘긴다.
+int catalog_page_emit(const catalog_page_t *page, catalog_emit_fn emit, void *userdata) {
+    if (!page || !emit) return -1;
+    for (size_t i = 0; i < page->count; ++i) {
+        if (emit(userdata, page->rows[i].video_id, page->rows[i].json, page->rows[i].length) != 0) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+void catalog_page_free(catalog_page_t *page) {
+    if (!page) return;
+    for (size_t i = 0; i < page->count; ++i) {
+        free(page->rows[i].json);
+    }
+    free(page->rows);
+    page->rows = NULL;
+    page->count = 0;
+    page->capacity = 0;
+}
+
+// 같은 세대에 같은 페이지를 본 적이 있으면 캐시된 조각으로 응답을 채운다.
+// 적중하면 0, 없으면 1, 콜백이 실패하면 -1.
+int catalog_cache_get(unsigned long generation, const char *query, const char *cursor, int limit,
+                      catalog_emit_fn emit, void *userdata, size_t *emitted_out, int *has_more_out,
+                      char *next_cursor_out, size_t next_cursor_len) {
+    if (!emit) return -1;
+    if (!query) query = "";
+    if (!cursor) cursor = "";
+    int result = 1;
+    pthread_rwlock_rdlock(&g_cache.lock);
+    const catalog_page_entry_t *page =
+        g_cache.generation == generation ? find_page(query, cursor, limit) : NULL;
+    if (page) {
+        result = 0;
+        for (size_t i = 0; i < page->count; ++i) {
+            // 페이지는 자신의 조각이 모두 들어간 다음에만 등록되므로 항상 찾을 수 있다.
+            const catalog_fragment_t *f = find_fragment(page->ids[i]);
+            if (!f || emit(userdata, f->video_id, f->json, f->length) != 0) {
+                result = -1;
+                break;
+            }
+        }
+        if (result == 0) {
+            if (emitted_out) *emitted_out = page->count;
+            if (has_more_out) *has_more_out = page->has_more;
+            if (next_cursor_out && next_cursor_len > 0) {
+                snprintf(next_cursor_out, next_cursor_len, "%s", page->next_cursor);
+            }
+        }
+    }
+    pthread_rwlock_unlock(&g_cache.lock);
+    return result;
+}
+
+// 새로 만든 페이지를 캐시에 넣는다. 조각의 소유권을 가져가며 page는 비워진다.
+// 이미 지난 세대로 만든 결과는 버리고, 더 새로운 세대가 오면 기존 항목을 모두 비운다.
+void catalog_cache_put(unsigned long generation, const char *query, const char *cursor, int limit,
+                       catalog_page_t *page) {
+    if (!page) return;
+    if (!query) query = "";
+    if (!cursor) cursor = "";
+    if (strlen(query) >= sizeof(((catalog_page_entry_t *)0)->query) ||
+        strlen(cursor) >= sizeof(((catalog_page_entry_t *)0)->cursor)) {
+        catalog_page_free(page);
+        return;
+    }
+    pthread_rwlock_wrlock(&g_cache.lock);
+    if (generation < g_cache.generation) {
+        pthread_rwlock_unlock(&g_cache.lock);
+        catalog_page_free(page);
+        return;
+    }
+    if (generation > g_cache.generation) {
+        clear_all_locked();
+        g_cache.generation = generation;
+    }
+    if (find_page(query, cursor, limit)) {
+        // 다른 요청이 같은 페이지를 먼저 채웠다.
+        pthread_rwlock_unlock(&g_cache.lock);
+        catalog_page_free(page);
+        return;
+    }
+    catalog_page_entry_t *entry = calloc(1, sizeof(*entry));
+    int *ids = page->count > 0 ? malloc(page->count * sizeof(*ids)) : NULL;
+    if (!entry || (page->count > 0 && !ids)) {
+        pthread_rwlock_unlock(&g_cache.lock);
+        free(entry);
+        free(ids);
+        catalog_page_free(page);
+        return;
+    }
+    for (size_t i = 0; i < page->count; ++i) {
+        catalog_row_t *row = &page->rows[i];
+        ids[i] = row->video_id;
+        if (find_fragment(row->video_id)) {
+            continue;
+        }
+        catalog_fragment_t *f = malloc(sizeof(*f));
+        if (!f) {
+            pthread_rwlock_unlock(&g_cache.lock);
+            free(entry);
+            free(ids);
+            catalog_page_free(page);
+            return;
+        }
+        size_t bucket = fragment_bucket(row->video_id);
+        f->video_id = row->video_id;
+        f->json = row->json;
+        f->length = row->length;
+        f->next = g_cache.fragments[bucket];
+        g_cache.fragments[bucket] = f;
+        row->json = NULL; // 소유권 이전
+    }
+    if (g_cache.page_count >= CATALOG_PAGE_CAPACITY) {
+        clear_pages_locked();
+    }
+    snprintf(entry->query, sizeof(entry->query), "%s", query);
+    snprintf(entry->cursor, sizeof(entry->cursor), "%s", cursor);
+    snprintf(entry->next_cursor, sizeof(entry->next_cursor), "%s", page->next_cursor);
+    entry->limit = limit;
+    entry->ids = ids;
+    entry->count = page->count;
+    entry->has_more = page->has_more;
+    size_t bucket = page_bucket(query, cursor, limit);
+    entry->next = g_cache.pages[bucket];
+    g_cache.pages[bucket] = entry;
+    g_cache.page_count++;
+    pthread_rwlock_unlock(&g_cache.lock);
+    catalog_page_free(page);
+}
+
+// 종료 시 캐시 메모리를 해제한다.
+void catalog_cache_clear(void) {
+    pthread_rwlock_wrlock(&g_cache.lock);
+    clear_all_locked();
+    pthread_rwlock_unlock(&g_cache.lock);
+}
@@ -1,4 +1,4 @@
-// SQLite를 감싸는 헬퍼 계층: 스레드 안전 보장을 위해 모든 쿼리를 직렬화한다.
+// SQLite를 감싸는 헬퍼 계층: 쓰기는 단일 writer 연결로 직렬화하고, 읽기는 WAL 읽기 전용 연결 풀에서 병렬로 처리한다.
 #include "db.h"
 
 #include <errno.h>
@@ -7,23 +7,102 @@
 #include <string.h>
 #include <time.h>
 
+#include "metrics.h"
 #include "utils.h"
 
-// 모든 DB 접근 전에 뮤텍스를 잡아 SQLite 연결을 직렬화한다.
-static void db_lock(db_ctx_t *db) {
-    pthread_mutex_lock(&db->mutex);
+// 연결의 준비된 문장 캐시에서 SQL을 찾고, 없으면 준비해서 넣는다.
+// sql은 호출부의 문자열 리터럴이어야 한다 (주소로 비교). 사용 후 db_finish로 되돌린다.
+// 캐시는 호출부마다 슬롯 하나를 차지하고 교체하지 않는다. 한 함수가 여러 문장을 동시에 들고
+// 있어도 (db_apply_media_changes는 다섯 개) 그중 하나가 중간에 finalize되는 일이 없다.
+static sqlite3_stmt *db_prepare(db_conn_t *conn, const char *sql) {
+    for (size_t i = 0; i < conn->stmt_count; ++i) {
+        if (conn->stmts[i].sql == sql) {
+            return conn->stmts[i].stmt;
+        }
+    }
+    if (conn->stmt_count >= DB_STMT_CACHE_SIZE) {
+        log_error("Prepared statement cache is full (%d); raise DB_STMT_CACHE_SIZE", DB_STMT_CACHE_SIZE);
+        return NULL;
+    }
+    sqlite3_stmt *stmt = NULL;
+    if (sqlite3_prepare_v3(conn->handle, sql, -1, SQLITE_PREPARE_PERSISTENT, &stmt, NULL) != SQLITE_OK) {
+        sqlite3_finalize(stmt);
+        return NULL;
+    }
+    db_stmt_slot_t *slot = &conn->stmts[conn->stmt_count++];
+    slot->sql = sql;
+    slot->stmt = stmt;
+    return stmt;
 }
 
-static void db_unlock(db_ctx_t *db) {
-    pthread_mutex_unlock(&db->mutex);
+// 캐시된 문장을 다음 사용을 위해 리셋한다. 읽기 연결의 WAL 스냅샷도 여기서 풀린다.
+static void db_finish(sqlite3_stmt *stmt) {
+    if (!stmt) return;
+    sqlite3_reset(stmt);
+    sqlite3_clear_bindings(stmt);
+}
+
+static void db_conn_close(db_conn_t *conn) {
+    for (size_t i = 0; i < conn->stmt_count; ++i) {
+        sqlite3_finalize(conn->stmts[i].stmt);
+    }
+    conn->stmt_count = 0;
+    if (conn->handle) {
+        sqlite3_close(conn->handle);
+        conn->handle = NULL;
+    }
+}
+
+// 쓰기 연결을 잡는다. 모든 쓰기는 이 연결 하나로 직렬화된다.
+// 바로 얻지 못할 때만 시계를 읽어 기다린 시간을 계측한다.
+static db_conn_t *db_acquire_writer(db_ctx_t *db) {
+    if (pthread_mutex_trylock(&db->mutex) != 0) {
+        uint64_t started = metrics_now_us();
+        pthread_mutex_lock(&db->mutex);
+        metrics_add_db_wait(1, metrics_now_us() - started);
+    }
+    return &db->writer;
+}
+
+// 읽기 풀에서 유휴 연결을 빌린다. 풀이 없으면 writer로 대신한다.
+static db_conn_t *db_acquire_reader(db_ctx_t *db) {
+    if (db->reader_count == 0) {
+        return db_acquire_writer(db);
+    }
+    pthread_mutex_lock(&db->pool_lock);
+    if (!db->free_readers) {
+        uint64_t started = metrics_now_us();
+        while (!db->free_readers) {
+            pthread_cond_wait(&db->pool_cond, &db->pool_lock);
+        }
+        metrics_add_db_wait(0, metrics_now_us() - started);
+    }
+    db_conn_t *conn = db->free_readers;
+    db->free_readers = conn->next_free;
+    conn->next_free = NULL;
+    pthread_mutex_unlock(&db->pool_lock);
+    return conn;
+}
+
+// db_acquire_writer/db_acquire_reader로 얻은 연결을 돌려준다.
+static void db_release(db_ctx_t *db, db_conn_t *conn) {
+    if (conn == &db->writer) {
+        pthread_mutex_unlock(&db->mutex);
+        return;
+    }
+    pthread_mutex_lock(&db->pool_lock);
+    conn->next_free = db->free_readers;
+    db->free_readers = conn;
+    pthread_cond_signal(&db->pool_cond);
+    pthread_mutex_unlock(&db->pool_lock);
 }
 
 // 최근 SQLite 에러 메시지를 안전하게 가져온다.
 const char *db_errmsg(db_ctx_t *db) {
-    if (!db || !db->conn) {
+    if (!db || !db->writer.handle) {
         return "db not initialized";
     }
-    return sqlite3_errmsg(db->conn);
+    return sqlite3_errmsg(db->writer.handle);
 }
 
 // DB 파일을 열고 외래키/타임아웃 등의 기본 설정을 적용한다.
@@ -35,32 +114,190 @@ int db_init(db_ctx_t *db, const char *path) {
     if (pthread_mutex_init(&db->mutex, NULL) != 0) {
         return -1;
     }
-
-    int flags = SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE | SQLITE_OPEN_FULLMUTEX;
-    if (sqlite3_open_v2(path, &db->conn, flags, NULL) != SQLITE_OK) {
+    if (pthread_mutex_init(&db->pool_lock, NULL) != 0) {
         pthread_mutex_destroy(&db->mutex);
         return -1;
     }
-    sqlite3_busy_timeout(db->conn, 5000);
-    if (sqlite3_exec(db->conn, "PRAGMA foreign_keys = ON", NULL, NULL, NULL) != SQLITE_OK) {
-        sqlite3_close(db->conn);
-        db->conn = NULL;
+    if (pthread_cond_init(&db->pool_cond, NULL) != 0) {
+        pthread_mutex_destroy(&db->pool_lock);
         pthread_mutex_destroy(&db->mutex);
         return -1;
     }
+
+    // db->mutex로 직렬화하므로 SQLite 내부 뮤텍스는 필요 없다.
+    int flags = SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE | SQLITE_OPEN_NOMUTEX;
+    if (sqlite3_open_v2(path, &db->writer.handle, flags, NULL) != SQLITE_OK) {
+        db_close(db);
+        return -1;
+    }
+    sqlite3_busy_timeout(db->writer.handle, 5000);
+    if (sqlite3_exec(db->writer.handle, "PRAGMA foreign_keys = ON", NULL, NULL, NULL) != SQLITE_OK) {
+        db_close(db);
+        return -1;
+    }
+    return 0;
+}
+
+// 스키마 적용(WAL 전환) 뒤에 읽기 전용 연결 풀을 연다. 실패하면 writer만으로 계속 동작한다.
+int db_open_readers(db_ctx_t *db, const char *path, size_t count) {
+    if (!db || !path || count == 0 || db->readers) {
+        return -1;
+    }
+    db->readers = calloc(count, sizeof(db_conn_t));
+    if (!db->readers) {
+        return -1;
+    }
+    int flags = SQLITE_OPEN_READONLY | SQLITE_OPEN_NOMUTEX;
+    size_t opened = 0;
+    for (; opened < count; ++opened) {
+        db_conn_t *conn = &db->readers[opened];
+        if (sqlite3_open_v2(path, &conn->handle, flags, NULL) != SQLITE_OK) {
+            log_warn("Failed to open read connection %zu: %s", opened,
+                     conn->handle ? sqlite3_errmsg(conn->handle) : "out of memory");
+            db_conn_close(conn);
+            break;
+        }
+        sqlite3_busy_timeout(conn->handle, 5000);
+        conn->next_free = db->free_readers;
+        db->free_readers = conn;
+    }
+    db->reader_count = opened;
+    if (opened == 0) {
+        free(db->readers);
+        db->readers = NULL;
+        return -1;
+    }
     return 0;
 }
 
 // 안전한 종료: 핸들을 닫고 뮤텍스를 파괴한다.
 void db_close(db_ctx_t *db) {
     if (!db) return;
-    if (db->conn) {
-        sqlite3_close(db->conn);
-        db->conn = NULL;
-    }
+    for (size_t i = 0; i < db->reader_count; ++i) {
+        db_conn_close(&db->readers[i]);
+    }
+    free(db->readers);
+    db->readers = NULL;
+    db->reader_count = 0;
+    db->free_readers = NULL;
+    db_conn_close(&db->writer);
+    pthread_cond_destroy(&db->pool_cond);
+    pthread_mutex_destroy(&db->pool_lock);
     pthread_mutex_destroy(&db->mutex);
 }
 
+// 컬럼이 존재하는지 PRAGMA table_info로 확인한다. 호출 측에서 잠금을 잡고 있어야 한다.
+static int db_has_column(db_ctx_t *db, const char *table, const char *column) {
+    char sql[128];
+    snprintf(sql, sizeof(sql), "PRAGMA table_info(%s)", table);
+    sqlite3_stmt *stmt = NULL;
+    if (sqlite3_prepare_v2(db->writer.handle, sql, -1, &stmt, NULL) != SQLITE_OK) {
+        return 0;
+    }
+    int found = 0;
+    while (sqlite3_step(stmt) == SQLITE_ROW) {
+        const unsigned char *name = sqlite3_column_text(stmt, 1);
+        if (name && strcmp((const char *)name, column) == 0) {
+            found = 1;
+            break;
+        }
+    }
+    sqlite3_finalize(stmt);
+    return found;
+}
+
+// 제목/파일명/설명 검색용 FTS5 trigram 인덱스를 준비한다. videos를 외부 콘텐츠로 쓰고 트리거로 동기화하므로
+// 카탈로그를 쓰는 db_apply_media_changes가 따로 손댈 필요가 없다.
+// FTS5가 없는 SQLite 빌드에서는 경고만 남기고 LIKE 검색으로 동작한다.
+static int db_setup_search_index(db_ctx_t *db) {
+    static const char *ddl =
+        "CREATE VIRTUAL TABLE IF NOT EXISTS videos_fts USING fts5("
+        "title, filename, description, content='videos', content_rowid='id', tokenize='trigram');\n"
+        "CREATE TRIGGER IF NOT EXISTS videos_fts_ai AFTER INSERT ON videos BEGIN\n"
+        "  INSERT INTO videos_fts(rowid, title, filename, description) "
+        "VALUES (new.id, new.title, new.filename, new.description);\n"
+        "END;\n"
+        "CREATE TRIGGER IF NOT EXISTS videos_fts_ad AFTER DELETE ON videos BEGIN\n"
+        "  INSERT INTO videos_fts(videos_fts, rowid, title, filename, description) "
+        "VALUES ('delete', old.id, old.title, old.filename, old.description);\n"
+        "END;\n"
+        "CREATE TRIGGER IF NOT EXISTS videos_fts_au AFTER UPDATE OF title, filename, description ON videos BEGIN\n"
+        "  INSERT INTO videos_fts(videos_fts, rowid, title, filename, description) "
+        "VALUES ('delete', old.id, old.title, old.filename, old.description);\n"
+        "  INSERT INTO videos_fts(rowid, title, filename, description) "
+        "VALUES (new.id, new.title, new.filename, new.description);\n"
+        "END;";
+    db->has_search_index = 0;
+    sqlite3_stmt *stmt = NULL;
+    int existed = 0;
+    if (sqlite3_prepare_v2(db->writer.handle,
+                           "SELECT 1 FROM sqlite_master WHERE name = 'videos_fts'", -1, &stmt, NULL) == SQLITE_OK) {
+        existed = sqlite3_step(stmt) == SQLITE_ROW;
+        sqlite3_finalize(stmt);
+    }
+    char *errmsg = NULL;
+    if (sqlite3_exec(db->writer.handle, ddl, NULL, NULL, &errmsg) != SQLITE_OK) {
+        log_warn("Full-text search unavailable, falling back to LIKE scans: %s",
+                 errmsg ? errmsg : "unknown");
+        sqlite3_free(errmsg);
+        return 0;
+    }
+    if (!existed) {
+        // 인덱스가 새로 생겼으면 기존 카탈로그로 채운다.
+        if (sqlite3_exec(db->writer.handle, "INSERT INTO videos_fts(videos_fts) VALUES('rebuild')",
+                         NULL, NULL, &errmsg) != SQLITE_OK) {
+            log_error("Failed to build search index: %s", errmsg ? errmsg : "unknown");
+            sqlite3_free(errmsg);
+            return -1;
+        }
+        log_info("Migrated schema: built full-text search index");
+    }
+    // rank는 bm25에 열 가중치를 준 값: 제목 일치가 파일명, 설명 일치보다 앞에 온다.
+    if (sqlite3_exec(db->writer.handle,
+                     "INSERT INTO videos_fts(videos_fts, rank) VALUES('rank', 'bm25(10.0, 5.0, 1.0)')",
+                     NULL, NULL, &errmsg) != SQLITE_OK) {
+        log_warn("Failed to configure search ranking: %s", errmsg ? errmsg : "unknown");
+        sqlite3_free(errmsg);
+    }
+    db->has_search_index = 1;
+    return 0;
+}
+
+// 예전 스키마로 만들어진 DB에 새 컬럼을 덧붙인다. (CREATE TABLE IF NOT EXISTS는 기존 테이블을 바꾸지 않는다)
+static int db_migrate(db_ctx_t *db) {
+    static const struct {
+        const char *table;
+        const char *column;
+        const char *ddl;
+    } migrations[] = {
+        {"videos", "file_size", "ALTER TABLE videos ADD COLUMN file_size INTEGER DEFAULT 0"},
+        {"videos", "file_mtime", "ALTER TABLE videos ADD COLUMN file_mtime INTEGER DEFAULT 0"},
+        {"videos", "width", "ALTER TABLE videos ADD COLUMN width INTEGER DEFAULT 0"},
+        {"videos", "height", "ALTER TABLE videos ADD COLUMN height INTEGER DEFAULT 0"},
+        {"videos", "video_codec", "ALTER TABLE videos ADD COLUMN video_codec TEXT"},
+        {"videos", "audio_codec", "ALTER TABLE videos ADD COLUMN audio_codec TEXT"},
+        {"videos", "mdat_offset", "ALTER TABLE videos ADD COLUMN mdat_offset INTEGER DEFAULT -1"},
+        {"videos", "faststart", "ALTER TABLE videos ADD COLUMN faststart INTEGER DEFAULT 1"},
+        // 색인된 적 없는 기존 행은 지문을 지워 다음 전체 스캔에서 다시 읽게 한다.
+        {"videos", "moov_offset",
+         "ALTER TABLE videos ADD COLUMN moov_offset INTEGER DEFAULT -1; UPDATE videos SET file_mtime = 0"},
+    };
+    for (size_t i = 0; i < ARRAY_SIZE(migrations); ++i) {
+        if (db_has_column(db, migrations[i].table, migrations[i].column)) {
+            continue;
+        }
+        char *errmsg = NULL;
+        if (sqlite3_exec(db->writer.handle, migrations[i].ddl, NULL, NULL, &errmsg) != SQLITE_OK) {
+            log_error("Migration failed (%s.%s): %s", migrations[i].table, migrations[i].column,
+                      errmsg ? errmsg : "unknown");
+            sqlite3_free(errmsg);
+            return -1;
+        }
+        log_info("Migrated schema: added %s.%s", migrations[i].table, migrations[i].column);
+    }
+    return db_setup_search_index(db);
+}
+
 // schema.sql을 통째로 실행해서 테이블을 준비한다.
 int db_run_schema(db_ctx_t *db, const char *schema_path) {
     if (!db || !schema_path) {
@@ -72,9 +309,10 @@ int db_run_schema(db_ctx_t *db, const char *schema_path) {
         return -1;
     }
     char *errmsg = NULL;
-    db_lock(db);
-    int rc = sqlite3_exec(db->conn, sql, NULL, NULL, &errmsg);
-    db_unlock(db);
+    db_conn_t *conn = db_acquire_writer(db);
+    int rc = sqlite3_exec(conn->handle, sql, NULL, NULL, &errmsg);
+    int migrate_rc = rc == SQLITE_OK ? db_migrate(db) : 0;
+    db_release(db, conn);
     free(sql);
     if (rc != SQLITE_OK) {
         if (errmsg) {
@@ -83,7 +321,7 @@ int db_run_schema(db_ctx_t *db, const char *schema_path) {
         }
         return -1;
     }
-    return 0;
+    return migrate_rc;
 }
 
 // sqlite3_column_blob의 내용을 고정 길이 버퍼로 복사한다.
@@ -105,10 +343,10 @@ int db_get_user_credentials(db_ctx_t *db, const char *username, int *user_id,
         return -1;
     }
     const char *sql = "SELECT id, password_hash, salt FROM users WHERE username = ?";
-    db_lock(db);
-    sqlite3_stmt *stmt = NULL;
-    if (sqlite3_prepare_v2(db->conn, sql, -1, &stmt, NULL) != SQLITE_OK) {
-        db_unlock(db);
+    db_conn_t *conn = db_acquire_reader(db);
+    sqlite3_stmt *stmt = db_prepare(conn, sql);
+    if (!stmt) {
+        db_release(db, conn);
         return -1;
     }
     sqlite3_bind_text(stmt, 1, username, -1, SQLITE_TRANSIENT);
@@ -123,8 +361,8 @@ int db_get_user_credentials(db_ctx_t *db, const char *username, int *user_id,
     } else {
         result = -1;
     }
-    sqlite3_finalize(stmt);
-    db_unlock(db);
+    db_finish(stmt);
+    db_release(db, conn);
     return result;
 }
 
@@ -138,18 +376,18 @@ int db_upsert_user(db_ctx_t *db, const char *username,
     const char *sql =
         "INSERT INTO users(username, password_hash, salt) VALUES(?, ?, ?) \n"
         "ON CONFLICT(username) DO UPDATE SET password_hash=excluded.password_hash, salt=excluded.salt";
-    db_lock(db);
-    sqlite3_stmt *stmt = NULL;
-    if (sqlite3_prepare_v2(db->conn, sql, -1, &stmt, NULL) != SQLITE_OK) {
-        db_unlock(db);
+    db_conn_t *conn = db_acquire_writer(db);
+    sqlite3_stmt *stmt = db_prepare(conn, sql);
+    if (!stmt) {
+        db_release(db, conn);
         return -1;
     }
     sqlite3_bind_text(stmt, 1, username, -1, SQLITE_TRANSIENT);
     sqlite3_bind_blob(stmt, 2, hash, (int)hash_len, SQLITE_TRANSIENT);
     sqlite3_bind_blob(stmt, 3, salt, (int)salt_len, SQLITE_TRANSIENT);
     int rc = sqlite3_step(stmt);
-    sqlite3_finalize(stmt);
-    db_unlock(db);
+    db_finish(stmt);
+    db_release(db, conn);
     return rc == SQLITE_DONE ? 0 : -1;
 }
 
@@ -162,22 +400,21 @@ int db_create_user(db_ctx_t *db, const char *username,
         return -1;
     }
     const char *sql = "INSERT INTO users(username, password_hash, salt) VALUES(?, ?, ?)";
-    db_lock(db);
-    sqlite3_stmt *stmt = NULL;
-    int rc = sqlite3_prepare_v2(db->conn, sql, -1, &stmt, NULL);
-    if (rc != SQLITE_OK) {
-        db_unlock(db);
+    db_conn_t *conn = db_acquire_writer(db);
+    sqlite3_stmt *stmt = db_prepare(conn, sql);
+    if (!stmt) {
+        db_release(db, conn);
         return -1;
     }
     sqlite3_bind_text(stmt, 1, username, -1, SQLITE_TRANSIENT);
     sqlite3_bind_blob(stmt, 2, hash, (int)hash_len, SQLITE_TRANSIENT);
     sqlite3_bind_blob(stmt, 3, salt, (int)salt_len, SQLITE_TRANSIENT);
-    rc = sqlite3_step(stmt);
+    int rc = sqlite3_step(stmt);
     if (rc == SQLITE_DONE && user_id_out) {
-        *user_id_out = (int)sqlite3_last_insert_rowid(db->conn);
+        *user_id_out = (int)sqlite3_last_insert_rowid(conn->handle);
     }
-    sqlite3_finalize(stmt);
-    db_unlock(db);
+    db_finish(stmt);
+    db_release(db, conn);
     if (rc == SQLITE_DONE) {
         return 0;
     }
@@ -193,18 +430,18 @@ int db_create_session(db_ctx_t *db, const char *token, int user_id, time_t expir
     const char *sql =
         "INSERT INTO sessions(token, user_id, expires_at) VALUES(?, ?, ?) \n"
         "ON CONFLICT(token) DO UPDATE SET user_id=excluded.user_id, expires_at=excluded.expires_at";
-    db_lock(db);
-    sqlite3_stmt *stmt = NULL;
-    if (sqlite3_prepare_v2(db->conn, sql, -1, &stmt, NULL) != SQLITE_OK) {
-        db_unlock(db);
+    db_conn_t *conn = db_acquire_writer(db);
+    sqlite3_stmt *stmt = db_prepare(conn, sql);
+    if (!stmt) {
+        db_release(db, conn);
         return -1;
     }
     sqlite3_bind_text(stmt, 1, token, -1, SQLITE_TRANSIENT);
     sqlite3_bind_int(stmt, 2, user_id);
     sqlite3_bind_int64(stmt, 3, (sqlite3_int64)expires_at);
     int rc = sqlite3_step(stmt);
-    sqlite3_finalize(stmt);
-    db_unlock(db);
+    db_finish(stmt);
+    db_release(db, conn);
     return rc == SQLITE_DONE ? 0 : -1;
 }
 
@@ -214,10 +451,10 @@ int db_get_session(db_ctx_t *db, const char *token, int *user_id, time_t *expire
         return -1;
     }
     const char *sql = "SELECT user_id, expires_at FROM sessions WHERE token = ?";
-    db_lock(db);
-    sqlite3_stmt *stmt = NULL;
-    if (sqlite3_prepare_v2(db->conn, sql, -1, &stmt, NULL) != SQLITE_OK) {
-        db_unlock(db);
+    db_conn_t *conn = db_acquire_reader(db);
+    sqlite3_stmt *stmt = db_prepare(conn, sql);
+    if (!stmt) {
+        db_release(db, conn);
         return -1;
     }
     sqlite3_bind_text(stmt, 1, token, -1, SQLITE_TRANSIENT);
@@ -228,8 +465,8 @@ int db_get_session(db_ctx_t *db, const char *token, int *user_id, time_t *expire
         *expires_at = (time_t)sqlite3_column_int64(stmt, 1);
         result = 0;
     }
-    sqlite3_finalize(stmt);
-    db_unlock(db);
+    db_finish(stmt);
+    db_release(db, conn);
     return result;
 }
 
@@ -237,16 +474,16 @@ int db_get_session(db_ctx_t *db, const char *token, int *user_id, time_t *expire
 int db_delete_session(db_ctx_t *db, const char *token) {
     if (!db || !token) return -1;
     const char *sql = "DELETE FROM sessions WHERE token = ?";
-    db_lock(db);
-    sqlite3_stmt *stmt = NULL;
-    if (sqlite3_prepare_v2(db->conn, sql, -1, &stmt, NULL) != SQLITE_OK) {
-        db_unlock(db);
+    db_conn_t *conn = db_acquire_writer(db);
+    sqlite3_stmt *stmt = db_prepare(conn, sql);
+    if (!stmt) {
+        db_release(db, conn);
         return -1;
     }
     sqlite3_bind_text(stmt, 1, token, -1, SQLITE_TRANSIENT);
     int rc = sqlite3_step(stmt);
-    sqlite3_finalize(stmt);
-    db_unlock(db);
+    db_finish(stmt);
+    db_release(db, conn);
     return rc == SQLITE_DONE ? 0 : -1;
 }
 
@@ -254,16 +491,16 @@ int db_delete_session(db_ctx_t *db, const char *token) {
 int db_purge_expired_sessions(db_ctx_t *db, time_t now) {
     if (!db) return -1;
     const char *sql = "DELETE FROM sessions WHERE expires_at < ?";
-    db_lock(db);
-    sqlite3_stmt *stmt = NULL;
-    if (sqlite3_prepare_v2(db->conn, sql, -1, &stmt, NULL) != SQLITE_OK) {
-        db_unlock(db);
+    db_conn_t *conn = db_acquire_writer(db);
+    sqlite3_stmt *stmt = db_prepare(conn, sql);
+    if (!stmt) {
+        db_release(db, conn);
         return -1;
     }
     sqlite3_bind_int64(stmt, 1, (sqlite3_int64)now);
     sqlite3_step(stmt);
-    sqlite3_finalize(stmt);
-    db_unlock(db);
+    db_finish(stmt);
+    db_release(db, conn);
     return 0;
 }
 
@@ -278,10 +515,10 @@ int db_list_videos(db_ctx_t *db,
     }
     const char *sql =
         "SELECT id, title, filename, IFNULL(description, ''), duration_seconds FROM videos ORDER BY id";
-    db_lock(db);
-    sqlite3_stmt *stmt = NULL;
-    if (sqlite3_prepare_v2(db->conn, sql, -1, &stmt, NULL) != SQLITE_OK) {
-        db_unlock(db);
+    db_conn_t *conn = db_acquire_reader(db);
+    sqlite3_stmt *stmt = db_prepare(conn, sql);
+    if (!stmt) {
+        db_release(db, conn);
         return -1;
     }
     int rc;
@@ -298,57 +535,102 @@ int db_list_videos(db_ctx_t *db,
             break;
         }
     }
-    sqlite3_finalize(stmt);
-    db_unlock(db);
+    db_finish(stmt);
+    db_release(db, conn);
     return (rc == SQLITE_DONE || rc == SQLITE_ROW) ? result : -1;
 }
 
-// 페이지네이션과 검색어 필터를 지원하는 비디오 조회 함수
-int db_query_videos(db_ctx_t *db, const char *search_term, int limit, int offset,
+// 검색어를 FTS5 구문 문자열("...", 내부 따옴표는 두 번)로 감싼다. trigram 인덱스는 부분 문자열
+// 일치를 지원하지만 3글자(코드 포인트) 이상이어야 하므로, 그보다 짧거나 너무 길면 -1을 돌려준다.
+static int db_fts_phrase(const char *term, char *out, size_t out_len) {
+    size_t codepoints = 0;
+    size_t pos = 0;
+    if (out_len < 3) return -1;
+    out[pos++] = '"';
+    for (const unsigned char *p = (const unsigned char *)term; *p; ++p) {
+        if ((*p & 0xC0) != 0x80) {
+            codepoints++;
+        }
+        size_t need = *p == '"' ? 2 : 1;
+        if (pos + need + 2 > out_len) {
+            return -1;
+        }
+        out[pos++] = (char)*p;
+        if (*p == '"') {
+            out[pos++] = '"';
+        }
+    }
+    out[pos++] = '"';
+    out[pos] = '\0';
+    return codepoints >= 3 ? 0 : -1;
+}
+
+// keyset 페이지네이션과 검색어 필터를 지원하는 비디오 조회 함수.
+// after가 NULL이면 첫 페이지, 아니면 그 키 다음부터 limit개를 돌려주고 마지막 행의 키를 last_out에 남긴다.
+// OFFSET을 쓰지 않으므로 깊은 페이지도 첫 페이지와 같은 비용이 든다.
+int db_query_videos(db_ctx_t *db, const char *search_term, int limit,
+                    const db_video_cursor_t *after,
                     int (*callback)(void *userdata, int id, const char *title,
                                     const char *filename, const char *description,
                                     int duration_seconds),
-                    void *userdata, int *has_more_out) {
-    if (!db || !callback || limit <= 0 || offset < 0) {
+                    void *userdata, int *has_more_out, db_video_cursor_t *last_out) {
+    if (!db || !callback || limit <= 0) {
         return -1;
     }
     const char *base_sql =
-        "SELECT id, title, filename, IFNULL(description, ''), duration_seconds FROM videos ORDER BY id LIMIT ? OFFSET ?";
+        "SELECT id, title, filename, IFNULL(description, ''), duration_seconds, 0.0 FROM videos "
+        "WHERE id > ?2 ORDER BY id LIMIT ?4";
+    // FTS 쪽에서 (rank, id) 순으로 커서 이후 한 페이지만 자른 뒤 그 행만 videos에서 읽는다.
+    // 첫 페이지는 ?2(rank)를 NULL로 바인딩한다.
+    const char *fts_sql =
+        "SELECT v.id, v.title, v.filename, IFNULL(v.description, ''), v.duration_seconds, hit.rank FROM "
+        "(SELECT id, rank FROM (SELECT rowid AS id, rank FROM videos_fts WHERE videos_fts MATCH ?1) "
+        "WHERE ?2 IS NULL OR (rank, id) > (?2, ?3) ORDER BY rank, id LIMIT ?4) AS hit "
+        "JOIN videos v ON v.id = hit.id ORDER BY hit.rank, hit.id";
     const char *search_sql =
-        "SELECT id, title, filename, IFNULL(description, ''), duration_seconds FROM videos "
-        "WHERE title LIKE ? OR filename LIKE ? OR IFNULL(description, '') LIKE ? "
-        "ORDER BY id LIMIT ? OFFSET ?";
+        "SELECT id, title, filename, IFNULL(description, ''), duration_seconds, 0.0 FROM videos "
+        "WHERE id > ?2 AND (title LIKE ?1 OR filename LIKE ?1 OR IFNULL(description, '') LIKE ?1) "
+        "ORDER BY id LIMIT ?4";
     const char *sql = base_sql;
     char pattern[256];
-    const char *like_term = NULL;
+    int use_fts = 0;
     if (search_term && *search_term) {
-        // 부분 일치를 위해 %검색어% 패턴을 만든다.
-        size_t len = strnlen(search_term, sizeof(pattern) - 3);
-        pattern[0] = '%';
-        memcpy(pattern + 1, search_term, len);
-        pattern[len + 1] = '%';
-        pattern[len + 2] = '\0';
-        like_term = pattern;
-        sql = search_sql;
+        if (db->has_search_index && db_fts_phrase(search_term, pattern, sizeof(pattern)) == 0) {
+            use_fts = 1;
+            sql = fts_sql;
+        } else {
+            // 3글자 미만은 trigram 인덱스로 찾을 수 없어 부분 일치 스캔으로 처리한다.
+            size_t len = strnlen(search_term, sizeof(pattern) - 3);
+            pattern[0] = '%';
+            memcpy(pattern + 1, search_term, len);
+            pattern[len + 1] = '%';
+            pattern[len + 2] = '\0';
+            sql = search_sql;
+        }
     }
     // 다음 페이지 존재 여부를 판단하기 위해 1건 더 가져온다.
     int limit_with_extra = limit + 1;
-    db_lock(db);
-    sqlite3_stmt *stmt = NULL;
-    int rc = sqlite3_prepare_v2(db->conn, sql, -1, &stmt, NULL);
-    if (rc != SQLITE_OK) {
-        db_unlock(db);
+    db_conn_t *conn = db_acquire_reader(db);
+    sqlite3_stmt *stmt = db_prepare(conn, sql);
+    if (!stmt) {
+        db_release(db, conn);
         return -1;
     }
-    int param = 1;
-    if (like_term) {
-        sqlite3_bind_text(stmt, param++, like_term, -1, SQLITE_TRANSIENT);
-        sqlite3_bind_text(stmt, param++, like_term, -1, SQLITE_TRANSIENT);
-        sqlite3_bind_text(stmt, param++, like_term, -1, SQLITE_TRANSIENT);
+    if (sql != base_sql) {
+        sqlite3_bind_text(stmt, 1, pattern, -1, SQLITE_TRANSIENT);
     }
-    sqlite3_bind_int(stmt, param++, limit_with_extra);
-    sqlite3_bind_int(stmt, param++, offset);
-    int emitted = 0;
+    if (use_fts) {
+        if (after) {
+            sqlite3_bind_double(stmt, 2, after->rank);
+        } else {
+            sqlite3_bind_null(stmt, 2);
+        }
+        sqlite3_bind_int(stmt, 3, after ? after->id : 0);
+    } else {
+        sqlite3_bind_int(stmt, 2, after ? after->id : 0);
+    }
+    sqlite3_bind_int(stmt, 4, limit_with_extra);
+    int rc;
     int total_rows = 0;
     int callback_error = 0;
     while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
@@ -363,22 +645,24 @@ int db_query_videos(db_ctx_t *db, const char *search_term, int limit, int offset
                 callback_error = 1;
                 break;
             }
-            emitted++;
+            if (last_out) {
+                last_out->id = id;
+                last_out->rank = sqlite3_column_double(stmt, 5);
+            }
         }
         total_rows++;
     }
     if (has_more_out) {
         *has_more_out = total_rows > limit ? 1 : 0;
     }
-    sqlite3_finalize(stmt);
-    db_unlock(db);
+    db_finish(stmt);
+    db_release(db, conn);
     if (callback_error) {
         return -1;
     }
     if (rc != SQLITE_DONE && rc != SQLITE_ROW) {
         return -1;
     }
-    (void)emitted;
     return 0;
 }
 
@@ -393,17 +677,17 @@ int db_get_video_by_id(db_ctx_t *db, int video_id,
     }
     const char *sql =
         "SELECT title, filename, IFNULL(description,''), duration_seconds FROM videos WHERE id = ?";
-    db_lock(db);
-    sqlite3_stmt *stmt = NULL;
-    if (sqlite3_prepare_v2(db->conn, sql, -1, &stmt, NULL) != SQLITE_OK) {
-        db_unlock(db);
+    db_conn_t *conn = db_acquire_reader(db);
+    sqlite3_stmt *stmt = db_prepare(conn, sql);
+    if (!stmt) {
+        db_release(db, conn);
         return -1;
     }
     sqlite3_bind_int(stmt, 1, video_id);
     int rc = sqlite3_step(stmt);
     if (rc != SQLITE_ROW) {
-        sqlite3_finalize(stmt);
-        db_unlock(db);
+        db_finish(stmt);
+        db_release(db, conn);
         return -1;
     }
     const char *title = (const char *)sqlite3_column_text(stmt, 0);
@@ -421,150 +705,258 @@ int db_get_video_by_id(db_ctx_t *db, int video_id,
     if (duration_seconds_out) {
         *duration_seconds_out = sqlite3_column_int(stmt, 3);
     }
-    sqlite3_finalize(stmt);
-    db_unlock(db);
+    db_finish(stmt);
+    db_release(db, conn);
     return 0;
 }
 
-// 실제 파일명을 기준으로 videos 테이블을 동기화한다.
-int db_upsert_video(db_ctx_t *db, const char *title, const char *filename,
-                    const char *description, int duration_seconds, int *video_id_out) {
-    if (!db || !filename) {
-        return -1;
-    }
-    const char *sql =
-        "INSERT INTO videos(title, filename, description, duration_seconds) VALUES(?, ?, ?, ?) \n"
-        "ON CONFLICT(filename) DO UPDATE SET title=excluded.title, description=excluded.description, duration_seconds=excluded.duration_seconds RETURNING id";
-    db_lock(db);
-    sqlite3_stmt *stmt = NULL;
-    if (sqlite3_prepare_v2(db->conn, sql, -1, &stmt, NULL) != SQLITE_OK) {
-        db_unlock(db);
+// 카탈로그에 저장된 파일별 크기/mtime 지문을 순회한다.
+int db_list_video_fingerprints(db_ctx_t *db,
+                               int (*callback)(void *userdata, const char *filename,
+                                               long long file_size, long long file_mtime),
+                               void *userdata) {
+    if (!db || !callback) return -1;
+    const char *sql = "SELECT filename, file_size, file_mtime FROM videos";
+    db_conn_t *conn = db_acquire_reader(db);
+    sqlite3_stmt *stmt = db_prepare(conn, sql);
+    if (!stmt) {
+        db_release(db, conn);
         return -1;
     }
-    sqlite3_bind_text(stmt, 1, title ? title : filename, -1, SQLITE_TRANSIENT);
-    sqlite3_bind_text(stmt, 2, filename, -1, SQLITE_TRANSIENT);
-    if (description) {
-        sqlite3_bind_text(stmt, 3, description, -1, SQLITE_TRANSIENT);
-    } else {
-        sqlite3_bind_null(stmt, 3);
+    int rc;
+    int result = 0;
+    while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+        const unsigned char *filename = sqlite3_column_text(stmt, 0);
+        if (callback(userdata, filename ? (const char *)filename : "",
+                     sqlite3_column_int64(stmt, 1), sqlite3_column_int64(stmt, 2)) != 0) {
+            result = -1;
+            break;
+        }
     }
-    sqlite3_bind_int(stmt, 4, duration_seconds);
-    int rc = sqlite3_step(stmt);
-    if (rc == SQLITE_ROW && video_id_out) {
-        *video_id_out = sqlite3_column_int(stmt, 0);
+    if (result == 0 && rc != SQLITE_DONE) {
+        result = -1;
     }
-    sqlite3_finalize(stmt);
-    db_unlock(db);
-    return (rc == SQLITE_ROW || rc == SQLITE_DONE) ? 0 : -1;
+    db_finish(stmt);
+    db_release(db, conn);
+    return result;
 }
 
-// 파일명이 제거된 비디오 레코드를 삭제한다.
-int db_delete_video_by_filename(db_ctx_t *db, const char *filename) {
-    if (!db || !filename) {
-        return -1;
-    }
-    const char *sql = "DELETE FROM videos WHERE filename = ?";
-    db_lock(db);
-    sqlite3_stmt *stmt = NULL;
-    if (sqlite3_prepare_v2(db->conn, sql, -1, &stmt, NULL) != SQLITE_OK) {
-        db_unlock(db);
-        return -1;
+// 워처가 모은 추가/변경/이름 변경/삭제를 하나의 트랜잭션으로 반영한다.
+// applied_out에는 실제로 바뀐 행 수가 담긴다 (지문이 같은 upsert는 건너뛴다).
+// 새로 들어오거나 바뀐 행의 ID는 RETURNING으로 받아 각 항목의 video_id에 적는다.
+// 바뀐 행이 있으면 같은 트랜잭션에서 카탈로그 세대를 올리고 새 값을 generation_out에 담는다 (없으면 0).
+int db_apply_media_changes(db_ctx_t *db, db_media_change_t *changes, size_t count,
+                           size_t *applied_out, unsigned long *generation_out) {
+    if (!db || (!changes && count > 0)) return -1;
+    if (applied_out) {
+        *applied_out = 0;
+    }
+    if (generation_out) {
+        *generation_out = 0;
+    }
+    if (count == 0) {
+        return 0;
     }
-    sqlite3_bind_text(stmt, 1, filename, -1, SQLITE_TRANSIENT);
-    int rc = sqlite3_step(stmt);
-    sqlite3_finalize(stmt);
-    db_unlock(db);
-    return rc == SQLITE_DONE ? 0 : -1;
-}
-
-// 실제 디렉터리에 없는 항목을 videos 테이블에서 삭제한다.
-int db_prune_missing_videos(db_ctx_t *db, const char *const *filenames, size_t count) {
-    if (!db) return -1;
-    db_lock(db);
+    const char *upsert_sql =
+        "INSERT INTO videos(title, filename, file_size, file_mtime, duration_seconds, width, height, \n"
+        "video_codec, audio_codec, moov_offset, mdat_offset, faststart) \n"
+        "VALUES(?, ?, ?, ?, ?, ?, ?, NULLIF(?, ''), NULLIF(?, ''), ?, ?, ?) \n"
+        "ON CONFLICT(filename) DO UPDATE SET title=excluded.title, file_size=excluded.file_size, file_mtime=excluded.file_mtime, \n"
+        "duration_seconds=excluded.duration_seconds, width=excluded.width, height=excluded.height, \n"
+        "video_codec=excluded.video_codec, audio_codec=excluded.audio_codec, moov_offset=excluded.moov_offset, \n"
+        "mdat_offset=excluded.mdat_offset, faststart=excluded.faststart \n"
+        "WHERE videos.title IS NOT excluded.title OR videos.file_size IS NOT excluded.file_size \n"
+        "OR videos.file_mtime IS NOT excluded.file_mtime RETURNING id";
+    const char *delete_sql = "DELETE FROM videos WHERE filename = ?";
+    // 이름 변경이 기존 파일을 덮어썼다면 덮인 쪽 행은 내용이 사라졌으므로 지우고, 옮겨진 행의 이름을 바꾼다.
+    const char *replaced_sql =
+        "DELETE FROM videos WHERE filename = ?1 AND EXISTS(SELECT 1 FROM videos WHERE filename = ?2)";
+    const char *rename_sql = "UPDATE videos SET filename = ?1, title = ?2 WHERE filename = ?3";
+    const char *generation_sql = "UPDATE catalog_state SET generation = generation + 1 WHERE id = 1 RETURNING generation";
+    unsigned long generation = 0;
+    db_conn_t *conn = db_acquire_writer(db);
+    sqlite3_stmt *upsert_stmt = NULL;
+    sqlite3_stmt *delete_stmt = NULL;
+    sqlite3_stmt *replaced_stmt = NULL;
+    sqlite3_stmt *rename_stmt = NULL;
+    size_t applied = 0;
     int rc = -1;
-    char *errmsg = NULL;
-    sqlite3_stmt *insert_stmt = NULL;
-    const char *create_sql = "CREATE TEMP TABLE IF NOT EXISTS temp_existing(filename TEXT PRIMARY KEY)";
-    if (sqlite3_exec(db->conn, create_sql, NULL, NULL, &errmsg) != SQLITE_OK) {
-        goto done;
-    }
-    if (errmsg) {
-        sqlite3_free(errmsg);
-        errmsg = NULL;
-    }
-    if (sqlite3_exec(db->conn, "DELETE FROM temp_existing", NULL, NULL, &errmsg) != SQLITE_OK) {
-        goto done;
-    }
-    if (errmsg) {
-        sqlite3_free(errmsg);
-        errmsg = NULL;
+    if (sqlite3_exec(conn->handle, "BEGIN IMMEDIATE", NULL, NULL, NULL) != SQLITE_OK) {
+        db_release(db, conn);
+        return -1;
     }
-    if (sqlite3_prepare_v2(db->conn,
-                           "INSERT OR IGNORE INTO temp_existing(filename) VALUES(?)",
-                           -1, &insert_stmt, NULL) != SQLITE_OK) {
+    upsert_stmt = db_prepare(conn, upsert_sql);
+    delete_stmt = db_prepare(conn, delete_sql);
+    replaced_stmt = db_prepare(conn, replaced_sql);
+    rename_stmt = db_prepare(conn, rename_sql);
+    if (!upsert_stmt || !delete_stmt || !replaced_stmt || !rename_stmt) {
         goto done;
     }
     for (size_t i = 0; i < count; ++i) {
-        const char *name = filenames ? filenames[i] : NULL;
-        if (!name || !*name) continue;
-        sqlite3_bind_text(insert_stmt, 1, name, -1, SQLITE_TRANSIENT);
-        if (sqlite3_step(insert_stmt) != SQLITE_DONE) {
+        db_media_change_t *change = &changes[i];
+        change->video_id = 0;
+        if (!change->filename || !*change->filename) continue;
+        if (change->old_filename && change->title) {
+            // 이전 이름의 행이 없으면 (카탈로그에 없던 파일) 바꿀 것이 없고 아래 upsert가 새로 넣는다.
+            sqlite3_bind_text(replaced_stmt, 1, change->filename, -1, SQLITE_TRANSIENT);
+            sqlite3_bind_text(replaced_stmt, 2, change->old_filename, -1, SQLITE_TRANSIENT);
+            if (sqlite3_step(replaced_stmt) != SQLITE_DONE) {
+                goto done;
+            }
+            applied += (size_t)sqlite3_changes(conn->handle);
+            db_finish(replaced_stmt);
+            sqlite3_bind_text(rename_stmt, 1, change->filename, -1, SQLITE_TRANSIENT);
+            sqlite3_bind_text(rename_stmt, 2, change->title, -1, SQLITE_TRANSIENT);
+            sqlite3_bind_text(rename_stmt, 3, change->old_filename, -1, SQLITE_TRANSIENT);
+            if (sqlite3_step(rename_stmt) != SQLITE_DONE) {
+                goto done;
+            }
+            applied += (size_t)sqlite3_changes(conn->handle);
+            db_finish(rename_stmt);
+        }
+        sqlite3_stmt *stmt = change->title ? upsert_stmt : delete_stmt;
+        if (change->title) {
+            sqlite3_bind_text(stmt, 1, change->title, -1, SQLITE_TRANSIENT);
+            sqlite3_bind_text(stmt, 2, change->filename, -1, SQLITE_TRANSIENT);
+            sqlite3_bind_int64(stmt, 3, change->file_size);
+            sqlite3_bind_int64(stmt, 4, change->file_mtime);
+            sqlite3_bind_int(stmt, 5, change->media.duration_seconds);
+            sqlite3_bind_int(stmt, 6, change->media.width);
+            sqlite3_bind_int(stmt, 7, change->media.height);
+            sqlite3_bind_text(stmt, 8, change->media.video_codec, -1, SQLITE_TRANSIENT);
+            sqlite3_bind_text(stmt, 9, change->media.audio_codec, -1, SQLITE_TRANSIENT);
+            sqlite3_bind_int64(stmt, 10, change->media.moov_offset);
+            sqlite3_bind_int64(stmt, 11, change->media.mdat_offset);
+            sqlite3_bind_int(stmt, 12, change->media.faststart);
+        } else {
+            sqlite3_bind_text(stmt, 1, change->filename, -1, SQLITE_TRANSIENT);
+        }
+        int step = sqlite3_step(stmt);
+        if (step == SQLITE_ROW) {
+            change->video_id = sqlite3_column_int(stmt, 0);
+            step = sqlite3_step(stmt);
+        }
+        if (step != SQLITE_DONE) {
             goto done;
         }
-        sqlite3_reset(insert_stmt);
-        sqlite3_clear_bindings(insert_stmt);
-    }
-    sqlite3_finalize(insert_stmt);
-    insert_stmt = NULL;
-    const char *delete_sql =
-        "DELETE FROM videos WHERE filename NOT IN (SELECT filename FROM temp_existing)";
-    if (sqlite3_exec(db->conn, delete_sql, NULL, NULL, &errmsg) != SQLITE_OK) {
-        goto done;
+        applied += (size_t)sqlite3_changes(conn->handle);
+        db_finish(stmt);
+    }
+    if (applied > 0) {
+        sqlite3_stmt *stmt = db_prepare(conn, generation_sql);
+        if (!stmt || sqlite3_step(stmt) != SQLITE_ROW) {
+            db_finish(stmt);
+            goto done;
+        }
+        generation = (unsigned long)sqlite3_column_int64(stmt, 0);
+        db_finish(stmt);
     }
     rc = 0;
 done:
-    if (insert_stmt) {
-        sqlite3_finalize(insert_stmt);
+    db_finish(upsert_stmt);
+    db_finish(delete_stmt);
+    db_finish(replaced_stmt);
+    db_finish(rename_stmt);
+    if (sqlite3_exec(conn->handle, rc == 0 ? "COMMIT" : "ROLLBACK", NULL, NULL, NULL) != SQLITE_OK) {
+        rc = -1;
     }
-    sqlite3_exec(db->conn, "DELETE FROM temp_existing", NULL, NULL, NULL);
-    if (errmsg) {
-        sqlite3_free(errmsg);
+    db_release(db, conn);
+    if (rc == 0 && applied_out) {
+        *applied_out = applied;
+    }
+    if (rc == 0 && generation_out) {
+        *generation_out = generation;
     }
-    db_unlock(db);
     return rc;
 }
 
+// 저장된 카탈로그 세대를 읽는다 (시작 시 이어 세기용).
+int db_get_catalog_generation(db_ctx_t *db, unsigned long *generation_out) {
+    if (!db || !generation_out) return -1;
+    db_conn_t *conn = db_acquire_reader(db);
+    sqlite3_stmt *stmt = db_prepare(conn, "SELECT generation FROM catalog_state WHERE id = 1");
+    if (!stmt) {
+        db_release(db, conn);
+        return -1;
+    }
+    int rc = sqlite3_step(stmt);
+    if (rc == SQLITE_ROW) {
+        *generation_out = (unsigned long)sqlite3_column_int64(stmt, 0);
+    }
+    db_finish(stmt);
+    db_release(db, conn);
+    return rc == SQLITE_ROW ? 0 : -1;
+}
+
 // 시청 위치를 upsert하여 마지막 재생 위치를 기록한다.
 int db_update_watch_history(db_ctx_t *db, int user_id, int video_id, double position_seconds) {
     if (!db) return -1;
     const char *sql =
         "INSERT INTO watch_history(user_id, video_id, position_seconds, updated_at) VALUES(?, ?, ?, CURRENT_TIMESTAMP) \n"
         "ON CONFLICT(user_id, video_id) DO UPDATE SET position_seconds=excluded.position_seconds, updated_at=CURRENT_TIMESTAMP";
-    db_lock(db);
-    sqlite3_stmt *stmt = NULL;
-    if (sqlite3_prepare_v2(db->conn, sql, -1, &stmt, NULL) != SQLITE_OK) {
-        db_unlock(db);
+    db_conn_t *conn = db_acquire_writer(db);
+    sqlite3_stmt *stmt = db_prepare(conn, sql);
+    if (!stmt) {
+        db_release(db, conn);
         return -1;
     }
     sqlite3_bind_int(stmt, 1, user_id);
     sqlite3_bind_int(stmt, 2, video_id);
     sqlite3_bind_double(stmt, 3, position_seconds);
     int rc = sqlite3_step(stmt);
-    sqlite3_finalize(stmt);
-    db_unlock(db);
+    db_finish(stmt);
+    db_release(db, conn);
     return rc == SQLITE_DONE ? 0 : -1;
 }
 
+// 버퍼에 모인 시청 위치를 한 트랜잭션으로 upsert한다. 그사이 삭제된 비디오는 건너뛴다.
+int db_flush_watch_history(db_ctx_t *db, const db_history_update_t *updates, size_t count) {
+    if (!db || (!updates && count > 0)) return -1;
+    if (count == 0) return 0;
+    const char *sql =
+        "INSERT INTO watch_history(user_id, video_id, position_seconds, updated_at) \n"
+        "SELECT ?1, ?2, ?3, datetime(?4, 'unixepoch') WHERE EXISTS(SELECT 1 FROM videos WHERE id = ?2) \n"
+        "ON CONFLICT(user_id, video_id) DO UPDATE SET position_seconds=excluded.position_seconds, updated_at=excluded.updated_at";
+    db_conn_t *conn = db_acquire_writer(db);
+    if (sqlite3_exec(conn->handle, "BEGIN IMMEDIATE", NULL, NULL, NULL) != SQLITE_OK) {
+        db_release(db, conn);
+        return -1;
+    }
+    int rc = -1;
+    sqlite3_stmt *stmt = db_prepare(conn, sql);
+    if (!stmt) {
+        goto done;
+    }
+    for (size_t i = 0; i < count; ++i) {
+        sqlite3_bind_int(stmt, 1, updates[i].user_id);
+        sqlite3_bind_int(stmt, 2, updates[i].video_id);
+        sqlite3_bind_double(stmt, 3, updates[i].position_seconds);
+        sqlite3_bind_int64(stmt, 4, (sqlite3_int64)updates[i].updated_at);
+        if (sqlite3_step(stmt) != SQLITE_DONE) {
+            goto done;
+        }
+        db_finish(stmt);
+    }
+    rc = 0;
+done:
+    db_finish(stmt);
+    if (sqlite3_exec(conn->handle, rc == 0 ? "COMMIT" : "ROLLBACK", NULL, NULL, NULL) != SQLITE_OK) {
+        rc = -1;
+    }
+    db_release(db, conn);
+    return rc;
+}
+
 // 특정 사용자/비디오에 대한 마지막 위치를 조회한다.
 int db_get_watch_history(db_ctx_t *db, int user_id, int video_id, double *position_seconds_out) {
     if (!db || !position_seconds_out) {
         return -1;
     }
     const char *sql = "SELECT position_seconds FROM watch_history WHERE user_id = ? AND video_id = ?";
-    db_lock(db);
-    sqlite3_stmt *stmt = NULL;
-    if (sqlite3_prepare_v2(db->conn, sql, -1, &stmt, NULL) != SQLITE_OK) {
-        db_unlock(db);
+    db_conn_t *conn = db_acquire_reader(db);
+    sqlite3_stmt *stmt = db_prepare(conn, sql);
+    if (!stmt) {
+        db_release(db, conn);
         return -1;
     }
     sqlite3_bind_int(stmt, 1, user_id);
@@ -572,12 +964,12 @@ int db_get_watch_history(db_ctx_t *db, int user_id, int video_id, double *positi
     int rc = sqlite3_step(stmt);
     if (rc == SQLITE_ROW) {
         *position_seconds_out = sqlite3_column_double(stmt, 0);
-        sqlite3_finalize(stmt);
-        db_unlock(db);
+        db_finish(stmt);
+        db_release(db, conn);
         return 0;
     }
-    sqlite3_finalize(stmt);
-    db_unlock(db);
+    db_finish(stmt);
+    db_release(db, conn);
     return -1;
 }
 
@@ -591,10 +983,10 @@ int db_list_watch_history(db_ctx_t *db, int user_id,
     }
     const char *sql =
         "SELECT video_id, position_seconds, updated_at FROM watch_history WHERE user_id = ? ORDER BY updated_at DESC";
-    db_lock(db);
-    sqlite3_stmt *stmt = NULL;
-    if (sqlite3_prepare_v2(db->conn, sql, -1, &stmt, NULL) != SQLITE_OK) {
-        db_unlock(db);
+    db_conn_t *conn = db_acquire_reader(db);
+    sqlite3_stmt *stmt = db_prepare(conn, sql);
+    if (!stmt) {
+        db_release(db, conn);
         return -1;
     }
     sqlite3_bind_int(stmt, 1, user_id);
@@ -609,8 +1001,58 @@ int db_list_watch_history(db_ctx_t *db, int user_id,
             break;
         }
     }
-    sqlite3_finalize(stmt);
-    db_unlock(db);
+    db_finish(stmt);
+    db_release(db, conn);
+    return (rc == SQLITE_DONE || rc == SQLITE_ROW) ? result : -1;
+}
+
+// /api/history용: 시청 기록을 비디오 제목과 함께 최신순으로 순회한다.
+// (user_id, updated_at, video_id) 인덱스를 타는 keyset 조회라 before 이후 limit개만 읽는다.
+int db_list_watch_history_titles(db_ctx_t *db, int user_id,
+                                 const db_history_cursor_t *before, int limit,
+                                 int (*callback)(void *userdata, int video_id,
+                                                 double position_seconds,
+                                                 const char *updated_at, const char *title),
+                                 void *userdata) {
+    if (!db || !callback || limit <= 0) {
+        return -1;
+    }
+    const char *first_sql =
+        "SELECT w.video_id, w.position_seconds, w.updated_at, IFNULL(v.title,'') "
+        "FROM watch_history w JOIN videos v ON v.id = w.video_id "
+        "WHERE w.user_id = ?1 ORDER BY w.updated_at DESC, w.video_id DESC LIMIT ?4";
+    const char *next_sql =
+        "SELECT w.video_id, w.position_seconds, w.updated_at, IFNULL(v.title,'') "
+        "FROM watch_history w JOIN videos v ON v.id = w.video_id "
+        "WHERE w.user_id = ?1 AND (w.updated_at, w.video_id) < (?2, ?3) "
+        "ORDER BY w.updated_at DESC, w.video_id DESC LIMIT ?4";
+    db_conn_t *conn = db_acquire_reader(db);
+    sqlite3_stmt *stmt = db_prepare(conn, before ? next_sql : first_sql);
+    if (!stmt) {
+        db_release(db, conn);
+        return -1;
+    }
+    sqlite3_bind_int(stmt, 1, user_id);
+    if (before) {
+        sqlite3_bind_text(stmt, 2, before->updated_at, -1, SQLITE_TRANSIENT);
+        sqlite3_bind_int(stmt, 3, before->video_id);
+    }
+    sqlite3_bind_int(stmt, 4, limit);
+    int rc;
+    int result = 0;
+    while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+        int video_id = sqlite3_column_int(stmt, 0);
+        double position = sqlite3_column_double(stmt, 1);
+        const char *updated_at = (const char *)sqlite3_column_text(stmt, 2);
+        const char *title = (const char *)sqlite3_column_text(stmt, 3);
+        if (callback(userdata, video_id, position, updated_at ? updated_at : "",
+                     title ? title : "") != 0) {
+            result = 1;
+            break;
+        }
+    }
+    db_finish(stmt);
+    db_release(db, conn);
     return (rc == SQLITE_DONE || rc == SQLITE_ROW) ? result : -1;
 }
 
@@ -620,10 +1062,10 @@ int db_get_username_by_id(db_ctx_t *db, int user_id, char *username_out, size_t
         return -1;
     }
     const char *sql = "SELECT username FROM users WHERE id = ?";
-    db_lock(db);
-    sqlite3_stmt *stmt = NULL;
-    if (sqlite3_prepare_v2(db->conn, sql, -1, &stmt, NULL) != SQLITE_OK) {
-        db_unlock(db);
+    db_conn_t *conn = db_acquire_reader(db);
+    sqlite3_stmt *stmt = db_prepare(conn, sql);
+    if (!stmt) {
+        db_release(db, conn);
         return -1;
     }
     sqlite3_bind_int(stmt, 1, user_id);
@@ -632,12 +1074,12 @@ int db_get_username_by_id(db_ctx_t *db, int user_id, char *username_out, size_t
         const char *username = (const char *)sqlite3_column_text(stmt, 0);
         if (username) {
             snprintf(username_out, len, "%s", username);
-            sqlite3_finalize(stmt);
-            db_unlock(db);
+            db_finish(stmt);
+            db_release(db, conn);
             return 0;
         }
     }
-    sqlite3_finalize(stmt);
-    db_unlock(db);
+    db_finish(stmt);
+    db_release(db, conn);
     return -1;
 }
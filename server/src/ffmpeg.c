@@ -1,7 +1,15 @@
 // 썸네일 생성을 위해 외부 ffmpeg CLI를 호출하는 래퍼
+// 요청 워커는 ffmpeg를 기다리지 않는다: 작업을 비디오/종류별로 중복 없이 큐에 넣고 전용 스레드가 처리한다.
+// 종류는 포스터 한 장과, 한 번의 디코딩으로 만드는 탐색 미리보기(스프라이트 시트 + WebVTT)다.
 #include "ffmpeg.h"
 
 #include <errno.h>
+#include <ftw.h>
+#include <limits.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdarg.h>
+#include <stdatomic.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -10,58 +18,695 @@
 #include <sys/wait.h>
 #include <unistd.h>
 
+#include "metrics.h"
+#include "mp4.h"
 #include "utils.h"
 
-// 썸네일을 저장할 디렉터리가 존재하는지 확인한다.
-int ffmpeg_initialize(server_ctx_t *server) {
-    if (!server) return -1;
-    if (ensure_directory(server->thumb_dir) != 0) {
-        log_error("Failed to ensure thumbnail directory %s: %s", server->thumb_dir, strerror(errno));
+#define THUMB_JOB_BUCKETS 256
+#define THUMB_QUEUE_MAX 4096   // 대기 중인 작업 상한 (넘치면 요청 시 다시 시도한다)
+#define THUMB_MAX_WORKERS 16
+
+// 미리보기 스프라이트: 160x90 타일을 10x10으로 붙인 한 장 (최대 100프레임)
+#define PREVIEW_TILE_WIDTH 160
+#define PREVIEW_TILE_HEIGHT 90
+#define PREVIEW_COLUMNS 10
+#define PREVIEW_ROWS 10
+#define PREVIEW_DEFAULT_INTERVAL 10 // 길이를 모를 때 프레임 간격(초)
+
+// HLS 세그먼트 길이(초). 모든 렌디션의 키프레임을 이 간격에 맞춰 세그먼트 경계를 일치시킨다.
+#define HLS_SEGMENT_SECONDS 4
+
+// HLS 비트레이트 사다리. 원본보다 높은 단계는 만들지 않는다 (가장 낮은 단계는 항상 만든다).
+static const struct {
+    const char *name;
+    int height;
+    int video_kbps;
+    int audio_kbps;
+} k_hls_ladder[] = {
+    {"360p", 360, 800, 96},
+    {"720p", 720, 2800, 128},
+    {"1080p", 1080, 5000, 160},
+};
+#define HLS_MAX_RENDITIONS (sizeof(k_hls_ladder) / sizeof(k_hls_ladder[0]))
+
+typedef enum {
+    THUMB_QUEUED,
+    THUMB_RUNNING,
+    THUMB_FAILED, // 같은 원본(mtime)으로는 다시 시도하지 않는다
+} thumb_job_state_t;
+
+// 비디오 하나에 대한 썸네일 작업. 비디오/종류마다 최대 하나만 존재한다.
+typedef struct thumb_job {
+    int video_id;
+    ffmpeg_job_kind_t kind;
+    int duration_seconds;       // 미리보기 간격 계산용 (0이면 모름)
+    thumb_job_state_t state;
+    time_t source_mtime;        // 실패했을 때의 원본 mtime
+    pid_t pid;                  // 실행 중인 ffmpeg 자식 (종료 시 정리용)
+    char video_path[PATH_MAX];
+    struct thumb_job *next;        // 해시 체인
+    struct thumb_job *next_queued; // 대기열 (FIFO)
+} thumb_job_t;
+
+typedef struct {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    thumb_job_t *buckets[THUMB_JOB_BUCKETS];
+    thumb_job_t *queue_head;
+    thumb_job_t *queue_tail;
+    size_t queued;
+    pthread_t threads[THUMB_MAX_WORKERS];
+    size_t thread_count;
+    atomic_int stop;
+} thumb_queue_t;
+
+static thumb_queue_t g_thumbs = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .cond = PTHREAD_COND_INITIALIZER,
+};
+
+static size_t job_bucket(int video_id, ffmpeg_job_kind_t kind) {
+    return (((unsigned)video_id * 4u + (unsigned)kind) * 2654435761u) % THUMB_JOB_BUCKETS;
+}
+
+// 잠금을 잡은 상태에서 비디오의 작업을 찾는다.
+static thumb_job_t *job_find_locked(int video_id, ffmpeg_job_kind_t kind) {
+    thumb_job_t *job = g_thumbs.buckets[job_bucket(video_id, kind)];
+    while (job && (job->video_id != video_id || job->kind != kind)) {
+        job = job->next;
+    }
+    return job;
+}
+
+// 잠금을 잡은 상태에서 작업을 해시에서 떼어 내고 해제한다.
+static void job_remove_locked(thumb_job_t *target) {
+    thumb_job_t **link = &g_thumbs.buckets[job_bucket(target->video_id, target->kind)];
+    while (*link && *link != target) {
+        link = &(*link)->next;
+    }
+    if (*link) {
+        *link = target->next;
+    }
+    free(target);
+}
+
+static int thumb_path_for(server_ctx_t *server, int video_id, char *out, size_t out_len) {
+    return snprintf(out, out_len, "%s/%d.jpg", server->thumb_dir, video_id) >= (int)out_len ? -1 : 0;
+}
+
+static int sprite_path_for(server_ctx_t *server, int video_id, char *out, size_t out_len) {
+    return snprintf(out, out_len, "%s/%d.sprite.jpg", server->thumb_dir, video_id) >= (int)out_len ? -1 : 0;
+}
+
+static int vtt_path_for(server_ctx_t *server, int video_id, char *out, size_t out_len) {
+    return snprintf(out, out_len, "%s/%d.vtt", server->thumb_dir, video_id) >= (int)out_len ? -1 : 0;
+}
+
+static int hls_dir_for(server_ctx_t *server, int video_id, char *out, size_t out_len) {
+    return snprintf(out, out_len, "%s/%d", server->hls_dir, video_id) >= (int)out_len ? -1 : 0;
+}
+
+// 작업이 끝났는지 판단하는 기준 파일: 포스터는 JPEG, 미리보기는 마지막에 쓰는 VTT,
+// HLS는 디렉터리째 교체되는 패키지의 master.m3u8.
+static int job_marker_path(server_ctx_t *server, int video_id, ffmpeg_job_kind_t kind,
+                           char *out, size_t out_len) {
+    if (kind == FFMPEG_JOB_HLS) {
+        return snprintf(out, out_len, "%s/%d/master.m3u8", server->hls_dir, video_id) >= (int)out_len ? -1 : 0;
+    }
+    return kind == FFMPEG_JOB_PREVIEWS ? vtt_path_for(server, video_id, out, out_len)
+                                       : thumb_path_for(server, video_id, out, out_len);
+}
+
+// 미리보기 프레임 간격(초). 길이를 알면 한 장의 타일 수 안에 전체가 들어가도록 늘린다.
+static int preview_interval(int duration_seconds) {
+    const int tiles = PREVIEW_COLUMNS * PREVIEW_ROWS;
+    if (duration_seconds <= 0) {
+        return PREVIEW_DEFAULT_INTERVAL;
+    }
+    int interval = (duration_seconds + tiles - 1) / tiles;
+    return interval < PREVIEW_DEFAULT_INTERVAL ? PREVIEW_DEFAULT_INTERVAL : interval;
+}
+
+// ffmpeg를 실행하고 끝날 때까지 기다린다. 실행 중인 pid는 종료 시 끊을 수 있게 작업에 적어 둔다.
+static int run_ffmpeg(thumb_job_t *job, char *const argv[]) {
+    pid_t pid = fork();
+    if (pid == 0) {
+        execvp("ffmpeg", argv);
+        _exit(1);
+    } else if (pid < 0) {
+        log_error("fork() failed for ffmpeg: %s", strerror(errno));
+        return -1;
+    }
+    pthread_mutex_lock(&g_thumbs.lock);
+    job->pid = pid;
+    pthread_mutex_unlock(&g_thumbs.lock);
+    int status = 0;
+    pid_t waited;
+    do {
+        waited = waitpid(pid, &status, 0);
+    } while (waited < 0 && errno == EINTR);
+    pthread_mutex_lock(&g_thumbs.lock);
+    job->pid = 0;
+    pthread_mutex_unlock(&g_thumbs.lock);
+    if (waited < 0) {
+        log_error("waitpid failed for ffmpeg: %s", strerror(errno));
+        return -1;
+    }
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        if (!g_thumbs.stop) {
+            log_error("ffmpeg failed to generate %s for %s",
+                      job->kind == FFMPEG_JOB_PREVIEWS ? "previews"
+                      : job->kind == FFMPEG_JOB_HLS    ? "HLS package"
+                                                       : "thumbnail",
+                      job->video_path);
+        }
         return -1;
     }
     return 0;
 }
 
-// 비디오의 변경 시각을 확인해 필요한 경우 새로 썸네일을 생성한다.
-int ffmpeg_ensure_thumbnail(server_ctx_t *server, int video_id,
-                            const char *video_path, char *thumb_path,
-                            size_t thumb_path_len) {
-    if (!server || !video_path || !thumb_path) {
+// 임시 파일을 최종 경로로 옮긴다. 읽는 쪽은 완성된 파일만 본다.
+static int install_file(const char *tmp_path, const char *final_path) {
+    if (rename(tmp_path, final_path) != 0) {
+        log_error("Failed to install %s: %s", final_path, strerror(errno));
+        unlink(tmp_path);
+        return -1;
+    }
+    return 0;
+}
+
+// ffmpeg로 임시 파일에 포스터를 만든 뒤 rename으로 교체한다.
+static int thumb_generate(thumb_job_t *job, const char *thumb_path) {
+    char tmp_path[PATH_MAX];
+    if (snprintf(tmp_path, sizeof(tmp_path), "%s.tmp.jpg", thumb_path) >= (int)sizeof(tmp_path)) {
+        return -1;
+    }
+    char *const argv[] = {"ffmpeg", "-y", "-loglevel", "error", "-ss", "5", "-i", job->video_path,
+                          "-vframes", "1", "-vf", "scale=320:-1", tmp_path, NULL};
+    if (run_ffmpeg(job, argv) != 0) {
+        unlink(tmp_path);
+        return -1;
+    }
+    return install_file(tmp_path, thumb_path);
+}
+
+// 스프라이트의 타일 위치를 가리키는 WebVTT 큐 파일을 쓴다.
+static int write_preview_vtt(const char *path, int video_id, int interval, int duration_seconds) {
+    FILE *fp = fopen(path, "w");
+    if (!fp) {
+        log_error("Failed to write %s: %s", path, strerror(errno));
+        return -1;
+    }
+    int tiles = PREVIEW_COLUMNS * PREVIEW_ROWS;
+    if (duration_seconds > 0) {
+        int needed = (duration_seconds + interval - 1) / interval;
+        if (needed < tiles) tiles = needed;
+    }
+    fputs("WEBVTT\n", fp);
+    for (int i = 0; i < tiles; ++i) {
+        int start = i * interval;
+        int end = start + interval;
+        if (duration_seconds > 0 && end > duration_seconds) end = duration_seconds;
+        fprintf(fp, "\n%02d:%02d:%02d.000 --> %02d:%02d:%02d.000\n"
+                    "/api/videos/%d/previews/sprite.jpg#xywh=%d,%d,%d,%d\n",
+                start / 3600, (start / 60) % 60, start % 60, end / 3600, (end / 60) % 60, end % 60,
+                video_id, (i % PREVIEW_COLUMNS) * PREVIEW_TILE_WIDTH, (i / PREVIEW_COLUMNS) * PREVIEW_TILE_HEIGHT,
+                PREVIEW_TILE_WIDTH, PREVIEW_TILE_HEIGHT);
+    }
+    if (fclose(fp) != 0) {
+        unlink(path);
+        return -1;
+    }
+    return 0;
+}
+
+// 한 번의 디코딩으로 일정 간격 프레임을 뽑아 스프라이트 한 장으로 타일링하고 VTT를 쓴다.
+// VTT를 마지막에 설치하므로 VTT가 보이면 스프라이트도 이미 준비되어 있다.
+static int previews_generate(server_ctx_t *server, thumb_job_t *job, const char *vtt_path) {
+    char sprite_path[PATH_MAX];
+    char sprite_tmp[PATH_MAX];
+    char vtt_tmp[PATH_MAX];
+    if (sprite_path_for(server, job->video_id, sprite_path, sizeof(sprite_path)) != 0 ||
+        snprintf(sprite_tmp, sizeof(sprite_tmp), "%s.tmp.jpg", sprite_path) >= (int)sizeof(sprite_tmp) ||
+        snprintf(vtt_tmp, sizeof(vtt_tmp), "%s.tmp", vtt_path) >= (int)sizeof(vtt_tmp)) {
         return -1;
     }
-    if (snprintf(thumb_path, thumb_path_len, "%s/%d.jpg", server->thumb_dir, video_id) >= (int)thumb_path_len) {
+    int interval = preview_interval(job->duration_seconds);
+    char filter[256];
+    snprintf(filter, sizeof(filter),
+             "fps=1/%d,scale=%d:%d:force_original_aspect_ratio=decrease,"
+             "pad=%d:%d:(ow-iw)/2:(oh-ih)/2,tile=%dx%d",
+             interval, PREVIEW_TILE_WIDTH, PREVIEW_TILE_HEIGHT, PREVIEW_TILE_WIDTH, PREVIEW_TILE_HEIGHT,
+             PREVIEW_COLUMNS, PREVIEW_ROWS);
+    char *const argv[] = {"ffmpeg", "-y", "-loglevel", "error", "-i", job->video_path, "-an", "-sn",
+                          "-vf", filter, "-frames:v", "1", "-q:v", "5", sprite_tmp, NULL};
+    if (run_ffmpeg(job, argv) != 0) {
+        unlink(sprite_tmp);
         return -1;
     }
+    if (install_file(sprite_tmp, sprite_path) != 0 ||
+        write_preview_vtt(vtt_tmp, job->video_id, interval, job->duration_seconds) != 0) {
+        return -1;
+    }
+    return install_file(vtt_tmp, vtt_path);
+}
+
+static int remove_tree_entry(const char *path, const struct stat *st, int type, struct FTW *ftw) {
+    (void)st;
+    (void)ftw;
+    return (type == FTW_DP ? rmdir(path) : unlink(path)) == 0 || errno == ENOENT ? 0 : -1;
+}
+
+// 디렉터리를 안쪽부터 지운다. 없으면 성공으로 본다.
+static int remove_tree(const char *path) {
+    struct stat st;
+    if (lstat(path, &st) != 0) {
+        return errno == ENOENT ? 0 : -1;
+    }
+    return nftw(path, remove_tree_entry, 16, FTW_DEPTH | FTW_PHYS);
+}
+
+// ffmpeg 인자 목록. 만든 문자열은 pool에 두어 argv가 함수 끝까지 유효하게 한다.
+typedef struct {
+    char *argv[128];
+    size_t argc;
+    char pool[4096];
+    size_t used;
+    int overflow;
+} ffmpeg_args_t;
+
+static void args_add(ffmpeg_args_t *args, const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+static void args_add(ffmpeg_args_t *args, const char *fmt, ...) {
+    if (args->overflow || args->argc + 1 >= ARRAY_SIZE(args->argv)) {
+        args->overflow = 1;
+        return;
+    }
+    va_list ap;
+    va_start(ap, fmt);
+    int n = vsnprintf(args->pool + args->used, sizeof(args->pool) - args->used, fmt, ap);
+    va_end(ap);
+    if (n < 0 || (size_t)n >= sizeof(args->pool) - args->used) {
+        args->overflow = 1;
+        return;
+    }
+    args->argv[args->argc++] = args->pool + args->used;
+    args->argv[args->argc] = NULL;
+    args->used += (size_t)n + 1;
+}
+
+// ffmpeg 한 번으로 원본을 한 번만 디코딩해 사다리의 모든 렌디션을 인코딩하고 fMP4 세그먼트로 자른다.
+// 임시 디렉터리에 만든 뒤 기존 패키지와 통째로 바꾸므로, 읽는 쪽은 한 세대의 파일만 본다.
+static int hls_generate(server_ctx_t *server, thumb_job_t *job) {
+    char final_dir[PATH_MAX];
+    char tmp_dir[PATH_MAX];
+    char old_dir[PATH_MAX];
+    if (hls_dir_for(server, job->video_id, final_dir, sizeof(final_dir)) != 0 ||
+        snprintf(tmp_dir, sizeof(tmp_dir), "%s.tmp", final_dir) >= (int)sizeof(tmp_dir) ||
+        snprintf(old_dir, sizeof(old_dir), "%s.old", final_dir) >= (int)sizeof(old_dir)) {
+        return -1;
+    }
+    // 원본보다 높은 단계를 건너뛰고 오디오 트랙 유무를 정하는 데 색인 결과를 쓴다.
+    mp4_info_t info;
+    int probed = mp4_probe(job->video_path, &info) == 0;
+    int has_audio = !probed || info.audio_codec[0] != '\0';
+    int source_height = probed ? info.height : 0;
+    size_t rungs[HLS_MAX_RENDITIONS];
+    size_t count = 0;
+    for (size_t i = 0; i < HLS_MAX_RENDITIONS; ++i) {
+        if (i == 0 || source_height <= 0 || k_hls_ladder[i].height <= source_height) {
+            rungs[count++] = i;
+        }
+    }
+
+    char filter[512];
+    size_t used = (size_t)snprintf(filter, sizeof(filter), "[0:v]split=%zu", count);
+    for (size_t i = 0; i < count && used < sizeof(filter); ++i) {
+        used += (size_t)snprintf(filter + used, sizeof(filter) - used, "[s%zu]", i);
+    }
+    for (size_t i = 0; i < count && used < sizeof(filter); ++i) {
+        used += (size_t)snprintf(filter + used, sizeof(filter) - used, ";[s%zu]scale=-2:'min(%d,ih)'[v%zu]",
+                                 i, k_hls_ladder[rungs[i]].height, i);
+    }
+    char stream_map[256];
+    size_t map_used = 0;
+    stream_map[0] = '\0';
+    for (size_t i = 0; i < count && map_used < sizeof(stream_map); ++i) {
+        map_used += (size_t)snprintf(stream_map + map_used, sizeof(stream_map) - map_used, "%sv:%zu", i ? " " : "", i);
+        if (has_audio && map_used < sizeof(stream_map)) {
+            map_used += (size_t)snprintf(stream_map + map_used, sizeof(stream_map) - map_used, ",a:%zu", i);
+        }
+        if (map_used < sizeof(stream_map)) {
+            map_used += (size_t)snprintf(stream_map + map_used, sizeof(stream_map) - map_used, ",name:%s",
+                                         k_hls_ladder[rungs[i]].name);
+        }
+    }
+    if (used >= sizeof(filter) || map_used >= sizeof(stream_map)) {
+        return -1;
+    }
+
+    ffmpeg_args_t args = {.argc = 0};
+    args_add(&args, "ffmpeg");
+    args_add(&args, "-y");
+    args_add(&args, "-loglevel");
+    args_add(&args, "error");
+    args_add(&args, "-i");
+    args_add(&args, "%s", job->video_path);
+    args_add(&args, "-filter_complex");
+    args_add(&args, "%s", filter);
+    for (size_t i = 0; i < count; ++i) {
+        args_add(&args, "-map");
+        args_add(&args, "[v%zu]", i);
+        if (has_audio) {
+            args_add(&args, "-map");
+            args_add(&args, "0:a:0");
+        }
+    }
+    // 키프레임을 세그먼트 경계마다 강제로 넣어 모든 렌디션의 세그먼트가 같은 시각에 끊기게 한다.
+    args_add(&args, "-c:v");
+    args_add(&args, "libx264");
+    args_add(&args, "-preset");
+    args_add(&args, "veryfast");
+    args_add(&args, "-sc_threshold");
+    args_add(&args, "0");
+    args_add(&args, "-force_key_frames");
+    args_add(&args, "expr:gte(t,n_forced*%d)", HLS_SEGMENT_SECONDS);
+    for (size_t i = 0; i < count; ++i) {
+        int kbps = k_hls_ladder[rungs[i]].video_kbps;
+        args_add(&args, "-b:v:%zu", i);
+        args_add(&args, "%dk", kbps);
+        args_add(&args, "-maxrate:v:%zu", i);
+        args_add(&args, "%dk", kbps * 107 / 100);
+        args_add(&args, "-bufsize:v:%zu", i);
+        args_add(&args, "%dk", kbps * 3 / 2);
+        if (has_audio) {
+            args_add(&args, "-b:a:%zu", i);
+            args_add(&args, "%dk", k_hls_ladder[rungs[i]].audio_kbps);
+        }
+    }
+    if (has_audio) {
+        args_add(&args, "-c:a");
+        args_add(&args, "aac");
+        args_add(&args, "-ac");
+        args_add(&args, "2");
+    }
+    args_add(&args, "-f");
+    args_add(&args, "hls");
+    args_add(&args, "-hls_time");
+    args_add(&args, "%d", HLS_SEGMENT_SECONDS);
+    args_add(&args, "-hls_playlist_type");
+    args_add(&args, "vod");
+    args_add(&args, "-hls_segment_type");
+    args_add(&args, "fmp4");
+    args_add(&args, "-hls_flags");
+    args_add(&args, "independent_segments");
+    args_add(&args, "-hls_fmp4_init_filename");
+    args_add(&args, "init.mp4");
+    args_add(&args, "-hls_segment_filename");
+    args_add(&args, "%s/%%v/seg_%%05d.m4s", tmp_dir);
+    args_add(&args, "-master_pl_name");
+    args_add(&args, "master.m3u8");
+    args_add(&args, "-var_stream_map");
+    args_add(&args, "%s", stream_map);
+    args_add(&args, "%s/%%v/index.m3u8", tmp_dir);
+    if (args.overflow) {
+        return -1;
+    }
+
+    if (remove_tree(tmp_dir) != 0 || ensure_directory(tmp_dir) != 0) {
+        log_error("Failed to prepare %s: %s", tmp_dir, strerror(errno));
+        return -1;
+    }
+    char master_path[PATH_MAX];
+    struct stat st;
+    if (run_ffmpeg(job, args.argv) != 0 ||
+        snprintf(master_path, sizeof(master_path), "%s/master.m3u8", tmp_dir) >= (int)sizeof(master_path) ||
+        stat(master_path, &st) != 0) {
+        remove_tree(tmp_dir);
+        return -1;
+    }
+    // 이전 패키지를 옆으로 치우고 새 패키지를 제자리에 놓은 뒤 지운다.
+    remove_tree(old_dir);
+    if (rename(final_dir, old_dir) != 0 && errno != ENOENT) {
+        log_error("Failed to retire %s: %s", final_dir, strerror(errno));
+        remove_tree(tmp_dir);
+        return -1;
+    }
+    if (rename(tmp_dir, final_dir) != 0) {
+        log_error("Failed to install %s: %s", final_dir, strerror(errno));
+        remove_tree(tmp_dir);
+        return -1;
+    }
+    remove_tree(old_dir);
+    log_info("Packaged HLS for video %d: %zu renditions%s", job->video_id, count, has_audio ? "" : " (no audio)");
+    return 0;
+}
+
+// 썸네일이 원본보다 새로우면 1, 오래됐거나 없으면 0, 원본이 없으면 -1.
+static int thumb_is_fresh(const char *video_path, const char *thumb_path, time_t *source_mtime_out) {
     struct stat video_stat;
     if (stat(video_path, &video_stat) != 0) {
         return -1;
     }
+    if (source_mtime_out) {
+        *source_mtime_out = video_stat.st_mtime;
+    }
     struct stat thumb_stat;
-    if (stat(thumb_path, &thumb_stat) == 0) {
-        if (thumb_stat.st_mtime >= video_stat.st_mtime) {
-            return 0; // cached thumbnail is fresh
+    return stat(thumb_path, &thumb_stat) == 0 && thumb_stat.st_mtime >= video_stat.st_mtime;
+}
+
+// 썸네일 작업 스레드: 대기열에서 하나씩 꺼내 ffmpeg를 실행한다.
+static void *thumb_worker(void *arg) {
+    server_ctx_t *server = arg;
+    pthread_mutex_lock(&g_thumbs.lock);
+    while (!g_thumbs.stop) {
+        thumb_job_t *job = g_thumbs.queue_head;
+        if (!job) {
+            pthread_cond_wait(&g_thumbs.cond, &g_thumbs.lock);
+            continue;
+        }
+        g_thumbs.queue_head = job->next_queued;
+        if (!g_thumbs.queue_head) {
+            g_thumbs.queue_tail = NULL;
+        }
+        g_thumbs.queued--;
+        job->next_queued = NULL;
+        job->state = THUMB_RUNNING;
+        pthread_mutex_unlock(&g_thumbs.lock);
+
+        char marker_path[PATH_MAX];
+        time_t source_mtime = 0;
+        int rc = -1;
+        int ran = 0;
+        uint64_t started = metrics_now_us();
+        if (job->kind == FFMPEG_JOB_FASTSTART) {
+            // 기준 파일이 없다: 원본을 다시 보고 이미 faststart면 할 일이 없다 (mp4_make_faststart가 1).
+            struct stat st;
+            if (stat(job->video_path, &st) == 0) {
+                source_mtime = st.st_mtime;
+                rc = mp4_make_faststart(job->video_path) >= 0 ? 0 : -1;
+                ran = 1;
+            }
+        } else if (job_marker_path(server, job->video_id, job->kind, marker_path, sizeof(marker_path)) == 0) {
+            int fresh = thumb_is_fresh(job->video_path, marker_path, &source_mtime);
+            // 큐에 있는 동안 다른 경로로 이미 만들어졌을 수 있다.
+            if (fresh == 1) {
+                rc = 0;
+            } else if (fresh == 0) {
+                rc = job->kind == FFMPEG_JOB_PREVIEWS ? previews_generate(server, job, marker_path)
+                     : job->kind == FFMPEG_JOB_HLS    ? hls_generate(server, job)
+                                                      : thumb_generate(job, marker_path);
+                ran = 1;
+            }
+        }
+        if (ran) {
+            metrics_observe_job((int)job->kind, metrics_now_us() - started);
+        }
+
+        if (rc == 0 && job->kind == FFMPEG_JOB_FASTSTART) {
+            log_info("Relocated moov to the front of %s", job->video_path);
+        }
+        pthread_mutex_lock(&g_thumbs.lock);
+        if (rc == 0) {
+            job_remove_locked(job);
+        } else {
+            job->state = THUMB_FAILED;
+            job->source_mtime = source_mtime;
         }
     }
+    pthread_mutex_unlock(&g_thumbs.lock);
+    return NULL;
+}
 
-    // 별도 프로세스로 ffmpeg를 실행해 서버 프로세스가 블로킹되지 않게 한다.
-    pid_t pid = fork();
-    if (pid == 0) {
-        execlp("ffmpeg", "ffmpeg", "-y", "-loglevel", "error", "-ss", "5",
-               "-i", video_path, "-vframes", "1", "-vf", "scale=320:-1", thumb_path, (char *)NULL);
-        _exit(1);
-    } else if (pid < 0) {
-        log_error("fork() failed for ffmpeg: %s", strerror(errno));
+// 썸네일 디렉터리를 준비하고 작업 스레드를 띄운다.
+int ffmpeg_initialize(server_ctx_t *server) {
+    if (!server) return -1;
+    if (ensure_directory(server->thumb_dir) != 0) {
+        log_error("Failed to ensure thumbnail directory %s: %s", server->thumb_dir, strerror(errno));
         return -1;
     }
-    int status = 0;
-    if (waitpid(pid, &status, 0) < 0) {
-        log_error("waitpid failed for ffmpeg: %s", strerror(errno));
+    if (ensure_directory(server->hls_dir) != 0) {
+        log_error("Failed to ensure HLS directory %s: %s", server->hls_dir, strerror(errno));
         return -1;
     }
-    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
-        log_error("ffmpeg failed to generate thumbnail for %s", video_path);
-        unlink(thumb_path);
+    size_t workers = server->thumbnail_workers > 0 ? (size_t)server->thumbnail_workers : 2;
+    if (workers > THUMB_MAX_WORKERS) workers = THUMB_MAX_WORKERS;
+    g_thumbs.stop = 0;
+    for (size_t i = 0; i < workers; ++i) {
+        if (pthread_create(&g_thumbs.threads[i], NULL, thumb_worker, server) != 0) {
+            log_error("Failed to start thumbnail worker: %s", strerror(errno));
+            break;
+        }
+        g_thumbs.thread_count++;
+    }
+    if (g_thumbs.thread_count == 0) {
         return -1;
     }
     return 0;
 }
+
+// 비디오의 썸네일 작업을 대기열에 넣는다. 이미 대기/실행 중이면 아무것도 하지 않는다.
+// 같은 원본으로 실패한 적이 있으면 -1, 대기 중이면 1.
+static int thumb_enqueue(int video_id, ffmpeg_job_kind_t kind, int duration_seconds,
+                         const char *video_path, time_t source_mtime) {
+    pthread_mutex_lock(&g_thumbs.lock);
+    thumb_job_t *job = job_find_locked(video_id, kind);
+    if (job && job->state == THUMB_FAILED) {
+        if (job->source_mtime == source_mtime) {
+            pthread_mutex_unlock(&g_thumbs.lock);
+            return -1;
+        }
+        job_remove_locked(job); // 원본이 바뀌었으니 다시 시도한다.
+        job = NULL;
+    }
+    if (!job) {
+        if (g_thumbs.stop || g_thumbs.thread_count == 0 || g_thumbs.queued >= THUMB_QUEUE_MAX) {
+            pthread_mutex_unlock(&g_thumbs.lock);
+            return 1; // 나중에 요청이 다시 오면 그때 넣는다.
+        }
+        job = calloc(1, sizeof(*job));
+        if (!job) {
+            pthread_mutex_unlock(&g_thumbs.lock);
+            return -1;
+        }
+        job->video_id = video_id;
+        job->kind = kind;
+        job->duration_seconds = duration_seconds;
+        job->state = THUMB_QUEUED;
+        snprintf(job->video_path, sizeof(job->video_path), "%s", video_path);
+        size_t bucket = job_bucket(video_id, kind);
+        job->next = g_thumbs.buckets[bucket];
+        g_thumbs.buckets[bucket] = job;
+        if (g_thumbs.queue_tail) {
+            g_thumbs.queue_tail->next_queued = job;
+        } else {
+            g_thumbs.queue_head = job;
+        }
+        g_thumbs.queue_tail = job;
+        g_thumbs.queued++;
+        pthread_cond_signal(&g_thumbs.cond);
+    }
+    pthread_mutex_unlock(&g_thumbs.lock);
+    return 1;
+}
+
+// 기준 파일이 최신이면 0, 작업을 넣었거나 이미 진행 중이면 1, 만들 수 없으면 -1.
+static int job_request(server_ctx_t *server, int video_id, ffmpeg_job_kind_t kind, int duration_seconds,
+                       const char *video_path, char *marker_path, size_t marker_path_len) {
+    if (job_marker_path(server, video_id, kind, marker_path, marker_path_len) != 0) {
+        return -1;
+    }
+    time_t source_mtime = 0;
+    int fresh = thumb_is_fresh(video_path, marker_path, &source_mtime);
+    if (fresh != 0) {
+        return fresh == 1 ? 0 : -1;
+    }
+    return thumb_enqueue(video_id, kind, duration_seconds, video_path, source_mtime);
+}
+
+// 요청 경로용: 최신 썸네일이 있으면 0과 경로를, 만드는 중이면 1, 만들 수 없으면 -1을 돌려준다.
+int ffmpeg_request_thumbnail(server_ctx_t *server, int video_id,
+                             const char *video_path, char *thumb_path,
+                             size_t thumb_path_len) {
+    if (!server || !video_path || !thumb_path) {
+        return -1;
+    }
+    return job_request(server, video_id, FFMPEG_JOB_POSTER, 0, video_path, thumb_path, thumb_path_len);
+}
+
+// 요청 경로용: 미리보기 VTT와 스프라이트가 준비되어 있으면 0과 두 경로를 돌려준다 (반환값은 위와 같다).
+int ffmpeg_request_previews(server_ctx_t *server, int video_id, int duration_seconds,
+                            const char *video_path, char *vtt_path, size_t vtt_path_len,
+                            char *sprite_path, size_t sprite_path_len) {
+    if (!server || !video_path || !vtt_path || !sprite_path) {
+        return -1;
+    }
+    if (sprite_path_for(server, video_id, sprite_path, sprite_path_len) != 0) {
+        return -1;
+    }
+    return job_request(server, video_id, FFMPEG_JOB_PREVIEWS, duration_seconds, video_path,
+                       vtt_path, vtt_path_len);
+}
+
+// 요청 경로용: HLS 패키지가 준비되어 있으면 0과 패키지 디렉터리를 돌려준다. 없으면 첫 요청이 패키징을 예약한다.
+int ffmpeg_request_hls(server_ctx_t *server, int video_id, const char *video_path,
+                       char *dir_out, size_t dir_len) {
+    char marker_path[PATH_MAX];
+    if (!server || !video_path || !dir_out || hls_dir_for(server, video_id, dir_out, dir_len) != 0) {
+        return -1;
+    }
+    return job_request(server, video_id, FFMPEG_JOB_HLS, 0, video_path, marker_path, sizeof(marker_path));
+}
+
+// 워처가 새 파일이나 바뀐 파일을 반영했을 때 포스터와 미리보기를 미리 만들어 둔다.
+// 포스터가 먼저 끝나도록 먼저 넣는다. 색인된 길이가 있으면 미리보기 간격을 거기에 맞춘다.
+void ffmpeg_queue_video(server_ctx_t *server, int video_id, const char *video_path, int duration_seconds) {
+    char marker_path[PATH_MAX];
+    if (!server || !video_path) {
+        return;
+    }
+    job_request(server, video_id, FFMPEG_JOB_POSTER, 0, video_path, marker_path, sizeof(marker_path));
+    job_request(server, video_id, FFMPEG_JOB_PREVIEWS, duration_seconds, video_path, marker_path,
+                sizeof(marker_path));
+}
+
+// moov가 뒤에 있는 파일의 재배치 작업을 넣는다. 교체가 끝나면 워처가 바뀐 파일을 다시 색인한다.
+void ffmpeg_queue_faststart(server_ctx_t *server, int video_id, const char *video_path) {
+    struct stat st;
+    if (!server || !video_path || stat(video_path, &st) != 0) {
+        return;
+    }
+    thumb_enqueue(video_id, FFMPEG_JOB_FASTSTART, 0, video_path, st.st_mtime);
+}
+
+// 작업 스레드를 멈춘다. 실행 중인 ffmpeg는 종료 신호로 끊고 남은 작업은 버린다.
+void ffmpeg_shutdown(void) {
+    pthread_mutex_lock(&g_thumbs.lock);
+    g_thumbs.stop = 1;
+    pthread_cond_broadcast(&g_thumbs.cond);
+    for (size_t b = 0; b < THUMB_JOB_BUCKETS; ++b) {
+        for (thumb_job_t *job = g_thumbs.buckets[b]; job; job = job->next) {
+            if (job->state == THUMB_RUNNING && job->pid > 0) {
+                kill(job->pid, SIGTERM);
+            }
+        }
+    }
+    pthread_mutex_unlock(&g_thumbs.lock);
+    for (size_t i = 0; i < g_thumbs.thread_count; ++i) {
+        pthread_join(g_thumbs.threads[i], NULL);
+    }
+    g_thumbs.thread_count = 0;
+    pthread_mutex_lock(&g_thumbs.lock);
+    for (size_t b = 0; b < THUMB_JOB_BUCKETS; ++b) {
+        thumb_job_t *job = g_thumbs.buckets[b];
+        while (job) {
+            thumb_job_t *next = job->next;
+            free(job);
+            job = next;
+        }
+        g_thumbs.buckets[b] = NULL;
+    }
+    g_thumbs.queue_head = NULL;
+    g_thumbs.queue_tail = NULL;
+    g_thumbs.queued = 0;
+    pthread_mutex_unlock(&g_thumbs.lock);
+}
@@ -1,105 +1,497 @@
-// 시청 기록 API 엔드포인트 구현부
+// 시청 기록 API 엔드포인트와 진행 위치 쓰기 지연(write-behind) 버퍼 구현부
 #include "history.h"
 
+#include <errno.h>
 #include <limits.h>
-#include <sqlite3.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 
 #include "db.h"
 #include "utils.h"
 
-// /api/history: 현재 사용자에 대한 최근 시청 기록을 JSON으로 돌려준다.
-void history_handle_get(request_ctx_t *ctx) {
-    if (!ctx->authenticated) {
-        router_send_json_error(ctx, 401, "Unauthorized");
-        return;
+#define HISTORY_BUCKETS 1024
+#define HISTORY_CAP_FACTOR 4          // 버퍼 상한 = max_entries * 이 값
+#define HISTORY_MAX_BACKOFF_MS 30000  // 플러시 실패 후 재시도 간격 상한
+
+// (user_id, video_id)별로 아직 DB에 반영되지 않은 최신 위치
+typedef struct history_entry {
+    int user_id;
+    int video_id;
+    double position;
+    time_t updated_at;
+    unsigned version;         // 갱신될 때마다 증가
+    struct history_entry *next;
+} history_entry_t;
+
+// 플러시 스레드가 잠금 밖에서 DB에 쓰기 위해 떠 둔 사본
+typedef struct {
+    db_history_update_t update;
+    unsigned version;
+} history_snapshot_t;
+
+typedef struct {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    history_entry_t *buckets[HISTORY_BUCKETS];
+    size_t count;         // 버퍼에 있는 항목 수
+    pthread_t thread;
+    int running;
+    atomic_int stop;
+    int interval_ms;
+    size_t max_entries;
+    server_ctx_t *server;
+} history_buffer_t;
+
+static history_buffer_t g_history = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .cond = PTHREAD_COND_INITIALIZER,
+};
+
+static size_t history_bucket(int user_id, int video_id) {
+    uint64_t key = ((uint64_t)(unsigned)user_id << 32) | (unsigned)video_id;
+    key *= 0x9E3779B97F4A7C15ULL;
+    return (size_t)(key >> 32) % HISTORY_BUCKETS;
+}
+
+// 잠금을 잡은 상태에서 항목을 찾는다.
+static history_entry_t *history_find_locked(int user_id, int video_id) {
+    history_entry_t *entry = g_history.buckets[history_bucket(user_id, video_id)];
+    while (entry && (entry->user_id != user_id || entry->video_id != video_id)) {
+        entry = entry->next;
     }
-    // 동적 JSON을 만들기 위해 string_builder를 사용한다.
-    string_builder_t sb;
-    if (sb_init(&sb, 512) != 0) {
-        router_send_json_error(ctx, 500, "Allocation failed");
-        return;
+    return entry;
+}
+
+// 위치를 버퍼에 합친다. 같은 (user, video)의 연속 갱신은 마지막 값만 남는다.
+// 버퍼가 상한에 차서 새 항목을 받을 수 없으면 1을 돌려준다. 호출자는 DB에 바로 쓴다.
+static int history_buffer_put(int user_id, int video_id, double position, time_t now) {
+    pthread_mutex_lock(&g_history.lock);
+    history_entry_t *entry = history_find_locked(user_id, video_id);
+    if (!entry) {
+        if (g_history.count >= g_history.max_entries * HISTORY_CAP_FACTOR) {
+            pthread_cond_signal(&g_history.cond);
+            pthread_mutex_unlock(&g_history.lock);
+            return 1;
+        }
+        entry = calloc(1, sizeof(*entry));
+        if (!entry) {
+            pthread_mutex_unlock(&g_history.lock);
+            return -1;
+        }
+        size_t bucket = history_bucket(user_id, video_id);
+        entry->user_id = user_id;
+        entry->video_id = video_id;
+        entry->next = g_history.buckets[bucket];
+        g_history.buckets[bucket] = entry;
+        g_history.count++;
     }
-    if (sb_append(&sb, "{\"history\":[") != 0) {
-        sb_free(&sb);
-        router_send_json_error(ctx, 500, "Allocation failed");
-        return;
+    entry->position = position;
+    entry->updated_at = now;
+    entry->version++;
+    if (g_history.count >= g_history.max_entries) {
+        pthread_cond_signal(&g_history.cond);
     }
-    db_ctx_t *db = &ctx->server->db;
-    const char *sql =
-        "SELECT w.video_id, w.position_seconds, IFNULL(w.updated_at,''), IFNULL(v.title,'') "
-        "FROM watch_history w JOIN videos v ON v.id = w.video_id "
-        "WHERE w.user_id = ? ORDER BY w.updated_at DESC";
-    pthread_mutex_lock(&db->mutex);
-    sqlite3_stmt *stmt = NULL;
-    if (sqlite3_prepare_v2(db->conn, sql, -1, &stmt, NULL) != SQLITE_OK) {
-        pthread_mutex_unlock(&db->mutex);
-        sb_free(&sb);
-        router_send_json_error(ctx, 500, "Failed to prepare history query");
-        return;
+    pthread_mutex_unlock(&g_history.lock);
+    return 0;
+}
+
+// 버퍼 내용을 한 트랜잭션으로 DB에 쓴다. 쓰는 동안에도 항목은 버퍼에 남아 읽기에 보인다.
+static int history_flush(server_ctx_t *server) {
+    pthread_mutex_lock(&g_history.lock);
+    size_t count = g_history.count;
+    if (count == 0) {
+        pthread_mutex_unlock(&g_history.lock);
+        return 0;
+    }
+    history_snapshot_t *snap = malloc(count * sizeof(*snap));
+    if (!snap) {
+        pthread_mutex_unlock(&g_history.lock);
+        return -1;
     }
-    sqlite3_bind_int(stmt, 1, ctx->user_id);
-    int first = 1;
-    int rc;
-    int error = 0;
-    while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
-        int video_id = sqlite3_column_int(stmt, 0);
-        double position = sqlite3_column_double(stmt, 1);
-        const char *updated_at = (const char *)sqlite3_column_text(stmt, 2);
-        const char *title = (const char *)sqlite3_column_text(stmt, 3);
-        const char *prefix = first ? "" : ",";
-        if (sb_append(&sb, "%s{\"videoId\":%d,\"position\":%.3f,\"updatedAt\":", prefix, video_id, position) != 0) {
-            error = 1;
-            break;
+    size_t n = 0;
+    for (size_t b = 0; b < HISTORY_BUCKETS; ++b) {
+        for (history_entry_t *e = g_history.buckets[b]; e; e = e->next) {
+            snap[n].update.user_id = e->user_id;
+            snap[n].update.video_id = e->video_id;
+            snap[n].update.position_seconds = e->position;
+            snap[n].update.updated_at = e->updated_at;
+            snap[n].version = e->version;
+            n++;
         }
-        if (sb_append_json_string(&sb, updated_at ? updated_at : "") != 0) {
-            error = 1;
-            break;
+    }
+    pthread_mutex_unlock(&g_history.lock);
+
+    db_history_update_t *updates = malloc(n * sizeof(*updates));
+    if (!updates) {
+        free(snap);
+        return -1;
+    }
+    for (size_t i = 0; i < n; ++i) {
+        updates[i] = snap[i].update;
+    }
+    int rc = db_flush_watch_history(&server->db, updates, n);
+    free(updates);
+    if (rc != 0) {
+        log_warn("Failed to flush %zu watch history updates: %s (will retry with backoff)", n,
+                 db_errmsg(&server->db));
+        free(snap);
+        return -1;
+    }
+
+    // 플러시 중에 다시 갱신되지 않은 항목만 버퍼에서 내린다.
+    pthread_mutex_lock(&g_history.lock);
+    for (size_t i = 0; i < n; ++i) {
+        size_t bucket = history_bucket(snap[i].update.user_id, snap[i].update.video_id);
+        history_entry_t **link = &g_history.buckets[bucket];
+        while (*link) {
+            history_entry_t *e = *link;
+            if (e->user_id == snap[i].update.user_id && e->video_id == snap[i].update.video_id) {
+                if (e->version == snap[i].version) {
+                    *link = e->next;
+                    free(e);
+                    g_history.count--;
+                }
+                break;
+            }
+            link = &e->next;
         }
-        if (sb_append(&sb, ",\"title\":") != 0) {
-            error = 1;
-            break;
+    }
+    pthread_mutex_unlock(&g_history.lock);
+    free(snap);
+    return 0;
+}
+
+// 잠금을 잡은 상태에서 wait_ms 동안 기다린다. wake_on_full이면 max_entries에 도달할 때 일찍 깬다.
+static void history_wait_locked(int wait_ms, int wake_on_full) {
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_sec += wait_ms / 1000;
+    deadline.tv_nsec += (long)(wait_ms % 1000) * 1000000L;
+    if (deadline.tv_nsec >= 1000000000L) {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000L;
+    }
+    int rc = 0;
+    while (rc != ETIMEDOUT && !g_history.stop &&
+           !(wake_on_full && g_history.count >= g_history.max_entries)) {
+        rc = pthread_cond_timedwait(&g_history.cond, &g_history.lock, &deadline);
+    }
+}
+
+// interval_ms마다 또는 max_entries에 도달하면 버퍼를 비우는 백그라운드 루프.
+// 플러시가 실패하면 버퍼가 차 있어도 간격을 두 배씩 늘려 가며 기다린 뒤 다시 시도한다.
+static void *history_flush_loop(void *arg) {
+    server_ctx_t *server = arg;
+    int backoff_ms = 0;
+    while (!g_history.stop) {
+        pthread_mutex_lock(&g_history.lock);
+        if (backoff_ms > 0) {
+            history_wait_locked(backoff_ms, 0);
+        } else if (g_history.count < g_history.max_entries) {
+            history_wait_locked(g_history.interval_ms, 1);
         }
-        if (sb_append_json_string(&sb, title ? title : "") != 0) {
-            error = 1;
-            break;
+        pthread_mutex_unlock(&g_history.lock);
+        if (g_history.stop) break;
+        if (history_flush(server) == 0) {
+            backoff_ms = 0;
+        } else {
+            backoff_ms = backoff_ms == 0 ? g_history.interval_ms : backoff_ms * 2;
+            if (backoff_ms > HISTORY_MAX_BACKOFF_MS) backoff_ms = HISTORY_MAX_BACKOFF_MS;
         }
-        char thumb_url[128];
-        snprintf(thumb_url, sizeof(thumb_url), "/api/videos/%d/thumbnail", video_id);
-        if (sb_append(&sb, ",\"thumbnailUrl\":") != 0) {
-            error = 1;
-            break;
+    }
+    return NULL;
+}
+
+// 쓰기 지연 버퍼를 준비하고 플러시 스레드를 시작한다. 스레드를 못 띄우면 동기 쓰기로 동작한다.
+int history_initialize(server_ctx_t *server) {
+    if (!server) return -1;
+    g_history.server = server;
+    g_history.interval_ms = server->history_flush_interval_ms > 0 ? server->history_flush_interval_ms : 1000;
+    g_history.max_entries = server->history_flush_max_entries > 0
+                                ? (size_t)server->history_flush_max_entries
+                                : 256;
+    g_history.stop = 0;
+    if (pthread_create(&g_history.thread, NULL, history_flush_loop, server) != 0) {
+        log_warn("History flush thread unavailable; progress updates will be written directly");
+        return 0;
+    }
+    g_history.running = 1;
+    return 0;
+}
+
+// 종료 시 플러시 스레드를 멈추고 남은 항목을 모두 DB에 쓴다. 워커가 멈춘 뒤에 호출한다.
+void history_shutdown(server_ctx_t *server) {
+    if (g_history.running) {
+        pthread_mutex_lock(&g_history.lock);
+        g_history.stop = 1;
+        pthread_cond_signal(&g_history.cond);
+        pthread_mutex_unlock(&g_history.lock);
+        pthread_join(g_history.thread, NULL);
+        g_history.running = 0;
+    }
+    if (server && history_flush(server) != 0) {
+        log_error("Watch history updates could not be saved on shutdown");
+    }
+    pthread_mutex_lock(&g_history.lock);
+    for (size_t b = 0; b < HISTORY_BUCKETS; ++b) {
+        history_entry_t *e = g_history.buckets[b];
+        while (e) {
+            history_entry_t *next = e->next;
+            free(e);
+            e = next;
         }
-        if (sb_append_json_string(&sb, thumb_url) != 0) {
-            error = 1;
-            break;
+        g_history.buckets[b] = NULL;
+    }
+    g_history.count = 0;
+    pthread_mutex_unlock(&g_history.lock);
+}
+
+// 사용자의 미반영 위치를 콜백으로 넘긴다. DB에서 읽은 값 위에 덮어써서 최신 상태를 보여 주기 위함이다.
+int history_overlay_user(int user_id,
+                         int (*callback)(void *userdata, int video_id, double position_seconds,
+                                         time_t updated_at),
+                         void *userdata) {
+    if (!callback) return -1;
+    int result = 0;
+    pthread_mutex_lock(&g_history.lock);
+    for (size_t b = 0; b < HISTORY_BUCKETS && result == 0; ++b) {
+        for (history_entry_t *e = g_history.buckets[b]; e; e = e->next) {
+            if (e->user_id != user_id) continue;
+            if (callback(userdata, e->video_id, e->position, e->updated_at) != 0) {
+                result = -1;
+                break;
+            }
         }
-        char stream_url[128];
-        snprintf(stream_url, sizeof(stream_url), "/api/videos/%d/stream", video_id);
-        if (sb_append(&sb, ",\"streamUrl\":") != 0) {
-            error = 1;
-            break;
+    }
+    pthread_mutex_unlock(&g_history.lock);
+    return result;
+}
+
+#define HISTORY_DEFAULT_LIMIT 50
+#define HISTORY_MAX_LIMIT 200
+
+// /api/history 응답용 한 행
+typedef struct {
+    int video_id;
+    double position;
+    char updated_at[32]; // "YYYY-MM-DD HH:MM:SS" (UTC, SQLite CURRENT_TIMESTAMP와 같은 형식)
+    char title[256];
+} history_row_t;
+
+typedef struct {
+    history_row_t *items;
+    size_t count;
+    size_t capacity;
+} history_rows_t;
+
+static history_row_t *history_rows_push(history_rows_t *rows) {
+    if (rows->count == rows->capacity) {
+        size_t new_cap = rows->capacity == 0 ? 16 : rows->capacity * 2;
+        history_row_t *new_items = realloc(rows->items, new_cap * sizeof(*new_items));
+        if (!new_items) {
+            return NULL;
         }
-        if (sb_append_json_string(&sb, stream_url) != 0) {
-            error = 1;
-            break;
+        rows->items = new_items;
+        rows->capacity = new_cap;
+    }
+    history_row_t *row = &rows->items[rows->count++];
+    memset(row, 0, sizeof(*row));
+    return row;
+}
+
+// db_list_watch_history_titles 콜백: DB에 반영된 기록을 모은다.
+static int collect_history_row(void *userdata, int video_id, double position,
+                               const char *updated_at, const char *title) {
+    history_row_t *row = history_rows_push(userdata);
+    if (!row) return -1;
+    row->video_id = video_id;
+    row->position = position;
+    snprintf(row->updated_at, sizeof(row->updated_at), "%s", updated_at);
+    snprintf(row->title, sizeof(row->title), "%s", title);
+    return 0;
+}
+
+// history_overlay_user 콜백: 아직 플러시되지 않은 기록을 모은다. 제목은 버퍼 잠금 밖에서 채운다.
+static int collect_pending_row(void *userdata, int video_id, double position, time_t updated_at) {
+    history_row_t *row = history_rows_push(userdata);
+    if (!row) return -1;
+    row->video_id = video_id;
+    row->position = position;
+    struct tm tm_utc;
+    gmtime_r(&updated_at, &tm_utc);
+    strftime(row->updated_at, sizeof(row->updated_at), "%Y-%m-%d %H:%M:%S", &tm_utc);
+    return 0;
+}
+
+// (updated_at, video_id) 키 비교. 목록은 이 키의 내림차순이다.
+static int history_key_compare(const char *updated_a, int video_a, const char *updated_b, int video_b) {
+    int c = strcmp(updated_a, updated_b);
+    if (c != 0) return c;
+    return (video_a > video_b) - (video_a < video_b);
+}
+
+static int history_row_compare(const void *a, const void *b) {
+    const history_row_t *ra = a;
+    const history_row_t *rb = b;
+    return history_key_compare(rb->updated_at, rb->video_id, ra->updated_at, ra->video_id); // 최신순
+}
+
+// 기록 커서 토큰: base64url("<updated_at>|<video_id>")
+static void history_cursor_encode(const history_row_t *row, char *out, size_t out_len) {
+    char plain[64];
+    int n = snprintf(plain, sizeof(plain), "%s|%d", row->updated_at, row->video_id);
+    if (n <= 0 || (size_t)n >= sizeof(plain) ||
+        base64url_encode((const uint8_t *)plain, (size_t)n, out, out_len) < 0) {
+        out[0] = '\0';
+    }
+}
+
+static int history_cursor_decode(const char *token, db_history_cursor_t *cursor) {
+    uint8_t plain[64];
+    int n = base64url_decode(token, plain, sizeof(plain) - 1);
+    if (n <= 0) return -1;
+    plain[n] = '\0';
+    char *sep = strrchr((char *)plain, '|');
+    if (!sep || sep == (char *)plain || (size_t)(sep - (char *)plain) >= sizeof(cursor->updated_at)) {
+        return -1;
+    }
+    char *end = NULL;
+    long id = strtol(sep + 1, &end, 10);
+    if (end == sep + 1 || *end != '\0' || id <= 0 || id > INT_MAX) return -1;
+    size_t len = (size_t)(sep - (char *)plain);
+    memcpy(cursor->updated_at, plain, len);
+    cursor->updated_at[len] = '\0';
+    cursor->video_id = (int)id;
+    return 0;
+}
+
+// 기록 한 건을 JSON 배열 항목으로 덧붙인다.
+static int append_history_row(string_builder_t *sb, const history_row_t *row, int first) {
+    const char *prefix = first ? "" : ",";
+    if (sb_append(sb, "%s{\"videoId\":%d,\"position\":%.3f,\"updatedAt\":", prefix, row->video_id, row->position) != 0) return -1;
+    if (sb_append_json_string(sb, row->updated_at) != 0) return -1;
+    if (sb_append(sb, ",\"title\":") != 0) return -1;
+    if (sb_append_json_string(sb, row->title) != 0) return -1;
+    char thumb_url[128];
+    snprintf(thumb_url, sizeof(thumb_url), "/api/videos/%d/thumbnail", row->video_id);
+    if (sb_append(sb, ",\"thumbnailUrl\":") != 0) return -1;
+    if (sb_append_json_string(sb, thumb_url) != 0) return -1;
+    char stream_url[128];
+    snprintf(stream_url, sizeof(stream_url), "/api/videos/%d/stream", row->video_id);
+    if (sb_append(sb, ",\"streamUrl\":") != 0) return -1;
+    if (sb_append_json_string(sb, stream_url) != 0) return -1;
+    if (sb_append(sb, "}") != 0) return -1;
+    return 0;
+}
+
+// 이 페이지에 들어갈 기록을 모은다: DB의 keyset 페이지에 아직 플러시되지 않은 위치를 합친다.
+// 버퍼에 있는 비디오의 DB 행은 오래된 값이므로 빼고, 버퍼 항목은 자기 키 위치에 끼워 넣는다.
+static int history_collect_page(request_ctx_t *ctx, const db_history_cursor_t *before, int limit,
+                                history_rows_t *rows) {
+    history_rows_t pending = {0};
+    if (history_overlay_user(ctx->user_id, collect_pending_row, &pending) != 0) {
+        free(pending.items);
+        return -1;
+    }
+    // 버퍼와 겹쳐 빠질 수 있는 행 수만큼 더 읽어야 다음 페이지 여부를 정확히 알 수 있다.
+    int fetch = limit + 1 + (int)pending.count;
+    if (db_list_watch_history_titles(&ctx->server->db, ctx->user_id, before, fetch,
+                                     collect_history_row, rows) != 0) {
+        free(pending.items);
+        return -1;
+    }
+    size_t kept = 0;
+    for (size_t i = 0; i < rows->count; ++i) {
+        int stale = 0;
+        for (size_t j = 0; j < pending.count && !stale; ++j) {
+            stale = pending.items[j].video_id == rows->items[i].video_id;
         }
-        if (sb_append(&sb, "}") != 0) {
-            error = 1;
-            break;
+        if (!stale) {
+            rows->items[kept++] = rows->items[i];
         }
-        first = 0;
     }
-    sqlite3_finalize(stmt);
-    pthread_mutex_unlock(&db->mutex);
-    if (error || (rc != SQLITE_DONE && rc != SQLITE_ROW)) {
-        sb_free(&sb);
+    rows->count = kept;
+    char filename[256];
+    for (size_t j = 0; j < pending.count; ++j) {
+        history_row_t *p = &pending.items[j];
+        if (before && history_key_compare(p->updated_at, p->video_id,
+                                          before->updated_at, before->video_id) >= 0) {
+            continue; // 이전 페이지에서 이미 보냈다.
+        }
+        // 그사이 카탈로그에서 빠진 비디오는 목록에서도 뺀다.
+        if (db_get_video_by_id(&ctx->server->db, p->video_id, p->title, sizeof(p->title),
+                               filename, sizeof(filename), NULL, 0, NULL) != 0) {
+            continue;
+        }
+        history_row_t *row = history_rows_push(rows);
+        if (!row) {
+            free(pending.items);
+            return -1;
+        }
+        *row = *p;
+    }
+    free(pending.items);
+    qsort(rows->items, rows->count, sizeof(*rows->items), history_row_compare);
+    return 0;
+}
+
+// /api/history: 현재 사용자에 대한 최근 시청 기록을 최신순 keyset 페이지로 돌려준다.
+void history_handle_get(request_ctx_t *ctx) {
+    if (!ctx->authenticated) {
+        router_send_json_error(ctx, 401, "Unauthorized");
+        return;
+    }
+    int limit = HISTORY_DEFAULT_LIMIT;
+    if (router_get_query_int(ctx, "limit", &limit) != 0 || limit < 1) {
+        limit = HISTORY_DEFAULT_LIMIT;
+    }
+    if (limit > HISTORY_MAX_LIMIT) limit = HISTORY_MAX_LIMIT;
+    char cursor[96] = {0};
+    db_history_cursor_t before;
+    int has_cursor = 0;
+    if (router_get_query(ctx, "cursor", cursor, sizeof(cursor)) == 0 && cursor[0] != '\0') {
+        if (history_cursor_decode(cursor, &before) != 0) {
+            router_send_json_error(ctx, 400, "Invalid cursor");
+            return;
+        }
+        has_cursor = 1;
+    }
+    history_rows_t rows = {0};
+    if (history_collect_page(ctx, has_cursor ? &before : NULL, limit, &rows) != 0) {
+        free(rows.items);
         router_send_json_error(ctx, 500, "Failed to read history");
         return;
     }
-    if (sb_append(&sb, "]}") != 0) {
+    int has_more = rows.count > (size_t)limit;
+    size_t count = has_more ? (size_t)limit : rows.count;
+    char next_cursor[96] = {0};
+    if (has_more) {
+        history_cursor_encode(&rows.items[count - 1], next_cursor, sizeof(next_cursor));
+    }
+
+    // 동적 JSON을 만들기 위해 string_builder를 사용한다.
+    string_builder_t sb;
+    if (sb_init(&sb, 512) != 0) {
+        free(rows.items);
+        router_send_json_error(ctx, 500, "Allocation failed");
+        return;
+    }
+    int error = sb_append(&sb, "{\"history\":[") != 0;
+    for (size_t i = 0; !error && i < count; ++i) {
+        error = append_history_row(&sb, &rows.items[i], i == 0) != 0;
+    }
+    if (!error) {
+        error = sb_append(&sb, "],\"limit\":%d,\"nextCursor\":%s%s%s,\"hasMore\":%s}", limit,
+                          has_more ? "\"" : "", has_more ? next_cursor : "null", has_more ? "\"" : "",
+                          has_more ? "true" : "false") != 0;
+    }
+    free(rows.items);
+    if (error) {
         sb_free(&sb);
         router_send_json_error(ctx, 500, "Allocation failed");
         return;
@@ -108,24 +500,15 @@ void history_handle_get(request_ctx_t *ctx) {
     sb_free(&sb);
 }
 
-// URL 경로 파라미터를 int로 파싱한다.
-static int parse_int(const char *s) {
-    if (!s) return -1;
-    char *end = NULL;
-    long v = strtol(s, &end, 10);
-    if (!end || *end != '\0' || v < 0 || v > INT_MAX) return -1;
-    return (int)v;
-}
-
 // /api/history/:id: 비디오별 마지막 시청 위치를 업데이트한다.
+// 위치는 버퍼에 합쳐 두고 플러시 스레드가 모아서 한 트랜잭션으로 기록한다.
 void history_handle_update(request_ctx_t *ctx) {
     if (!ctx->authenticated) {
         router_send_json_error(ctx, 401, "Unauthorized");
         return;
     }
-    const char *id_str = router_get_param(ctx, "id");
-    int video_id = parse_int(id_str);
-    if (video_id <= 0) {
+    int video_id = 0;
+    if (router_get_param_int(ctx, "id", &video_id) != 0 || video_id <= 0) {
         router_send_json_error(ctx, 400, "Invalid video id");
         return;
     }
@@ -144,7 +527,16 @@ void history_handle_update(request_ctx_t *ctx) {
         router_send_json_error(ctx, 400, "Invalid position");
         return;
     }
-    if (db_update_watch_history(&ctx->server->db, ctx->user_id, video_id, position) != 0) {
+    int stored;
+    if (g_history.running && !g_history.stop) {
+        stored = history_buffer_put(ctx->user_id, video_id, position, time(NULL));
+    } else {
+        stored = 1;
+    }
+    if (stored > 0) {
+        stored = db_update_watch_history(&ctx->server->db, ctx->user_id, video_id, position);
+    }
+    if (stored != 0) {
         router_send_json_error(ctx, 500, "Failed to update history");
         return;
     }
@@ -0,0 +1,191 @@
+// 패키징된 HLS를 내려주는 모듈. master.m3u8은 원본 버전(mtime)을 경로에 넣어 매번 재검증하고,
+// 그 아래 렌디션 재생 목록과 세그먼트는 버전 경로 덕분에 내용이 바뀌지 않으므로 immutable로 캐시하게 한다.
+#include "hls.h"
+
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include "db.h"
+#include "ffmpeg.h"
+#include "http.h"
+#include "utils.h"
+
+#define HLS_PLAYLIST_TYPE "application/vnd.apple.mpegurl"
+#define HLS_MASTER_CACHE_CONTROL "private, no-cache"
+#define HLS_SEGMENT_CACHE_CONTROL "private, max-age=31536000, immutable"
+
+// 요청의 비디오를 찾아 패키지 상태를 돌려준다. 오류 응답은 여기서 보내고 -2를 돌려준다.
+// 0이면 dir에 패키지 디렉터리, version에 원본 버전 문자열이 담긴다.
+static int request_package(request_ctx_t *ctx, int *video_id_out, char *dir, size_t dir_len,
+                           char *version, size_t version_len) {
+    if (!ctx->authenticated) {
+        router_send_json_error(ctx, 401, "Unauthorized");
+        return -2;
+    }
+    int video_id = 0;
+    if (router_get_param_int(ctx, "id", &video_id) != 0 || video_id <= 0) {
+        router_send_json_error(ctx, 400, "Invalid video id");
+        return -2;
+    }
+    char filename[256];
+    if (db_get_video_by_id(&ctx->server->db, video_id, NULL, 0, filename, sizeof(filename), NULL, 0, NULL) != 0) {
+        router_send_json_error(ctx, 404, "Video not found");
+        return -2;
+    }
+    char video_path[PATH_MAX];
+    struct stat st;
+    if (snprintf(video_path, sizeof(video_path), "%s/%s", ctx->server->media_dir, filename) >= (int)sizeof(video_path) ||
+        stat(video_path, &st) != 0) {
+        router_send_json_error(ctx, 404, "Video not found");
+        return -2;
+    }
+    int status = ffmpeg_request_hls(ctx->server, video_id, video_path, dir, dir_len);
+    if (status < 0) {
+        router_send_json_error(ctx, 500, "HLS packaging error");
+        return -2;
+    }
+    // 패키지는 원본보다 새로울 때만 준비된 것으로 보므로, 원본 mtime이 곧 패키지 버전이다.
+    snprintf(version, version_len, "%lld", (long long)st.st_mtime);
+    *video_id_out = video_id;
+    return status;
+}
+
+// 패키지 디렉터리 안의 이름 한 조각인지 확인한다 (경로 구분자, 숨김 파일, 특수 문자 거부).
+static int is_plain_name(const char *name, size_t len) {
+    if (!name || len == 0 || len > 64 || name[0] == '.') {
+        return 0;
+    }
+    for (size_t i = 0; i < len; ++i) {
+        char c = name[i];
+        if (!((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_' ||
+              c == '-' || c == '.')) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+// 패키지가 만드는 파일 종류의 Content-Type. 재생 목록/세그먼트가 아니면 NULL.
+static const char *segment_content_type(const char *name, size_t len) {
+    if (!is_plain_name(name, len)) {
+        return NULL;
+    }
+    static const struct {
+        const char *ext;
+        const char *type;
+    } types[] = {
+        {".m3u8", HLS_PLAYLIST_TYPE},
+        {".m4s", "video/iso.segment"},
+        {".mp4", "video/mp4"}, // 초기화 세그먼트 (EXT-X-MAP)
+    };
+    for (size_t i = 0; i < ARRAY_SIZE(types); ++i) {
+        size_t ext_len = strlen(types[i].ext);
+        if (len > ext_len && memcmp(name + len - ext_len, types[i].ext, ext_len) == 0) {
+            return types[i].type;
+        }
+    }
+    return NULL;
+}
+
+// /api/videos/:id/hls/master.m3u8: 렌디션 목록. 각 URI 앞에 원본 버전을 붙여 내려준다.
+// 아직 패키징 중이면 202와 Retry-After로 진행형 스트림(/stream)을 쓰라고 알린다.
+void hls_handle_master(request_ctx_t *ctx) {
+    char dir[PATH_MAX];
+    char version[32];
+    int video_id = 0;
+    int status = request_package(ctx, &video_id, dir, sizeof(dir), version, sizeof(version));
+    if (status == -2) {
+        return;
+    }
+    char headers[768];
+    if (status > 0) {
+        snprintf(headers, sizeof(headers), "%sCache-Control: no-store\r\nRetry-After: 10\r\n",
+                 ctx->server->security_headers);
+        static const char body[] = "{\"status\":\"packaging\"}";
+        if (http_send_response(ctx->client_fd, 202, http_status_text(202), "application/json", body,
+                               sizeof(body) - 1, headers, ctx->keep_alive) != 0) {
+            log_warn("Failed to send pending HLS status for video %d", video_id);
+        }
+        return;
+    }
+    char master_path[PATH_MAX];
+    size_t length = 0;
+    char *master = NULL;
+    if (snprintf(master_path, sizeof(master_path), "%s/master.m3u8", dir) < (int)sizeof(master_path)) {
+        master = read_file(master_path, &length);
+    }
+    if (!master) {
+        router_send_json_error(ctx, 404, "HLS package not found");
+        return;
+    }
+    string_builder_t sb;
+    if (sb_init(&sb, length + 256) != 0) {
+        free(master);
+        router_send_json_error(ctx, 500, "Out of memory");
+        return;
+    }
+    int error = 0;
+    for (char *line = master; *line && !error;) {
+        char *end = strchr(line, '\n');
+        size_t line_len = end ? (size_t)(end - line + 1) : strlen(line);
+        if (line[0] != '#' && line[0] != '\n' && line[0] != '\r') {
+            error = sb_append(&sb, "%s/", version) != 0;
+        }
+        error = error || sb_append_raw(&sb, line, line_len) != 0;
+        line += line_len;
+    }
+    free(master);
+    snprintf(headers, sizeof(headers), "%sCache-Control: " HLS_MASTER_CACHE_CONTROL "\r\n",
+             ctx->server->security_headers);
+    if (error || http_send_response(ctx->client_fd, 200, http_status_text(200), HLS_PLAYLIST_TYPE, sb.data,
+                                    sb.length, headers, ctx->keep_alive) != 0) {
+        log_warn("Failed to send HLS master playlist for video %d", video_id);
+    }
+    sb_free(&sb);
+}
+
+// /api/videos/:id/hls/:version/:rendition/:file: 렌디션 재생 목록, 초기화 세그먼트, 미디어 세그먼트.
+// 버전이 현재 원본과 다르면 404를 돌려 플레이어가 master부터 다시 받게 한다.
+void hls_handle_file(request_ctx_t *ctx) {
+    char dir[PATH_MAX];
+    char version[32];
+    int video_id = 0;
+    int status = request_package(ctx, &video_id, dir, sizeof(dir), version, sizeof(version));
+    if (status == -2) {
+        return;
+    }
+    size_t version_len = 0;
+    size_t rendition_len = 0;
+    size_t file_len = 0;
+    const char *requested_version = router_get_param(ctx, "version", &version_len);
+    const char *rendition = router_get_param(ctx, "rendition", &rendition_len);
+    const char *file = router_get_param(ctx, "file", &file_len);
+    if (status > 0 || !requested_version || version_len != strlen(version) ||
+        memcmp(requested_version, version, version_len) != 0) {
+        router_send_json_error(ctx, 404, "HLS package not found");
+        return;
+    }
+    const char *content_type = file ? segment_content_type(file, file_len) : NULL;
+    if (!content_type || !is_plain_name(rendition, rendition_len)) {
+        router_send_json_error(ctx, 404, "Not Found");
+        return;
+    }
+    char path[PATH_MAX];
+    if (snprintf(path, sizeof(path), "%s/%.*s/%.*s", dir, (int)rendition_len, rendition, (int)file_len, file) >=
+        (int)sizeof(path)) {
+        router_send_json_error(ctx, 404, "Not Found");
+        return;
+    }
+    struct stat st;
+    if (stat(path, &st) != 0 || !S_ISREG(st.st_mode)) {
+        router_send_json_error(ctx, 404, "Not Found");
+        return;
+    }
+    if (http_send_cacheable_file(ctx->client_fd, ctx->request, content_type, path, HLS_SEGMENT_CACHE_CONTROL,
+                                 ctx->server->security_headers, ctx->keep_alive) != 0) {
+        log_warn("Failed to send HLS file for video %d", video_id);
+    }
+}
@@ -1,10 +1,13 @@
 // 소켓에서 HTTP 요청을 읽고, 헤더 파싱/응답 송신을 담당하는 저수준 유틸
 #include "http.h"
+#include "media_cache.h"
+#include "metrics.h"
 #include "utils.h"
 
 #include <ctype.h>
 #include <errno.h>
 #include <fcntl.h>
+#include <poll.h>
 #include <stdarg.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -12,6 +15,8 @@
 #include <strings.h>
 #include <sys/socket.h>
 #include <sys/stat.h>
+#include <sys/uio.h>
+#include <time.h>
 #include <unistd.h>
 
 #if defined(__linux__)
@@ -22,6 +27,8 @@
 #endif
 #define HTTP_INITIAL_BUFFER 8192
 #define HTTP_MAX_BUFFER (8 * 1024 * 1024)
+// 클라이언트 소켓은 항상 논블로킹이므로 워커가 읽기/쓰기를 기다릴 최대 시간
+#define HTTP_IO_TIMEOUT_MS 30000
 
 // 구조체를 초기화해 모든 포인터를 NULL/0으로 만든다.
 static void request_init(http_request_t *req) {
@@ -39,175 +46,334 @@ http_method_t http_method_from_string(const char *method) {
     return HTTP_UNKNOWN;
 }
 
-// 요청 본문을 모두 담을 수 있도록 버퍼 크기를 동적으로 늘린다.
-static int ensure_capacity(http_request_t *req, char **buffer, size_t *capacity, size_t required) {
-    if (required <= *capacity) {
+// 논블로킹 소켓이 읽기/쓰기 가능해질 때까지 poll()로 기다린다. 타임아웃 시 -1
+static int wait_socket(int fd, short events) {
+    struct pollfd pfd;
+    pfd.fd = fd;
+    pfd.events = events;
+    pfd.revents = 0;
+    for (;;) {
+        int rc = poll(&pfd, 1, HTTP_IO_TIMEOUT_MS);
+        if (rc > 0) {
+            return 0;
+        }
+        if (rc == 0 || errno != EINTR) {
+            return -1;
+        }
+    }
+}
+
+// 연결 버퍼 크기를 required 이상으로 늘린다. 최대치를 넘으면 실패
+static int buffer_reserve(http_buffer_t *buffer, size_t required) {
+    if (required <= buffer->capacity) {
         return 0;
     }
-    if (!req->owns_raw_data) {
+    if (required > HTTP_MAX_BUFFER) {
         return -1;
     }
-    size_t new_cap = *capacity * 2;
+    size_t new_cap = buffer->capacity ? buffer->capacity * 2 : HTTP_INITIAL_BUFFER;
     while (new_cap < required) {
         new_cap *= 2;
-        if (new_cap > HTTP_MAX_BUFFER) {
-            return -1;
-        }
     }
     if (new_cap > HTTP_MAX_BUFFER) {
-        return -1;
+        new_cap = HTTP_MAX_BUFFER;
     }
-    char *new_buf = realloc(*buffer, new_cap);
+    char *new_buf = realloc(buffer->data, new_cap);
     if (!new_buf) {
         return -1;
     }
-    *buffer = new_buf;
-    *capacity = new_cap;
+    buffer->data = new_buf;
+    buffer->capacity = new_cap;
     return 0;
 }
 
-// 소켓에서 HTTP 요청 전체(헤더+본문)를 읽어 http_request_t로 변환한다.
-int http_parse_request(int fd, http_request_t *req, char *buffer, size_t bufsize) {
-    request_init(req);
-    size_t capacity = buffer ? bufsize : HTTP_INITIAL_BUFFER;
-    char *raw = buffer;
-    if (!raw) {
-        raw = malloc(capacity);
-        if (!raw) {
-            return -1;
-        }
-        req->owns_raw_data = 1;
-    } else {
-        req->owns_raw_data = 0;
+// "keep-alive, Upgrade" 같은 콤마 구분 헤더 값에 token이 있는지 확인한다.
+static int header_has_token(const char *value, const char *token) {
+    if (!value) {
+        return 0;
     }
-    req->raw_data = raw;
-
-    size_t total = 0;
-    char *header_end = NULL;
-    while (!header_end) {
-        // recv()를 반복 호출해 헤더의 끝(\r\n\r\n)이 나올 때까지 읽는다.
-        if (total + 1 >= capacity) {
-            if (ensure_capacity(req, &raw, &capacity, total + 1) != 0) {
-                goto fail;
-            }
-            req->raw_data = raw;
+    size_t token_len = strlen(token);
+    const char *p = value;
+    while (*p) {
+        while (*p == ' ' || *p == '\t' || *p == ',') {
+            p++;
         }
-        ssize_t n = recv(fd, raw + total, capacity - total - 1, 0);
-        if (n <= 0) {
-            goto fail;
+        const char *end = p;
+        while (*end && *end != ',') {
+            end++;
         }
-        total += (size_t)n;
-        raw[total] = '\0';
-        header_end = strstr(raw, "\r\n\r\n");
-        if (header_end) {
-            break;
+        const char *trim = end;
+        while (trim > p && (trim[-1] == ' ' || trim[-1] == '\t')) {
+            trim--;
         }
-        if (total >= HTTP_MAX_BUFFER) {
-            goto fail;
+        if ((size_t)(trim - p) == token_len && strncasecmp(p, token, token_len) == 0) {
+            return 1;
         }
+        p = end;
     }
+    return 0;
+}
 
-    size_t header_len = (size_t)(header_end - raw) + 4; // include CRLFCRLF
+// 파싱 시점에 색인하는 헤더 이름 (http_known_header_t 순서와 같다)
+static const struct {
+    const char *name;
+    size_t length;
+} k_known_headers[HTTP_HDR_KNOWN_COUNT] = {
+    {"Content-Length", 14},
+    {"Transfer-Encoding", 17},
+    {"Connection", 10},
+    {"Cookie", 6},
+    {"Range", 5},
+    {"If-Range", 8},
+    {"If-None-Match", 13},
+    {"If-Modified-Since", 17},
+    {"Accept-Encoding", 15},
+};
 
-    char *line = raw;
-    char *line_end = strstr(line, "\r\n");
-    if (!line_end) {
-        goto fail;
+// 헤더 이름이 알려진 헤더이면 그 번호, 아니면 -1. 길이를 먼저 비교해 대부분 바로 걸러진다.
+static int known_header_index(const char *name, size_t length) {
+    for (int i = 0; i < HTTP_HDR_KNOWN_COUNT; ++i) {
+        if (k_known_headers[i].length == length && strncasecmp(k_known_headers[i].name, name, length) == 0) {
+            return i;
+        }
     }
-    *line_end = '\0';
+    return -1;
+}
 
-    char method[16] = {0};
-    char url[512] = {0};
-    char version[16] = {0};
-    if (sscanf(line, "%15s %511s %15s", method, url, version) != 3) {
-        goto fail;
+// 헤더 끝(빈 줄)을 지난번에 멈춘 곳부터 찾는다. '\n'은 memchr(glibc에서 SIMD 구현)로 건너뛰고,
+// 찾은 '\n' 앞 세 바이트만 확인하므로 이미 훑은 바이트는 다시 보지 않는다. 없으면 0.
+static size_t find_header_end(http_buffer_t *buffer) {
+    const char *data = buffer->data;
+    size_t pos = buffer->scan_pos;
+    while (pos < buffer->length) {
+        const char *nl = memchr(data + pos, '\n', buffer->length - pos);
+        if (!nl) {
+            break;
+        }
+        size_t idx = (size_t)(nl - data);
+        if (idx >= 3 && nl[-1] == '\r' && nl[-2] == '\n' && nl[-3] == '\r') {
+            return idx + 1;
+        }
+        pos = idx + 1;
     }
-    req->method = http_method_from_string(method);
-    strncpy(req->http_version, version, sizeof(req->http_version) - 1);
+    buffer->scan_pos = buffer->length;
+    return 0;
+}
 
-    char *qmark = strchr(url, '?');
-    if (qmark) {
-        *qmark = '\0';
-        strncpy(req->query, qmark + 1, sizeof(req->query) - 1);
+// 요청 줄과 헤더를 훑어 위치만 기록한다. finalize가 0이 아니면 그 자리에서 널 종료하고 req를 채운다.
+// 본문이 아직 다 오지 않았을 때는 버퍼를 건드리지 않고 Content-Length만 알아낸다.
+static int parse_head(char *raw, size_t header_len, http_request_t *req, size_t *content_length_out,
+                      int finalize) {
+    char *end = raw + header_len - 2; // 마지막 빈 줄의 CRLF 앞
+    char *line_end = memchr(raw, '\r', (size_t)(end - raw));
+    if (!line_end || line_end[1] != '\n') {
+        return -1;
+    }
+    // 요청 줄: METHOD SP target SP HTTP/1.x
+    char *method_end = memchr(raw, ' ', (size_t)(line_end - raw));
+    if (!method_end || method_end == raw || method_end - raw > 15) {
+        return -1;
+    }
+    char *target = method_end + 1;
+    char *target_end = memchr(target, ' ', (size_t)(line_end - target));
+    if (!target_end || target_end == target) {
+        return -1;
     }
-    strncpy(req->path, url, sizeof(req->path) - 1);
+    char *version = target_end + 1;
+    if (line_end - version < 8 || strncmp(version, "HTTP/1.", 7) != 0) {
+        return -1;
+    }
+    char *qmark = memchr(target, '?', (size_t)(target_end - target));
 
-    req->header_count = 0;
-    char *cursor = line_end + 2; // move past CRLF
-    while (cursor < raw + header_len) {
-        char *next = strstr(cursor, "\r\n");
-        if (!next) {
-            break;
-        }
-        if (next == cursor) {
-            break; // empty line
+    const char *known[HTTP_HDR_KNOWN_COUNT] = {0};
+    size_t header_count = 0;
+    char *cursor = line_end + 2;
+    while (cursor < end) {
+        char *next = memchr(cursor, '\r', (size_t)(end - cursor) + 1);
+        if (!next || next[1] != '\n') {
+            return -1;
         }
-        *next = '\0';
-        char *colon = strchr(cursor, ':');
-        if (colon) {
-            *colon = '\0';
+        char *colon = memchr(cursor, ':', (size_t)(next - cursor));
+        if (colon && colon > cursor) {
             char *value = colon + 1;
-            while (*value && isspace((unsigned char)*value)) {
+            while (value < next && (*value == ' ' || *value == '\t')) {
                 value++;
             }
-            if (req->header_count < ARRAY_SIZE(req->headers)) {
-                req->headers[req->header_count].name = cursor;
-                req->headers[req->header_count].value = value;
-                req->header_count++;
+            char *value_end = next;
+            while (value_end > value && (value_end[-1] == ' ' || value_end[-1] == '\t')) {
+                value_end--;
+            }
+            int id = known_header_index(cursor, (size_t)(colon - cursor));
+            if (id >= 0 && !known[id]) {
+                known[id] = value;
+            }
+            if (finalize) {
+                *colon = '\0';
+                *value_end = '\0';
+                if (header_count < ARRAY_SIZE(req->headers)) {
+                    req->headers[header_count].name = cursor;
+                    req->headers[header_count].value = value;
+                    header_count++;
+                }
+            } else if (id == HTTP_HDR_CONTENT_LENGTH) {
+                // 아직 널 종료 전이므로 값의 끝을 직접 확인한다.
+                size_t length = 0;
+                for (const char *p = value; p < value_end; ++p) {
+                    if (*p < '0' || *p > '9' || length > HTTP_MAX_BUFFER) return -1;
+                    length = length * 10 + (size_t)(*p - '0');
+                }
+                *content_length_out = length;
             }
         }
         cursor = next + 2;
     }
-
-    const char *cl_value = http_get_header(req, "Content-Length");
-    size_t content_length = 0;
-    if (cl_value) {
-        content_length = (size_t)strtoull(cl_value, NULL, 10);
+    if (!finalize) {
+        return 0;
+    }
+    *method_end = '\0';
+    *target_end = '\0';
+    *line_end = '\0';
+    if (qmark) {
+        *qmark = '\0';
+        req->query = qmark + 1;
+    } else {
+        req->query = target_end; // 빈 문자열
     }
+    req->method = http_method_from_string(raw);
+    req->path = target;
+    req->http_version = version;
+    req->header_count = header_count;
+    memcpy(req->known, known, sizeof(known));
+    return 0;
+}
 
-    size_t available_body = total - header_len;
-    if (content_length > HTTP_MAX_BUFFER) {
-        goto fail;
+// 연결 버퍼에 쌓인 바이트로 요청 하나(헤더+본문)를 완성한다. 소켓은 논블로킹으로 읽고,
+// 더 읽을 것이 없으면 1을 돌려 워커를 놓아준다. 다음 호출은 버퍼에 남긴 상태에서 이어서 파싱한다.
+// 버퍼에 이미 남아 있는(파이프라이닝된) 바이트가 있으면 그것부터 사용한다.
+int http_parse_request(int fd, http_request_t *req, http_buffer_t *buffer) {
+    request_init(req);
+    if (buffer_reserve(buffer, HTTP_INITIAL_BUFFER) != 0) {
+        return -1;
     }
-    if (content_length > available_body) {
-        // 아직 읽히지 않은 본문이 있다면 정확한 길이만큼 추가로 읽는다.
-        size_t missing = content_length - available_body;
-        if (ensure_capacity(req, &raw, &capacity, header_len + content_length + 1) != 0) {
-            goto fail;
+    buffer->data[buffer->length] = '\0';
+    for (;;) {
+        if (buffer->header_len == 0) {
+            buffer->header_len = find_header_end(buffer);
         }
-        req->raw_data = raw;
-        while (missing > 0) {
-            ssize_t n = recv(fd, raw + total, capacity - total - 1, 0);
-            if (n <= 0) {
+        if (buffer->header_len > 0) {
+            size_t content_length = 0;
+            if (parse_head(buffer->data, buffer->header_len, req, &content_length, 0) != 0 ||
+                content_length > HTTP_MAX_BUFFER) {
                 goto fail;
             }
-            total += (size_t)n;
-            size_t consumed = (size_t)n;
-            if (consumed > missing) {
-                consumed = missing;
+            size_t request_len = buffer->header_len + content_length;
+            if (request_len <= buffer->length) {
+                char *raw = buffer->data;
+                if (parse_head(raw, buffer->header_len, req, &content_length, 1) != 0) {
+                    goto fail;
+                }
+                // HTTP/1.1은 기본 유지, HTTP/1.0은 명시적으로 keep-alive를 요청한 경우만 유지한다.
+                const char *connection = req->known[HTTP_HDR_CONNECTION];
+                if (strcmp(req->http_version, "HTTP/1.1") == 0) {
+                    req->keep_alive = !header_has_token(connection, "close");
+                } else {
+                    req->keep_alive = header_has_token(connection, "keep-alive");
+                }
+                if (req->known[HTTP_HDR_TRANSFER_ENCODING]) {
+                    // chunked 본문은 해석하지 않으므로 다음 요청 경계를 알 수 없다.
+                    req->keep_alive = 0;
+                }
+                req->raw_data = raw;
+                req->body = raw + buffer->header_len;
+                req->body_length = content_length;
+                req->raw_length = request_len;
+                if (buffer->length > request_len) {
+                    // 본문이 널 종료되도록 다음 요청의 첫 바이트를 잠시 보관한다.
+                    buffer->held_pos = request_len;
+                    buffer->held_byte = raw[request_len];
+                    buffer->holding = 1;
+                    raw[request_len] = '\0';
+                }
+                return 0;
             }
-            missing -= consumed;
+            // 아직 읽히지 않은 본문이 있다면 정확한 길이만큼 받을 공간을 미리 마련한다.
+            if (buffer_reserve(buffer, request_len + 1) != 0) {
+                goto fail;
+            }
+        } else if (buffer->length + 1 >= buffer->capacity &&
+                   buffer_reserve(buffer, buffer->length + 2) != 0) {
+            goto fail; // 헤더가 HTTP_MAX_BUFFER를 넘는다.
         }
+        ssize_t n = recv(fd, buffer->data + buffer->length, buffer->capacity - buffer->length - 1, 0);
+        if (n > 0) {
+            if (buffer->started_ms == 0) {
+                buffer->started_ms = get_monotonic_ms();
+            }
+            buffer->length += (size_t)n;
+            buffer->data[buffer->length] = '\0';
+            continue;
+        }
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            // 요청 하나를 받는 데 드는 전체 시간을 제한해 조금씩 보내는 클라이언트를 정리한다.
+            if (buffer->started_ms != 0 && get_monotonic_ms() - buffer->started_ms > HTTP_IO_TIMEOUT_MS) {
+                goto fail;
+            }
+            request_init(req);
+            return 1;
+        }
+        goto fail; // 연결 종료 또는 오류
     }
 
-    req->body = raw + header_len;
-    req->body_length = content_length;
-    req->raw_length = header_len + content_length;
-    if (total < capacity) {
-        raw[total] = '\0';
-    }
-    return 0;
-
 fail:
-    if (req->owns_raw_data && raw) {
-        free(raw);
-    }
     request_init(req);
     return -1;
 }
 
-// 헤더 배열을 순회하며 대소문자 무시 비교로 찾는다.
+// 처리를 마친 요청 바이트를 버퍼 앞에서 제거하고 남은 파이프라인 바이트를 당긴다.
+void http_buffer_consume(http_buffer_t *buffer, size_t length) {
+    if (!buffer || !buffer->data) {
+        return;
+    }
+    if (buffer->holding) {
+        buffer->data[buffer->held_pos] = buffer->held_byte;
+        buffer->holding = 0;
+    }
+    if (length >= buffer->length) {
+        buffer->length = 0;
+    } else {
+        memmove(buffer->data, buffer->data + length, buffer->length - length);
+        buffer->length -= length;
+    }
+    buffer->data[buffer->length] = '\0';
+    buffer->scan_pos = 0;
+    buffer->header_len = 0;
+    buffer->started_ms = buffer->length > 0 ? get_monotonic_ms() : 0;
+    if (buffer->length == 0 && buffer->capacity > HTTP_INITIAL_BUFFER) {
+        // 큰 본문 때문에 늘어난 버퍼는 유휴 연결이 계속 붙잡지 않도록 돌려준다.
+        http_buffer_free(buffer);
+    }
+}
+
+void http_buffer_free(http_buffer_t *buffer) {
+    if (!buffer) return;
+    free(buffer->data);
+    memset(buffer, 0, sizeof(*buffer));
+}
+
+// 파싱 때 색인해 둔 헤더 값을 바로 돌려준다.
+const char *http_get_known_header(const http_request_t *req, http_known_header_t id) {
+    return id < HTTP_HDR_KNOWN_COUNT ? req->known[id] : NULL;
+}
+
+// 알려진 헤더는 파싱 때 만든 색인에서, 나머지는 헤더 배열을 대소문자 무시 비교로 찾는다.
 const char *http_get_header(const http_request_t *req, const char *name) {
+    int id = known_header_index(name, strlen(name));
+    if (id >= 0) {
+        return req->known[id];
+    }
     for (size_t i = 0; i < req->header_count; ++i) {
         if (strcasecmp(req->headers[i].name, name) == 0) {
             return req->headers[i].value;
@@ -216,180 +382,503 @@ const char *http_get_header(const http_request_t *req, const char *name) {
     return NULL;
 }
 
-// send()가 짧게 보낼 수 있으므로 전체가 전송될 때까지 반복한다.
-static int send_all(int fd, const void *buf, size_t len) {
-    const unsigned char *p = buf;
-    size_t sent = 0;
-    while (sent < len) {
-        ssize_t n = send(fd, p + sent, len - sent, 0);
-        if (n <= 0) {
+// 상태 코드별 상태줄은 컴파일 시점에 완성해 두고 그대로 iovec에 싣는다.
+#define HTTP_STATUS_ENTRY(code, text) \
+    {code, text, "HTTP/1.1 " #code " " text "\r\n", sizeof("HTTP/1.1 " #code " " text "\r\n") - 1}
+
+typedef struct {
+    int status;
+    const char *text;
+    const char *line;
+    size_t line_len;
+} http_status_entry_t;
+
+static const http_status_entry_t k_status_lines[] = {
+    HTTP_STATUS_ENTRY(200, "OK"),
+    HTTP_STATUS_ENTRY(201, "Created"),
+    HTTP_STATUS_ENTRY(202, "Accepted"),
+    HTTP_STATUS_ENTRY(204, "No Content"),
+    HTTP_STATUS_ENTRY(206, "Partial Content"),
+    HTTP_STATUS_ENTRY(304, "Not Modified"),
+    HTTP_STATUS_ENTRY(400, "Bad Request"),
+    HTTP_STATUS_ENTRY(401, "Unauthorized"),
+    HTTP_STATUS_ENTRY(403, "Forbidden"),
+    HTTP_STATUS_ENTRY(404, "Not Found"),
+    HTTP_STATUS_ENTRY(405, "Method Not Allowed"),
+    HTTP_STATUS_ENTRY(409, "Conflict"),
+    HTTP_STATUS_ENTRY(416, "Range Not Satisfiable"),
+    HTTP_STATUS_ENTRY(500, "Internal Server Error"),
+    HTTP_STATUS_ENTRY(503, "Service Unavailable"),
+};
+
+static _Thread_local int t_response_status;
+static _Thread_local size_t t_response_length;
+
+void http_note_response(int status, size_t body_length) {
+    t_response_status = status;
+    t_response_length = body_length;
+}
+
+int http_take_response(size_t *body_length_out) {
+    int status = t_response_status;
+    if (body_length_out) {
+        *body_length_out = t_response_length;
+    }
+    t_response_status = 0;
+    t_response_length = 0;
+    return status;
+}
+
+static const char k_connection_keep_alive[] = "Connection: keep-alive\r\n";
+static const char k_connection_close[] = "Connection: close\r\n";
+static const char k_content_type_prefix[] = "Content-Type: ";
+static const char k_crlf[] = "\r\n";
+
+// 응답 헤더 조각 목록. 바뀌는 부분(상태줄 대체, Content-Length)만 여기 버퍼에 쓰고
+// 보안 헤더 같은 미리 만든 블록은 복사하지 않고 가리킨다.
+#define HTTP_HEAD_MAX_IOV 10
+
+typedef struct {
+    struct iovec iov[HTTP_HEAD_MAX_IOV + 1]; // 마지막 칸은 본문용
+    int count;
+    char status_buf[64];
+    char length_buf[40];
+} http_head_t;
+
+static void head_add(http_head_t *head, const char *data, size_t len) {
+    if (len > 0) {
+        head->iov[head->count].iov_base = (void *)data;
+        head->iov[head->count].iov_len = len;
+        head->count++;
+    }
+}
+
+static void head_add_str(http_head_t *head, const char *data) {
+    if (data) {
+        head_add(head, data, strlen(data));
+    }
+}
+
+// 상태줄부터 빈 줄까지 헤더 조각을 채운다. with_length가 0이면 Content-Length를 넣지 않는다 (304).
+static int head_build(http_head_t *head, int status, const char *status_text, int keep_alive, int with_length,
+                      size_t length, const char *content_type, const char *common_headers,
+                      const char *extra_headers) {
+    head->count = 0;
+    http_note_response(status, with_length ? length : 0);
+    const http_status_entry_t *entry = NULL;
+    for (size_t i = 0; i < ARRAY_SIZE(k_status_lines); ++i) {
+        if (k_status_lines[i].status == status) {
+            entry = &k_status_lines[i];
+            break;
+        }
+    }
+    if (entry && (!status_text || strcmp(status_text, entry->text) == 0)) {
+        head_add(head, entry->line, entry->line_len);
+    } else {
+        int n = snprintf(head->status_buf, sizeof(head->status_buf), "HTTP/1.1 %d %s\r\n", status,
+                         status_text ? status_text : http_status_text(status));
+        if (n < 0 || (size_t)n >= sizeof(head->status_buf)) {
+            return -1;
+        }
+        head_add(head, head->status_buf, (size_t)n);
+    }
+    if (keep_alive) {
+        head_add(head, k_connection_keep_alive, sizeof(k_connection_keep_alive) - 1);
+    } else {
+        head_add(head, k_connection_close, sizeof(k_connection_close) - 1);
+    }
+    if (with_length) {
+        int n = snprintf(head->length_buf, sizeof(head->length_buf), "Content-Length: %zu\r\n", length);
+        head_add(head, head->length_buf, (size_t)n);
+    }
+    if (content_type && *content_type) {
+        head_add(head, k_content_type_prefix, sizeof(k_content_type_prefix) - 1);
+        head_add_str(head, content_type);
+        head_add(head, k_crlf, 2);
+    }
+    head_add_str(head, common_headers);
+    head_add_str(head, extra_headers);
+    head_add(head, k_crlf, 2);
+    return 0;
+}
+
+// 여러 조각을 sendmsg 한 번으로 보낸다. 짧게 쓰이면 남은 조각부터 이어서 보낸다.
+// flags에 MSG_MORE를 주면 뒤이은 본문 송신과 한 세그먼트로 묶이도록 커널이 잠시 모아 둔다.
+static int send_iov_flags(int fd, struct iovec *iov, int iovcnt, int flags) {
+    while (iovcnt > 0) {
+        if (iov->iov_len == 0) {
+            iov++;
+            iovcnt--;
+            continue;
+        }
+        struct msghdr msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = iov;
+        msg.msg_iovlen = (size_t)iovcnt;
+        ssize_t n = sendmsg(fd, &msg, flags);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if ((errno == EAGAIN || errno == EWOULDBLOCK) && wait_socket(fd, POLLOUT) == 0) {
+                continue;
+            }
+            return -1;
+        }
+        if (n == 0) {
             return -1;
         }
-        sent += (size_t)n;
+        size_t written = (size_t)n;
+        while (iovcnt > 0 && written >= iov->iov_len) {
+            written -= iov->iov_len;
+            iov++;
+            iovcnt--;
+        }
+        if (iovcnt > 0) {
+            iov->iov_base = (char *)iov->iov_base + written;
+            iov->iov_len -= written;
+        }
     }
     return 0;
 }
 
+// 여러 조각을 한 번의 시스템 콜로 보낸다. iov 배열은 진행 상황에 맞게 수정된다.
+int http_send_iov(int fd, struct iovec *iov, int iovcnt) {
+    return send_iov_flags(fd, iov, iovcnt, 0);
+}
+
 // 메모리에 있는 본문을 한 번에 내려주는 단순 응답 빌더
 int http_send_response(int fd, int status, const char *status_text,
                        const char *content_type, const void *body, size_t length,
-                       const char *extra_headers) {
-    char header[2048];
-    int offset = snprintf(header, sizeof(header),
-                          "HTTP/1.1 %d %s\r\n"
-                          "Connection: close\r\n"
-                          "Content-Length: %zu\r\n",
-                          status, status_text, length);
-    if (offset < 0 || (size_t)offset >= sizeof(header)) {
+                       const char *extra_headers, int keep_alive) {
+    return http_send_response_blocks(fd, status, status_text, content_type, body, length, NULL, extra_headers,
+                                     keep_alive);
+}
+
+// 공통 헤더 블록(보안 헤더처럼 시작 시 만들어 둔 문자열)과 요청별 헤더를 이어 붙이지 않고
+// 헤더와 본문을 writev 한 번에 보낸다. 작은 JSON 응답이 한 패킷으로 나간다.
+int http_send_response_blocks(int fd, int status, const char *status_text, const char *content_type,
+                              const void *body, size_t length, const char *common_headers,
+                              const char *extra_headers, int keep_alive) {
+    http_head_t head;
+    if (head_build(&head, status, status_text, keep_alive, 1, length, content_type, common_headers,
+                   extra_headers) != 0) {
         return -1;
     }
-    if (content_type && *content_type) {
-        int n = snprintf(header + offset, sizeof(header) - offset,
-                         "Content-Type: %s\r\n", content_type);
-        if (n < 0 || (size_t)n >= sizeof(header) - offset) {
-            return -1;
-        }
-        offset += n;
+    if (body && length > 0) {
+        head_add(&head, body, length);
     }
-    if (extra_headers && *extra_headers) {
-        int n = snprintf(header + offset, sizeof(header) - offset, "%s", extra_headers);
-        if (n < 0 || (size_t)n >= sizeof(header) - offset) {
-            return -1;
-        }
-        offset += n;
+    return send_iov_flags(fd, head.iov, head.count, 0);
+}
+
+void http_stream_init(http_file_stream_t *stream) {
+    memset(stream, 0, sizeof(*stream));
+    stream->file_fd = -1;
+}
+
+void http_stream_close(http_file_stream_t *stream) {
+    if (!stream) return;
+    if (stream->media) {
+        media_cache_release(stream->media); // 공유 FD는 캐시가 닫는다.
+    } else if (stream->file_fd >= 0) {
+        close(stream->file_fd);
+    }
+    http_stream_init(stream);
+}
+
+// 파일 본문 앞의 상태줄/헤더를 만들어 보낸다. length가 0이거나 파일보다 길면 끝까지로 줄인다.
+// 본문이 따라오면 MSG_MORE로 보내 헤더가 첫 sendfile 조각과 같은 세그먼트에 실리게 한다.
+static int send_stream_headers(int fd, int status, const char *status_text, const char *content_type,
+                               off_t file_size, off_t offset, size_t *length, const char *extra_headers,
+                               int keep_alive) {
+    if (offset > file_size) {
+        return -1;
+    }
+    if (*length == 0 || (off_t)*length > file_size - offset) {
+        *length = (size_t)(file_size - offset);
     }
-    if (offset + 2 >= (int)sizeof(header)) {
+    http_head_t head;
+    if (head_build(&head, status, status_text, keep_alive, 1, *length,
+                   content_type ? content_type : "application/octet-stream", NULL, extra_headers) != 0) {
         return -1;
     }
-    header[offset++] = '\r';
-    header[offset++] = '\n';
+    return send_iov_flags(fd, head.iov, head.count, *length > 0 ? MSG_MORE : 0);
+}
 
-    if (send_all(fd, header, (size_t)offset) != 0) {
+// 상태줄/헤더만 보내고 파일 본문은 stream에 담아 호출자가 이어 보내도록 한다.
+int http_begin_file_response(int fd, int status, const char *status_text,
+                             const char *content_type, const char *file_path,
+                             off_t offset, size_t length, int sendfile_enabled,
+                             const char *extra_headers, int keep_alive,
+                             http_file_stream_t *stream) {
+    http_stream_init(stream);
+    int file_fd = open(file_path, O_RDONLY);
+    if (file_fd < 0) {
         return -1;
     }
-    if (body && length > 0) {
-        if (send_all(fd, body, length) != 0) {
+    struct stat st;
+    if (fstat(file_fd, &st) != 0 ||
+        send_stream_headers(fd, status, status_text, content_type, st.st_size, offset, &length,
+                            extra_headers, keep_alive) != 0) {
+        close(file_fd);
+        return -1;
+    }
+    stream->file_fd = file_fd;
+    stream->offset = offset;
+    stream->remaining = length;
+#if HAVE_SENDFILE
+    stream->use_sendfile = sendfile_enabled ? 1 : 0;
+#else
+    (void)sendfile_enabled;
+    stream->use_sendfile = 0;
+#endif
+    return 0;
+}
+
+// http_begin_file_response와 같되 파일 핸들 캐시에서 빌린 핸들을 쓴다.
+// 성공하면 참조는 stream이 갖고 http_stream_close에서 반납한다. 실패하면 호출자가 반납한다.
+int http_begin_media_response(int fd, int status, const char *status_text, const char *content_type,
+                              struct media_file *media, off_t offset, size_t length,
+                              const char *extra_headers, int keep_alive, http_file_stream_t *stream) {
+    http_stream_init(stream);
+    if (send_stream_headers(fd, status, status_text, content_type, media_file_size(media), offset, &length,
+                            extra_headers, keep_alive) != 0) {
+        return -1;
+    }
+    stream->file_fd = media_file_fd(media);
+    stream->media = media;
+    stream->offset = offset;
+    stream->remaining = length;
+    stream->use_sendfile = HAVE_SENDFILE;
+    http_stream_progress(stream, 0); // 첫 구간을 헤더 송신 직후 미리 읽기 시작한다.
+    return 0;
+}
+
+void http_stream_progress(http_file_stream_t *stream, size_t sent) {
+    if (stream && stream->media) {
+        media_file_progress(stream->media, stream->offset, stream->offset + (off_t)stream->remaining, sent,
+                            &stream->prefetched);
+    }
+}
+
+// 한 번의 http_stream_send에서 보낸 양을 경로별 바이트 카운터와 미리 읽기에 반영한다.
+static void stream_sent(http_file_stream_t *stream, size_t sent) {
+    metrics_add_body_bytes(stream->use_sendfile ? METRICS_BODY_SENDFILE : METRICS_BODY_COPY, sent);
+    http_stream_progress(stream, sent);
+}
+
+// 남은 본문을 최대 budget 바이트까지 보낸다. 완료 1, 소켓이 가득 찼거나 budget 소진 0, 오류 -1
+int http_stream_send(int fd, http_file_stream_t *stream, size_t budget) {
+    if (!stream || stream->file_fd < 0) {
+        return -1;
+    }
+    size_t sent_total = 0;
+    while (stream->remaining > 0 && sent_total < budget) {
+        size_t want = stream->remaining;
+        if (want > budget - sent_total) {
+            want = budget - sent_total;
+        }
+        ssize_t n;
+#if HAVE_SENDFILE
+        if (stream->use_sendfile) {
+            off_t file_offset = stream->offset;
+            n = sendfile(fd, stream->file_fd, &file_offset, want);
+        } else
+#endif
+        {
+            char buf[8192];
+            size_t to_read = want < sizeof(buf) ? want : sizeof(buf);
+            ssize_t r = pread(stream->file_fd, buf, to_read, stream->offset);
+            if (r <= 0) {
+                return -1;
+            }
+            n = send(fd, buf, (size_t)r, 0);
+        }
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                stream_sent(stream, sent_total);
+                return 0;
+            }
             return -1;
         }
+        if (n == 0) {
+            return -1; // 파일이 전송 도중 잘렸다.
+        }
+        stream->offset += n;
+        stream->remaining -= (size_t)n;
+        sent_total += (size_t)n;
     }
-    return 0;
+    stream_sent(stream, sent_total);
+    return stream->remaining == 0 ? 1 : 0;
 }
 
 // 파일 디스크립터를 열어 클라이언트로 스트리밍한다. Range 지원 옵션 포함
 int http_send_file_response(int fd, int status, const char *status_text,
                             const char *content_type, const char *file_path,
                             off_t offset, size_t length, int sendfile_enabled,
-                            const char *extra_headers) {
-    struct stat st;
-    if (stat(file_path, &st) != 0) {
-        return -1;
-    }
-    if (offset > st.st_size) {
+                            const char *extra_headers, int keep_alive) {
+    http_file_stream_t stream;
+    if (http_begin_file_response(fd, status, status_text, content_type, file_path,
+                                 offset, length, sendfile_enabled, extra_headers, keep_alive,
+                                 &stream) != 0) {
         return -1;
     }
-    if (length == 0 || (off_t)length > st.st_size - offset) {
-        length = (size_t)(st.st_size - offset);
+    int rc = 0;
+    for (;;) {
+        int step = http_stream_send(fd, &stream, SIZE_MAX);
+        if (step == 1) {
+            break;
+        }
+        if (step < 0 || wait_socket(fd, POLLOUT) != 0) {
+            rc = -1;
+            break;
+        }
     }
+    http_stream_close(&stream);
+    return rc;
+}
+
+// 파일의 inode/크기/mtime(나노초)로 강한 ETag를, mtime으로 Last-Modified를 만든다.
+void http_validator_from_stat(const struct stat *st, http_validator_t *out) {
+    memset(out, 0, sizeof(*out));
+    out->mtime = st->st_mtime;
+    unsigned long long mtime_ns =
+        (unsigned long long)st->st_mtim.tv_sec * 1000000000ULL + (unsigned long long)st->st_mtim.tv_nsec;
+    snprintf(out->etag, sizeof(out->etag), "\"%llx-%llx-%llx\"", (unsigned long long)st->st_ino,
+             (unsigned long long)st->st_size, mtime_ns);
+    struct tm tm_utc;
+    gmtime_r(&st->st_mtime, &tm_utc);
+    strftime(out->last_modified, sizeof(out->last_modified), "%a, %d %b %Y %H:%M:%S GMT", &tm_utc);
+}
 
-    char header[2048];
-    int hdr_off = snprintf(header, sizeof(header),
-                           "HTTP/1.1 %d %s\r\n"
-                           "Connection: close\r\n"
-                           "Content-Length: %zu\r\n"
-                           "Content-Type: %s\r\n",
-                           status, status_text, length,
-                           content_type ? content_type : "application/octet-stream");
-    if (hdr_off < 0 || (size_t)hdr_off >= sizeof(header)) {
+// IMF-fixdate("Sun, 06 Nov 1994 08:49:37 GMT")를 time_t로 바꾼다. 형식이 다르면 -1.
+static int parse_http_date(const char *value, time_t *out) {
+    struct tm tm_utc;
+    memset(&tm_utc, 0, sizeof(tm_utc));
+    const char *end = strptime(value, "%a, %d %b %Y %H:%M:%S GMT", &tm_utc);
+    if (!end) {
         return -1;
     }
-    if (extra_headers && *extra_headers) {
-        int n = snprintf(header + hdr_off, sizeof(header) - hdr_off, "%s", extra_headers);
-        if (n < 0 || (size_t)n >= sizeof(header) - hdr_off) {
-            return -1;
+    *out = timegm(&tm_utc);
+    return 0;
+}
+
+// If-None-Match 목록에 ETag가 있는지 약한 비교로 확인한다 ("*"는 모두 일치).
+static int etag_list_matches(const char *list, const char *etag) {
+    size_t etag_len = strlen(etag);
+    const char *p = list;
+    while (*p) {
+        while (*p == ' ' || *p == '\t' || *p == ',') p++;
+        if (!*p) break;
+        if (*p == '*') return 1;
+        if (strncmp(p, "W/", 2) == 0) p += 2;
+        const char *start = p;
+        while (*p && *p != ',') p++;
+        const char *end = p;
+        while (end > start && (end[-1] == ' ' || end[-1] == '\t')) end--;
+        if ((size_t)(end - start) == etag_len && strncmp(start, etag, etag_len) == 0) {
+            return 1;
         }
-        hdr_off += n;
     }
-    if (hdr_off + 2 >= (int)sizeof(header)) {
-        return -1;
+    return 0;
+}
+
+// 조건부 요청이 캐시된 사본을 그대로 써도 되는지(304) 판단한다.
+// If-None-Match가 있으면 If-Modified-Since는 보지 않는다 (RFC 9110 13.2.2).
+int http_request_not_modified(const http_request_t *req, const http_validator_t *validator) {
+    if (!req || !validator) return 0;
+    const char *inm = http_get_known_header(req, HTTP_HDR_IF_NONE_MATCH);
+    if (inm) {
+        return etag_list_matches(inm, validator->etag);
+    }
+    const char *ims = http_get_known_header(req, HTTP_HDR_IF_MODIFIED_SINCE);
+    time_t since;
+    if (ims && parse_http_date(ims, &since) == 0) {
+        return validator->mtime <= since;
     }
-    header[hdr_off++] = '\r';
-    header[hdr_off++] = '\n';
+    return 0;
+}
 
-    if (send_all(fd, header, (size_t)hdr_off) != 0) {
+// If-Range가 없거나 현재 표현과 일치하면 1: Range를 적용해도 된다.
+// 일치하지 않으면 0이며, 호출자는 Range를 무시하고 전체 본문(200)을 보내야 한다.
+int http_if_range_allows(const http_request_t *req, const http_validator_t *validator) {
+    if (!req || !validator) return 1;
+    const char *if_range = http_get_known_header(req, HTTP_HDR_IF_RANGE);
+    if (!if_range) {
+        return 1;
+    }
+    if (if_range[0] == '"') {
+        return strcmp(if_range, validator->etag) == 0; // 강한 비교만 허용
+    }
+    if (strncmp(if_range, "W/", 2) == 0) {
+        return 0;
+    }
+    time_t date;
+    return parse_http_date(if_range, &date) == 0 && date == validator->mtime;
+}
+
+// ETag/Last-Modified/Cache-Control 헤더 줄을 out에 쓴다. 잘리면 -1.
+int http_format_validator_headers(const http_validator_t *validator, const char *cache_control,
+                                  char *out, size_t out_len) {
+    int n = snprintf(out, out_len, "ETag: %s\r\nLast-Modified: %s\r\n%s%s%s", validator->etag,
+                     validator->last_modified, cache_control && *cache_control ? "Cache-Control: " : "",
+                     cache_control && *cache_control ? cache_control : "",
+                     cache_control && *cache_control ? "\r\n" : "");
+    return n < 0 || (size_t)n >= out_len ? -1 : 0;
+}
+
+// 본문 없는 304 응답. 검증자와 캐시 정책은 extra_headers로 다시 알려 준다.
+int http_send_not_modified(int fd, const char *extra_headers, int keep_alive) {
+    http_head_t head;
+    if (head_build(&head, 304, NULL, keep_alive, 0, 0, NULL, NULL, extra_headers) != 0) {
         return -1;
     }
+    return send_iov_flags(fd, head.iov, head.count, 0);
+}
 
-    int file_fd = open(file_path, O_RDONLY);
-    if (file_fd < 0) {
+// 검증자를 붙여 파일 전체를 보낸다. 조건부 요청이 일치하면 본문 없이 304로 끝낸다.
+int http_send_cacheable_file(int fd, const http_request_t *req, const char *content_type,
+                             const char *file_path, const char *cache_control,
+                             const char *extra_headers, int keep_alive) {
+    struct stat st;
+    if (stat(file_path, &st) != 0) {
         return -1;
     }
-    int rc = 0;
-    if (offset > 0) {
-        if (lseek(file_fd, offset, SEEK_SET) < 0) {
-            rc = -1;
-            goto done;
+    http_validator_t validator;
+    http_validator_from_stat(&st, &validator);
+    char headers[2048];
+    size_t used = 0;
+    if (extra_headers && *extra_headers) {
+        int n = snprintf(headers, sizeof(headers), "%s", extra_headers);
+        if (n < 0 || (size_t)n >= sizeof(headers)) {
+            return -1;
         }
+        used = (size_t)n;
     }
-#if HAVE_SENDFILE
-    if (sendfile_enabled) {
-        size_t remaining = length;
-        while (remaining > 0) {
-            ssize_t sent = sendfile(fd, file_fd, NULL, remaining);
-            if (sent <= 0) {
-                rc = -1;
-                break;
-            }
-            remaining -= (size_t)sent;
-        }
-    } else
-#else
-    (void)sendfile_enabled;
-#endif
-    {
-        char buf[8192];
-        size_t remaining = length;
-        while (remaining > 0) {
-            size_t to_read = remaining < sizeof(buf) ? remaining : sizeof(buf);
-            ssize_t r = read(file_fd, buf, to_read);
-            if (r <= 0) {
-                rc = -1;
-                break;
-            }
-            if (send_all(fd, buf, (size_t)r) != 0) {
-                rc = -1;
-                break;
-            }
-            remaining -= (size_t)r;
-        }
+    if (http_format_validator_headers(&validator, cache_control, headers + used, sizeof(headers) - used) != 0) {
+        return -1;
     }
-
-done:
-    close(file_fd);
-    return rc;
+    if (http_request_not_modified(req, &validator)) {
+        return http_send_not_modified(fd, headers, keep_alive);
+    }
+    return http_send_file_response(fd, 200, http_status_text(200), content_type, file_path, 0, 0, 1,
+                                   headers, keep_alive);
 }
 
-// malloc으로 확보한 버퍼를 해제하고 구조체를 초기화한다.
+// 요청 구조체를 초기화한다. 원본 바이트는 연결 버퍼가 소유한다.
 void http_free_request(http_request_t *req) {
-    if (req->owns_raw_data && req->raw_data) {
-        free(req->raw_data);
-    }
     request_init(req);
 }
 
 // HTTP 상태 코드에 대응하는 기본 Reason-Phrase를 돌려준다.
 const char *http_status_text(int status) {
-    switch (status) {
-        case 200: return "OK";
-        case 201: return "Created";
-        case 204: return "No Content";
-        case 206: return "Partial Content";
-        case 400: return "Bad Request";
-        case 401: return "Unauthorized";
-        case 403: return "Forbidden";
-        case 404: return "Not Found";
-        case 405: return "Method Not Allowed";
-        case 409: return "Conflict";
-        case 416: return "Range Not Satisfiable";
-        default: return status >= 500 ? "Internal Server Error" : "OK";
+    for (size_t i = 0; i < ARRAY_SIZE(k_status_lines); ++i) {
+        if (k_status_lines[i].status == status) {
+            return k_status_lines[i].text;
+        }
     }
+    return status >= 500 ? "Internal Server Error" : "OK";
 }
@@ -0,0 +1,691 @@
+// media 디렉터리를 videos 카탈로그와 맞춰 두는 모듈: 파일 지문 기반 전체 스캔과 inotify 증분 반영
+#include "library.h"
+
+#include <dirent.h>
+#include <errno.h>
+#include <limits.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#if defined(__linux__)
+#include <sys/inotify.h>
+#define USE_INOTIFY 1
+#else
+#define USE_INOTIFY 0
+#endif
+
+#include "db.h"
+#include "ffmpeg.h"
+#include "mp4.h"
+#include "utils.h"
+
+// 이벤트가 잦아든 뒤 배치를 반영하기까지 기다리는 시간 / 이벤트가 계속 와도 반영하는 최대 지연
+#define WATCH_QUIET_MS 250
+#define WATCH_MAX_DELAY_MS 2000
+// 전체 스캔은 이만큼씩 끊어 커밋한다 (큰 라이브러리의 첫 스캔이 쓰기 잠금을 오래 쥐지 않고 목록에 점점 나타나게)
+#define SYNC_CHUNK_FILES 256
+
+// media 디렉터리 변경을 감지하기 위한 상태 구조체
+typedef struct {
+    pthread_t thread;
+    int running;
+    atomic_int stop;
+    int interval_sec;
+    server_ctx_t *server;
+} media_watch_state_t;
+
+// 카탈로그에 저장된 파일 하나의 지문 (전체 스캔 비교용)
+typedef struct {
+    char *filename;
+    long long file_size;
+    long long file_mtime;
+    int seen;
+} fingerprint_t;
+
+typedef struct {
+    fingerprint_t *items;
+    size_t count;
+    size_t capacity;
+} fingerprint_list_t;
+
+// db_apply_media_changes에 넘길 변경 목록 (문자열은 배치가 소유한다)
+typedef struct {
+    db_media_change_t *items;
+    size_t count;
+    size_t capacity;
+} media_batch_t;
+
+// 증분 워처가 모아 두는 변경된 파일명 집합
+typedef struct {
+    char **items;
+    size_t count;
+    size_t capacity;
+} filename_set_t;
+
+// IN_MOVED_FROM/IN_MOVED_TO를 cookie로 짝지은 이름 변경 (to가 NULL이면 아직 짝이 없다)
+typedef struct {
+    uint32_t cookie;
+    char *from;
+    char *to;
+} media_move_t;
+
+typedef struct {
+    media_move_t *items;
+    size_t count;
+    size_t capacity;
+} move_list_t;
+
+static media_watch_state_t g_media_watch = {0};
+
+// 워처 스레드와 관리자 재스캔이 동시에 카탈로그를 고치지 않도록 직렬화한다.
+static pthread_mutex_t g_sync_lock = PTHREAD_MUTEX_INITIALIZER;
+// 카탈로그 내용이 바뀔 때마다 1씩 증가하는 세대 번호 (클라이언트/캐시 무효화 기준).
+// 값은 DB catalog_state에 있고 이것은 그 사본이다: 시작 시 읽어 오고 커밋마다 DB가 올린 값으로 맞춘다.
+static atomic_ulong g_catalog_generation = 1;
+// 시작 후 첫 전체 동기화가 끝났는지 (그 전에는 지난 실행의 카탈로그를 그대로 내보낸다)
+static atomic_int g_library_ready = 0;
+static uint64_t g_library_started_ms;
+
+// 환경 변수에서 정수를 읽되 파싱 오류 시 기본값을 돌려준다.
+static int getenv_int(const char *name, int fallback) {
+    const char *value = getenv(name);
+    if (!value || !*value) {
+        return fallback;
+    }
+    char *end = NULL;
+    long v = strtol(value, &end, 10);
+    if (!end || *end != '\0') {
+        return fallback;
+    }
+    if (v < 0 || v > INT_MAX) {
+        return fallback;
+    }
+    return (int)v;
+}
+
+static int has_mp4_extension(const char *name) {
+    const char *ext = strrchr(name, '.');
+    if (!ext) return 0;
+    return strcasecmp(ext, ".mp4") == 0;
+}
+
+// 카탈로그에 올릴 파일명인지 확인한다. (숨김 파일과 mp4가 아닌 파일 제외)
+static int is_media_filename(const char *name) {
+    return name && name[0] != '\0' && name[0] != '.' && has_mp4_extension(name);
+}
+
+// 파일명에서 확장자와 언더스코어를 제거해 사람이 읽을 제목을 만든다.
+static void make_title(const char *filename, char *title, size_t len) {
+    if (!filename || !title || len == 0) return;
+    const char *base = filename;
+    const char *slash = strrchr(filename, '/');
+    if (slash) base = slash + 1;
+    char tmp[256];
+    snprintf(tmp, sizeof(tmp), "%s", base);
+    char *dot = strrchr(tmp, '.');
+    if (dot) *dot = '\0';
+    for (char *p = tmp; *p; ++p) {
+        if (*p == '_' || *p == '-') {
+            *p = ' ';
+        }
+    }
+    if (tmp[0] == '\0') {
+        snprintf(title, len, "%s", filename);
+    } else {
+        snprintf(title, len, "%s", tmp);
+    }
+}
+
+static void fingerprint_list_free(fingerprint_list_t *list) {
+    if (!list) return;
+    for (size_t i = 0; i < list->count; ++i) {
+        free(list->items[i].filename);
+    }
+    free(list->items);
+    memset(list, 0, sizeof(*list));
+}
+
+// db_list_video_fingerprints 콜백에서 지문 목록을 채운다.
+static int collect_fingerprint(void *userdata, const char *filename, long long file_size,
+                               long long file_mtime) {
+    fingerprint_list_t *list = userdata;
+    if (list->count == list->capacity) {
+        size_t new_cap = list->capacity == 0 ? 64 : list->capacity * 2;
+        fingerprint_t *new_items = realloc(list->items, new_cap * sizeof(*new_items));
+        if (!new_items) {
+            return -1;
+        }
+        list->items = new_items;
+        list->capacity = new_cap;
+    }
+    char *copy = strdup(filename);
+    if (!copy) {
+        return -1;
+    }
+    fingerprint_t *fp = &list->items[list->count++];
+    fp->filename = copy;
+    fp->file_size = file_size;
+    fp->file_mtime = file_mtime;
+    fp->seen = 0;
+    return 0;
+}
+
+static int fingerprint_compare(const void *a, const void *b) {
+    const fingerprint_t *fa = a;
+    const fingerprint_t *fb = b;
+    return strcmp(fa->filename, fb->filename);
+}
+
+// 정렬된 지문 목록에서 파일명을 이진 탐색한다.
+static fingerprint_t *fingerprint_find(fingerprint_list_t *list, const char *filename) {
+    if (list->count == 0) return NULL;
+    fingerprint_t key = {.filename = (char *)filename};
+    return bsearch(&key, list->items, list->count, sizeof(*list->items), fingerprint_compare);
+}
+
+static void media_batch_free(media_batch_t *batch) {
+    if (!batch) return;
+    for (size_t i = 0; i < batch->count; ++i) {
+        free((char *)batch->items[i].filename);
+        free((char *)batch->items[i].old_filename);
+        free((char *)batch->items[i].title);
+    }
+    free(batch->items);
+    memset(batch, 0, sizeof(*batch));
+}
+
+// 배치에 upsert(st != NULL) 또는 삭제(st == NULL) 항목을 추가한다. upsert는 박스 헤더를 읽어 색인한다.
+// old_filename이 있으면 그 이름의 행을 filename으로 바꾼 뒤 upsert한다 (이름 변경).
+static int media_batch_add(server_ctx_t *server, media_batch_t *batch, const char *filename,
+                           const char *old_filename, const struct stat *st) {
+    if (batch->count == batch->capacity) {
+        size_t new_cap = batch->capacity == 0 ? 16 : batch->capacity * 2;
+        db_media_change_t *new_items = realloc(batch->items, new_cap * sizeof(*new_items));
+        if (!new_items) {
+            return -1;
+        }
+        batch->items = new_items;
+        batch->capacity = new_cap;
+    }
+    db_media_change_t change = {0};
+    change.filename = strdup(filename);
+    if (!change.filename) {
+        return -1;
+    }
+    if (st) {
+        char title[256];
+        make_title(filename, title, sizeof(title));
+        change.title = strdup(title);
+        change.old_filename = old_filename ? strdup(old_filename) : NULL;
+        if (!change.title || (old_filename && !change.old_filename)) {
+            free((char *)change.filename);
+            free((char *)change.title);
+            free((char *)change.old_filename);
+            return -1;
+        }
+        change.file_size = (long long)st->st_size;
+        change.file_mtime = (long long)st->st_mtime;
+        char path[PATH_MAX];
+        if (snprintf(path, sizeof(path), "%s/%s", server->media_dir, filename) >= (int)sizeof(path) ||
+            mp4_probe(path, &change.media) != 0) {
+            log_warn("Could not index MP4 boxes of %s; duration and codec stay unknown", filename);
+            change.media.faststart = 1; // 구조를 모르는 파일은 고쳐 쓰지 않는다
+        } else if (!change.media.faststart) {
+            log_info("%s is not faststart (moov at %lld after mdat at %lld)%s", filename,
+                     change.media.moov_offset, change.media.mdat_offset,
+                     server->mp4_faststart ? "; relocating moov in background" : "");
+        }
+    }
+    batch->items[batch->count++] = change;
+    return 0;
+}
+
+// 배치를 한 트랜잭션으로 반영하고, 실제로 바뀐 행이 있으면 세대를 올린다.
+// 새로 들어오거나 바뀐 파일은 썸네일/미리보기 작업 큐에 넣어 첫 요청 전에 만들어 두게 한다.
+static int media_batch_commit(server_ctx_t *server, const media_batch_t *batch, int *changed_out) {
+    size_t applied = 0;
+    unsigned long generation = 0;
+    if (db_apply_media_changes(&server->db, batch->items, batch->count, &applied, &generation) != 0) {
+        log_warn("Failed to apply %zu media changes: %s", batch->count, db_errmsg(&server->db));
+        return -1;
+    }
+    if (generation > 0) {
+        atomic_store(&g_catalog_generation, generation);
+    }
+    for (size_t i = 0; i < batch->count; ++i) {
+        const db_media_change_t *change = &batch->items[i];
+        char path[PATH_MAX];
+        if (change->video_id > 0 &&
+            snprintf(path, sizeof(path), "%s/%s", server->media_dir, change->filename) < (int)sizeof(path)) {
+            // moov를 먼저 옮겨 두면 뒤따르는 포스터/미리보기가 바뀐 파일을 기준으로 만들어진다.
+            if (server->mp4_faststart && !change->media.faststart) {
+                ffmpeg_queue_faststart(server, change->video_id, path);
+            }
+            ffmpeg_queue_video(server, change->video_id, path, change->media.duration_seconds);
+        }
+    }
+    if (changed_out) {
+        *changed_out = applied > 0;
+    }
+    return 0;
+}
+
+// media 디렉터리 파일의 stat을 얻는다. 일반 파일이 아니면 -1.
+static int stat_media_file(server_ctx_t *server, const char *filename, struct stat *st) {
+    char path[PATH_MAX];
+    if (snprintf(path, sizeof(path), "%s/%s", server->media_dir, filename) >= (int)sizeof(path)) {
+        return -1;
+    }
+    if (stat(path, st) != 0 || !S_ISREG(st->st_mode)) {
+        return -1;
+    }
+    return 0;
+}
+
+// media 디렉터리 전체를 카탈로그 지문과 비교해 크기/mtime이 달라진 파일만 반영한다 (SYNC_CHUNK_FILES개씩 나눠 커밋).
+int library_sync(server_ctx_t *server, int *changed_out) {
+    if (changed_out) {
+        *changed_out = 0;
+    }
+    if (!server) return -1;
+    pthread_mutex_lock(&g_sync_lock);
+    fingerprint_list_t known = {0};
+    if (db_list_video_fingerprints(&server->db, collect_fingerprint, &known) != 0) {
+        log_warn("Failed to load media fingerprints: %s", db_errmsg(&server->db));
+        fingerprint_list_free(&known);
+        pthread_mutex_unlock(&g_sync_lock);
+        return -1;
+    }
+    qsort(known.items, known.count, sizeof(*known.items), fingerprint_compare);
+
+    DIR *dir = opendir(server->media_dir);
+    if (!dir) {
+        log_warn("Failed to open media directory %s: %s", server->media_dir, strerror(errno));
+        fingerprint_list_free(&known);
+        pthread_mutex_unlock(&g_sync_lock);
+        return -1;
+    }
+    media_batch_t batch = {0};
+    int result = 0;
+    int changed = 0;
+    size_t applied = 0; // 커밋한 변경 수 (첫 동기화 로그용)
+    struct dirent *ent;
+    while ((ent = readdir(dir)) != NULL) {
+        if (!is_media_filename(ent->d_name)) continue;
+        struct stat st;
+        if (stat_media_file(server, ent->d_name, &st) != 0) continue;
+        fingerprint_t *fp = fingerprint_find(&known, ent->d_name);
+        if (fp) {
+            fp->seen = 1;
+            if (fp->file_size == (long long)st.st_size && fp->file_mtime == (long long)st.st_mtime) {
+                continue;
+            }
+        }
+        if (media_batch_add(server, &batch, ent->d_name, NULL, &st) != 0) {
+            log_warn("Failed to track media file %s", ent->d_name);
+            result = -1;
+            break;
+        }
+        if (batch.count >= SYNC_CHUNK_FILES) {
+            int chunk_changed = 0;
+            result = media_batch_commit(server, &batch, &chunk_changed);
+            applied += batch.count;
+            changed |= chunk_changed;
+            media_batch_free(&batch);
+            if (result != 0) break;
+        }
+    }
+    closedir(dir);
+    // 디렉터리에서 사라진 파일은 카탈로그에서 삭제한다.
+    for (size_t i = 0; result == 0 && i < known.count; ++i) {
+        if (!known.items[i].seen && media_batch_add(server, &batch, known.items[i].filename, NULL, NULL) != 0) {
+            result = -1;
+        }
+    }
+    if (result == 0) {
+        int chunk_changed = 0;
+        result = media_batch_commit(server, &batch, &chunk_changed);
+        applied += batch.count;
+        changed |= chunk_changed;
+    }
+    if (result != 0) {
+        log_error("Media synchronization aborted; see warnings above for details");
+    } else if (!atomic_exchange(&g_library_ready, 1)) {
+        log_info("Media catalogue ready: %zu change(s) applied in %llu ms (generation %lu)", applied,
+                 (unsigned long long)(get_monotonic_ms() - g_library_started_ms), library_generation());
+    }
+    if (changed_out) {
+        *changed_out = changed;
+    }
+    media_batch_free(&batch);
+    fingerprint_list_free(&known);
+    pthread_mutex_unlock(&g_sync_lock);
+    return result;
+}
+
+// 현재 카탈로그 세대 번호를 돌려준다.
+unsigned long library_generation(void) {
+    return atomic_load(&g_catalog_generation);
+}
+
+int library_ready(void) {
+    return atomic_load(&g_library_ready);
+}
+
+// usleep 대신 짧게 여러 번 슬립해서 stop 플래그를 빠르게 반영한다.
+static void sleep_with_stop(media_watch_state_t *state) {
+    if (!state || state->interval_sec <= 0) return;
+    int slices = state->interval_sec * 10; // 100ms x interval_sec
+    for (int i = 0; i < slices && !state->stop; ++i) {
+        usleep(100000);
+    }
+}
+
+// inotify를 쓸 수 없을 때: 주기마다 지문 비교 스캔을 돌려 제자리 덮어쓰기까지 감지한다.
+static void media_watch_poll(media_watch_state_t *state) {
+    // 첫 동기화가 아직이면 (inotify를 못 쓰는 경우) 주기를 기다리지 않고 바로 한다.
+    if (!library_ready() && library_sync(state->server, NULL) != 0) {
+        log_warn("Initial media sync failed; serving the previous catalogue (will retry)");
+    }
+    while (!state->stop) {
+        sleep_with_stop(state);
+        if (state->stop) break;
+        int changed = 0;
+        if (library_sync(state->server, &changed) != 0) {
+            log_warn("Media hot-reload: sync failed (will retry)");
+        } else if (changed) {
+            log_info("Media hot-reload: library synchronized (generation %lu)", library_generation());
+        }
+    }
+}
+
+#if USE_INOTIFY
+static void filename_set_clear(filename_set_t *set) {
+    for (size_t i = 0; i < set->count; ++i) {
+        free(set->items[i]);
+    }
+    set->count = 0;
+}
+
+// 같은 파일에 대한 연속 이벤트(CREATE → CLOSE_WRITE 등)는 한 번만 담는다.
+static int filename_set_add(filename_set_t *set, const char *name) {
+    for (size_t i = 0; i < set->count; ++i) {
+        if (strcmp(set->items[i], name) == 0) {
+            return 0;
+        }
+    }
+    if (set->count == set->capacity) {
+        size_t new_cap = set->capacity == 0 ? 16 : set->capacity * 2;
+        char **new_items = realloc(set->items, new_cap * sizeof(*new_items));
+        if (!new_items) {
+            return -1;
+        }
+        set->items = new_items;
+        set->capacity = new_cap;
+    }
+    char *copy = strdup(name);
+    if (!copy) {
+        return -1;
+    }
+    set->items[set->count++] = copy;
+    return 0;
+}
+
+static void move_list_clear(move_list_t *moves) {
+    for (size_t i = 0; i < moves->count; ++i) {
+        free(moves->items[i].from);
+        free(moves->items[i].to);
+    }
+    moves->count = 0;
+}
+
+// IN_MOVED_FROM을 기록한다. 짝이 되는 IN_MOVED_TO는 move_list_pair가 채운다.
+static int move_list_add(move_list_t *moves, uint32_t cookie, const char *from) {
+    if (moves->count == moves->capacity) {
+        size_t new_cap = moves->capacity == 0 ? 8 : moves->capacity * 2;
+        media_move_t *new_items = realloc(moves->items, new_cap * sizeof(*new_items));
+        if (!new_items) {
+            return -1;
+        }
+        moves->items = new_items;
+        moves->capacity = new_cap;
+    }
+    char *copy = strdup(from);
+    if (!copy) {
+        return -1;
+    }
+    moves->items[moves->count++] = (media_move_t){.cookie = cookie, .from = copy, .to = NULL};
+    return 0;
+}
+
+// IN_MOVED_TO를 같은 cookie의 IN_MOVED_FROM에 붙인다. 짝이 없으면 (밖에서 들어온 파일) 0.
+static int move_list_pair(move_list_t *moves, uint32_t cookie, const char *to) {
+    for (size_t i = 0; i < moves->count; ++i) {
+        media_move_t *move = &moves->items[i];
+        if (move->cookie == cookie && !move->to) {
+            move->to = strdup(to);
+            return move->to ? 1 : -1;
+        }
+    }
+    return 0;
+}
+
+// 이벤트가 들어온 파일만 다시 stat해서 존재하면 upsert, 없으면 삭제로 반영한다.
+// 짝지은 이름 변경은 먼저 적용해 id를 유지하고, 짝이 없는 IN_MOVED_FROM은 삭제로 본다.
+static int library_apply_pending(server_ctx_t *server, const filename_set_t *pending,
+                                 const move_list_t *moves, int *changed_out) {
+    pthread_mutex_lock(&g_sync_lock);
+    media_batch_t batch = {0};
+    int result = 0;
+    for (size_t i = 0; result == 0 && i < moves->count; ++i) {
+        const media_move_t *move = &moves->items[i];
+        struct stat st;
+        if (move->to && stat_media_file(server, move->to, &st) == 0) {
+            log_info("Media hot-reload: %s renamed to %s", move->from, move->to);
+            result = media_batch_add(server, &batch, move->to, move->from, &st);
+        } else {
+            // 옮겨진 뒤 다시 사라졌거나 디렉터리 밖으로 나갔다.
+            result = media_batch_add(server, &batch, move->from, NULL, NULL);
+            if (result == 0 && move->to) {
+                result = media_batch_add(server, &batch, move->to, NULL, NULL);
+            }
+        }
+    }
+    for (size_t i = 0; result == 0 && i < pending->count; ++i) {
+        struct stat st;
+        int exists = stat_media_file(server, pending->items[i], &st) == 0;
+        if (media_batch_add(server, &batch, pending->items[i], NULL, exists ? &st : NULL) != 0) {
+            result = -1;
+            break;
+        }
+    }
+    if (result == 0) {
+        result = media_batch_commit(server, &batch, changed_out);
+    }
+    media_batch_free(&batch);
+    pthread_mutex_unlock(&g_sync_lock);
+    return result;
+}
+
+// IN_CREATE만으로 내용이 완성된 파일: 심볼릭 링크와 하드 링크는 IN_CLOSE_WRITE가 오지 않는다.
+static int created_complete(server_ctx_t *server, const char *filename) {
+    char path[PATH_MAX];
+    struct stat st;
+    if (snprintf(path, sizeof(path), "%s/%s", server->media_dir, filename) >= (int)sizeof(path) ||
+        lstat(path, &st) != 0) {
+        return 0;
+    }
+    return S_ISLNK(st.st_mode) || (S_ISREG(st.st_mode) && st.st_nlink > 1);
+}
+
+// inotify 이벤트를 모아 배치로 반영한다. 감시 대상 디렉터리가 사라지면 -1을 돌려 폴링으로 전환한다.
+static int media_watch_inotify(media_watch_state_t *state) {
+    int fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (fd < 0) {
+        log_warn("inotify unavailable (%s); falling back to polling", strerror(errno));
+        return -1;
+    }
+    // 일반 파일은 IN_CREATE가 아니라 쓰기가 끝난 IN_CLOSE_WRITE나 IN_MOVED_TO에서 반영한다 (복사 중인 파일 제외).
+    uint32_t mask = IN_CREATE | IN_CLOSE_WRITE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO |
+                    IN_DELETE_SELF | IN_MOVE_SELF;
+    if (inotify_add_watch(fd, state->server->media_dir, mask) < 0) {
+        log_warn("inotify watch on %s failed (%s); falling back to polling",
+                 state->server->media_dir, strerror(errno));
+        close(fd);
+        return -1;
+    }
+    // 감시를 건 뒤에 전체 스캔을 해야 스캔 도중 바뀐 파일도 놓치지 않는다. 시작 시에는 이것이 첫 동기화다.
+    filename_set_t pending = {0};
+    move_list_t moves = {0};
+    int need_full_sync = 0;
+    if (library_sync(state->server, NULL) != 0) {
+        log_warn("Media sync failed; serving the previous catalogue (will retry)");
+        need_full_sync = 1;
+    }
+    int result = 0;
+    uint64_t first_event_ms = 0;
+    uint64_t last_event_ms = 0;
+    union {
+        struct inotify_event event;
+        char raw[8192];
+    } buf;
+    while (!state->stop) {
+        struct pollfd pfd = {.fd = fd, .events = POLLIN, .revents = 0};
+        int n = poll(&pfd, 1, 100);
+        if (n < 0 && errno != EINTR) {
+            log_warn("inotify poll failed: %s", strerror(errno));
+            result = -1;
+            break;
+        }
+        if (n > 0 && (pfd.revents & POLLIN)) {
+            ssize_t len;
+            while ((len = read(fd, buf.raw, sizeof(buf.raw))) > 0) {
+                for (char *p = buf.raw; p < buf.raw + len;) {
+                    const struct inotify_event *ev = (const struct inotify_event *)p;
+                    p += sizeof(struct inotify_event) + ev->len;
+                    if (ev->mask & IN_Q_OVERFLOW) {
+                        // 커널 큐가 넘쳐 이벤트를 잃었으므로 전체 지문 비교로 복구한다.
+                        need_full_sync = 1;
+                    } else if (ev->mask & (IN_DELETE_SELF | IN_MOVE_SELF | IN_IGNORED)) {
+                        result = -1;
+                    } else if (!(ev->mask & IN_ISDIR) && ev->len > 0 && is_media_filename(ev->name)) {
+                        int rc = 0;
+                        if (ev->mask & IN_MOVED_FROM) {
+                            rc = move_list_add(&moves, ev->cookie, ev->name);
+                        } else if (ev->mask & IN_MOVED_TO) {
+                            rc = move_list_pair(&moves, ev->cookie, ev->name);
+                            rc = rc == 0 ? filename_set_add(&pending, ev->name) : (rc < 0 ? -1 : 0);
+                        } else if (!(ev->mask & IN_CREATE) || created_complete(state->server, ev->name)) {
+                            rc = filename_set_add(&pending, ev->name);
+                        }
+                        if (rc != 0) {
+                            need_full_sync = 1;
+                        }
+                    }
+                }
+            }
+            uint64_t now = get_monotonic_ms();
+            if (first_event_ms == 0) {
+                first_event_ms = now;
+            }
+            last_event_ms = now;
+        }
+        if (result != 0) {
+            log_warn("Media directory %s is no longer watchable; falling back to polling",
+                     state->server->media_dir);
+            break;
+        }
+        if (pending.count == 0 && moves.count == 0 && !need_full_sync) {
+            first_event_ms = 0;
+            continue;
+        }
+        uint64_t now = get_monotonic_ms();
+        if (now - last_event_ms < WATCH_QUIET_MS && now - first_event_ms < WATCH_MAX_DELAY_MS) {
+            continue;
+        }
+        int changed = 0;
+        int rc = need_full_sync ? library_sync(state->server, &changed)
+                                : library_apply_pending(state->server, &pending, &moves, &changed);
+        if (rc != 0) {
+            log_warn("Media hot-reload: failed to apply changes (will rescan)");
+            need_full_sync = 1;
+            first_event_ms = now;
+            last_event_ms = now;
+            continue;
+        }
+        if (changed) {
+            log_info("Media hot-reload: library synchronized (generation %lu)", library_generation());
+        }
+        filename_set_clear(&pending);
+        move_list_clear(&moves);
+        need_full_sync = 0;
+        first_event_ms = 0;
+    }
+    filename_set_clear(&pending);
+    free(pending.items);
+    move_list_clear(&moves);
+    free(moves.items);
+    close(fd);
+    return result;
+}
+#endif
+
+// 백그라운드 워처: 가능하면 inotify로 증분 반영하고, 아니면 주기적 지문 스캔으로 대체한다.
+static void *media_watch_loop(void *arg) {
+    media_watch_state_t *state = (media_watch_state_t *)arg;
+#if USE_INOTIFY
+    if (media_watch_inotify(state) == 0) {
+        return NULL;
+    }
+#endif
+    media_watch_poll(state);
+    return NULL;
+}
+
+// 워처를 띄운다. 첫 전체 동기화는 워처 스레드가 맡으므로 서버는 지난 카탈로그로 바로 리스닝을 시작하고,
+// library_ready()가 1이 될 때까지 /healthz가 준비 전(503)으로 답한다. 스레드를 못 띄우면 여기서 동기화한다.
+int library_start(server_ctx_t *server) {
+    if (!server) return -1;
+    if (g_media_watch.running) return 0;
+    g_library_started_ms = get_monotonic_ms();
+    unsigned long generation = 0;
+    if (db_get_catalog_generation(&server->db, &generation) == 0 && generation > 0) {
+        atomic_store(&g_catalog_generation, generation);
+    } else {
+        log_warn("Could not read the stored catalogue generation; numbering restarts at 1");
+    }
+    struct stat st;
+    if (stat(server->media_dir, &st) != 0 || !S_ISDIR(st.st_mode)) {
+        log_error("Media directory %s is not accessible", server->media_dir);
+        return -1;
+    }
+    g_media_watch.server = server;
+    g_media_watch.interval_sec = getenv_int("MEDIA_WATCH_INTERVAL_SEC", 2);
+    if (g_media_watch.interval_sec <= 0) {
+        g_media_watch.interval_sec = 2;
+    }
+    g_media_watch.stop = 0;
+    if (pthread_create(&g_media_watch.thread, NULL, media_watch_loop, &g_media_watch) != 0) {
+        log_warn("Media hot-reload watcher is not running; use POST /api/admin/rescan after adding files");
+        memset(&g_media_watch, 0, sizeof(g_media_watch));
+        return library_sync(server, NULL);
+    }
+    g_media_watch.running = 1;
+    return 0;
+}
+
+// 서버 종료 시 백그라운드 워처 스레드를 정리한다.
+void library_stop(void) {
+    if (!g_media_watch.running) {
+        return;
+    }
+    g_media_watch.stop = 1;
+    pthread_join(g_media_watch.thread, NULL);
+    memset(&g_media_watch, 0, sizeof(g_media_watch));
+}
@@ -0,0 +1,397 @@
+// 비동기 로거. 각 스레드는 자기 링 버퍼(단일 생산자/단일 소비자)에 레코드를 복사만 하고 곧바로 돌아간다.
+// 배경 스레드가 주기적으로 모든 링을 시각 순으로 합쳐 형식화한 뒤 출력 대상마다 write로 한꺼번에 내보낸다.
+// 링이 가득 차면 기다리지 않고 버리며, 버린 수는 다음 배치에서 경고 한 줄로 알린다.
+#include "logger.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "http.h"
+#include "metrics.h"
+#include "utils.h"
+
+#define LOG_RING_BYTES (64 * 1024) // 스레드별 링 크기 (2의 거듭제곱)
+#define LOG_RECORD_ALIGN 16        // 레코드 헤더 크기이기도 하다: 끝에 남는 자리는 언제나 PAD 헤더가 들어간다
+#define LOG_LINE_MAX 1024          // 로그 한 줄 최대 길이 (넘으면 자른다)
+#define LOG_FLUSH_INTERVAL_MS 20
+#define LOG_OUT_BUFFER (64 * 1024)
+
+typedef enum {
+    LOG_RECORD_PAD,    // 링 끝의 남는 자리 (건너뛴다)
+    LOG_RECORD_TEXT,   // log_info 등: 호출한 스레드가 만든 메시지 본문
+    LOG_RECORD_ACCESS  // access_log_entry_t 그대로
+} log_record_kind_t;
+
+typedef struct {
+    uint32_t size;   // 헤더 포함 전체 크기 (LOG_RECORD_ALIGN 배수)
+    uint8_t kind;
+    uint8_t level;
+    uint16_t length; // 본문 바이트
+    uint64_t ts_ns;  // CLOCK_REALTIME
+} log_record_t;
+
+_Static_assert(sizeof(log_record_t) == LOG_RECORD_ALIGN, "log record header must fill one alignment unit");
+
+static const char *const k_level_names[] = {"INFO", "WARN", "ERROR"};
+static const char *const k_method_names[] = {"GET", "POST", "PUT", "DELETE", "OPTIONS", "UNKNOWN"};
+
+typedef struct log_ring {
+    _Atomic uint64_t head;    // 쓴 바이트 누계 (생산자만 증가)
+    _Atomic uint64_t dropped; // 가득 차서 버린 레코드 수 (생산자만 증가)
+    _Alignas(64) _Atomic uint64_t tail; // 소비한 바이트 누계 (배경 스레드만 증가)
+    uint64_t read_pos;        // 이번 배치에서 읽은 위치 (배경 스레드 전용)
+    uint64_t read_end;
+    uint64_t reported;        // 이미 경고한 dropped 값
+    struct log_ring *next;
+    _Alignas(64) unsigned char data[LOG_RING_BYTES];
+} log_ring_t;
+
+typedef struct {
+    int fd;
+    size_t length;
+    char data[LOG_OUT_BUFFER];
+} log_out_t;
+
+static struct {
+    _Atomic(log_ring_t *) rings;
+    atomic_int running; // 1이면 링 경로, 0이면 동기 stderr 출력
+    pthread_t thread;
+    pthread_mutex_t lock; // stop/cond 보호 (생산자는 잡지 않는다)
+    pthread_cond_t cond;
+    int stop;
+    int access_fd;      // -1이면 접근 로그 끔
+    int owns_access_fd;
+    int access_sample;  // N개 중 1개 기록
+    log_out_t app_out;
+    log_out_t access_out;
+} g_log = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .cond = PTHREAD_COND_INITIALIZER,
+    .access_fd = -1,
+    .access_sample = 1,
+};
+
+static _Thread_local log_ring_t *t_ring = NULL;
+static _Thread_local unsigned t_sample_counter = 0;
+
+static uint64_t realtime_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+// 처음 기록하는 스레드의 링을 만들어 목록 앞에 끼운다. 링은 종료 때까지 남는다 (스레드는 모두 수명이 길다).
+static log_ring_t *local_ring(void) {
+    if (t_ring) {
+        return t_ring;
+    }
+    log_ring_t *ring = aligned_alloc(64, sizeof(*ring));
+    if (!ring) {
+        return NULL;
+    }
+    memset(ring, 0, offsetof(log_ring_t, data));
+    log_ring_t *head = atomic_load_explicit(&g_log.rings, memory_order_relaxed);
+    do {
+        ring->next = head;
+    } while (!atomic_compare_exchange_weak_explicit(&g_log.rings, &head, ring, memory_order_release,
+                                                    memory_order_relaxed));
+    t_ring = ring;
+    return ring;
+}
+
+// 레코드 하나를 링에 넣는다. 자리가 없으면 기다리지 않고 버린다.
+static void ring_push(log_record_kind_t kind, int level, const void *payload, size_t length) {
+    log_ring_t *ring = local_ring();
+    if (!ring) {
+        return;
+    }
+    size_t size = (sizeof(log_record_t) + length + LOG_RECORD_ALIGN - 1) & ~(size_t)(LOG_RECORD_ALIGN - 1);
+    uint64_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    uint64_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+    size_t offset = (size_t)(head & (LOG_RING_BYTES - 1));
+    size_t contiguous = LOG_RING_BYTES - offset;
+    // 끝에 다 들어가지 않으면 남은 자리를 PAD로 채우고 링 처음부터 쓴다.
+    size_t need = size <= contiguous ? size : contiguous + size;
+    if (LOG_RING_BYTES - (size_t)(head - tail) < need) {
+        atomic_store_explicit(&ring->dropped, atomic_load_explicit(&ring->dropped, memory_order_relaxed) + 1,
+                              memory_order_relaxed);
+        return;
+    }
+    if (size > contiguous) {
+        log_record_t *pad = (log_record_t *)(ring->data + offset);
+        pad->size = (uint32_t)contiguous;
+        pad->kind = LOG_RECORD_PAD;
+        head += contiguous;
+        offset = 0;
+    }
+    log_record_t *record = (log_record_t *)(ring->data + offset);
+    record->size = (uint32_t)size;
+    record->kind = (uint8_t)kind;
+    record->level = (uint8_t)level;
+    record->length = (uint16_t)length;
+    record->ts_ns = realtime_ns();
+    memcpy(record + 1, payload, length);
+    atomic_store_explicit(&ring->head, head + size, memory_order_release);
+}
+
+// 인자가 가리키는 문자열은 곧 사라질 수 있으므로 메시지 본문만 호출한 스레드에서 만들고,
+// 접두어를 붙여 내보내는 일은 배경 스레드가 한다. 시작 전과 종료 후에는 바로 stderr에 쓴다.
+static void vlog_at_level(int level, const char *fmt, va_list ap) {
+    char line[LOG_LINE_MAX];
+    int n = vsnprintf(line, sizeof(line), fmt, ap);
+    if (n < 0) {
+        return;
+    }
+    size_t length = (size_t)n < sizeof(line) ? (size_t)n : sizeof(line) - 1;
+    if (atomic_load_explicit(&g_log.running, memory_order_acquire)) {
+        ring_push(LOG_RECORD_TEXT, level, line, length);
+        return;
+    }
+    fprintf(stderr, "[%s] %.*s\n", k_level_names[level], (int)length, line);
+}
+
+void log_info(const char *fmt, ...) {
+    va_list ap;
+    va_start(ap, fmt);
+    vlog_at_level(0, fmt, ap);
+    va_end(ap);
+}
+
+void log_warn(const char *fmt, ...) {
+    va_list ap;
+    va_start(ap, fmt);
+    vlog_at_level(1, fmt, ap);
+    va_end(ap);
+}
+
+void log_error(const char *fmt, ...) {
+    va_list ap;
+    va_start(ap, fmt);
+    vlog_at_level(2, fmt, ap);
+    va_end(ap);
+}
+
+int access_log_sampled(int status) {
+    if (g_log.access_fd < 0 || !atomic_load_explicit(&g_log.running, memory_order_relaxed)) {
+        return 0;
+    }
+    if (status >= 500 || g_log.access_sample <= 1) {
+        return 1;
+    }
+    // 스레드마다 따로 세므로 공유 카운터 없이 대략 N개 중 1개가 남는다.
+    return ++t_sample_counter % (unsigned)g_log.access_sample == 0;
+}
+
+void access_log_record(const access_log_entry_t *entry) {
+    if (entry && g_log.access_fd >= 0 && atomic_load_explicit(&g_log.running, memory_order_relaxed)) {
+        ring_push(LOG_RECORD_ACCESS, 0, entry, sizeof(*entry));
+    }
+}
+
+// 버퍼를 대상 FD에 모두 쓴다. 배경 스레드만 호출하므로 대상이 느려도 이 스레드만 기다린다.
+static void out_flush(log_out_t *out) {
+    size_t written = 0;
+    while (written < out->length) {
+        ssize_t n = write(out->fd, out->data + written, out->length - written);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            break; // 쓸 수 없는 대상: 이번 배치는 버린다
+        }
+        written += (size_t)n;
+    }
+    out->length = 0;
+}
+
+static void out_append(log_out_t *out, const char *data, size_t length) {
+    if (out->length + length > sizeof(out->data)) {
+        out_flush(out);
+    }
+    if (length > sizeof(out->data)) {
+        length = sizeof(out->data);
+    }
+    memcpy(out->data + out->length, data, length);
+    out->length += length;
+}
+
+// "2025-01-02T03:04:05.678Z"
+static void format_timestamp(uint64_t ts_ns, char *out, size_t out_len) {
+    time_t seconds = (time_t)(ts_ns / 1000000000ULL);
+    struct tm tm;
+    gmtime_r(&seconds, &tm);
+    size_t n = strftime(out, out_len, "%Y-%m-%dT%H:%M:%S", &tm);
+    snprintf(out + n, out_len - n, ".%03uZ", (unsigned)(ts_ns / 1000000ULL % 1000ULL));
+}
+
+static void format_record(const log_record_t *record) {
+    const char *payload = (const char *)(record + 1);
+    if (record->kind == LOG_RECORD_TEXT) {
+        char line[LOG_LINE_MAX + 16];
+        int n = snprintf(line, sizeof(line), "[%s] %.*s\n", k_level_names[record->level < 3 ? record->level : 2],
+                         (int)record->length, payload);
+        if (n > 0) {
+            out_append(&g_log.app_out, line, (size_t)n < sizeof(line) ? (size_t)n : sizeof(line) - 1);
+        }
+        return;
+    }
+    if (record->kind != LOG_RECORD_ACCESS || record->length != sizeof(access_log_entry_t)) {
+        return;
+    }
+    access_log_entry_t entry;
+    memcpy(&entry, payload, sizeof(entry));
+    char ts[40];
+    format_timestamp(record->ts_ns, ts, sizeof(ts));
+    const char *route = metrics_route_pattern(entry.route_id);
+    const char *method = entry.method >= 0 && entry.method <= HTTP_UNKNOWN ? k_method_names[entry.method] : "UNKNOWN";
+    char user[16] = "null";
+    if (entry.user_id > 0) {
+        snprintf(user, sizeof(user), "%d", entry.user_id);
+    }
+    char line[512];
+    int n = snprintf(line, sizeof(line),
+                     "{\"ts\":\"%s\",\"method\":\"%s\",\"route\":\"%s\",\"status\":%d,\"bytes\":%llu,"
+                     "\"duration_ms\":%.3f,\"user_id\":%s}\n",
+                     ts, method, route ? route : "unknown", entry.status, (unsigned long long)entry.bytes,
+                     (double)entry.duration_us / 1000.0, user);
+    if (n > 0) {
+        out_append(&g_log.access_out, line, (size_t)n < sizeof(line) ? (size_t)n : sizeof(line) - 1);
+    }
+}
+
+// 모든 링의 지금까지 쌓인 레코드를 시각 순으로 합쳐 형식화한다. 처리한 레코드 수를 돌려준다.
+static size_t drain_once(void) {
+    log_ring_t *rings = atomic_load_explicit(&g_log.rings, memory_order_acquire);
+    for (log_ring_t *ring = rings; ring; ring = ring->next) {
+        ring->read_pos = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+        ring->read_end = atomic_load_explicit(&ring->head, memory_order_acquire);
+    }
+    size_t processed = 0;
+    for (;;) {
+        log_ring_t *oldest = NULL;
+        const log_record_t *oldest_record = NULL;
+        for (log_ring_t *ring = rings; ring; ring = ring->next) {
+            while (ring->read_pos < ring->read_end) {
+                const log_record_t *record =
+                    (const log_record_t *)(ring->data + (ring->read_pos & (LOG_RING_BYTES - 1)));
+                if (record->kind != LOG_RECORD_PAD) {
+                    if (!oldest_record || record->ts_ns < oldest_record->ts_ns) {
+                        oldest = ring;
+                        oldest_record = record;
+                    }
+                    break;
+                }
+                ring->read_pos += record->size;
+            }
+        }
+        if (!oldest) {
+            break;
+        }
+        format_record(oldest_record);
+        oldest->read_pos += oldest_record->size;
+        processed++;
+    }
+    for (log_ring_t *ring = rings; ring; ring = ring->next) {
+        atomic_store_explicit(&ring->tail, ring->read_end, memory_order_release);
+        uint64_t dropped = atomic_load_explicit(&ring->dropped, memory_order_relaxed);
+        if (dropped != ring->reported) {
+            char line[96];
+            int n = snprintf(line, sizeof(line), "[WARN] Log ring full: dropped %llu records\n",
+                             (unsigned long long)(dropped - ring->reported));
+            out_append(&g_log.app_out, line, (size_t)n);
+            ring->reported = dropped;
+        }
+    }
+    out_flush(&g_log.app_out);
+    if (g_log.access_out.fd >= 0) {
+        out_flush(&g_log.access_out);
+    }
+    return processed;
+}
+
+static void *logger_main(void *arg) {
+    (void)arg;
+    pthread_mutex_lock(&g_log.lock);
+    while (!g_log.stop) {
+        struct timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_nsec += LOG_FLUSH_INTERVAL_MS * 1000000L;
+        if (deadline.tv_nsec >= 1000000000L) {
+            deadline.tv_sec += 1;
+            deadline.tv_nsec -= 1000000000L;
+        }
+        pthread_cond_timedwait(&g_log.cond, &g_log.lock, &deadline);
+        pthread_mutex_unlock(&g_log.lock);
+        drain_once();
+        pthread_mutex_lock(&g_log.lock);
+    }
+    pthread_mutex_unlock(&g_log.lock);
+    while (drain_once() > 0) {
+    }
+    return NULL;
+}
+
+int logger_start(const server_ctx_t *server) {
+    if (!server || atomic_load(&g_log.running)) {
+        return -1;
+    }
+    g_log.app_out.fd = STDERR_FILENO;
+    g_log.access_out.fd = -1;
+    g_log.access_sample = server->access_log_sample > 0 ? server->access_log_sample : 1;
+    const char *path = server->access_log_path;
+    if (path[0] == '\0') {
+        g_log.access_fd = -1;
+    } else if (strcmp(path, "-") == 0 || strcmp(path, "stderr") == 0) {
+        g_log.access_fd = STDERR_FILENO;
+    } else {
+        g_log.access_fd = open(path, O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC, 0640);
+        if (g_log.access_fd < 0) {
+            log_warn("Failed to open access log %s: %s; access logging disabled", path, strerror(errno));
+        } else {
+            g_log.owns_access_fd = 1;
+        }
+    }
+    g_log.access_out.fd = g_log.access_fd;
+    g_log.stop = 0;
+    if (pthread_create(&g_log.thread, NULL, logger_main, NULL) != 0) {
+        if (g_log.owns_access_fd) {
+            close(g_log.access_fd);
+        }
+        g_log.access_fd = -1;
+        g_log.owns_access_fd = 0;
+        return -1;
+    }
+    atomic_store_explicit(&g_log.running, 1, memory_order_release);
+    // 시작 이후 main이 어느 경로로 끝나든 링에 남은 로그(특히 종료 사유)를 내보낸다.
+    atexit(logger_shutdown);
+    if (g_log.access_fd >= 0) {
+        log_info("Access log: %s (1 in %d requests, all 5xx)", path, g_log.access_sample);
+    }
+    return 0;
+}
+
+void logger_shutdown(void) {
+    if (!atomic_exchange(&g_log.running, 0)) {
+        return;
+    }
+    pthread_mutex_lock(&g_log.lock);
+    g_log.stop = 1;
+    pthread_cond_signal(&g_log.cond);
+    pthread_mutex_unlock(&g_log.lock);
+    pthread_join(g_log.thread, NULL);
+    // 오류로 main을 빠져나가는 경로에서는 다른 스레드가 아직 링을 쥐고 있을 수 있으므로 링은 해제하지 않는다.
+    if (g_log.owns_access_fd) {
+        close(g_log.access_fd);
+    }
+    g_log.access_fd = -1;
+    g_log.owns_access_fd = 0;
+}
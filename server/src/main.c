@@ -2,76 +2,77 @@
 #include "auth.h"
 #include "ffmpeg.h"
 #include "history.h"
+#include "hls.h"
 #include "http.h"
+#include "library.h"
+#include "logger.h"
+#include "media_cache.h"
+#include "metrics.h"
+#include "reactor.h"
 #include "router.h"
 #include "server.h"
+#include "static_cache.h"
 #include "utils.h"
 #include "video.h"
 
 #include <arpa/inet.h>
 #include <errno.h>
-#include <fcntl.h>
 #include <netinet/in.h>
 #include <signal.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <strings.h>
-#if defined(__linux__)
-#include <sys/epoll.h>
-#define USE_EPOLL 1
-#else
-#include <poll.h>
-#define USE_EPOLL 0
-#endif
 #include <sys/socket.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <unistd.h>
 
-// 에지 트리거 I/O 대기 시 한 번에 수용할 최대 이벤트 수
-#define MAX_EVENTS 128
-
 static volatile sig_atomic_t g_running = 1;
+// SIGTERM을 받아 종료를 앞둔 상태: /healthz가 503을 돌려 프록시가 트래픽을 빼는 동안 요청은 계속 받는다.
+static volatile sig_atomic_t g_draining = 0;
+static int g_drain_sec = 0;
+// 리액터 목록 (REACTOR_THREADS가 1이면 하나만 쓰고 메인 스레드에서 돌린다)
+#define MAX_REACTORS 64
+static reactor_t g_reactors[MAX_REACTORS];
+static int g_reactor_cpus[MAX_REACTORS];
+static int g_pin_reactors = 0;
 
 // SIGINT/SIGTERM을 받으면 메인 루프가 종료되도록 플래그만 갱신한다.
+// SIGTERM은 먼저 g_drain_sec 동안 draining으로 알리고 SIGALRM으로 멈춘다. 두 번째 신호는 바로 멈춘다.
 static void handle_signal(int signum) {
-    (void)signum;
-    g_running = 0;
-}
-
-// 논블로킹 소켓으로 전환한다.
-static int make_nonblocking(int fd) {
-    int flags = fcntl(fd, F_GETFL, 0);
-    if (flags == -1) {
-        return -1;
-    }
-    if (fcntl(fd, F_SETFL, flags | O_NONBLOCK) == -1) {
-        return -1;
-    }
-    return 0;
-}
-
-// 블로킹 소켓으로 되돌린다. 워커 스레드에서 요청을 처리할 때 사용한다.
-static int make_blocking(int fd) {
-    int flags = fcntl(fd, F_GETFL, 0);
-    if (flags == -1) {
-        return -1;
-    }
-    if (fcntl(fd, F_SETFL, flags & ~O_NONBLOCK) == -1) {
-        return -1;
+    if (signum == SIGTERM && !g_draining && g_drain_sec > 0) {
+        g_draining = 1;
+        alarm((unsigned)g_drain_sec);
+        return;
     }
-    return 0;
+    g_running = 0;
 }
 
 // TCP 서버 소켓을 만들고 논블로킹 상태로 리스닝 준비까지 마친다.
-static int create_listen_socket(int port) {
+static int create_listen_socket(int port, int backlog, int reuse_port) {
+#if defined(__linux__)
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+#else
     int fd = socket(AF_INET, SOCK_STREAM, 0);
+#endif
     if (fd < 0) {
         return -1;
     }
     int opt = 1;
     setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+#ifdef SO_REUSEPORT
+    // 리액터마다 같은 포트의 리스너를 따로 열면 커널이 연결을 리스너별 accept 큐로 나눠 준다.
+    if (reuse_port && setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &opt, sizeof(opt)) != 0) {
+        close(fd);
+        return -1;
+    }
+#else
+    if (reuse_port) {
+        close(fd);
+        return -1;
+    }
+#endif
     struct sockaddr_in addr;
     memset(&addr, 0, sizeof(addr));
     addr.sin_family = AF_INET;
@@ -81,17 +82,29 @@ static int create_listen_socket(int port) {
         close(fd);
         return -1;
     }
-    if (listen(fd, 128) < 0) {
+    if (listen(fd, backlog) < 0) {
         close(fd);
         return -1;
     }
+#if !defined(__linux__)
     if (make_nonblocking(fd) != 0) {
         close(fd);
         return -1;
     }
+#endif
     return fd;
 }
 
+// 다중 리액터 모드에서 리액터 하나를 CPU에 고정해 돌리는 스레드 진입점
+static void *reactor_thread_main(void *arg) {
+    reactor_t *reactor = (reactor_t *)arg;
+    if (g_pin_reactors) {
+        reactor_pin(reactor, g_reactor_cpus[reactor - g_reactors]);
+    }
+    reactor_run(reactor, &g_running);
+    return NULL;
+}
+
 // 기본 디렉터리 + 상대 경로를 조합한 결과를 out 버퍼에 채운다.
 static int join_path(const char *base, const char *path, char *out, size_t len) {
     if (snprintf(out, len, "%s/%s", base, path) >= (int)len) {
@@ -100,23 +113,6 @@ static int join_path(const char *base, const char *path, char *out, size_t len)
     return 0;
 }
 
-// 정적 파일 확장자에 맞춰 심플한 MIME 타입을 선택한다.
-static const char *mime_type_for_path(const char *path) {
-    const char *ext = strrchr(path, '.');
-    if (!ext) return "application/octet-stream";
-    ext++;
-    if (strcasecmp(ext, "html") == 0) return "text/html; charset=utf-8";
-    if (strcasecmp(ext, "css") == 0) return "text/css; charset=utf-8";
-    if (strcasecmp(ext, "js") == 0) return "application/javascript";
-    if (strcasecmp(ext, "json") == 0) return "application/json";
-    if (strcasecmp(ext, "png") == 0) return "image/png";
-    if (strcasecmp(ext, "jpg") == 0 || strcasecmp(ext, "jpeg") == 0) return "image/jpeg";
-    if (strcasecmp(ext, "svg") == 0) return "image/svg+xml";
-    if (strcasecmp(ext, "ico") == 0) return "image/x-icon";
-    if (strcasecmp(ext, "mp4") == 0) return "video/mp4";
-    return "application/octet-stream";
-}
-
 // 경로 순회 공격을 방지하기 위해 ".." 토큰을 거부한다.
 static int is_safe_path(const char *path) {
     if (strstr(path, "..")) {
@@ -126,24 +122,38 @@ static int is_safe_path(const char *path) {
 }
 
 // API 응답 패턴을 재사용하기 위한 JSON 에러 헬퍼
-static int send_json_error(server_ctx_t *server, int fd, int status, const char *message) {
+static int send_json_error(request_ctx_t *ctx, int status, const char *message) {
     char body[512];
     int len = snprintf(body, sizeof(body), "{\"error\":\"%s\"}", message ? message : "error");
     if (len < 0 || (size_t)len >= sizeof(body)) {
         return -1;
     }
-    return http_send_response(fd, status, http_status_text(status), "application/json",
-                               body, (size_t)len, server->security_headers);
+    return http_send_response(ctx->client_fd, status, http_status_text(status), "application/json",
+                              body, (size_t)len, ctx->server->security_headers, ctx->keep_alive);
+}
+
+// 준비 상태 확인 (Caddy active health check, 오케스트레이터 readiness probe).
+// 리스너는 시작하자마자 지난 실행의 카탈로그로 응답하지만, 첫 미디어 동기화가 끝나기 전과 SIGTERM 뒤 draining 구간에는 503을 돌려준다.
+static void handle_healthz(request_ctx_t *ctx) {
+    char body[96];
+    if (g_draining) {
+        router_send_json(ctx, 503, "{\"status\":\"draining\"}", "Cache-Control: no-store\r\n");
+    } else if (!library_ready()) {
+        router_send_json(ctx, 503, "{\"status\":\"starting\"}", "Cache-Control: no-store\r\nRetry-After: 1\r\n");
+    } else {
+        snprintf(body, sizeof(body), "{\"status\":\"ready\",\"catalogGeneration\":%lu}", library_generation());
+        router_send_json(ctx, 200, body, "Cache-Control: no-store\r\n");
+    }
 }
 
 // 웹 클라이언트 정적 자산(css/js/html 등)을 찾아 내려준다.
 static int serve_static_file(server_ctx_t *server, request_ctx_t *ctx) {
     const char *path = ctx->request->path;
     if (!path || !*path) {
-        return send_json_error(server, ctx->client_fd, 404, "Not Found");
+        return send_json_error(ctx, 404, "Not Found");
     }
     if (!is_safe_path(path)) {
-        return send_json_error(server, ctx->client_fd, 403, "Forbidden");
+        return send_json_error(ctx, 403, "Forbidden");
     }
     char relative[512];
     if (strcmp(path, "/") == 0) {
@@ -154,56 +164,144 @@ static int serve_static_file(server_ctx_t *server, request_ctx_t *ctx) {
         snprintf(relative, sizeof(relative), "%s", path);
     }
 
+    // 시작 시 메모리에 올려 둔 자산은 stat/open 없이 미리 만든 응답으로 보낸다.
+    int cached = static_cache_serve(ctx->client_fd, ctx->request, relative, ctx->keep_alive);
+    if (cached <= 0) {
+        return cached;
+    }
+
     char full_path[PATH_MAX];
     if (join_path(server->static_dir, relative, full_path, sizeof(full_path)) != 0) {
-        return send_json_error(server, ctx->client_fd, 500, "Path too long");
+        return send_json_error(ctx, 500, "Path too long");
     }
     struct stat st;
     if (stat(full_path, &st) != 0 || S_ISDIR(st.st_mode)) {
-        return send_json_error(server, ctx->client_fd, 404, "Not Found");
+        return send_json_error(ctx, 404, "Not Found");
     }
     const char *mime = mime_type_for_path(relative);
-    return http_send_file_response(ctx->client_fd, 200, "OK", mime, full_path, 0, 0, 1,
-                                   server->security_headers);
+    const char *cache_control = static_cache_control_for(server, mime);
+    return http_send_cacheable_file(ctx->client_fd, ctx->request, mime, full_path, cache_control,
+                                    server->security_headers, ctx->keep_alive);
 }
 
-typedef struct client_task {
-    server_ctx_t *server;
-    int fd;
-} client_task_t;
-
 // 워커 스레드에서 실행되며 HTTP 요청 파싱 → 라우팅 → 응답까지 담당한다.
-static void handle_client(void *arg) {
-    client_task_t *task = (client_task_t *)arg;
-    server_ctx_t *server = task->server;
-    int fd = task->fd;
-    free(task);
-
-    make_blocking(fd);
+// 파일 본문이 남은 응답(비디오 스트림)은 이벤트 루프로 넘겨 워커를 곧바로 반환한다.
+static void handle_client(connection_t *conn) {
+    server_ctx_t *server = conn->owner->server;
+    int fd = conn->fd;
+
+    // 파이프라이닝된 요청이 버퍼에 남아 있으면 같은 워커에서 이어서 처리한다.
+    for (;;) {
+        http_request_t req;
+        int parsed = 0;
+        if (conn->parsed) {
+            // BULK lane으로 옮겨 온 요청: inbuf는 그대로이므로 파싱 결과를 이어 쓴다.
+            req = *conn->parsed;
+            free(conn->parsed);
+            conn->parsed = NULL;
+        } else {
+            parsed = http_parse_request(fd, &req, &conn->inbuf);
+        }
+        if (parsed > 0) {
+            // 요청이 아직 다 오지 않았다: 워커를 붙잡지 않고 이벤트 루프가 다음 바이트를 기다린다.
+            reactor_resume(conn);
+            return;
+        }
+        if (parsed != 0) {
+            reactor_close(conn);
+            return;
+        }
+        // 루프는 요청을 읽지 않고 interactive lane으로 넘기므로, 무거운 라우트는 파싱한 뒤에 BULK로 옮긴다.
+        if (conn->lane != THREAD_POOL_LANE_BULK && router_route_is_bulk(req.method, req.path)) {
+            conn->parsed = malloc(sizeof(*conn->parsed));
+            if (conn->parsed) {
+                *conn->parsed = req;
+                if (reactor_requeue(conn, THREAD_POOL_LANE_BULK) == 0) {
+                    return;
+                }
+                free(conn->parsed);
+                conn->parsed = NULL;
+            }
+            // BULK 큐가 가득 찼다: 이 워커에서 그대로 처리한다.
+        }
+        conn->requests_served++;
+
+        request_ctx_t ctx;
+        memset(&ctx, 0, sizeof(ctx));
+        ctx.server = server;
+        ctx.client_fd = fd;
+        ctx.request = &req;
+        ctx.stream = &conn->stream;
+        ctx.keep_alive = req.keep_alive && g_running && !g_draining &&
+                         server->keepalive_timeout_sec > 0 &&
+                         conn->requests_served < (unsigned)server->keepalive_max_requests;
+
+        // 인증부터 응답(스트림이면 헤더) 송신까지를 라우트별 지연 시간으로 잰다.
+        uint64_t started = metrics_now_us();
+        auth_authenticate_request(&ctx);
+
+        if (strncmp(req.path, "/api/", 5) == 0 || strcmp(req.path, "/metrics") == 0 ||
+            strcmp(req.path, "/healthz") == 0) {
+            router_handle(&ctx);
+        } else {
+            ctx.route_id = METRICS_ROUTE_STATIC;
+            int rc = serve_static_file(server, &ctx);
+            (void)rc;
+        }
+        size_t body_bytes = 0;
+        int status = http_take_response(&body_bytes);
+        uint64_t elapsed = metrics_now_us() - started;
+        metrics_observe_request(ctx.route_id, status, elapsed);
+        if (access_log_sampled(status)) {
+            access_log_entry_t entry = {
+                .route_id = ctx.route_id,
+                .method = (int)req.method,
+                .status = status,
+                .user_id = ctx.authenticated ? ctx.user_id : 0,
+                .bytes = body_bytes,
+                .duration_us = elapsed,
+            };
+            if (conn->stream.file_fd >= 0) {
+                // 본문은 이벤트 루프가 마저 보내므로 전송이 끝났을 때 실제로 보낸 양과 전체 시간으로 남긴다.
+                conn->access = entry;
+                conn->access_started_us = started;
+                conn->access_pending = 1;
+            } else {
+                access_log_record(&entry);
+            }
+        }
 
-    http_request_t req;
-    if (http_parse_request(fd, &req, NULL, 0) != 0) {
-        close(fd);
-        return;
+        size_t consumed = req.raw_length;
+        http_free_request(&req);
+        http_buffer_consume(&conn->inbuf, consumed);
+        conn->keep_alive = ctx.keep_alive;
+        if (conn->stream.file_fd >= 0) {
+            reactor_stream(conn);
+            return;
+        }
+        if (!conn->keep_alive) {
+            reactor_close(conn);
+            return;
+        }
+        if (conn->inbuf.length == 0) {
+            reactor_resume(conn);
+            return;
+        }
     }
+}
 
-    request_ctx_t ctx;
-    memset(&ctx, 0, sizeof(ctx));
-    ctx.server = server;
-    ctx.client_fd = fd;
-    ctx.request = &req;
-
-    auth_authenticate_request(&ctx);
-
-    if (strncmp(req.path, "/api/", 5) == 0) {
-        router_handle(&ctx);
+// 환경 변수의 max-age/immutable 설정으로 Cache-Control 값을 만든다. max-age가 0이면 매번 재검증한다.
+static void build_cache_control(char *out, size_t len, const char *scope,
+                                const char *max_age_env, int default_max_age, const char *immutable_env) {
+    const char *max_age_value = getenv(max_age_env);
+    int max_age = max_age_value ? atoi(max_age_value) : default_max_age;
+    const char *immutable_value = getenv(immutable_env);
+    int immutable = immutable_value && atoi(immutable_value) > 0;
+    if (max_age <= 0) {
+        snprintf(out, len, "%s, no-cache", scope);
     } else {
-        int rc = serve_static_file(server, &ctx);
-        (void)rc;
+        snprintf(out, len, "%s, max-age=%d%s", scope, max_age, immutable ? ", immutable" : "");
     }
-
-    http_free_request(&req);
-    close(fd);
 }
 
 // 환경 변수 또는 후보 경로 목록에서 우선순위대로 경로를 선택한다.
@@ -246,6 +344,7 @@ int main(void) {
     // 신호 처리기 등록: Ctrl+C(SIGINT) 등으로 안전하게 종료한다.
     signal(SIGINT, handle_signal);
     signal(SIGTERM, handle_signal);
+    signal(SIGALRM, handle_signal);
     signal(SIGPIPE, SIG_IGN);
 
     server_ctx_t server;
@@ -257,6 +356,11 @@ int main(void) {
         "X-Frame-Options: DENY\r\n"
         "Content-Security-Policy: default-src 'self'; img-src 'self' data:; media-src 'self'; style-src 'self' 'unsafe-inline'; script-src 'self';\r\n";
     snprintf(server.security_headers, sizeof(server.security_headers), "%s", security);
+    // 반복 방문 시 브라우저/엣지 캐시가 워커까지 오지 않도록 자산별 캐시 정책을 미리 만들어 둔다.
+    build_cache_control(server.static_cache_control, sizeof(server.static_cache_control), "public",
+                        "STATIC_CACHE_MAX_AGE", 300, "STATIC_CACHE_IMMUTABLE");
+    build_cache_control(server.thumb_cache_control, sizeof(server.thumb_cache_control), "private",
+                        "THUMBNAIL_CACHE_MAX_AGE", 86400, "THUMBNAIL_CACHE_IMMUTABLE");
 
     const char *static_candidates[] = {"./web/public", "../web/public", NULL};
     choose_path("STATIC_DIR", static_candidates, ARRAY_SIZE(static_candidates),
@@ -287,6 +391,16 @@ int main(void) {
     }
     log_info("Thumbnail directory: %s", server.thumb_dir);
 
+    // HLS 패키지는 썸네일처럼 원본에서 다시 만들 수 있는 캐시라 기본으로 썸네일 디렉터리 아래에 둔다.
+    const char *hls_env = getenv("HLS_DIR");
+    if (hls_env && *hls_env) {
+        snprintf(server.hls_dir, sizeof(server.hls_dir), "%s", hls_env);
+    } else if (snprintf(server.hls_dir, sizeof(server.hls_dir), "%s/hls", server.thumb_dir) >=
+               (int)sizeof(server.hls_dir)) {
+        log_error("HLS directory path too long");
+        return 1;
+    }
+
     const char *data_candidates[] = {"./data", "../data", NULL};
     choose_path("DATA_DIR", data_candidates, ARRAY_SIZE(data_candidates),
                 server.data_dir, sizeof(server.data_dir), 1);
@@ -314,6 +428,133 @@ int main(void) {
     const char *ttl_env = getenv("SESSION_TTL_HOURS");
     server.session_ttl_hours = ttl_env ? atoi(ttl_env) : 24;
     if (server.session_ttl_hours <= 0) server.session_ttl_hours = 24;
+    const char *cache_size_env = getenv("SESSION_CACHE_SIZE");
+    server.session_cache_size = cache_size_env ? atoi(cache_size_env) : 4096;
+    if (server.session_cache_size <= 0) server.session_cache_size = 4096;
+    const char *cache_ttl_env = getenv("SESSION_CACHE_TTL_SEC");
+    server.session_cache_ttl_sec = cache_ttl_env ? atoi(cache_ttl_env) : 300;
+    if (server.session_cache_ttl_sec <= 0) server.session_cache_ttl_sec = 300;
+    // SESSION_MODE=stateless면 세션을 DB 대신 SESSION_KEYS로 서명한 쿠키에 담는다 (로그아웃 폐기는 노드별).
+    const char *session_mode_env = getenv("SESSION_MODE");
+    if (session_mode_env && strcmp(session_mode_env, "stateless") == 0) {
+        server.session_stateless = 1;
+    } else if (session_mode_env && strcmp(session_mode_env, "db") != 0) {
+        log_warn("Unknown SESSION_MODE '%s'; using db sessions", session_mode_env);
+    }
+    const char *session_keys_env = getenv("SESSION_KEYS");
+    if (session_keys_env) {
+        snprintf(server.session_keys, sizeof(server.session_keys), "%s", session_keys_env);
+    }
+    const char *revocation_env = getenv("SESSION_REVOCATION_MAX");
+    server.session_revocation_limit = revocation_env ? atoi(revocation_env) : 4096;
+    if (server.session_revocation_limit <= 0) server.session_revocation_limit = 4096;
+
+    // keep-alive 유휴 타임아웃(0이면 매 응답 후 종료)과 연결당 최대 요청 수
+    const char *keepalive_env = getenv("KEEPALIVE_TIMEOUT_SEC");
+    server.keepalive_timeout_sec = keepalive_env ? atoi(keepalive_env) : 15;
+    if (server.keepalive_timeout_sec < 0) server.keepalive_timeout_sec = 15;
+    // Caddy가 2초마다 /healthz를 보므로 기본 5초면 종료 전에 트래픽이 빠진다.
+    const char *drain_env = getenv("SHUTDOWN_DRAIN_SEC");
+    server.shutdown_drain_sec = drain_env ? atoi(drain_env) : 5;
+    if (server.shutdown_drain_sec < 0) server.shutdown_drain_sec = 5;
+    g_drain_sec = server.shutdown_drain_sec;
+    const char *max_requests_env = getenv("KEEPALIVE_MAX_REQUESTS");
+    server.keepalive_max_requests = max_requests_env ? atoi(max_requests_env) : 100;
+    if (server.keepalive_max_requests <= 0) server.keepalive_max_requests = 100;
+    // 시청 위치는 메모리에서 합친 뒤 주기적으로 한 트랜잭션에 기록한다.
+    const char *flush_interval_env = getenv("HISTORY_FLUSH_INTERVAL_MS");
+    server.history_flush_interval_ms = flush_interval_env ? atoi(flush_interval_env) : 1000;
+    if (server.history_flush_interval_ms <= 0) server.history_flush_interval_ms = 1000;
+    const char *flush_max_env = getenv("HISTORY_FLUSH_MAX_ENTRIES");
+    server.history_flush_max_entries = flush_max_env ? atoi(flush_max_env) : 256;
+    if (server.history_flush_max_entries <= 0) server.history_flush_max_entries = 256;
+    const char *static_refresh_env = getenv("STATIC_CACHE_REFRESH_SEC");
+    server.static_cache_refresh_sec = static_refresh_env ? atoi(static_refresh_env) : 2;
+    if (server.static_cache_refresh_sec <= 0) server.static_cache_refresh_sec = 2;
+    const char *thumb_workers_env = getenv("THUMBNAIL_WORKERS");
+    server.thumbnail_workers = thumb_workers_env ? atoi(thumb_workers_env) : 2;
+    if (server.thumbnail_workers <= 0) server.thumbnail_workers = 2;
+    // MP4_FASTSTART=1이면 moov가 mdat 뒤에 있는 파일을 썸네일 작업 스레드에서 앞으로 옮겨 다시 쓴다.
+    const char *faststart_env = getenv("MP4_FASTSTART");
+    server.mp4_faststart = faststart_env && atoi(faststart_env) > 0;
+    // 비디오 파일 핸들은 inode별로 공유해 열어 두고, 스트림은 평균 비트레이트로 몇 초 앞까지 미리 읽는다.
+    const char *media_cache_env = getenv("MEDIA_FD_CACHE_SIZE");
+    server.media_fd_cache_size = media_cache_env ? atoi(media_cache_env) : 128;
+    if (server.media_fd_cache_size < 0) server.media_fd_cache_size = 128;
+    const char *readahead_env = getenv("MEDIA_READAHEAD_SEC");
+    server.media_readahead_sec = readahead_env ? atoi(readahead_env) : 8;
+    if (server.media_readahead_sec <= 0) server.media_readahead_sec = 8;
+    // STREAM_PACING_FACTOR=N이면 스트림을 평균 비트레이트의 N배로 보낸다. 첫 STREAM_BURST_SEC초 분량은 제한 없이.
+    const char *pacing_env = getenv("STREAM_PACING_FACTOR");
+    server.stream_pacing_factor = pacing_env ? atof(pacing_env) : 0.0;
+    if (server.stream_pacing_factor < 0) server.stream_pacing_factor = 0.0;
+    const char *burst_env = getenv("STREAM_BURST_SEC");
+    server.stream_burst_sec = burst_env ? atoi(burst_env) : 10;
+    if (server.stream_burst_sec < 0) server.stream_burst_sec = 10;
+    const char *pacing_mode_env = getenv("STREAM_PACING_MODE");
+    server.stream_pacing_userspace = pacing_mode_env && strcmp(pacing_mode_env, "userspace") == 0;
+    if (server.stream_pacing_factor > 0) {
+        log_info("Stream pacing: %.2fx title bitrate after a %ds burst (%s)", server.stream_pacing_factor,
+                 server.stream_burst_sec, server.stream_pacing_userspace ? "userspace" : "SO_MAX_PACING_RATE");
+    }
+    // MEDIA_PIN_BUDGET_MB > 0이면 최근 전송량이 큰 타이틀을 이 예산 안에서 mlock한다 (RLIMIT_MEMLOCK 필요).
+    const char *pin_budget_env = getenv("MEDIA_PIN_BUDGET_MB");
+    server.media_pin_budget_mb = pin_budget_env ? atoi(pin_budget_env) : 0;
+    if (server.media_pin_budget_mb < 0) server.media_pin_budget_mb = 0;
+    // 워커 큐에 쌓일 수 있는 요청 수. 넘치면 이벤트 루프가 곧바로 503 + Retry-After로 거절한다.
+    const char *queue_limit_env = getenv("WORKER_QUEUE_LIMIT");
+    server.worker_queue_limit = queue_limit_env ? atoi(queue_limit_env) : 1024;
+    if (server.worker_queue_limit <= 0) server.worker_queue_limit = 1024;
+    // REACTOR_THREADS > 1이면 코어마다 SO_REUSEPORT 리스너와 epoll 루프를 하나씩 둔다.
+    const char *reactors_env = getenv("REACTOR_THREADS");
+    server.reactor_threads = reactors_env ? atoi(reactors_env) : 1;
+    if (server.reactor_threads <= 0) server.reactor_threads = 1;
+    if (server.reactor_threads > MAX_REACTORS) server.reactor_threads = MAX_REACTORS;
+    const char *pin_env = getenv("REACTOR_PIN_CPUS");
+    server.reactor_pin_cpus = server.reactor_threads > 1 && (!pin_env || atoi(pin_env) > 0);
+    const char *backlog_env = getenv("LISTEN_BACKLOG");
+    server.listen_backlog = backlog_env ? atoi(backlog_env) : 511;
+    if (server.listen_backlog <= 0) server.listen_backlog = 511;
+    // IO_BACKEND=io_uring이면 multishot accept와 splice 본문 전송을 링으로 처리한다 (그 외에는 epoll).
+    const char *backend_env = getenv("IO_BACKEND");
+    if (backend_env && (strcmp(backend_env, "io_uring") == 0 || strcmp(backend_env, "uring") == 0)) {
+#if HAVE_IO_URING
+        server.io_uring = 1;
+#else
+        log_warn("IO_BACKEND=%s requested but this build has no io_uring support (make IO_URING=1); using epoll",
+                 backend_env);
+#endif
+    }
+    // 비밀번호 해시는 요청 워커와 분리된 작은 풀에서 계산한다. 기본은 코어의 절반, 대기열은 스레드 수만큼.
+    long cpu_count = sysconf(_SC_NPROCESSORS_ONLN);
+    int default_hash_threads = cpu_count > 1 ? (int)(cpu_count / 2) : 1;
+    const char *hash_threads_env = getenv("AUTH_HASH_THREADS");
+    server.auth_hash_threads = hash_threads_env ? atoi(hash_threads_env) : default_hash_threads;
+    if (server.auth_hash_threads <= 0) server.auth_hash_threads = default_hash_threads;
+    const char *hash_queue_env = getenv("AUTH_HASH_QUEUE_LIMIT");
+    server.auth_hash_queue_limit = hash_queue_env ? atoi(hash_queue_env) : server.auth_hash_threads;
+    if (server.auth_hash_queue_limit <= 0) server.auth_hash_queue_limit = server.auth_hash_threads;
+    // METRICS_TOKEN이 있으면 /metrics는 "Authorization: Bearer <token>"을 요구한다 (Prometheus authorization 설정).
+    const char *metrics_token_env = getenv("METRICS_TOKEN");
+    if (metrics_token_env) {
+        snprintf(server.metrics_token, sizeof(server.metrics_token), "%s", metrics_token_env);
+    }
+    const char *admin_token_env = getenv("ADMIN_TOKEN");
+    if (admin_token_env) {
+        snprintf(server.admin_token, sizeof(server.admin_token), "%s", admin_token_env);
+    }
+    // ACCESS_LOG=경로(또는 "-"면 stderr)면 요청마다 JSON 한 줄을 남긴다. ACCESS_LOG_SAMPLE=N이면 N개 중 1개만.
+    const char *access_log_env = getenv("ACCESS_LOG");
+    if (access_log_env) {
+        snprintf(server.access_log_path, sizeof(server.access_log_path), "%s", access_log_env);
+    }
+    const char *access_sample_env = getenv("ACCESS_LOG_SAMPLE");
+    server.access_log_sample = access_sample_env ? atoi(access_sample_env) : 1;
+    if (server.access_log_sample <= 0) server.access_log_sample = 1;
+    // 여기부터 로그는 워커가 stderr를 기다리지 않도록 배경 스레드가 모아서 쓴다.
+    if (logger_start(&server) != 0) {
+        log_warn("Asynchronous logger unavailable; logging synchronously");
+    }
 
     if (db_init(&server.db, server.db_path) != 0) {
         log_error("Failed to open database: %s", db_errmsg(&server.db));
@@ -335,26 +576,46 @@ int main(void) {
         return 1;
     }
 
+    size_t worker_count = (size_t)sysconf(_SC_NPROCESSORS_ONLN);
+    if (worker_count == 0) worker_count = 4;
+    worker_count *= 2;
+
+    // WAL 모드에서 읽기를 병렬화하기 위해 워커 수만큼 읽기 전용 연결을 연다.
+    const char *readers_env = getenv("DB_READ_CONNECTIONS");
+    int reader_count = readers_env ? atoi(readers_env) : (int)worker_count;
+    if (reader_count < 0) reader_count = (int)worker_count;
+    if (reader_count > 0 && db_open_readers(&server.db, server.db_path, (size_t)reader_count) != 0) {
+        log_warn("Read connection pool unavailable; all queries will use the writer connection");
+    }
+
     if (auth_initialize(&server) != 0) {
         log_error("Failed to initialize auth");
         db_close(&server.db);
         return 1;
     }
+    // 실패하면 디스크에서 보내므로 서버 시작을 막지 않는다.
+    static_cache_initialize(&server);
+    // 초기 동기화가 바로 썸네일 작업을 넣을 수 있도록 라이브러리보다 먼저 띄운다.
+    if (ffmpeg_initialize(&server) != 0) {
+        log_error("Failed to initialize ffmpeg module");
+        db_close(&server.db);
+        return 1;
+    }
+    // 실패하면 요청마다 파일을 여는 기존 경로로 보내므로 서버 시작을 막지 않는다.
+    media_cache_initialize(&server);
     if (video_initialize(&server) != 0) {
         log_error("Failed to initialize video module");
         db_close(&server.db);
         return 1;
     }
-    if (ffmpeg_initialize(&server) != 0) {
-        log_error("Failed to initialize ffmpeg module");
+    if (history_initialize(&server) != 0) {
+        log_error("Failed to initialize history module");
         db_close(&server.db);
         return 1;
     }
 
-    size_t worker_count = (size_t)sysconf(_SC_NPROCESSORS_ONLN);
-    if (worker_count == 0) worker_count = 4;
-    worker_count *= 2;
-    if (thread_pool_init(&server.pool, worker_count) != 0) {
+    if (thread_pool_init(&server.pool, worker_count, (size_t)server.worker_queue_limit,
+                         server.reactor_pin_cpus) != 0) {
         log_error("Failed to init thread pool");
         db_close(&server.db);
         return 1;
@@ -362,189 +623,106 @@ int main(void) {
 
     // 라우터가 참조할 HTTP 엔드포인트 테이블 정의
     route_entry_t routes[] = {
-        {HTTP_POST, "/api/auth/login", auth_handle_login},
-        {HTTP_POST, "/api/auth/register", auth_handle_register},
-        {HTTP_POST, "/api/auth/logout", auth_handle_logout},
-        {HTTP_GET, "/api/auth/me", auth_handle_me},
-        {HTTP_GET, "/api/videos", video_handle_list},
-        {HTTP_GET, "/api/videos/:id/stream", video_handle_stream},
-        {HTTP_GET, "/api/videos/:id/thumbnail", video_handle_thumbnail},
-        {HTTP_GET, "/api/history", history_handle_get},
-        {HTTP_POST, "/api/history/:id", history_handle_update},
+        {HTTP_POST, "/api/auth/login", auth_handle_login, 1},
+        {HTTP_POST, "/api/auth/register", auth_handle_register, 1},
+        {HTTP_POST, "/api/auth/logout", auth_handle_logout, 1},
+        {HTTP_GET, "/api/auth/me", auth_handle_me, 0},
+        {HTTP_GET, "/api/videos", video_handle_list, 0},
+        {HTTP_GET, "/api/videos/:id/stream", video_handle_stream, 0},
+        {HTTP_GET, "/api/videos/:id/thumbnail", video_handle_thumbnail, 0},
+        {HTTP_GET, "/api/videos/:id/previews", video_handle_previews, 0},
+        {HTTP_GET, "/api/videos/:id/previews/sprite.jpg", video_handle_preview_sprite, 0},
+        {HTTP_GET, "/api/videos/:id/hls/master.m3u8", hls_handle_master, 0},
+        {HTTP_GET, "/api/videos/:id/hls/:version/:rendition/:file", hls_handle_file, 0},
+        {HTTP_GET, "/api/history", history_handle_get, 0},
+        {HTTP_POST, "/api/history/:id", history_handle_update, 0},
+        {HTTP_POST, "/api/admin/rescan", video_handle_rescan, 1},
+        {HTTP_GET, "/api/admin/sessions", auth_handle_session_stats, 0},
+        {HTTP_GET, "/api/admin/media", video_handle_media_stats, 0},
+        {HTTP_GET, "/metrics", metrics_handle_scrape, 0},
+        {HTTP_GET, "/healthz", handle_healthz, 0},
     };
-    router_set_routes(routes, ARRAY_SIZE(routes));
-
-    int listen_fd = create_listen_socket(server.port);
-    if (listen_fd < 0) {
-        log_error("Failed to create listen socket on port %d", server.port);
+    if (router_set_routes(routes, ARRAY_SIZE(routes)) != 0) {
+        log_error("Failed to compile route table");
         thread_pool_destroy(&server.pool);
         db_close(&server.db);
         return 1;
     }
-    server.listen_fd = listen_fd;
 
-    server.epoll_fd = -1; // non-Linux 환경에서는 poll()을 사용할 수 있으므로 기본값은 -1
-
-#if USE_EPOLL
-    // Linux 환경에서는 epoll로 대량 접속을 효율적으로 감지한다.
-    int epoll_fd = epoll_create1(0);
-    if (epoll_fd < 0) {
-        log_error("Failed to create epoll instance");
-        close(listen_fd);
-        thread_pool_destroy(&server.pool);
-        db_close(&server.db);
-        return 1;
+    // 리액터마다 자기 리스너와 epoll 집합을 갖는다. 연결은 받은 리액터에서 끝까지 처리된다.
+    size_t reactor_count = (size_t)server.reactor_threads;
+    g_pin_reactors = server.reactor_pin_cpus && cpu_count > 0;
+    size_t ready = 0;
+    for (; ready < reactor_count; ++ready) {
+        int listen_fd = create_listen_socket(server.port, server.listen_backlog, reactor_count > 1);
+        if (listen_fd < 0) {
+            log_error("Failed to create listen socket on port %d: %s", server.port, strerror(errno));
+            break;
+        }
+        if (reactor_init(&g_reactors[ready], &server, listen_fd, handle_client) != 0) {
+            close(listen_fd);
+            break;
+        }
+        g_reactor_cpus[ready] = cpu_count > 0 ? (int)(ready % (size_t)cpu_count) : 0;
     }
-    server.epoll_fd = epoll_fd;
-
-    struct epoll_event ev;
-    ev.events = EPOLLIN;
-    ev.data.fd = listen_fd;
-    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, listen_fd, &ev) < 0) {
-        log_error("epoll_ctl ADD listen fd failed");
-        close(epoll_fd);
-        close(listen_fd);
+    if (ready < reactor_count) {
+        for (size_t i = 0; i < ready; ++i) {
+            close(g_reactors[i].listen_fd);
+            reactor_destroy(&g_reactors[i]);
+        }
         thread_pool_destroy(&server.pool);
         db_close(&server.db);
         return 1;
     }
+    server.listen_fd = g_reactors[0].listen_fd;
+    server.epoll_fd = g_reactors[0].poll_fd; // non-Linux 환경에서는 poll()을 사용하므로 -1
 
-    log_info("Server listening on port %d", server.port);
-
-    struct epoll_event events[MAX_EVENTS];
-    while (g_running) {
-        // epoll_wait으로 새 연결/데이터 도착을 기다린다.
-        int n = epoll_wait(epoll_fd, events, MAX_EVENTS, 1000);
-        if (n < 0) {
-            if (errno == EINTR) {
-                continue;
-            }
-            log_error("epoll_wait error: %s", strerror(errno));
+    pthread_t reactor_threads[MAX_REACTORS];
+    size_t started = 1;
+    for (; started < reactor_count; ++started) {
+        if (pthread_create(&reactor_threads[started], NULL, reactor_thread_main, &g_reactors[started]) != 0) {
+            log_error("Failed to start reactor thread %zu", started);
+            g_running = 0;
             break;
         }
-        for (int i = 0; i < n; ++i) {
-            if (events[i].data.fd == listen_fd) {
-                for (;;) {
-                    struct sockaddr_in client_addr;
-                    socklen_t client_len = sizeof(client_addr);
-                    int client_fd = accept(listen_fd, (struct sockaddr *)&client_addr, &client_len);
-                    if (client_fd < 0) {
-                        if (errno == EAGAIN || errno == EWOULDBLOCK) {
-                            break;
-                        }
-                        log_warn("accept failed: %s", strerror(errno));
-                        break;
-                    }
-                    if (make_nonblocking(client_fd) != 0) {
-                        close(client_fd);
-                        continue;
-                    }
-                    struct epoll_event client_ev;
-                    client_ev.events = EPOLLIN;
-                    client_ev.data.fd = client_fd;
-                    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, client_fd, &client_ev) < 0) {
-                        log_warn("epoll_ctl ADD client failed: %s", strerror(errno));
-                        close(client_fd);
-                    }
-                }
-            } else {
-                int client_fd = events[i].data.fd;
-                epoll_ctl(epoll_fd, EPOLL_CTL_DEL, client_fd, NULL);
-                client_task_t *task = malloc(sizeof(client_task_t));
-                if (!task) {
-                    close(client_fd);
-                    continue;
-                }
-                task->server = &server;
-                task->fd = client_fd;
-                thread_pool_submit(&server.pool, handle_client, task);
-            }
-        }
     }
-
-    if (server.epoll_fd >= 0) {
-        close(epoll_fd);
-        server.epoll_fd = -1;
+    if (reactor_count > 1) {
+        log_info("Server listening on port %d with %zu reactors (SO_REUSEPORT%s, backlog %d)", server.port,
+                 reactor_count, g_pin_reactors ? ", pinned" : "", server.listen_backlog);
+    } else {
+        log_info("Server listening on port %d", server.port);
     }
-#else
-    // epoll을 쓸 수 없는 플랫폼(BSD, macOS 등)은 poll() 기반 루프를 사용한다.
-    log_info("Server listening on port %d", server.port);
-    struct pollfd fds[MAX_EVENTS];
-    nfds_t fd_count = 1;
-    memset(fds, 0, sizeof(fds));
-    fds[0].fd = listen_fd;
-    fds[0].events = POLLIN;
-
-    while (g_running) {
-        int n = poll(fds, fd_count, 1000);
-        if (n < 0) {
-            if (errno == EINTR) {
-                continue;
-            }
-            log_error("poll error: %s", strerror(errno));
-            break;
-        }
-        if (fds[0].revents & POLLIN) {
-            for (;;) {
-                struct sockaddr_in client_addr;
-                socklen_t client_len = sizeof(client_addr);
-                int client_fd = accept(listen_fd, (struct sockaddr *)&client_addr, &client_len);
-                if (client_fd < 0) {
-                    if (errno == EAGAIN || errno == EWOULDBLOCK) {
-                        break;
-                    }
-                    log_warn("accept failed: %s", strerror(errno));
-                    break;
-                }
-                if (make_nonblocking(client_fd) != 0) {
-                    close(client_fd);
-                    continue;
-                }
-                if (fd_count >= MAX_EVENTS) {
-                    log_warn("Too many open connections, dropping client");
-                    close(client_fd);
-                    continue;
-                }
-                fds[fd_count].fd = client_fd;
-                fds[fd_count].events = POLLIN;
-                fds[fd_count].revents = 0;
-                fd_count++;
-            }
-        }
-        for (nfds_t i = 1; i < fd_count;) {
-            if (fds[i].revents & POLLIN) {
-                int client_fd = fds[i].fd;
-                fds[i] = fds[fd_count - 1];
-                fd_count--;
-                client_task_t *task = malloc(sizeof(client_task_t));
-                if (!task) {
-                    close(client_fd);
-                    continue;
-                }
-                task->server = &server;
-                task->fd = client_fd;
-                thread_pool_submit(&server.pool, handle_client, task);
-                continue;
-            }
-            if (fds[i].revents & (POLLERR | POLLHUP | POLLNVAL)) {
-                close(fds[i].fd);
-                fds[i] = fds[fd_count - 1];
-                fd_count--;
-                continue;
-            }
-            fds[i].revents = 0;
-            i++;
-        }
+    if (g_pin_reactors) {
+        reactor_pin(&g_reactors[0], g_reactor_cpus[0]);
     }
-    for (nfds_t i = 1; i < fd_count; ++i) {
-        close(fds[i].fd);
+    reactor_run(&g_reactors[0], &g_running);
+    for (size_t i = 1; i < started; ++i) {
+        pthread_join(reactor_threads[i], NULL);
     }
-#endif
 
     log_info("Shutting down...");
-    close(listen_fd);
+    for (size_t i = 0; i < reactor_count; ++i) {
+        close(g_reactors[i].listen_fd);
+    }
     video_shutdown();
+    // 워처가 멈춘 뒤라 더 이상 썸네일 작업이 들어오지 않는다.
+    ffmpeg_shutdown();
+    static_cache_shutdown();
+    // 워커가 모두 멈춘 뒤에 남은 연결을 정리해야 반환 중인 연결과 경합하지 않는다.
     thread_pool_destroy(&server.pool);
+    for (size_t i = 0; i < reactor_count; ++i) {
+        reactor_destroy(&g_reactors[i]);
+    }
+    server.epoll_fd = -1;
+    // 연결이 모두 닫혀 빌려 간 파일 핸들이 반납된 뒤에 캐시를 비운다.
+    media_cache_shutdown();
+    router_shutdown();
+    // 버퍼에 남은 시청 위치를 DB를 닫기 전에 모두 기록한다.
+    history_shutdown(&server);
+    auth_shutdown(&server);
     db_close(&server.db);
+    // 라우트 이름을 쓰는 접근 로그가 남아 있을 수 있으므로 계측보다 먼저 비운다.
+    logger_shutdown();
+    metrics_shutdown();
     return 0;
 }
@@ -0,0 +1,542 @@
+// 비디오 원본 파일 핸들 캐시. 같은 inode를 보는 스트림은 FD 하나를 나눠 쓰고(sendfile/pread/splice는
+// 모두 명시적 오프셋을 쓰므로 파일 위치를 공유해도 된다), 아무도 쓰지 않는 핸들은 LRU로 보관했다가 닫는다.
+// 스트림은 비트레이트로 정한 폭만큼 재생 위치 앞을 WILLNEED로 미리 읽고, 고정 예산이 있으면
+// 최근 전송량이 큰 타이틀을 mmap + mlock으로 페이지 캐시에 붙잡아 둔다.
+#include "media_cache.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "utils.h"
+
+#define MEDIA_CACHE_BUCKETS 256
+#define MEDIA_READAHEAD_DEFAULT (4u * 1024 * 1024) // 길이를 모를 때의 미리 읽기 폭
+#define MEDIA_READAHEAD_MIN (1u * 1024 * 1024)
+#define MEDIA_READAHEAD_MAX (32u * 1024 * 1024)
+#define MEDIA_PIN_INTERVAL_SEC 10
+#define MEDIA_PIN_MAX_TITLES 32
+
+struct media_file {
+    int fd;
+    dev_t dev;
+    ino_t ino;
+    off_t size;
+    struct timespec mtime;
+    int video_id;
+    size_t readahead;      // 재생 위치 앞으로 미리 읽어 둘 바이트 수
+    int refs;              // lock 보호. 빌려 간 스트림 수 (고정 중이면 1을 더 잡고 있다)
+    int detached;          // 해시에서 빠짐 (파일이 바뀌었거나 종료 중). refs가 0이 되면 닫는다.
+    atomic_uint_least64_t bytes_served;
+    uint64_t score_base;   // 지난 점검 때의 bytes_served (고정 스레드 전용)
+    double score;          // 점검마다 절반으로 줄이는 최근 전송량
+    atomic_int pinned;     // mlock으로 고정됨 (미리 읽기가 필요 없다)
+    void *pin_addr;
+    struct media_file *hash_next;
+    struct media_file *lru_prev; // refs가 0일 때만 LRU에 있다 (앞이 최근)
+    struct media_file *lru_next;
+};
+
+typedef struct {
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+    media_file_t **buckets;   // NULL이면 캐시 비활성
+    size_t count;             // 해시에 있는 항목 수
+    size_t capacity;
+    media_file_t *lru_head;
+    media_file_t *lru_tail;
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t evictions;
+    atomic_uint_least64_t bytes_served;
+    int readahead_sec;
+    uint64_t pin_budget;
+    media_file_t *pinned[MEDIA_PIN_MAX_TITLES]; // 고정 스레드만 바꾸고, 통계는 lock 아래에서 읽는다
+    size_t pinned_count;
+    uint64_t pinned_bytes;
+    pthread_t thread;
+    int running;
+    int stop;
+} media_cache_t;
+
+static media_cache_t g_media = {.lock = PTHREAD_MUTEX_INITIALIZER, .wake = PTHREAD_COND_INITIALIZER};
+
+static size_t bucket_of(dev_t dev, ino_t ino) {
+    uint64_t h = ((uint64_t)dev * 0x9E3779B97F4A7C15ULL) ^ (uint64_t)ino;
+    h ^= h >> 29;
+    h *= 0xBF58476D1CE4E5B9ULL;
+    h ^= h >> 32;
+    return (size_t)(h % MEDIA_CACHE_BUCKETS);
+}
+
+// 캐시된 핸들이 지금 stat한 파일과 같은 내용인지 (제자리 수정이면 크기나 mtime이 바뀐다)
+static int same_version(const media_file_t *file, const struct stat *st) {
+    return file->size == st->st_size && file->mtime.tv_sec == st->st_mtim.tv_sec &&
+           file->mtime.tv_nsec == st->st_mtim.tv_nsec;
+}
+
+static media_file_t *find_locked(size_t bucket, const struct stat *st) {
+    for (media_file_t *file = g_media.buckets[bucket]; file; file = file->hash_next) {
+        if (file->dev == st->st_dev && file->ino == st->st_ino) {
+            return file;
+        }
+    }
+    return NULL;
+}
+
+static void lru_remove(media_file_t *file) {
+    if (file->lru_prev) file->lru_prev->lru_next = file->lru_next;
+    else g_media.lru_head = file->lru_next;
+    if (file->lru_next) file->lru_next->lru_prev = file->lru_prev;
+    else g_media.lru_tail = file->lru_prev;
+    file->lru_prev = file->lru_next = NULL;
+}
+
+static void lru_push_front(media_file_t *file) {
+    file->lru_prev = NULL;
+    file->lru_next = g_media.lru_head;
+    if (g_media.lru_head) g_media.lru_head->lru_prev = file;
+    g_media.lru_head = file;
+    if (!g_media.lru_tail) g_media.lru_tail = file;
+}
+
+static void hash_remove(media_file_t *file) {
+    media_file_t **link = &g_media.buckets[bucket_of(file->dev, file->ino)];
+    while (*link && *link != file) {
+        link = &(*link)->hash_next;
+    }
+    if (*link) {
+        *link = file->hash_next;
+        g_media.count--;
+    }
+    file->hash_next = NULL;
+}
+
+static void destroy_file(media_file_t *file) {
+    close(file->fd);
+    free(file);
+}
+
+// 해시에서 뺀다. 쓰는 스트림이 없으면 바로 닫고, 있으면 마지막 반납 때 닫힌다.
+static void detach_locked(media_file_t *file) {
+    hash_remove(file);
+    file->detached = 1;
+    if (file->refs == 0) {
+        lru_remove(file);
+        destroy_file(file);
+    }
+}
+
+// 용량을 넘으면 쓰이지 않는 핸들을 오래된 것부터 닫는다. 빌려 간 핸들은 건드리지 않는다.
+static void evict_locked(void) {
+    while (g_media.count > g_media.capacity && g_media.lru_tail) {
+        media_file_t *victim = g_media.lru_tail;
+        lru_remove(victim);
+        hash_remove(victim);
+        g_media.evictions++;
+        destroy_file(victim);
+    }
+}
+
+// 평균 비트레이트(크기/길이)로 readahead_sec초 분량을 미리 읽기 폭으로 정한다.
+static size_t readahead_for(off_t size, int duration_seconds) {
+    if (duration_seconds <= 0 || size <= 0) {
+        return MEDIA_READAHEAD_DEFAULT;
+    }
+    uint64_t window = (uint64_t)size / (uint64_t)duration_seconds * (uint64_t)g_media.readahead_sec;
+    if (window < MEDIA_READAHEAD_MIN) window = MEDIA_READAHEAD_MIN;
+    if (window > MEDIA_READAHEAD_MAX) window = MEDIA_READAHEAD_MAX;
+    return (size_t)window;
+}
+
+media_file_t *media_cache_acquire(const char *path, const struct stat *st, int video_id, int duration_seconds) {
+    if (!path || !st) {
+        return NULL;
+    }
+    pthread_mutex_lock(&g_media.lock);
+    if (!g_media.buckets) {
+        pthread_mutex_unlock(&g_media.lock);
+        return NULL;
+    }
+    size_t bucket = bucket_of(st->st_dev, st->st_ino);
+    media_file_t *file = find_locked(bucket, st);
+    if (file && !same_version(file, st)) {
+        detach_locked(file);
+        file = NULL;
+    }
+    if (file) {
+        if (file->refs++ == 0) {
+            lru_remove(file);
+        }
+        if (duration_seconds > 0) {
+            file->readahead = readahead_for(file->size, duration_seconds);
+        }
+        g_media.hits++;
+        pthread_mutex_unlock(&g_media.lock);
+        return file;
+    }
+    g_media.misses++;
+    pthread_mutex_unlock(&g_media.lock);
+
+    // open은 잠금 밖에서 한다. 그사이 다른 스트림이 같은 파일을 넣었으면 그쪽을 쓴다.
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return NULL;
+    }
+    struct stat fst;
+    if (fstat(fd, &fst) != 0 || fst.st_dev != st->st_dev || fst.st_ino != st->st_ino) {
+        close(fd); // stat과 open 사이에 파일이 바뀌었다. 호출자가 검증자를 다시 만들어야 한다.
+        return NULL;
+    }
+    media_file_t *created = calloc(1, sizeof(*created));
+    if (!created) {
+        close(fd);
+        return NULL;
+    }
+    // 같은 struct file을 공유하므로 커널 readahead 창도 모든 스트림에 대해 커진다.
+    (void)posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+    created->fd = fd;
+    created->dev = fst.st_dev;
+    created->ino = fst.st_ino;
+    created->size = fst.st_size;
+    created->mtime = fst.st_mtim;
+    created->video_id = video_id;
+    created->readahead = readahead_for(fst.st_size, duration_seconds);
+    created->refs = 1;
+    atomic_init(&created->bytes_served, 0);
+    atomic_init(&created->pinned, 0);
+
+    pthread_mutex_lock(&g_media.lock);
+    if (!g_media.buckets) {
+        pthread_mutex_unlock(&g_media.lock);
+        destroy_file(created);
+        return NULL;
+    }
+    media_file_t *existing = find_locked(bucket, &fst);
+    if (existing && same_version(existing, &fst)) {
+        if (existing->refs++ == 0) {
+            lru_remove(existing);
+        }
+        pthread_mutex_unlock(&g_media.lock);
+        destroy_file(created);
+        return existing;
+    }
+    if (existing) {
+        detach_locked(existing);
+    }
+    created->hash_next = g_media.buckets[bucket];
+    g_media.buckets[bucket] = created;
+    g_media.count++;
+    evict_locked();
+    pthread_mutex_unlock(&g_media.lock);
+    if (!same_version(created, st)) {
+        media_cache_release(created);
+        return NULL;
+    }
+    return created;
+}
+
+void media_cache_release(media_file_t *file) {
+    if (!file) return;
+    pthread_mutex_lock(&g_media.lock);
+    if (--file->refs == 0) {
+        if (file->detached) {
+            destroy_file(file);
+        } else {
+            lru_push_front(file);
+            evict_locked();
+        }
+    }
+    pthread_mutex_unlock(&g_media.lock);
+}
+
+int media_file_fd(const media_file_t *file) {
+    return file ? file->fd : -1;
+}
+
+off_t media_file_size(const media_file_t *file) {
+    return file ? file->size : 0;
+}
+
+void media_file_progress(media_file_t *file, off_t offset, off_t end, size_t sent, off_t *prefetched) {
+    if (!file) return;
+    if (sent > 0) {
+        atomic_fetch_add_explicit(&file->bytes_served, sent, memory_order_relaxed);
+        atomic_fetch_add_explicit(&g_media.bytes_served, sent, memory_order_relaxed);
+    }
+    if (!prefetched || offset >= end || atomic_load_explicit(&file->pinned, memory_order_relaxed)) {
+        return;
+    }
+    if (*prefetched < offset) {
+        *prefetched = offset; // 탐색으로 앞으로 건너뛰었다.
+    }
+    // 남은 선행 구간이 폭의 절반 아래로 줄었을 때만 다음 구간을 예약해 시스템 콜 수를 줄인다.
+    if (*prefetched >= end || *prefetched - offset > (off_t)(file->readahead / 2)) {
+        return;
+    }
+    off_t stop = offset + (off_t)file->readahead;
+    if (stop > end) stop = end;
+    if (stop > *prefetched) {
+        (void)posix_fadvise(file->fd, *prefetched, stop - *prefetched, POSIX_FADV_WILLNEED);
+        *prefetched = stop;
+    }
+}
+
+static int compare_score_desc(const void *a, const void *b) {
+    const media_file_t *fa = *(media_file_t *const *)a;
+    const media_file_t *fb = *(media_file_t *const *)b;
+    return (fa->score < fb->score) - (fa->score > fb->score);
+}
+
+// 파일 전체를 읽기 전용으로 매핑해 mlock한다. 권한/한도 부족이면 -2로 알려 고정을 멈추게 한다.
+static int pin_file(media_file_t *file) {
+    void *addr = mmap(NULL, (size_t)file->size, PROT_READ, MAP_SHARED, file->fd, 0);
+    if (addr == MAP_FAILED) {
+        log_warn("Media pin: mmap failed for video %d: %s", file->video_id, strerror(errno));
+        return -1;
+    }
+#ifdef MADV_HUGEPAGE
+    // 파일 매핑의 대형 페이지는 커널 설정(READ_ONLY_THP_FOR_FS)에 달렸으므로 실패해도 무시한다.
+    (void)madvise(addr, (size_t)file->size, MADV_HUGEPAGE);
+#endif
+    if (mlock(addr, (size_t)file->size) != 0) {
+        int err = errno;
+        munmap(addr, (size_t)file->size);
+        log_warn("Media pin: mlock failed for video %d (%lld bytes): %s", file->video_id,
+                 (long long)file->size, strerror(err));
+        return (err == EPERM || err == ENOMEM || err == EAGAIN) ? -2 : -1;
+    }
+    file->pin_addr = addr;
+    atomic_store(&file->pinned, 1);
+    return 0;
+}
+
+static void unpin_file(media_file_t *file) {
+    atomic_store(&file->pinned, 0);
+    munlock(file->pin_addr, (size_t)file->size);
+    munmap(file->pin_addr, (size_t)file->size);
+    file->pin_addr = NULL;
+}
+
+// 최근 전송량 순으로 예산 안에 드는 타이틀을 고른다. 고정/해제(mlock은 디스크를 읽는다)는 잠금 밖에서 한다.
+static int pin_sweep(void) {
+    media_file_t *to_pin[MEDIA_PIN_MAX_TITLES];
+    media_file_t *to_unpin[MEDIA_PIN_MAX_TITLES];
+    size_t pin_count = 0;
+    size_t unpin_count = 0;
+
+    pthread_mutex_lock(&g_media.lock);
+    media_file_t **candidates = g_media.count ? malloc(g_media.count * sizeof(*candidates)) : NULL;
+    size_t candidate_count = 0;
+    for (size_t b = 0; b < MEDIA_CACHE_BUCKETS; ++b) {
+        for (media_file_t *file = g_media.buckets[b]; file; file = file->hash_next) {
+            uint64_t served = atomic_load_explicit(&file->bytes_served, memory_order_relaxed);
+            file->score = file->score / 2 + (double)(served - file->score_base);
+            file->score_base = served;
+            if (candidates && file->score >= 1.0 && file->size > 0) {
+                candidates[candidate_count++] = file;
+            }
+        }
+    }
+    if (candidate_count > 1) {
+        qsort(candidates, candidate_count, sizeof(*candidates), compare_score_desc);
+    }
+    size_t wanted_count = 0;
+    uint64_t remaining = g_media.pin_budget;
+    for (size_t i = 0; i < candidate_count && wanted_count < MEDIA_PIN_MAX_TITLES; ++i) {
+        if ((uint64_t)candidates[i]->size <= remaining) {
+            remaining -= (uint64_t)candidates[i]->size;
+            candidates[wanted_count++] = candidates[i];
+        }
+    }
+    size_t kept = 0;
+    for (size_t i = 0; i < g_media.pinned_count; ++i) {
+        media_file_t *file = g_media.pinned[i];
+        int wanted = 0;
+        for (size_t j = 0; j < wanted_count && !file->detached; ++j) {
+            wanted = wanted || candidates[j] == file;
+        }
+        if (wanted) {
+            g_media.pinned[kept++] = file;
+        } else {
+            to_unpin[unpin_count++] = file;
+            g_media.pinned_bytes -= (uint64_t)file->size;
+        }
+    }
+    g_media.pinned_count = kept;
+    for (size_t j = 0; j < wanted_count; ++j) {
+        media_file_t *file = candidates[j];
+        if (!atomic_load(&file->pinned) && pin_count + kept < MEDIA_PIN_MAX_TITLES) {
+            if (file->refs++ == 0) {
+                lru_remove(file); // 고정 중에는 LRU로 닫히지 않게 참조를 하나 잡는다.
+            }
+            to_pin[pin_count++] = file;
+        }
+    }
+    pthread_mutex_unlock(&g_media.lock);
+    free(candidates);
+
+    for (size_t i = 0; i < unpin_count; ++i) {
+        log_info("Media pin: released video %d", to_unpin[i]->video_id);
+        unpin_file(to_unpin[i]);
+        media_cache_release(to_unpin[i]);
+    }
+    int disable = 0;
+    for (size_t i = 0; i < pin_count; ++i) {
+        media_file_t *file = to_pin[i];
+        int rc = disable ? -1 : pin_file(file);
+        if (rc != 0) {
+            disable = disable || rc == -2;
+            media_cache_release(file);
+            continue;
+        }
+        log_info("Media pin: locked video %d (%lld bytes) in memory", file->video_id, (long long)file->size);
+        pthread_mutex_lock(&g_media.lock);
+        g_media.pinned[g_media.pinned_count++] = file;
+        g_media.pinned_bytes += (uint64_t)file->size;
+        pthread_mutex_unlock(&g_media.lock);
+    }
+    if (disable) {
+        log_warn("Media pin: disabled; raise RLIMIT_MEMLOCK (ulimit -l) or grant CAP_IPC_LOCK to use MEDIA_PIN_BUDGET_MB");
+        return -1;
+    }
+    return 0;
+}
+
+// 고정된 타이틀을 모두 풀어 준다 (종료 또는 고정 중단 시).
+static void unpin_all(void) {
+    pthread_mutex_lock(&g_media.lock);
+    size_t count = g_media.pinned_count;
+    media_file_t *pinned[MEDIA_PIN_MAX_TITLES];
+    memcpy(pinned, g_media.pinned, count * sizeof(*pinned));
+    g_media.pinned_count = 0;
+    g_media.pinned_bytes = 0;
+    pthread_mutex_unlock(&g_media.lock);
+    for (size_t i = 0; i < count; ++i) {
+        unpin_file(pinned[i]);
+        media_cache_release(pinned[i]);
+    }
+}
+
+static void *media_pin_loop(void *arg) {
+    (void)arg;
+    pthread_mutex_lock(&g_media.lock);
+    while (!g_media.stop) {
+        struct timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_sec += MEDIA_PIN_INTERVAL_SEC;
+        while (!g_media.stop &&
+               pthread_cond_timedwait(&g_media.wake, &g_media.lock, &deadline) != ETIMEDOUT) {
+        }
+        if (g_media.stop) {
+            break;
+        }
+        pthread_mutex_unlock(&g_media.lock);
+        int rc = pin_sweep();
+        pthread_mutex_lock(&g_media.lock);
+        if (rc != 0) {
+            break;
+        }
+    }
+    pthread_mutex_unlock(&g_media.lock);
+    unpin_all();
+    return NULL;
+}
+
+// 서버 시작 시 핸들 캐시를 만들고, 고정 예산이 있으면 고정 스레드를 띄운다.
+int media_cache_initialize(server_ctx_t *server) {
+    pthread_mutex_lock(&g_media.lock);
+    g_media.capacity = server->media_fd_cache_size > 0 ? (size_t)server->media_fd_cache_size : 0;
+    g_media.readahead_sec = server->media_readahead_sec;
+    g_media.pin_budget = (uint64_t)server->media_pin_budget_mb * 1024 * 1024;
+    g_media.stop = 0;
+    if (g_media.capacity > 0) {
+        g_media.buckets = calloc(MEDIA_CACHE_BUCKETS, sizeof(*g_media.buckets));
+    }
+    int enabled = g_media.buckets != NULL;
+    pthread_mutex_unlock(&g_media.lock);
+    if (!enabled) {
+        if (g_media.capacity > 0) {
+            log_warn("Media handle cache unavailable; streams will open files per request");
+        }
+        return g_media.capacity > 0 ? -1 : 0;
+    }
+    if (g_media.pin_budget > 0) {
+        if (pthread_create(&g_media.thread, NULL, media_pin_loop, NULL) != 0) {
+            log_warn("Media pin thread is not running; hot titles will not be locked in memory");
+        } else {
+            g_media.running = 1;
+        }
+    }
+    log_info("Media handle cache: %zu files, %ds readahead, pin budget %d MB", g_media.capacity,
+             g_media.readahead_sec, server->media_pin_budget_mb);
+    return 0;
+}
+
+void media_cache_get_stats(media_cache_stats_t *out) {
+    memset(out, 0, sizeof(*out));
+    pthread_mutex_lock(&g_media.lock);
+    out->entries = g_media.count;
+    out->capacity = g_media.capacity;
+    out->hits = g_media.hits;
+    out->misses = g_media.misses;
+    out->evictions = g_media.evictions;
+    out->pinned_titles = g_media.pinned_count;
+    out->pinned_bytes = g_media.pinned_bytes;
+    out->pin_budget_bytes = g_media.pin_budget;
+    for (size_t b = 0; g_media.buckets && b < MEDIA_CACHE_BUCKETS; ++b) {
+        for (media_file_t *file = g_media.buckets[b]; file; file = file->hash_next) {
+            media_title_stats_t title = {
+                .video_id = file->video_id,
+                .bytes_served = atomic_load_explicit(&file->bytes_served, memory_order_relaxed),
+                .pinned = atomic_load_explicit(&file->pinned, memory_order_relaxed),
+            };
+            if (file->refs > title.pinned) {
+                out->in_use++; // 고정 스레드가 잡은 참조는 빼고 센다.
+            }
+            if (title.bytes_served == 0) {
+                continue;
+            }
+            // 상위 몇 개만 남기는 삽입 정렬
+            size_t pos = out->top_count;
+            while (pos > 0 && out->top[pos - 1].bytes_served < title.bytes_served) {
+                if (pos < MEDIA_CACHE_TOP_TITLES) out->top[pos] = out->top[pos - 1];
+                pos--;
+            }
+            if (pos < MEDIA_CACHE_TOP_TITLES) {
+                out->top[pos] = title;
+                if (out->top_count < MEDIA_CACHE_TOP_TITLES) out->top_count++;
+            }
+        }
+    }
+    pthread_mutex_unlock(&g_media.lock);
+    out->bytes_served = atomic_load_explicit(&g_media.bytes_served, memory_order_relaxed);
+}
+
+// 서버 종료 시 고정을 풀고 쓰이지 않는 핸들을 닫는다. 아직 빌려 간 핸들은 반납 때 닫힌다.
+void media_cache_shutdown(void) {
+    if (g_media.running) {
+        pthread_mutex_lock(&g_media.lock);
+        g_media.stop = 1;
+        pthread_cond_broadcast(&g_media.wake);
+        pthread_mutex_unlock(&g_media.lock);
+        pthread_join(g_media.thread, NULL);
+        g_media.running = 0;
+    }
+    pthread_mutex_lock(&g_media.lock);
+    for (size_t b = 0; g_media.buckets && b < MEDIA_CACHE_BUCKETS; ++b) {
+        while (g_media.buckets[b]) {
+            detach_locked(g_media.buckets[b]);
+        }
+    }
+    free(g_media.buckets);
+    g_media.buckets = NULL;
+    pthread_mutex_unlock(&g_media.lock);
+}
@@ -0,0 +1,397 @@
+// 요청 경로의 계측. 스레드마다 자기 카운터 묶음(shard)에만 쓰므로 기록에는 잠금도 원자적 RMW도 없다
+// (단일 작성자가 relaxed load/store로 올리고, /metrics는 모든 shard를 relaxed로 읽어 합친다).
+// 지연 시간은 HDR 방식의 로그-선형 버킷(2의 거듭제곱 구간을 4칸으로 나눔)에 마이크로초 단위로 쌓는다.
+#include "metrics.h"
+
+#include <openssl/crypto.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "ffmpeg.h"
+#include "router.h"
+#include "utils.h"
+
+#define HIST_SUB_BITS 2
+#define HIST_SUB (1 << HIST_SUB_BITS)
+#define HIST_MAX_EXP 30 // 2^30us(약 18분)를 넘는 값은 마지막 칸에 모은다
+#define HIST_BUCKETS (HIST_SUB + (HIST_MAX_EXP - HIST_SUB_BITS + 1) * HIST_SUB)
+#define METRICS_JOB_KINDS 4
+#define METRICS_STATUS_CLASSES 5 // 1xx..5xx
+
+typedef _Atomic uint64_t metrics_counter_t;
+
+typedef struct {
+    metrics_counter_t counts[HIST_BUCKETS];
+    metrics_counter_t sum_us;
+} metrics_hist_t;
+
+typedef struct metrics_shard {
+    metrics_hist_t routes[METRICS_MAX_ROUTES];
+    metrics_counter_t route_status[METRICS_MAX_ROUTES][METRICS_STATUS_CLASSES];
+    metrics_hist_t jobs[METRICS_JOB_KINDS];
+    metrics_counter_t body_bytes[METRICS_BODY_KINDS];
+    metrics_counter_t streams_finished;
+    metrics_counter_t connections_opened;
+    metrics_counter_t connections_closed;
+    metrics_counter_t db_waits[2];   // [0] 읽기 풀, [1] 쓰기 잠금
+    metrics_counter_t db_wait_us[2];
+    struct metrics_shard *next;
+} metrics_shard_t;
+
+typedef struct {
+    char method[8];
+    char pattern[128];
+} metrics_route_t;
+
+// 라우트 이름은 시작 시에만 등록되고, 개수는 release/acquire로 공개한다.
+static metrics_route_t g_routes[METRICS_MAX_ROUTES] = {
+    [METRICS_ROUTE_STATIC] = {"GET", "static"},
+    [METRICS_ROUTE_UNMATCHED] = {"ANY", "unmatched"},
+};
+static _Atomic int g_route_count = 2;
+static _Atomic(metrics_shard_t *) g_shards = NULL;
+static _Thread_local metrics_shard_t *t_shard = NULL;
+
+static const char *const k_job_names[METRICS_JOB_KINDS] = {
+    [FFMPEG_JOB_POSTER] = "poster",
+    [FFMPEG_JOB_PREVIEWS] = "previews",
+    [FFMPEG_JOB_FASTSTART] = "faststart",
+    [FFMPEG_JOB_HLS] = "hls",
+};
+static const char *const k_body_names[METRICS_BODY_KINDS] = {"sendfile", "splice", "copy"};
+
+// 이 스레드의 shard. 처음 한 번만 할당해 전역 목록 앞에 CAS로 넣는다 (스레드가 끝나도 남겨 둔다).
+static metrics_shard_t *local_shard(void) {
+    if (t_shard) {
+        return t_shard;
+    }
+    metrics_shard_t *shard = calloc(1, sizeof(*shard));
+    if (!shard) {
+        return NULL;
+    }
+    metrics_shard_t *head = atomic_load(&g_shards);
+    do {
+        shard->next = head;
+    } while (!atomic_compare_exchange_weak(&g_shards, &head, shard));
+    t_shard = shard;
+    return shard;
+}
+
+// 단일 작성자 카운터 증가: 읽는 쪽이 찢어진 값을 보지 않을 만큼만 원자적이면 된다.
+static inline void counter_add(metrics_counter_t *counter, uint64_t value) {
+    atomic_store_explicit(counter, atomic_load_explicit(counter, memory_order_relaxed) + value,
+                          memory_order_relaxed);
+}
+
+static inline uint64_t counter_get(metrics_counter_t *counter) {
+    return atomic_load_explicit(counter, memory_order_relaxed);
+}
+
+static size_t hist_bucket(uint64_t us) {
+    if (us < HIST_SUB) {
+        return (size_t)us;
+    }
+    int exp = 63 - __builtin_clzll(us);
+    if (exp > HIST_MAX_EXP) {
+        return HIST_BUCKETS - 1;
+    }
+    size_t sub = (size_t)(us >> (exp - HIST_SUB_BITS)) & (HIST_SUB - 1);
+    return HIST_SUB + (size_t)(exp - HIST_SUB_BITS) * HIST_SUB + sub;
+}
+
+static void hist_record(metrics_hist_t *hist, uint64_t us) {
+    counter_add(&hist->counts[hist_bucket(us)], 1);
+    counter_add(&hist->sum_us, us);
+}
+
+uint64_t metrics_now_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + (uint64_t)ts.tv_nsec / 1000;
+}
+
+int metrics_register_route(const char *method, const char *pattern) {
+    int count = atomic_load_explicit(&g_route_count, memory_order_acquire);
+    for (int i = 0; i < count; ++i) {
+        if (strcmp(g_routes[i].method, method) == 0 && strcmp(g_routes[i].pattern, pattern) == 0) {
+            return i;
+        }
+    }
+    if (count >= METRICS_MAX_ROUTES) {
+        return -1;
+    }
+    snprintf(g_routes[count].method, sizeof(g_routes[count].method), "%s", method);
+    snprintf(g_routes[count].pattern, sizeof(g_routes[count].pattern), "%s", pattern);
+    atomic_store_explicit(&g_route_count, count + 1, memory_order_release);
+    return count;
+}
+
+const char *metrics_route_pattern(int route_id) {
+    int count = atomic_load_explicit(&g_route_count, memory_order_acquire);
+    return route_id >= 0 && route_id < count ? g_routes[route_id].pattern : NULL;
+}
+
+void metrics_observe_request(int route_id, int status, uint64_t elapsed_us) {
+    metrics_shard_t *shard = local_shard();
+    if (!shard || route_id < 0 || route_id >= METRICS_MAX_ROUTES) {
+        return;
+    }
+    hist_record(&shard->routes[route_id], elapsed_us);
+    if (status >= 100 && status < 600) {
+        counter_add(&shard->route_status[route_id][status / 100 - 1], 1);
+    }
+}
+
+void metrics_add_body_bytes(metrics_body_kind_t kind, size_t bytes) {
+    metrics_shard_t *shard = bytes ? local_shard() : NULL;
+    if (shard && (unsigned)kind < METRICS_BODY_KINDS) {
+        counter_add(&shard->body_bytes[kind], bytes);
+    }
+}
+
+void metrics_stream_finished(void) {
+    metrics_shard_t *shard = local_shard();
+    if (shard) counter_add(&shard->streams_finished, 1);
+}
+
+void metrics_connection_opened(void) {
+    metrics_shard_t *shard = local_shard();
+    if (shard) counter_add(&shard->connections_opened, 1);
+}
+
+void metrics_connection_closed(void) {
+    metrics_shard_t *shard = local_shard();
+    if (shard) counter_add(&shard->connections_closed, 1);
+}
+
+void metrics_add_db_wait(int writer, uint64_t waited_us) {
+    metrics_shard_t *shard = local_shard();
+    if (shard) {
+        counter_add(&shard->db_waits[writer ? 1 : 0], 1);
+        counter_add(&shard->db_wait_us[writer ? 1 : 0], waited_us);
+    }
+}
+
+void metrics_observe_job(int kind, uint64_t elapsed_us) {
+    metrics_shard_t *shard = local_shard();
+    if (shard && kind >= 0 && kind < METRICS_JOB_KINDS) {
+        hist_record(&shard->jobs[kind], elapsed_us);
+    }
+}
+
+// 모든 shard의 같은 히스토그램을 합친다. hist_of는 shard에서 그 히스토그램을 고른다.
+static uint64_t hist_sum(metrics_shard_t *shards, metrics_hist_t *(*hist_of)(metrics_shard_t *, int), int index,
+                         uint64_t counts[HIST_BUCKETS], uint64_t *sum_us) {
+    memset(counts, 0, HIST_BUCKETS * sizeof(uint64_t));
+    *sum_us = 0;
+    uint64_t total = 0;
+    for (metrics_shard_t *shard = shards; shard; shard = shard->next) {
+        metrics_hist_t *hist = hist_of(shard, index);
+        for (size_t b = 0; b < HIST_BUCKETS; ++b) {
+            uint64_t n = counter_get(&hist->counts[b]);
+            counts[b] += n;
+            total += n;
+        }
+        *sum_us += counter_get(&hist->sum_us);
+    }
+    return total;
+}
+
+static metrics_hist_t *route_hist(metrics_shard_t *shard, int index) {
+    return &shard->routes[index];
+}
+
+static metrics_hist_t *job_hist(metrics_shard_t *shard, int index) {
+    return &shard->jobs[index];
+}
+
+// 누적 버킷을 2의 거듭제곱 경계(초 단위 le)마다 내보낸다. 마지막 구간은 +Inf로만 나타낸다.
+static int emit_histogram(string_builder_t *sb, const char *name, const char *labels, const uint64_t counts[HIST_BUCKETS],
+                          uint64_t total, uint64_t sum_us) {
+    uint64_t cumulative = 0;
+    size_t bucket = 0;
+    for (int exp = HIST_SUB_BITS - 1; exp < HIST_MAX_EXP; ++exp) {
+        size_t end = exp < HIST_SUB_BITS ? HIST_SUB : HIST_SUB + (size_t)(exp - HIST_SUB_BITS + 1) * HIST_SUB;
+        for (; bucket < end; ++bucket) {
+            cumulative += counts[bucket];
+        }
+        if (sb_append(sb, "%s_bucket{%s,le=\"%.6f\"} %llu\n", name, labels, (double)(1ULL << (exp + 1)) / 1e6,
+                      (unsigned long long)cumulative) != 0) {
+            return -1;
+        }
+    }
+    return sb_append(sb, "%s_bucket{%s,le=\"+Inf\"} %llu\n%s_sum{%s} %.6f\n%s_count{%s} %llu\n", name, labels,
+                     (unsigned long long)total, name, labels, (double)sum_us / 1e6, name, labels,
+                     (unsigned long long)total);
+}
+
+// 라벨 값 안의 역슬래시/따옴표를 이스케이프한다 (라우트 패턴은 보통 둘 다 없다).
+static void label_value(char *out, size_t out_len, const char *value) {
+    size_t used = 0;
+    for (const char *p = value; *p && used + 2 < out_len; ++p) {
+        if (*p == '\\' || *p == '"') {
+            out[used++] = '\\';
+        }
+        out[used++] = *p;
+    }
+    out[used] = '\0';
+}
+
+static int emit_scrape(string_builder_t *sb, server_ctx_t *server) {
+    metrics_shard_t *shards = atomic_load(&g_shards);
+    int route_count = atomic_load_explicit(&g_route_count, memory_order_acquire);
+    uint64_t counts[HIST_BUCKETS];
+    uint64_t sum_us = 0;
+    char labels[256];
+    char pattern[160];
+
+    if (sb_append(sb, "# HELP ott_http_requests_total Requests handled, by route and status class.\n"
+                      "# TYPE ott_http_requests_total counter\n") != 0) {
+        return -1;
+    }
+    for (int r = 0; r < route_count; ++r) {
+        label_value(pattern, sizeof(pattern), g_routes[r].pattern);
+        for (int c = 0; c < METRICS_STATUS_CLASSES; ++c) {
+            uint64_t n = 0;
+            for (metrics_shard_t *shard = shards; shard; shard = shard->next) {
+                n += counter_get(&shard->route_status[r][c]);
+            }
+            if (n > 0 && sb_append(sb, "ott_http_requests_total{method=\"%s\",route=\"%s\",code=\"%dxx\"} %llu\n",
+                                   g_routes[r].method, pattern, c + 1, (unsigned long long)n) != 0) {
+                return -1;
+            }
+        }
+    }
+    if (sb_append(sb, "# HELP ott_http_request_duration_seconds Time from request dispatch until the response "
+                      "(or the headers of a streamed body) was sent.\n"
+                      "# TYPE ott_http_request_duration_seconds histogram\n") != 0) {
+        return -1;
+    }
+    for (int r = 0; r < route_count; ++r) {
+        uint64_t total = hist_sum(shards, route_hist, r, counts, &sum_us);
+        if (total == 0) {
+            continue; // 호출된 적 없는 라우트는 시계열을 만들지 않는다.
+        }
+        label_value(pattern, sizeof(pattern), g_routes[r].pattern);
+        snprintf(labels, sizeof(labels), "method=\"%s\",route=\"%s\"", g_routes[r].method, pattern);
+        if (emit_histogram(sb, "ott_http_request_duration_seconds", labels, counts, total, sum_us) != 0) {
+            return -1;
+        }
+    }
+
+    uint64_t body[METRICS_BODY_KINDS] = {0};
+    uint64_t streams = 0, opened = 0, closed = 0;
+    uint64_t db_waits[2] = {0}, db_wait_us[2] = {0};
+    for (metrics_shard_t *shard = shards; shard; shard = shard->next) {
+        for (int k = 0; k < METRICS_BODY_KINDS; ++k) {
+            body[k] += counter_get(&shard->body_bytes[k]);
+        }
+        streams += counter_get(&shard->streams_finished);
+        opened += counter_get(&shard->connections_opened);
+        closed += counter_get(&shard->connections_closed);
+        for (int w = 0; w < 2; ++w) {
+            db_waits[w] += counter_get(&shard->db_waits[w]);
+            db_wait_us[w] += counter_get(&shard->db_wait_us[w]);
+        }
+    }
+    if (sb_append(sb, "# HELP ott_body_bytes_total File body bytes handed to the kernel, by send path.\n"
+                      "# TYPE ott_body_bytes_total counter\n") != 0) {
+        return -1;
+    }
+    for (int k = 0; k < METRICS_BODY_KINDS; ++k) {
+        if (sb_append(sb, "ott_body_bytes_total{path=\"%s\"} %llu\n", k_body_names[k],
+                      (unsigned long long)body[k]) != 0) {
+            return -1;
+        }
+    }
+    thread_pool_t *pool = &server->pool;
+    size_t workers = pool->worker_count;
+    size_t busy = atomic_load_explicit(&pool->active, memory_order_relaxed);
+    if (sb_append(sb,
+                  "# HELP ott_streams_completed_total File bodies sent to the end by the event loop.\n"
+                  "# TYPE ott_streams_completed_total counter\nott_streams_completed_total %llu\n"
+                  "# HELP ott_connections_active Open client connections.\n"
+                  "# TYPE ott_connections_active gauge\nott_connections_active %lld\n"
+                  "# HELP ott_connections_accepted_total Client connections accepted.\n"
+                  "# TYPE ott_connections_accepted_total counter\nott_connections_accepted_total %llu\n"
+                  "# HELP ott_worker_queue_depth Requests waiting in the worker pool queues.\n"
+                  "# TYPE ott_worker_queue_depth gauge\nott_worker_queue_depth %zu\n"
+                  "# HELP ott_worker_queue_limit Queue depth at which new requests are rejected with 503.\n"
+                  "# TYPE ott_worker_queue_limit gauge\nott_worker_queue_limit %zu\n"
+                  "# HELP ott_workers Worker threads.\n"
+                  "# TYPE ott_workers gauge\nott_workers %zu\n"
+                  "# HELP ott_workers_busy Worker threads running a job.\n"
+                  "# TYPE ott_workers_busy gauge\nott_workers_busy %zu\n"
+                  "# HELP ott_worker_rejected_total Requests rejected because the worker queue was full.\n"
+                  "# TYPE ott_worker_rejected_total counter\nott_worker_rejected_total %llu\n"
+                  "# HELP ott_db_lock_waits_total Database acquisitions that had to wait.\n"
+                  "# TYPE ott_db_lock_waits_total counter\n"
+                  "ott_db_lock_waits_total{lock=\"writer\"} %llu\nott_db_lock_waits_total{lock=\"reader_pool\"} %llu\n"
+                  "# HELP ott_db_lock_wait_seconds_total Time spent waiting for the database writer lock or a "
+                  "read connection.\n"
+                  "# TYPE ott_db_lock_wait_seconds_total counter\n"
+                  "ott_db_lock_wait_seconds_total{lock=\"writer\"} %.6f\n"
+                  "ott_db_lock_wait_seconds_total{lock=\"reader_pool\"} %.6f\n",
+                  (unsigned long long)streams, (long long)(opened - closed), (unsigned long long)opened,
+                  atomic_load_explicit(&pool->queued, memory_order_relaxed), pool->queue_limit, workers, busy,
+                  (unsigned long long)atomic_load_explicit(&pool->rejected, memory_order_relaxed),
+                  (unsigned long long)db_waits[1], (unsigned long long)db_waits[0], db_wait_us[1] / 1e6,
+                  db_wait_us[0] / 1e6) != 0) {
+        return -1;
+    }
+    if (sb_append(sb, "# HELP ott_ffmpeg_job_duration_seconds Background media job run time, by kind.\n"
+                      "# TYPE ott_ffmpeg_job_duration_seconds histogram\n") != 0) {
+        return -1;
+    }
+    for (int k = 0; k < METRICS_JOB_KINDS; ++k) {
+        uint64_t total = hist_sum(shards, job_hist, k, counts, &sum_us);
+        snprintf(labels, sizeof(labels), "kind=\"%s\"", k_job_names[k]);
+        if (total > 0 && emit_histogram(sb, "ott_ffmpeg_job_duration_seconds", labels, counts, total, sum_us) != 0) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+void metrics_handle_scrape(request_ctx_t *ctx) {
+    const char *expected = ctx->server->metrics_token;
+    if (expected[0]) {
+        const char *provided = http_get_header(ctx->request, "Authorization");
+        size_t expected_len = strlen(expected);
+        if (!provided || strncmp(provided, "Bearer ", 7) != 0 || strlen(provided + 7) != expected_len ||
+            CRYPTO_memcmp(provided + 7, expected, expected_len) != 0) {
+            router_send_json_error(ctx, 401, "Unauthorized");
+            return;
+        }
+    }
+    string_builder_t sb;
+    if (sb_init(&sb, 16384) != 0) {
+        router_send_json_error(ctx, 500, "Allocation failed");
+        return;
+    }
+    if (emit_scrape(&sb, ctx->server) != 0) {
+        sb_free(&sb);
+        router_send_json_error(ctx, 500, "Allocation failed");
+        return;
+    }
+    if (http_send_response_blocks(ctx->client_fd, 200, http_status_text(200), "text/plain; version=0.0.4",
+                                  sb.data, sb.length, ctx->server->security_headers, "Cache-Control: no-store\r\n",
+                                  ctx->keep_alive) != 0) {
+        log_warn("Failed to send metrics");
+    }
+    sb_free(&sb);
+}
+
+// 서버 종료 시 shard를 모두 놓는다. 이 시점에는 기록하는 스레드가 모두 멈춰 있어야 한다.
+void metrics_shutdown(void) {
+    metrics_shard_t *shard = atomic_exchange(&g_shards, NULL);
+    while (shard) {
+        metrics_shard_t *next = shard->next;
+        free(shard);
+        shard = next;
+    }
+    t_shard = NULL;
+}
@@ -0,0 +1,433 @@
+// MP4 박스 인덱서: 디코딩 없이 최상위 박스 헤더와 moov만 읽어 카탈로그 메타데이터를 채운다.
+// moov가 mdat 뒤에 있는 파일은 moov를 앞으로 옮긴 사본으로 바꿔 재생 시작 전 꼬리 Range 요청을 없앤다.
+#include "mp4.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "utils.h"
+
+#define MP4_MAX_TOP_BOXES 4096                  // 최상위 박스 수 상한 (깨진 파일에서 오래 돌지 않게)
+#define MP4_MAX_MOOV_SIZE (64LL * 1024 * 1024)  // 이보다 큰 moov는 읽지 않는다
+#define MP4_COPY_CHUNK (256 * 1024)
+
+// 메모리에 읽어 둔 박스 하나 (type은 4바이트, 본문은 헤더 뒤)
+typedef struct {
+    const unsigned char *type;
+    unsigned char *body;
+    size_t body_len;
+} mp4_box_t;
+
+static uint32_t be32(const unsigned char *p) {
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | (uint32_t)p[3];
+}
+
+static uint64_t be64(const unsigned char *p) {
+    return ((uint64_t)be32(p) << 32) | be32(p + 4);
+}
+
+static void put_be32(unsigned char *p, uint32_t v) {
+    p[0] = (unsigned char)(v >> 24);
+    p[1] = (unsigned char)(v >> 16);
+    p[2] = (unsigned char)(v >> 8);
+    p[3] = (unsigned char)v;
+}
+
+static void put_be64(unsigned char *p, uint64_t v) {
+    put_be32(p, (uint32_t)(v >> 32));
+    put_be32(p + 4, (uint32_t)v);
+}
+
+static int box_is(const mp4_box_t *box, const char *type) {
+    return memcmp(box->type, type, 4) == 0;
+}
+
+// 짧은 읽기를 이어 붙여 len 바이트를 모두 읽는다.
+static int pread_full(int fd, void *buf, size_t len, off_t offset) {
+    unsigned char *p = buf;
+    while (len > 0) {
+        ssize_t n = pread(fd, p, len, offset);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return -1;
+        }
+        p += n;
+        len -= (size_t)n;
+        offset += n;
+    }
+    return 0;
+}
+
+static int write_full(int fd, const void *buf, size_t len) {
+    const unsigned char *p = buf;
+    while (len > 0) {
+        ssize_t n = write(fd, p, len);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return -1;
+        }
+        p += n;
+        len -= (size_t)n;
+    }
+    return 0;
+}
+
+// buf[*pos, len)에서 다음 박스를 꺼낸다. 남은 박스가 없거나 크기가 맞지 않으면 0.
+static int next_box(unsigned char *buf, size_t len, size_t *pos, mp4_box_t *box) {
+    if (*pos > len || len - *pos < 8) {
+        return 0;
+    }
+    unsigned char *p = buf + *pos;
+    uint64_t size = be32(p);
+    size_t header = 8;
+    if (size == 1) {
+        if (len - *pos < 16) return 0;
+        size = be64(p + 8);
+        header = 16;
+    } else if (size == 0) {
+        size = len - *pos; // 부모 끝까지
+    }
+    if (size < header || size > len - *pos) {
+        return 0;
+    }
+    box->type = p + 4;
+    box->body = p + header;
+    box->body_len = (size_t)size - header;
+    *pos += (size_t)size;
+    return 1;
+}
+
+// 부모 본문에서 type인 첫 자식을 찾는다.
+static int find_child(unsigned char *buf, size_t len, const char *type, mp4_box_t *out) {
+    size_t pos = 0;
+    while (next_box(buf, len, &pos, out)) {
+        if (box_is(out, type)) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static void copy_fourcc(char *dst, const unsigned char *src) {
+    for (int i = 0; i < 4; ++i) {
+        dst[i] = (src[i] >= 0x20 && src[i] < 0x7f) ? (char)src[i] : '?';
+    }
+    dst[4] = '\0';
+}
+
+// 트랙 하나에서 핸들러 종류와 첫 샘플 엔트리(코덱), 표시 크기를 읽는다.
+static void parse_trak(mp4_box_t *trak, mp4_info_t *info) {
+    mp4_box_t tkhd, mdia, hdlr, minf, stbl, stsd;
+    int width = 0;
+    int height = 0;
+    if (find_child(trak->body, trak->body_len, "tkhd", &tkhd) && tkhd.body_len >= 84) {
+        // 마지막 8바이트가 16.16 고정소수점 너비/높이 (버전과 무관)
+        width = (int)(be32(tkhd.body + tkhd.body_len - 8) >> 16);
+        height = (int)(be32(tkhd.body + tkhd.body_len - 4) >> 16);
+    }
+    if (!find_child(trak->body, trak->body_len, "mdia", &mdia) ||
+        !find_child(mdia.body, mdia.body_len, "hdlr", &hdlr) || hdlr.body_len < 12 ||
+        !find_child(mdia.body, mdia.body_len, "minf", &minf) ||
+        !find_child(minf.body, minf.body_len, "stbl", &stbl) ||
+        !find_child(stbl.body, stbl.body_len, "stsd", &stsd) || stsd.body_len < 16 ||
+        be32(stsd.body + 4) == 0) {
+        return;
+    }
+    const unsigned char *handler = hdlr.body + 8;
+    const unsigned char *entry = stsd.body + 8;
+    if (memcmp(handler, "vide", 4) == 0 && info->video_codec[0] == '\0') {
+        copy_fourcc(info->video_codec, entry + 4);
+        if ((width == 0 || height == 0) && stsd.body_len >= 8 + 28) {
+            // VisualSampleEntry의 부호화 크기
+            width = (entry[24] << 8) | entry[25];
+            height = (entry[26] << 8) | entry[27];
+        }
+        info->width = width;
+        info->height = height;
+    } else if (memcmp(handler, "soun", 4) == 0 && info->audio_codec[0] == '\0') {
+        copy_fourcc(info->audio_codec, entry + 4);
+    }
+}
+
+// moov 본문에서 전체 길이(mvhd)와 트랙 정보를 채운다.
+static void parse_moov(unsigned char *body, size_t len, mp4_info_t *info) {
+    size_t pos = 0;
+    mp4_box_t box;
+    while (next_box(body, len, &pos, &box)) {
+        if (box_is(&box, "mvhd") && box.body_len >= 20) {
+            uint64_t timescale;
+            uint64_t duration;
+            if (box.body[0] == 1) {
+                if (box.body_len < 32) continue;
+                timescale = be32(box.body + 20);
+                duration = be64(box.body + 24);
+            } else {
+                timescale = be32(box.body + 12);
+                duration = be32(box.body + 16);
+                if (duration == UINT32_MAX) duration = 0; // 알 수 없음
+            }
+            if (timescale > 0 && duration / timescale < INT_MAX) {
+                info->duration_seconds = (int)((duration + timescale / 2) / timescale);
+            }
+        } else if (box_is(&box, "trak")) {
+            parse_trak(&box, info);
+        }
+    }
+}
+
+// 최상위 박스 헤더를 따라가며 첫 moov/mdat 위치를 찾는다. 박스가 파일 크기와 맞지 않으면 -1
+// (복사 중인 파일은 마지막 박스가 잘려 있으므로 여기서 걸러진다).
+static int scan_top_level(int fd, long long file_size, mp4_info_t *info) {
+    long long offset = 0;
+    for (int count = 0; offset + 8 <= file_size && count < MP4_MAX_TOP_BOXES; ++count) {
+        unsigned char header[16];
+        size_t want = file_size - offset >= 16 ? 16 : 8;
+        if (pread_full(fd, header, want, (off_t)offset) != 0) {
+            return -1;
+        }
+        for (int i = 4; i < 8; ++i) {
+            if (header[i] < 0x20 || header[i] >= 0x7f) {
+                return -1; // 박스 타입이 아니다: mp4가 아니거나 깨졌다
+            }
+        }
+        uint64_t size = be32(header);
+        uint64_t header_len = 8;
+        if (size == 1) {
+            if (want < 16) return -1;
+            size = be64(header + 8);
+            header_len = 16;
+        } else if (size == 0) {
+            size = (uint64_t)(file_size - offset);
+        }
+        if (size < header_len || size > (uint64_t)(file_size - offset)) {
+            return -1;
+        }
+        if (memcmp(header + 4, "moov", 4) == 0 && info->moov_offset < 0) {
+            info->moov_offset = offset;
+            info->moov_size = (long long)size;
+        } else if (memcmp(header + 4, "mdat", 4) == 0 && info->mdat_offset < 0) {
+            info->mdat_offset = offset;
+            info->mdat_size = (long long)size;
+        }
+        offset += (long long)size;
+    }
+    if (info->moov_offset < 0) {
+        return -1;
+    }
+    info->faststart = info->mdat_offset < 0 || info->moov_offset < info->mdat_offset;
+    return 0;
+}
+
+// moov 박스 전체를 읽어 온다. 호출자가 free한다.
+static unsigned char *read_moov(int fd, const mp4_info_t *info) {
+    if (info->moov_size > MP4_MAX_MOOV_SIZE) {
+        return NULL;
+    }
+    unsigned char *buf = malloc((size_t)info->moov_size);
+    if (!buf) {
+        return NULL;
+    }
+    if (pread_full(fd, buf, (size_t)info->moov_size, (off_t)info->moov_offset) != 0) {
+        free(buf);
+        return NULL;
+    }
+    return buf;
+}
+
+static int probe_fd(int fd, long long file_size, mp4_info_t *info) {
+    if (scan_top_level(fd, file_size, info) != 0) {
+        return -1;
+    }
+    unsigned char *moov = read_moov(fd, info);
+    if (!moov) {
+        return 0; // 위치 정보만으로도 faststart 여부는 안다
+    }
+    size_t pos = 0;
+    mp4_box_t box;
+    if (next_box(moov, (size_t)info->moov_size, &pos, &box)) {
+        parse_moov(box.body, box.body_len, info);
+    }
+    free(moov);
+    return 0;
+}
+
+// 디코더 없이 박스 헤더만으로 파일을 색인한다. 실패해도 info는 기본값(오프셋 -1)으로 채워진다.
+int mp4_probe(const char *path, mp4_info_t *info) {
+    if (!path || !info) return -1;
+    memset(info, 0, sizeof(*info));
+    info->moov_offset = -1;
+    info->mdat_offset = -1;
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return -1;
+    }
+    struct stat st;
+    int rc = fstat(fd, &st) == 0 ? probe_fd(fd, (long long)st.st_size, info) : -1;
+    close(fd);
+    return rc;
+}
+
+// 청크 오프셋 하나를 새 배치 기준으로 옮긴다. 첫 mdat부터 옛 moov 앞까지는 moov 크기만큼 밀리고,
+// 옛 moov 뒤쪽은 빠진 만큼과 들어간 만큼이 상쇄되어 그대로다.
+static uint64_t shift_offset(uint64_t offset, const mp4_info_t *info) {
+    if (offset >= (uint64_t)info->mdat_offset && offset < (uint64_t)info->moov_offset) {
+        return offset + (uint64_t)info->moov_size;
+    }
+    return offset;
+}
+
+// moov 아래의 모든 stco/co64 항목을 보정한다. 32비트 stco가 넘치면 -1.
+static int patch_chunk_offsets(unsigned char *buf, size_t len, const mp4_info_t *info) {
+    size_t pos = 0;
+    mp4_box_t box;
+    while (next_box(buf, len, &pos, &box)) {
+        if (box_is(&box, "trak") || box_is(&box, "mdia") || box_is(&box, "minf") || box_is(&box, "stbl")) {
+            if (patch_chunk_offsets(box.body, box.body_len, info) != 0) {
+                return -1;
+            }
+        } else if (box_is(&box, "stco") || box_is(&box, "co64")) {
+            size_t width = box_is(&box, "co64") ? 8 : 4;
+            if (box.body_len < 8) return -1;
+            uint32_t count = be32(box.body + 4);
+            if ((box.body_len - 8) / width < count) return -1;
+            for (uint32_t i = 0; i < count; ++i) {
+                unsigned char *p = box.body + 8 + (size_t)i * width;
+                if (width == 8) {
+                    put_be64(p, shift_offset(be64(p), info));
+                } else {
+                    uint64_t shifted = shift_offset(be32(p), info);
+                    if (shifted > UINT32_MAX) return -1;
+                    put_be32(p, (uint32_t)shifted);
+                }
+            }
+        }
+    }
+    return 0;
+}
+
+// 원본의 [offset, offset + len) 구간을 그대로 복사한다. 가능하면 copy_file_range로 커널 안에서 옮긴다.
+static int copy_range(int in_fd, int out_fd, long long offset, long long len) {
+    off_t in_off = (off_t)offset;
+    while (len > 0) {
+#if defined(__linux__)
+        ssize_t n = copy_file_range(in_fd, &in_off, out_fd, NULL, (size_t)len, 0);
+        if (n > 0) {
+            len -= n;
+            continue;
+        }
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n == 0 || (errno != EXDEV && errno != ENOSYS && errno != EINVAL && errno != EOPNOTSUPP)) {
+            return -1;
+        }
+#endif
+        // 파일 시스템이 지원하지 않으면 사용자 공간 버퍼로 복사한다.
+        unsigned char *buf = malloc(MP4_COPY_CHUNK);
+        if (!buf) return -1;
+        while (len > 0) {
+            size_t chunk = len < MP4_COPY_CHUNK ? (size_t)len : MP4_COPY_CHUNK;
+            if (pread_full(in_fd, buf, chunk, in_off) != 0 || write_full(out_fd, buf, chunk) != 0) {
+                free(buf);
+                return -1;
+            }
+            in_off += (off_t)chunk;
+            len -= (long long)chunk;
+        }
+        free(buf);
+    }
+    return 0;
+}
+
+// 같은 디렉터리의 숨김 임시 파일 경로 (라이브러리 스캔은 점으로 시작하는 파일을 무시한다)
+static int faststart_tmp_path(const char *path, char *out, size_t out_len) {
+    const char *slash = strrchr(path, '/');
+    int dir_len = slash ? (int)(slash - path + 1) : 0;
+    const char *base = slash ? slash + 1 : path;
+    return snprintf(out, out_len, "%.*s.%s.faststart.tmp", dir_len, path, base) >= (int)out_len ? -1 : 0;
+}
+
+// ftyp 등 앞쪽 박스, 보정한 moov, mdat 이후 박스(옛 moov 제외) 순서로 사본을 쓰고 rename으로 교체한다.
+// 재생 중인 스트림은 열어 둔 옛 inode를 계속 읽으므로 영향을 받지 않는다.
+int mp4_make_faststart(const char *path) {
+    if (!path) return -1;
+    int in_fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (in_fd < 0) {
+        return -1;
+    }
+    struct stat before;
+    mp4_info_t info;
+    memset(&info, 0, sizeof(info));
+    info.moov_offset = -1;
+    info.mdat_offset = -1;
+    if (fstat(in_fd, &before) != 0 || scan_top_level(in_fd, (long long)before.st_size, &info) != 0) {
+        close(in_fd);
+        return -1;
+    }
+    if (info.faststart) {
+        close(in_fd);
+        return 1;
+    }
+    unsigned char *moov = read_moov(in_fd, &info);
+    size_t pos = 0;
+    mp4_box_t box;
+    if (!moov || !next_box(moov, (size_t)info.moov_size, &pos, &box) ||
+        patch_chunk_offsets(box.body, box.body_len, &info) != 0) {
+        log_warn("Cannot relocate moov of %s (unsupported layout)", path);
+        free(moov);
+        close(in_fd);
+        return -1;
+    }
+    char tmp_path[PATH_MAX];
+    if (faststart_tmp_path(path, tmp_path, sizeof(tmp_path)) != 0) {
+        free(moov);
+        close(in_fd);
+        return -1;
+    }
+    int out_fd = open(tmp_path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, before.st_mode & 0777);
+    if (out_fd < 0) {
+        log_warn("Cannot create %s: %s", tmp_path, strerror(errno));
+        free(moov);
+        close(in_fd);
+        return -1;
+    }
+    long long tail_offset = info.moov_offset + info.moov_size;
+    int rc = copy_range(in_fd, out_fd, 0, info.mdat_offset) == 0 &&
+                     write_full(out_fd, moov, (size_t)info.moov_size) == 0 &&
+                     copy_range(in_fd, out_fd, info.mdat_offset, info.moov_offset - info.mdat_offset) == 0 &&
+                     copy_range(in_fd, out_fd, tail_offset, (long long)before.st_size - tail_offset) == 0 &&
+                     fsync(out_fd) == 0
+                 ? 0
+                 : -1;
+    free(moov);
+    if (close(out_fd) != 0) {
+        rc = -1;
+    }
+    // 복사하는 동안 원본이 바뀌었으면 (덮어쓰기, 이어 쓰기) 사본을 버린다.
+    struct stat after;
+    if (rc == 0 && (fstat(in_fd, &after) != 0 || after.st_size != before.st_size ||
+                    after.st_mtime != before.st_mtime)) {
+        rc = -1;
+    }
+    close(in_fd);
+    if (rc == 0 && rename(tmp_path, path) != 0) {
+        log_warn("Failed to replace %s: %s", path, strerror(errno));
+        rc = -1;
+    }
+    if (rc != 0) {
+        unlink(tmp_path);
+        return -1;
+    }
+    return 0;
+}
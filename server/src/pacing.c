@@ -0,0 +1,122 @@
+// 스트림 본문 속도 제한 (SO_MAX_PACING_RATE 또는 토큰 버킷)
+#include "pacing.h"
+
+#include <errno.h>
+#include <limits.h>
+#include <stdatomic.h>
+#include <string.h>
+#include <sys/socket.h>
+
+#include "metrics.h"
+#include "utils.h"
+
+// 토큰이 이만큼 모일 때까지 쉰다 (작은 sendfile을 잘게 반복하지 않도록)
+#define PACER_MIN_CHUNK (16 * 1024)
+// 버킷 용량은 100ms 분량: 쉬다 온 스트림도 그 이상 몰아서 보내지 않는다.
+#define PACER_BUCKET_MS 100
+
+// 소켓에 최대 송신 속도를 건다. 지원하지 않는 플랫폼/커널이면 -1.
+static int set_socket_rate(int fd, uint64_t rate) {
+#ifdef SO_MAX_PACING_RATE
+    unsigned int value = rate >= UINT_MAX ? UINT_MAX : (unsigned int)rate; // UINT_MAX = 제한 없음
+    return setsockopt(fd, SOL_SOCKET, SO_MAX_PACING_RATE, &value, sizeof(value));
+#else
+    (void)fd;
+    (void)rate;
+    errno = ENOPROTOOPT;
+    return -1;
+#endif
+}
+
+static void apply_kernel_rate(stream_pacer_t *pacer, int fd) {
+    pacer->want_kernel = 0;
+    if (set_socket_rate(fd, pacer->rate) == 0) {
+        pacer->kernel_applied = 1;
+        return;
+    }
+    // 커널 pacing을 못 쓰면 토큰 버킷으로 이어 간다 (처음 한 번만 알린다).
+    static atomic_int warned;
+    if (!atomic_exchange(&warned, 1)) {
+        log_warn("SO_MAX_PACING_RATE unavailable (%s); pacing streams in userspace", strerror(errno));
+    }
+}
+
+void pacer_start(stream_pacer_t *pacer, int fd, uint64_t rate, uint64_t burst, int prefer_kernel) {
+    pacer_finish(pacer);
+    if (rate == 0 || !prefer_kernel || (burst > 0 && !pacer->burst_used)) {
+        pacer_release(pacer, fd); // 제한 없이 보내는 구간에는 이전 스트림의 소켓 속도를 남기지 않는다.
+    }
+    if (rate == 0) {
+        return;
+    }
+    pacer->rate = rate;
+    pacer->burst_left = pacer->burst_used ? 0 : burst;
+    pacer->burst_used = 1;
+    pacer->tokens = 0;
+    pacer->refilled_us = metrics_now_us();
+    pacer->want_kernel = prefer_kernel;
+    if (pacer->want_kernel && pacer->burst_left == 0) {
+        apply_kernel_rate(pacer, fd);
+    }
+}
+
+size_t pacer_allowance(stream_pacer_t *pacer, uint64_t now_us, size_t budget, size_t remaining,
+                       uint64_t *wait_us) {
+    if (pacer->rate == 0 || pacer->kernel_applied) {
+        return budget;
+    }
+    if (pacer->burst_left > 0) {
+        // 버스트 동안에는 토큰을 쌓지 않고 남은 버스트만큼 그대로 보낸다.
+        pacer->refilled_us = now_us;
+        return pacer->burst_left < budget ? (size_t)pacer->burst_left : budget;
+    }
+    uint64_t capacity = pacer->rate * PACER_BUCKET_MS / 1000;
+    if (capacity < PACER_MIN_CHUNK) {
+        capacity = PACER_MIN_CHUNK;
+    }
+    if (now_us > pacer->refilled_us) {
+        pacer->tokens += pacer->rate * (now_us - pacer->refilled_us) / 1000000;
+        if (pacer->tokens > capacity) {
+            pacer->tokens = capacity;
+        }
+        pacer->refilled_us = now_us;
+    }
+    uint64_t need = remaining < PACER_MIN_CHUNK ? remaining : PACER_MIN_CHUNK;
+    if (pacer->tokens < need) {
+        *wait_us = (need - pacer->tokens) * 1000000 / pacer->rate + 1;
+        return 0;
+    }
+    return pacer->tokens < budget ? (size_t)pacer->tokens : budget;
+}
+
+void pacer_consume(stream_pacer_t *pacer, int fd, size_t sent) {
+    if (pacer->rate == 0 || sent == 0) {
+        return;
+    }
+    if (pacer->burst_left > 0) {
+        size_t used = pacer->burst_left < sent ? (size_t)pacer->burst_left : sent;
+        pacer->burst_left -= used;
+        sent -= used;
+        if (pacer->burst_left == 0 && pacer->want_kernel) {
+            apply_kernel_rate(pacer, fd);
+        }
+    }
+    if (!pacer->kernel_applied) {
+        pacer->tokens = pacer->tokens > sent ? pacer->tokens - sent : 0;
+    }
+}
+
+void pacer_finish(stream_pacer_t *pacer) {
+    int kernel_applied = pacer->kernel_applied;
+    int burst_used = pacer->burst_used;
+    memset(pacer, 0, sizeof(*pacer));
+    pacer->kernel_applied = kernel_applied;
+    pacer->burst_used = burst_used;
+}
+
+void pacer_release(stream_pacer_t *pacer, int fd) {
+    if (pacer->kernel_applied) {
+        (void)set_socket_rate(fd, UINT64_MAX);
+        pacer->kernel_applied = 0;
+    }
+}
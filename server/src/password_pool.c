@@ -0,0 +1,187 @@
+// PBKDF2 계산을 요청 워커와 분리된 스레드에서 돌려 로그인 폭주가 스트리밍/API 워커를 잠식하지 않게 한다.
+#include "password_pool.h"
+
+#include <openssl/evp.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "utils.h"
+
+#define PASSWORD_POOL_MAX_THREADS 16
+
+// 요청 워커의 스택에 놓이는 작업. 워커는 done이 될 때까지 cond에서 기다린다.
+typedef struct password_job {
+    const char *password;
+    const unsigned char *salt;
+    size_t salt_len;
+    unsigned char *out;
+    size_t out_len;
+    uint64_t queued_us;
+    int done;
+    int rc;
+    pthread_cond_t cond;
+    struct password_job *next;
+} password_job_t;
+
+static struct {
+    pthread_mutex_t lock;
+    pthread_cond_t ready;       // 작업 스레드 깨우기
+    password_job_t *head;
+    password_job_t *tail;
+    pthread_t threads[PASSWORD_POOL_MAX_THREADS];
+    size_t thread_count;
+    size_t queue_limit;
+    int iterations;
+    int stop;
+    int initialized;
+    password_pool_stats_t stats;
+} g_pool = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .ready = PTHREAD_COND_INITIALIZER,
+};
+
+static uint64_t now_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000ULL + (uint64_t)ts.tv_nsec / 1000ULL;
+}
+
+// 대기열에서 작업을 꺼내 PBKDF2를 계산하고 결과를 기다리는 워커를 깨운다.
+static void *password_worker(void *arg) {
+    (void)arg;
+    pthread_mutex_lock(&g_pool.lock);
+    for (;;) {
+        while (!g_pool.stop && !g_pool.head) {
+            pthread_cond_wait(&g_pool.ready, &g_pool.lock);
+        }
+        if (!g_pool.head) {
+            break; // stop이고 남은 작업이 없다
+        }
+        password_job_t *job = g_pool.head;
+        g_pool.head = job->next;
+        if (!g_pool.head) {
+            g_pool.tail = NULL;
+        }
+        g_pool.stats.queued--;
+        g_pool.stats.running++;
+        int iterations = g_pool.iterations;
+        pthread_mutex_unlock(&g_pool.lock);
+
+        uint64_t start = now_us();
+        int rc = PKCS5_PBKDF2_HMAC(job->password, (int)strlen(job->password), job->salt, (int)job->salt_len,
+                                   iterations, EVP_sha256(), (int)job->out_len, job->out) == 1 ? 0 : -1;
+        uint64_t end = now_us();
+
+        pthread_mutex_lock(&g_pool.lock);
+        g_pool.stats.running--;
+        g_pool.stats.completed++;
+        g_pool.stats.total_hash_us += end - start;
+        g_pool.stats.total_wait_us += start - job->queued_us;
+        if (end - start > g_pool.stats.max_hash_us) {
+            g_pool.stats.max_hash_us = end - start;
+        }
+        job->rc = rc;
+        job->done = 1;
+        pthread_cond_signal(&job->cond);
+    }
+    pthread_mutex_unlock(&g_pool.lock);
+    return NULL;
+}
+
+// 해시 전용 스레드를 만든다. queue_limit은 계산 중인 것을 뺀, 기다릴 수 있는 작업 수다.
+int password_pool_init(size_t threads, size_t queue_limit, int iterations) {
+    if (g_pool.initialized) {
+        return 0;
+    }
+    if (threads == 0) threads = 1;
+    if (threads > PASSWORD_POOL_MAX_THREADS) threads = PASSWORD_POOL_MAX_THREADS;
+    g_pool.queue_limit = queue_limit;
+    g_pool.iterations = iterations;
+    g_pool.stop = 0;
+    memset(&g_pool.stats, 0, sizeof(g_pool.stats));
+    for (size_t i = 0; i < threads; ++i) {
+        if (pthread_create(&g_pool.threads[i], NULL, password_worker, NULL) != 0) {
+            log_error("Failed to start password hashing thread");
+            g_pool.thread_count = i;
+            g_pool.initialized = 1;
+            password_pool_shutdown();
+            return -1;
+        }
+    }
+    g_pool.thread_count = threads;
+    g_pool.initialized = 1;
+    log_info("Password hashing pool: %zu threads, queue limit %zu, %d iterations",
+             threads, queue_limit, iterations);
+    return 0;
+}
+
+// 작업을 대기열에 넣고 끝날 때까지 기다린다. 대기열이 가득 차면 기다리지 않고 바로 거절한다.
+int password_pool_derive(const char *password, const unsigned char *salt, size_t salt_len,
+                         unsigned char *out, size_t out_len) {
+    if (!password || !salt || !out) {
+        return -1;
+    }
+    password_job_t job;
+    memset(&job, 0, sizeof(job));
+    job.password = password;
+    job.salt = salt;
+    job.salt_len = salt_len;
+    job.out = out;
+    job.out_len = out_len;
+    if (pthread_cond_init(&job.cond, NULL) != 0) {
+        return -1;
+    }
+    int rc;
+    pthread_mutex_lock(&g_pool.lock);
+    if (!g_pool.initialized || g_pool.stop) {
+        rc = -1;
+    } else if (g_pool.stats.queued + g_pool.stats.running >= g_pool.thread_count + g_pool.queue_limit) {
+        // 스레드가 아직 꺼내 가지 않은 작업도 빈 스레드 몫으로 치므로, 깨어나는 지연 때문에 거절하지 않는다.
+        g_pool.stats.rejected++;
+        rc = PASSWORD_POOL_BUSY;
+    } else {
+        job.queued_us = now_us();
+        if (g_pool.tail) {
+            g_pool.tail->next = &job;
+        } else {
+            g_pool.head = &job;
+        }
+        g_pool.tail = &job;
+        g_pool.stats.queued++;
+        pthread_cond_signal(&g_pool.ready);
+        while (!job.done) {
+            pthread_cond_wait(&job.cond, &g_pool.lock);
+        }
+        rc = job.rc;
+    }
+    pthread_mutex_unlock(&g_pool.lock);
+    pthread_cond_destroy(&job.cond);
+    return rc;
+}
+
+void password_pool_get_stats(password_pool_stats_t *stats) {
+    pthread_mutex_lock(&g_pool.lock);
+    *stats = g_pool.stats;
+    stats->threads = g_pool.thread_count;
+    stats->queue_limit = g_pool.queue_limit;
+    stats->iterations = g_pool.iterations;
+    pthread_mutex_unlock(&g_pool.lock);
+}
+
+// 남은 작업을 모두 계산해 기다리는 워커를 풀어 준 뒤 스레드를 종료한다.
+void password_pool_shutdown(void) {
+    if (!g_pool.initialized) {
+        return;
+    }
+    pthread_mutex_lock(&g_pool.lock);
+    g_pool.stop = 1;
+    pthread_cond_broadcast(&g_pool.ready);
+    pthread_mutex_unlock(&g_pool.lock);
+    for (size_t i = 0; i < g_pool.thread_count; ++i) {
+        pthread_join(g_pool.threads[i], NULL);
+    }
+    g_pool.thread_count = 0;
+    g_pool.initialized = 0;
+}
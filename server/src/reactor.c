@@ -0,0 +1,922 @@
+// accept/읽기 준비 감지와 대용량 파일 본문 송신을 담당하는 이벤트 루프 구현
+#include "reactor.h"
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+#if defined(__linux__)
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#define USE_EPOLL 1
+#else
+#include <poll.h>
+#define USE_EPOLL 0
+#endif
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "metrics.h"
+#include "utils.h"
+
+// 에지 트리거 I/O 대기 시 한 번에 수용할 최대 이벤트 수
+#define MAX_EVENTS 128
+// 한 연결이 이벤트 한 번에 보낼 수 있는 최대 바이트 (다른 스트림과 공평하게 순환)
+#define REACTOR_STREAM_BUDGET (512 * 1024)
+// 과부하로 거절할 때 클라이언트에게 알려 줄 재시도 대기 시간(초)
+#define REACTOR_RETRY_AFTER_SEC "1"
+
+// 워커 스레드 풀에서 실행될 진입점: 리액터에 등록된 핸들러로 넘긴다.
+static void reactor_job(void *arg) {
+    connection_t *conn = (connection_t *)arg;
+    conn->owner->handler(conn);
+}
+
+#if !USE_EPOLL || HAVE_IO_URING
+// 루프 스레드를 깨운다. poll()은 감시 목록을 다시 만들고, io_uring은 대기 중인 제출을 처리한다.
+static void reactor_wake(reactor_t *reactor) {
+    char b = 1;
+    ssize_t n = write(reactor->wake_fds[1], &b, 1);
+    (void)n; // 파이프가 가득 찼다면 이미 깨어날 예정이다.
+}
+#endif
+
+// 연결 하나를 다음 이벤트 한 번에 대해 다시 감시하도록 등록한다.
+// epoll은 ONESHOT 재등록이 스레드 안전하므로 워커에서도 바로 호출한다.
+static void reactor_arm(reactor_t *reactor, connection_t *conn, int writable) {
+#if USE_EPOLL
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = (writable ? EPOLLOUT : EPOLLIN) | EPOLLONESHOT;
+    ev.data.ptr = conn;
+    if (epoll_ctl(reactor->poll_fd, EPOLL_CTL_MOD, conn->fd, &ev) < 0) {
+        log_warn("epoll_ctl MOD client failed: %s", strerror(errno));
+        reactor_close(conn);
+    }
+#else
+    // poll() 루프는 매 반복마다 상태를 보고 감시 목록을 다시 만든다.
+    (void)conn;
+    (void)writable;
+    reactor_wake(reactor);
+#endif
+}
+
+// 연결의 소유권을 루프로 넘기며 상태를 바꾼다. 유휴 정리와 경합하지 않도록 잠금 안에서 갱신한다.
+static void reactor_set_state(reactor_t *reactor, connection_t *conn, conn_state_t state) {
+    pthread_mutex_lock(&reactor->lock);
+    conn->state = state;
+    conn->last_active_ms = get_monotonic_ms();
+    pthread_mutex_unlock(&reactor->lock);
+}
+
+// 워커 큐가 상한에 도달했을 때의 빠른 거절 경로. 루프 스레드에서 미리 만든 503을 보내고 닫는다.
+// 받은 요청 바이트를 먼저 비워 두어야 close()가 RST로 응답을 지우지 않는다.
+static void reactor_reject(connection_t *conn) {
+    static const char response[] =
+        "HTTP/1.1 503 Service Unavailable\r\n"
+        "Content-Type: application/json\r\n"
+        "Content-Length: 31\r\n"
+        "Retry-After: " REACTOR_RETRY_AFTER_SEC "\r\n"
+        "Connection: close\r\n"
+        "\r\n"
+        "{\"error\":\"Service Unavailable\"}";
+    char scratch[4096];
+    while (recv(conn->fd, scratch, sizeof(scratch), MSG_DONTWAIT) > 0) {
+    }
+    ssize_t n = send(conn->fd, response, sizeof(response) - 1, MSG_DONTWAIT | MSG_NOSIGNAL);
+    (void)n; // 소켓 버퍼가 가득 찼다면 응답 없이 닫는 것으로 충분하다.
+    shutdown(conn->fd, SHUT_WR);
+    reactor_close(conn);
+}
+
+// 요청이 도착한 연결을 워커 풀로 넘긴다. 대기 작업이 상한을 넘으면 바로 503으로 거절한다.
+// 루프는 요청을 읽지 않으므로 모두 interactive lane으로 보내고, 무거운 라우트는 워커가 파싱 후 옮긴다.
+static void reactor_dispatch(reactor_t *reactor, connection_t *conn) {
+    thread_pool_lane_t lane = THREAD_POOL_LANE_INTERACTIVE;
+    conn->lane = lane;
+    // 앞 스트림의 본문은 클라이언트가 다 받았으므로 다음 응답은 제한 없이 보낸다.
+    pacer_release(&conn->pacer, conn->fd);
+    reactor_set_state(reactor, conn, CONN_DISPATCHED);
+    thread_pool_t *pool = &reactor->server->pool;
+    int rc;
+    size_t cpu = (size_t)reactor->cpu;
+    if (reactor->cpu >= 0 && pool->pin_cpus && pool->cpu_count > 0 && cpu < pool->worker_count) {
+        // 워커 i는 CPU (i % cpu_count)에 고정되어 있으므로 같은 CPU의 워커 큐로 넘긴다.
+        size_t ncpu = (size_t)pool->cpu_count;
+        size_t local = (pool->worker_count - cpu + ncpu - 1) / ncpu;
+        size_t preferred = cpu + ncpu * (reactor->next_local++ % local);
+        rc = thread_pool_submit_to(pool, preferred, lane, reactor_job, conn);
+    } else {
+        rc = thread_pool_submit(pool, lane, reactor_job, conn);
+    }
+    if (rc != 0) {
+        reactor_reject(conn);
+    }
+}
+
+// 워커가 넘긴 스트림의 접근 로그를 실제로 보낸 바이트와 요청 시작부터의 시간으로 남긴다.
+static void reactor_log_access(connection_t *conn) {
+    if (!conn->access_pending) {
+        return;
+    }
+    conn->access_pending = 0;
+    size_t unsent = conn->stream.remaining;
+    conn->access.bytes = conn->access.bytes > unsent ? conn->access.bytes - unsent : 0;
+    conn->access.duration_us = metrics_now_us() - conn->access_started_us;
+    access_log_record(&conn->access);
+}
+
+// 본문 전송이 끝난 연결을 keep-alive 여부에 따라 다음 요청 대기로 돌리거나 닫는다.
+static void reactor_finish_response(reactor_t *reactor, connection_t *conn) {
+    if (conn->stream.file_fd >= 0) {
+        metrics_stream_finished();
+    }
+    pacer_finish(&conn->pacer);
+    reactor_log_access(conn);
+    http_stream_close(&conn->stream);
+    if (!conn->keep_alive) {
+        reactor_close(conn);
+    } else if (conn->inbuf.length > 0) {
+        // 스트리밍 중에 이미 읽어 둔 파이프라이닝 요청은 바로 처리한다.
+        reactor_dispatch(reactor, conn);
+    } else {
+        reactor_set_state(reactor, conn, CONN_READING);
+        reactor_arm(reactor, conn, 0);
+    }
+}
+
+// 토큰이 모자란 스트림을 wait_us 뒤에 깨우도록 쉬는 목록에 넣는다. 그동안 쓰기 이벤트는 걸지 않는다.
+static void reactor_pace_sleep(reactor_t *reactor, connection_t *conn, uint64_t wait_us) {
+    conn->pace_wake_ms = get_monotonic_ms() + (wait_us + 999) / 1000;
+    conn->pace_next = reactor->paced;
+    reactor->paced = conn;
+}
+
+// 다음 이벤트 대기 시간: 가장 먼저 깨울 스트림까지 (없으면 max_ms).
+static int reactor_pace_timeout(const reactor_t *reactor, int max_ms) {
+    if (!reactor->paced) {
+        return max_ms;
+    }
+    uint64_t now = get_monotonic_ms();
+    int timeout = max_ms;
+    for (const connection_t *conn = reactor->paced; conn; conn = conn->pace_next) {
+        uint64_t left = conn->pace_wake_ms > now ? conn->pace_wake_ms - now : 0;
+        if (left < (uint64_t)timeout) {
+            timeout = (int)left;
+        }
+    }
+    return timeout;
+}
+
+// 스트리밍 중인 연결에 한 번에 REACTOR_STREAM_BUDGET(속도 제한 중이면 모인 토큰)만큼 본문을 보낸다.
+static void reactor_pump_stream(reactor_t *reactor, connection_t *conn) {
+    uint64_t wait_us = 0;
+    size_t budget = pacer_allowance(&conn->pacer, metrics_now_us(), REACTOR_STREAM_BUDGET,
+                                    conn->stream.remaining, &wait_us);
+    if (budget == 0) {
+        reactor_pace_sleep(reactor, conn, wait_us);
+        return;
+    }
+    size_t before = conn->stream.remaining;
+    int rc = http_stream_send(conn->fd, &conn->stream, budget);
+    pacer_consume(&conn->pacer, conn->fd, before - conn->stream.remaining);
+    if (rc < 0) {
+        // 클라이언트 이탈 또는 IO 오류
+        reactor_close(conn);
+        return;
+    }
+    if (rc == 1) {
+        reactor_finish_response(reactor, conn);
+        return;
+    }
+    reactor_arm(reactor, conn, 1);
+}
+
+// 연결이 가진 버퍼/파일/소켓(과 splice 파이프)을 모두 해제한다. 목록에서는 이미 빠져 있어야 한다.
+static void connection_free(connection_t *conn) {
+    reactor_log_access(conn); // 클라이언트가 스트림 도중 떠난 경우
+    http_buffer_free(&conn->inbuf);
+    free(conn->parsed);
+    http_stream_close(&conn->stream);
+#if HAVE_IO_URING
+    for (int i = 0; i < 2; ++i) {
+        if (conn->pipe_fds[i] >= 0) {
+            close(conn->pipe_fds[i]);
+        }
+    }
+#endif
+    close(conn->fd);
+    free(conn);
+    metrics_connection_closed();
+}
+
+// keep-alive 유휴 시간이 지난 연결을 닫는다. 루프 스레드에서 이벤트 처리 사이에만 호출한다.
+static void reactor_sweep_idle(reactor_t *reactor) {
+    uint64_t now = get_monotonic_ms();
+    if (now - reactor->last_sweep_ms < 1000) {
+        return;
+    }
+    reactor->last_sweep_ms = now;
+    uint64_t timeout_ms = (uint64_t)(reactor->server->keepalive_timeout_sec > 0
+                                         ? reactor->server->keepalive_timeout_sec
+                                         : 15) * 1000;
+    connection_t *expired = NULL;
+    pthread_mutex_lock(&reactor->lock);
+    connection_t *conn = reactor->connections;
+    while (conn) {
+        connection_t *next = conn->next;
+        if (conn->state == CONN_READING && now - conn->last_active_ms >= timeout_ms) {
+            if (conn->prev) {
+                conn->prev->next = conn->next;
+            } else {
+                reactor->connections = conn->next;
+            }
+            if (conn->next) {
+                conn->next->prev = conn->prev;
+            }
+            reactor->connection_count--;
+            conn->next = expired;
+            expired = conn;
+        }
+        conn = next;
+    }
+    pthread_mutex_unlock(&reactor->lock);
+    while (expired) {
+        connection_t *next = expired->next;
+        connection_free(expired);
+        expired = next;
+    }
+}
+
+// 받은 소켓을 연결 목록에 추가하고 첫 요청을 기다리도록 등록한다.
+static void reactor_add_connection(reactor_t *reactor, int client_fd) {
+    connection_t *conn = calloc(1, sizeof(connection_t));
+    if (!conn) {
+        close(client_fd);
+        return;
+    }
+    metrics_connection_opened();
+    conn->fd = client_fd;
+    conn->owner = reactor;
+    conn->state = CONN_READING;
+    conn->last_active_ms = get_monotonic_ms();
+    http_stream_init(&conn->stream);
+#if HAVE_IO_URING
+    conn->pipe_fds[0] = -1;
+    conn->pipe_fds[1] = -1;
+#endif
+
+    pthread_mutex_lock(&reactor->lock);
+    conn->next = reactor->connections;
+    if (reactor->connections) {
+        reactor->connections->prev = conn;
+    }
+    reactor->connections = conn;
+    reactor->connection_count++;
+    pthread_mutex_unlock(&reactor->lock);
+
+#if USE_EPOLL
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN | EPOLLONESHOT;
+    ev.data.ptr = conn;
+    if (epoll_ctl(reactor->poll_fd, EPOLL_CTL_ADD, client_fd, &ev) < 0) {
+        log_warn("epoll_ctl ADD client failed: %s", strerror(errno));
+        reactor_close(conn);
+    }
+#endif
+}
+
+// 새 연결을 받아 논블로킹으로 전환하고 연결 목록에 추가한다.
+static void reactor_accept(reactor_t *reactor) {
+    for (;;) {
+        struct sockaddr_in client_addr;
+        socklen_t client_len = sizeof(client_addr);
+#if defined(__linux__)
+        // accept4로 논블로킹/CLOEXEC를 한 번에 설정해 연결마다 fcntl 두 번을 아낀다.
+        int client_fd = accept4(reactor->listen_fd, (struct sockaddr *)&client_addr, &client_len,
+                                SOCK_NONBLOCK | SOCK_CLOEXEC);
+#else
+        int client_fd = accept(reactor->listen_fd, (struct sockaddr *)&client_addr, &client_len);
+#endif
+        if (client_fd < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                break;
+            }
+            if (errno == EINTR || errno == ECONNABORTED) {
+                continue;
+            }
+            log_warn("accept failed: %s", strerror(errno));
+            break;
+        }
+#if !defined(__linux__)
+        if (make_nonblocking(client_fd) != 0) {
+            close(client_fd);
+            continue;
+        }
+#endif
+        reactor_add_connection(reactor, client_fd);
+    }
+}
+
+#if HAVE_IO_URING
+// user_data 하위 비트에 작업 종류를 싣는다 (connection_t는 8바이트 정렬).
+#define URING_TAG_ACCEPT 1u
+#define URING_OP_FILL 1u   // 파일 → 파이프 splice
+#define URING_OP_DRAIN 2u  // 파이프 → 소켓 splice
+#define URING_OP_POLL 3u   // 소켓이 다시 쓰기 가능해질 때까지 대기
+#define URING_OP_MASK 7u
+#define URING_ENTRIES 256
+
+static uint64_t uring_tag(connection_t *conn, unsigned op) {
+    return (uint64_t)(uintptr_t)conn | op;
+}
+
+// multishot accept 하나로 리스닝 소켓의 모든 새 연결을 CQE로 받는다 (accept 시스템 콜이 없다).
+static int uring_queue_accept(reactor_t *reactor) {
+    struct io_uring_sqe *sqe = uring_get_sqe(reactor->ring);
+    if (!sqe) {
+        return -1;
+    }
+    sqe->opcode = IORING_OP_ACCEPT;
+    sqe->fd = reactor->listen_fd;
+    sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+    sqe->accept_flags = SOCK_NONBLOCK | SOCK_CLOEXEC;
+    sqe->user_data = URING_TAG_ACCEPT;
+    return 0;
+}
+
+// multishot accept를 쓸 수 없는 커널이면 리스닝 소켓을 epoll로 되돌린다.
+static void uring_fallback_accept(reactor_t *reactor) {
+    reactor->uring_accept = 0;
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.ptr = NULL;
+    if (epoll_ctl(reactor->poll_fd, EPOLL_CTL_ADD, reactor->listen_fd, &ev) < 0) {
+        log_error("epoll_ctl ADD listen fd failed");
+    }
+}
+
+static void uring_prep_splice(struct io_uring_sqe *sqe, int fd_in, int64_t off_in, int fd_out,
+                              size_t len, uint64_t user_data) {
+    sqe->opcode = IORING_OP_SPLICE;
+    sqe->fd = fd_out;
+    sqe->off = (uint64_t)-1;
+    sqe->splice_fd_in = fd_in;
+    sqe->splice_off_in = (uint64_t)off_in;
+    sqe->len = (unsigned)len;
+    sqe->splice_flags = SPLICE_F_MOVE;
+    sqe->user_data = user_data;
+}
+
+// 연결마다 splice 중계 파이프를 한 번 만들고 keep-alive 동안 재사용한다.
+static int uring_ensure_pipe(connection_t *conn) {
+    if (conn->pipe_fds[0] >= 0) {
+        return 0;
+    }
+    if (pipe2(conn->pipe_fds, O_CLOEXEC) != 0) {
+        conn->pipe_fds[0] = conn->pipe_fds[1] = -1;
+        return -1;
+    }
+    int size = fcntl(conn->pipe_fds[1], F_SETPIPE_SZ, REACTOR_STREAM_BUDGET);
+    if (size <= 0) {
+        size = fcntl(conn->pipe_fds[1], F_GETPIPE_SZ);
+    }
+    conn->pipe_size = size > 0 ? (size_t)size : 65536;
+    return 0;
+}
+
+// 진행 중인 SQE가 모두 끝난 스트림의 다음 단계를 제출한다. 보통은 파일 → 파이프 → 소켓 두 splice를
+// IOSQE_IO_LINK로 묶어 한 번에 넣으므로, 청크 하나에 사용자 공간 복사와 추가 시스템 콜이 없다.
+static void uring_stream_next(reactor_t *reactor, connection_t *conn) {
+    if (conn->uring_failed) {
+        reactor_close(conn);
+        return;
+    }
+    struct io_uring_sqe *sqe;
+    if (conn->uring_need_poll) {
+        conn->uring_need_poll = 0;
+        if (!(sqe = uring_get_sqe(reactor->ring))) {
+            reactor_close(conn);
+            return;
+        }
+        sqe->opcode = IORING_OP_POLL_ADD;
+        sqe->fd = conn->fd;
+        sqe->poll32_events = POLLOUT;
+        sqe->user_data = uring_tag(conn, URING_OP_POLL);
+        conn->uring_inflight = 1;
+        return;
+    }
+    if (conn->pipe_pending > 0) {
+        // 지난 청크 중 소켓으로 못 보낸 나머지를 먼저 비운다.
+        if (!(sqe = uring_get_sqe(reactor->ring))) {
+            reactor_close(conn);
+            return;
+        }
+        uring_prep_splice(sqe, conn->pipe_fds[0], -1, conn->fd, conn->pipe_pending,
+                          uring_tag(conn, URING_OP_DRAIN));
+        conn->uring_inflight = 1;
+        return;
+    }
+    if (conn->stream.remaining == 0) {
+        reactor_finish_response(reactor, conn);
+        return;
+    }
+    size_t chunk = conn->stream.remaining < conn->pipe_size ? conn->stream.remaining : conn->pipe_size;
+    uint64_t wait_us = 0;
+    chunk = pacer_allowance(&conn->pacer, metrics_now_us(), chunk, conn->stream.remaining, &wait_us);
+    if (chunk == 0) {
+        reactor_pace_sleep(reactor, conn, wait_us);
+        return;
+    }
+    struct io_uring_sqe *fill = uring_get_sqe(reactor->ring);
+    struct io_uring_sqe *drain = fill ? uring_get_sqe(reactor->ring) : NULL;
+    if (!drain) {
+        if (fill) {
+            // 빈 칸으로 남지 않도록 아무 일도 하지 않는 작업으로 채운다.
+            fill->opcode = IORING_OP_NOP;
+            fill->user_data = uring_tag(conn, URING_OP_POLL);
+            conn->uring_inflight = 1;
+            conn->uring_failed = 1;
+            return;
+        }
+        reactor_close(conn);
+        return;
+    }
+    uring_prep_splice(fill, conn->stream.file_fd, (int64_t)conn->stream.offset, conn->pipe_fds[1], chunk,
+                      uring_tag(conn, URING_OP_FILL));
+    fill->flags |= IOSQE_IO_LINK;
+    uring_prep_splice(drain, conn->pipe_fds[0], -1, conn->fd, chunk, uring_tag(conn, URING_OP_DRAIN));
+    conn->uring_inflight = 2;
+}
+
+// 스트림 CQE 하나를 반영한다. 짧은 splice는 연결을 끊어 뒤 SQE가 -ECANCELED로 끝나므로,
+// 파이프에 남은 양(pipe_pending)을 기준으로 다음 단계에서 이어 보낸다.
+static void uring_handle_stream_cqe(reactor_t *reactor, connection_t *conn, unsigned op, int res) {
+    conn->uring_inflight--;
+    if (op == URING_OP_FILL) {
+        if (res > 0) {
+            conn->pipe_pending += (size_t)res;
+            conn->stream.offset += res;
+            conn->stream.remaining -= (size_t)res;
+            pacer_consume(&conn->pacer, conn->fd, (size_t)res);
+            http_stream_progress(&conn->stream, (size_t)res);
+            metrics_add_body_bytes(METRICS_BODY_SPLICE, (size_t)res);
+        } else if (res != -ECANCELED) {
+            conn->uring_failed = 1; // 읽기 오류 또는 전송 도중 파일이 잘렸다.
+        }
+    } else if (op == URING_OP_DRAIN) {
+        if (res > 0) {
+            conn->pipe_pending -= (size_t)res;
+        } else if (res == -EAGAIN) {
+            conn->uring_need_poll = 1;
+        } else if (res != -ECANCELED) {
+            conn->uring_failed = 1; // 클라이언트 이탈
+        }
+    } else if (res < 0 || (res & (POLLERR | POLLHUP))) {
+        conn->uring_failed = 1;
+    }
+    if (conn->uring_inflight == 0) {
+        uring_stream_next(reactor, conn);
+    }
+}
+
+// eventfd가 울리면 쌓인 CQE를 모두 처리한다.
+static void uring_reap(reactor_t *reactor) {
+    uint64_t count;
+    ssize_t n = read(reactor->event_fd, &count, sizeof(count));
+    (void)n;
+    struct io_uring_cqe *cqe;
+    while ((cqe = uring_peek_cqe(reactor->ring)) != NULL) {
+        uint64_t user_data = cqe->user_data;
+        int res = cqe->res;
+        unsigned flags = cqe->flags;
+        uring_cqe_seen(reactor->ring);
+        if (user_data == URING_TAG_ACCEPT) {
+            if (res >= 0) {
+                reactor_add_connection(reactor, res);
+            } else if (res == -EINVAL || res == -EOPNOTSUPP) {
+                log_warn("io_uring multishot accept unavailable; accepting through epoll");
+                uring_fallback_accept(reactor);
+                continue;
+            } else if (res != -EAGAIN && res != -EINTR && res != -ECONNABORTED) {
+                log_warn("io_uring accept failed: %s", strerror(-res));
+            }
+            if (!(flags & IORING_CQE_F_MORE) && reactor->uring_accept && uring_queue_accept(reactor) != 0) {
+                uring_fallback_accept(reactor);
+            }
+            continue;
+        }
+        connection_t *conn = (connection_t *)(uintptr_t)(user_data & ~(uint64_t)URING_OP_MASK);
+        uring_handle_stream_cqe(reactor, conn, (unsigned)(user_data & URING_OP_MASK), res);
+    }
+}
+
+// 워커가 reactor_stream으로 넘긴 연결들의 첫 splice를 루프 스레드에서 제출한다.
+static void uring_drain_queue(reactor_t *reactor) {
+    pthread_mutex_lock(&reactor->lock);
+    connection_t *queue = reactor->uring_queue;
+    reactor->uring_queue = NULL;
+    pthread_mutex_unlock(&reactor->lock);
+    while (queue) {
+        connection_t *next = queue->uring_next;
+        queue->uring_next = NULL;
+        queue->pipe_pending = 0;
+        queue->uring_failed = 0;
+        queue->uring_need_poll = 0;
+        if (uring_ensure_pipe(queue) != 0) {
+            reactor_close(queue);
+        } else {
+            uring_stream_next(reactor, queue);
+        }
+        queue = next;
+    }
+}
+
+// 링과 eventfd를 만들고 multishot accept를 건다. 실패하면 epoll 경로를 그대로 쓴다.
+static int uring_setup(reactor_t *reactor) {
+    reactor->event_fd = -1;
+    reactor->ring = calloc(1, sizeof(uring_t));
+    if (!reactor->ring || uring_init(reactor->ring, URING_ENTRIES) != 0) {
+        log_warn("io_uring unavailable (%s); using epoll", strerror(errno));
+        free(reactor->ring);
+        reactor->ring = NULL;
+        return -1;
+    }
+    reactor->event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.ptr = &reactor->event_fd;
+    if (reactor->event_fd < 0 || uring_register_eventfd(reactor->ring, reactor->event_fd) != 0 ||
+        epoll_ctl(reactor->poll_fd, EPOLL_CTL_ADD, reactor->event_fd, &ev) < 0 ||
+        uring_queue_accept(reactor) != 0 || uring_submit(reactor->ring) < 0) {
+        log_warn("io_uring setup failed (%s); using epoll", strerror(errno));
+        uring_destroy(reactor->ring);
+        free(reactor->ring);
+        reactor->ring = NULL;
+        if (reactor->event_fd >= 0) {
+            close(reactor->event_fd);
+            reactor->event_fd = -1;
+        }
+        return -1;
+    }
+    reactor->uring_accept = 1;
+    return 0;
+}
+#endif
+
+// 깨울 시각이 된 스트림을 이어 보낸다. 아직 이른 스트림은 목록에 되돌린다.
+static void reactor_pace_wake(reactor_t *reactor) {
+    if (!reactor->paced) {
+        return;
+    }
+    uint64_t now = get_monotonic_ms();
+    connection_t *list = reactor->paced;
+    reactor->paced = NULL;
+    while (list) {
+        connection_t *conn = list;
+        list = conn->pace_next;
+        conn->pace_next = NULL;
+        if (conn->pace_wake_ms > now) {
+            conn->pace_next = reactor->paced;
+            reactor->paced = conn;
+            continue;
+        }
+        conn->pace_wake_ms = 0;
+#if HAVE_IO_URING
+        if (reactor->ring && conn->stream.use_sendfile) {
+            uring_stream_next(reactor, conn);
+            continue;
+        }
+#endif
+        reactor_pump_stream(reactor, conn);
+    }
+}
+
+int reactor_init(reactor_t *reactor, server_ctx_t *server, int listen_fd,
+                 reactor_handler_fn handler) {
+    memset(reactor, 0, sizeof(*reactor));
+    reactor->server = server;
+    reactor->listen_fd = listen_fd;
+    reactor->handler = handler;
+    reactor->cpu = -1;
+    reactor->poll_fd = -1;
+    reactor->wake_fds[0] = -1;
+    reactor->wake_fds[1] = -1;
+#if HAVE_IO_URING
+    reactor->event_fd = -1;
+#endif
+    reactor->last_sweep_ms = get_monotonic_ms();
+    if (pthread_mutex_init(&reactor->lock, NULL) != 0) {
+        return -1;
+    }
+    if (pipe(reactor->wake_fds) != 0 ||
+        make_nonblocking(reactor->wake_fds[0]) != 0 ||
+        make_nonblocking(reactor->wake_fds[1]) != 0) {
+        log_error("Failed to create reactor wake pipe: %s", strerror(errno));
+        reactor_destroy(reactor);
+        return -1;
+    }
+#if USE_EPOLL
+    // Linux 환경에서는 epoll로 대량 접속을 효율적으로 감지한다.
+    reactor->poll_fd = epoll_create1(0);
+    if (reactor->poll_fd < 0) {
+        log_error("Failed to create epoll instance");
+        reactor_destroy(reactor);
+        return -1;
+    }
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+#if HAVE_IO_URING
+    // io_uring 모드에서는 multishot accept가 리스닝 소켓을 맡으므로 epoll에 올리지 않는다.
+    if (!server->io_uring || uring_setup(reactor) != 0)
+#endif
+    {
+        ev.events = EPOLLIN;
+        ev.data.ptr = NULL; // 리스닝 소켓
+        if (epoll_ctl(reactor->poll_fd, EPOLL_CTL_ADD, listen_fd, &ev) < 0) {
+            log_error("epoll_ctl ADD listen fd failed");
+            reactor_destroy(reactor);
+            return -1;
+        }
+    }
+    ev.events = EPOLLIN;
+    ev.data.ptr = reactor->wake_fds; // 워커 반환 알림
+    if (epoll_ctl(reactor->poll_fd, EPOLL_CTL_ADD, reactor->wake_fds[0], &ev) < 0) {
+        log_error("epoll_ctl ADD wake fd failed");
+        reactor_destroy(reactor);
+        return -1;
+    }
+#endif
+    return 0;
+}
+
+// 다중 리액터 모드에서 각 루프 스레드를 코어 하나에 고정한다.
+int reactor_pin(reactor_t *reactor, int cpu) {
+#if defined(__linux__)
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    if (pthread_setaffinity_np(pthread_self(), sizeof(set), &set) != 0) {
+        log_warn("Failed to pin reactor to CPU %d", cpu);
+        return -1;
+    }
+    reactor->cpu = cpu;
+    return 0;
+#else
+    (void)reactor;
+    (void)cpu;
+    return -1;
+#endif
+}
+
+#if USE_EPOLL
+int reactor_run(reactor_t *reactor, volatile sig_atomic_t *running) {
+    struct epoll_event events[MAX_EVENTS];
+    while (*running) {
+        // epoll_wait으로 새 연결/데이터 도착/송신 가능 상태를 기다린다.
+        int n = epoll_wait(reactor->poll_fd, events, MAX_EVENTS, reactor_pace_timeout(reactor, 1000));
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            log_error("epoll_wait error: %s", strerror(errno));
+            return -1;
+        }
+        for (int i = 0; i < n; ++i) {
+            void *tag = events[i].data.ptr;
+            uint32_t revents = events[i].events;
+            if (tag == NULL) {
+                reactor_accept(reactor);
+                continue;
+            }
+            if (tag == (void *)reactor->wake_fds) {
+                char buf[64];
+                while (read(reactor->wake_fds[0], buf, sizeof(buf)) > 0) {
+                }
+#if HAVE_IO_URING
+                if (reactor->ring) {
+                    uring_drain_queue(reactor);
+                }
+#endif
+                continue;
+            }
+#if HAVE_IO_URING
+            if (tag == (void *)&reactor->event_fd) {
+                uring_reap(reactor);
+                continue;
+            }
+#endif
+            connection_t *conn = (connection_t *)tag;
+            if (conn->state == CONN_STREAMING) {
+                if (revents & (EPOLLERR | EPOLLHUP)) {
+                    reactor_close(conn);
+                } else {
+                    reactor_pump_stream(reactor, conn);
+                }
+            } else if ((revents & (EPOLLERR | EPOLLHUP)) && !(revents & EPOLLIN)) {
+                reactor_close(conn);
+            } else {
+                reactor_dispatch(reactor, conn);
+            }
+        }
+        reactor_pace_wake(reactor);
+        reactor_sweep_idle(reactor);
+#if HAVE_IO_URING
+        if (reactor->ring) {
+            // 이번 바퀴에 쌓인 SQE를 한 번의 io_uring_enter로 제출한다.
+            uring_submit(reactor->ring);
+        }
+#endif
+    }
+    return 0;
+}
+#else
+// epoll을 쓸 수 없는 플랫폼(BSD, macOS 등)은 poll() 기반 루프를 사용한다.
+int reactor_run(reactor_t *reactor, volatile sig_atomic_t *running) {
+    struct pollfd *fds = NULL;
+    connection_t **conns = NULL;
+    size_t capacity = 0;
+    int rc = 0;
+    while (*running) {
+        // 루프가 소유한 연결(READING/STREAMING)만 감시 목록에 올린다.
+        pthread_mutex_lock(&reactor->lock);
+        size_t needed = reactor->connection_count + 2;
+        if (needed > capacity) {
+            size_t new_cap = capacity == 0 ? MAX_EVENTS : capacity;
+            while (new_cap < needed) {
+                new_cap *= 2;
+            }
+            struct pollfd *new_fds = realloc(fds, new_cap * sizeof(*fds));
+            if (new_fds) {
+                fds = new_fds;
+            }
+            connection_t **new_conns = realloc(conns, new_cap * sizeof(*conns));
+            if (new_conns) {
+                conns = new_conns;
+            }
+            if (!new_fds || !new_conns) {
+                pthread_mutex_unlock(&reactor->lock);
+                log_error("Out of memory while growing poll set");
+                rc = -1;
+                break;
+            }
+            capacity = new_cap;
+        }
+        nfds_t count = 0;
+        fds[count].fd = reactor->listen_fd;
+        fds[count].events = POLLIN;
+        conns[count++] = NULL;
+        fds[count].fd = reactor->wake_fds[0];
+        fds[count].events = POLLIN;
+        conns[count++] = NULL;
+        for (connection_t *conn = reactor->connections; conn; conn = conn->next) {
+            if (conn->state == CONN_READING) {
+                fds[count].events = POLLIN;
+            } else if (conn->state == CONN_STREAMING && conn->pace_wake_ms == 0) {
+                fds[count].events = POLLOUT;
+            } else {
+                continue;
+            }
+            fds[count].fd = conn->fd;
+            conns[count++] = conn;
+        }
+        pthread_mutex_unlock(&reactor->lock);
+        for (nfds_t i = 0; i < count; ++i) {
+            fds[i].revents = 0;
+        }
+
+        int n = poll(fds, count, reactor_pace_timeout(reactor, 1000));
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            log_error("poll error: %s", strerror(errno));
+            rc = -1;
+            break;
+        }
+        for (nfds_t i = 2; i < count; ++i) {
+            connection_t *conn = conns[i];
+            short revents = fds[i].revents;
+            if (!revents) {
+                continue;
+            }
+            if (conn->state == CONN_STREAMING) {
+                if (revents & (POLLERR | POLLHUP | POLLNVAL)) {
+                    reactor_close(conn);
+                } else {
+                    reactor_pump_stream(reactor, conn);
+                }
+            } else if ((revents & (POLLERR | POLLHUP | POLLNVAL)) && !(revents & POLLIN)) {
+                reactor_close(conn);
+            } else {
+                reactor_dispatch(reactor, conn);
+            }
+        }
+        if (fds[1].revents & POLLIN) {
+            char buf[64];
+            while (read(reactor->wake_fds[0], buf, sizeof(buf)) > 0) {
+            }
+        }
+        if (fds[0].revents & POLLIN) {
+            reactor_accept(reactor);
+        }
+        reactor_pace_wake(reactor);
+        reactor_sweep_idle(reactor);
+    }
+    free(fds);
+    free(conns);
+    return rc;
+}
+#endif
+
+// 워커가 헤더 송신을 마친 연결의 파일 본문 전송을 이벤트 루프에 넘긴다.
+void reactor_stream(connection_t *conn) {
+    pacer_start(&conn->pacer, conn->fd, conn->stream.pace_rate, conn->stream.pace_burst,
+                !conn->owner->server->stream_pacing_userspace);
+#if HAVE_IO_URING
+    reactor_t *reactor = conn->owner;
+    if (reactor->ring && conn->stream.use_sendfile) {
+        // 링 제출은 루프 스레드만 하므로 대기 목록에 넣고 루프를 깨운다.
+        pthread_mutex_lock(&reactor->lock);
+        conn->state = CONN_STREAMING;
+        conn->last_active_ms = get_monotonic_ms();
+        conn->uring_next = reactor->uring_queue;
+        reactor->uring_queue = conn;
+        pthread_mutex_unlock(&reactor->lock);
+        reactor_wake(reactor);
+        return;
+    }
+#endif
+    reactor_set_state(conn->owner, conn, CONN_STREAMING);
+    reactor_arm(conn->owner, conn, 1);
+}
+
+// 응답을 마친 keep-alive 연결을 이벤트 루프로 돌려 다음 요청을 기다리게 한다.
+void reactor_resume(connection_t *conn) {
+    reactor_set_state(conn->owner, conn, CONN_READING);
+    reactor_arm(conn->owner, conn, 0);
+}
+
+int reactor_requeue(connection_t *conn, thread_pool_lane_t lane) {
+    conn->lane = lane; // 실패하면 호출한 워커가 이 lane의 작업으로 이어서 처리한다.
+    return thread_pool_submit(&conn->owner->server->pool, lane, reactor_job, conn);
+}
+
+// 연결을 목록에서 제거하고 소켓/파일 FD를 정리한다. 소유자(루프 또는 워커)만 호출한다.
+void reactor_close(connection_t *conn) {
+    reactor_t *reactor = conn->owner;
+    pthread_mutex_lock(&reactor->lock);
+    if (conn->prev) {
+        conn->prev->next = conn->next;
+    } else {
+        reactor->connections = conn->next;
+    }
+    if (conn->next) {
+        conn->next->prev = conn->prev;
+    }
+    reactor->connection_count--;
+    pthread_mutex_unlock(&reactor->lock);
+    connection_free(conn);
+}
+
+// 워커 풀이 모두 종료된 뒤 호출해 남은 연결과 FD를 정리한다.
+void reactor_destroy(reactor_t *reactor) {
+#if HAVE_IO_URING
+    // 링을 먼저 닫아 진행 중인 splice가 해제할 연결의 FD를 더 쓰지 않게 한다.
+    if (reactor->ring) {
+        uring_destroy(reactor->ring);
+        free(reactor->ring);
+        reactor->ring = NULL;
+    }
+    if (reactor->event_fd >= 0) {
+        close(reactor->event_fd);
+        reactor->event_fd = -1;
+    }
+#endif
+    connection_t *conn = reactor->connections;
+    while (conn) {
+        connection_t *next = conn->next;
+        connection_free(conn);
+        conn = next;
+    }
+    reactor->connections = NULL;
+    reactor->connection_count = 0;
+    if (reactor->poll_fd >= 0) {
+        close(reactor->poll_fd);
+        reactor->poll_fd = -1;
+    }
+    for (int i = 0; i < 2; ++i) {
+        if (reactor->wake_fds[i] >= 0) {
+            close(reactor->wake_fds[i]);
+            reactor->wake_fds[i] = -1;
+        }
+    }
+    pthread_mutex_destroy(&reactor->lock);
+}
@@ -1,88 +1,340 @@
 // URL 패턴 → 핸들러 매핑을 수행하는 초간단 라우터
 #include "router.h"
 
+#include <limits.h>
+#include <openssl/crypto.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
 #include "http.h"
+#include "metrics.h"
+#include "utils.h"
 
-static const route_entry_t *g_routes = NULL;
-static size_t g_route_count = 0;
+// 경로 segment 하나에 대응하는 트라이 노드. 리프(또는 중간 노드)에서 메서드별로 핸들러를 고른다.
+typedef struct route_node {
+    char *segment;                  // 리터럴 segment (파라미터 노드는 NULL)
+    size_t segment_len;
+    char *param_name;               // 파라미터 노드이면 ":" 뒤의 이름
+    struct route_node **children;   // 리터럴 자식
+    size_t child_count;
+    struct route_node *param_child; // ":name" 자식은 위치마다 하나
+    route_handler_fn handlers[HTTP_UNKNOWN];
+    int route_ids[HTTP_UNKNOWN];    // 메서드별 계측 번호 (metrics_register_route)
+    unsigned char bulk[HTTP_UNKNOWN]; // 메서드별 워커 lane 표시 (route_entry_t.bulk)
+    int has_handler;
+} route_node_t;
 
-// 서버 부팅 시 라우팅 테이블을 등록한다.
-void router_set_routes(const route_entry_t *routes, size_t count) {
-    g_routes = routes;
-    g_route_count = count;
+static route_node_t *g_root = NULL;
+static const char *const k_method_names[HTTP_UNKNOWN] = {"GET", "POST", "PUT", "DELETE", "OPTIONS"};
+
+static void node_free(route_node_t *node) {
+    if (!node) {
+        return;
+    }
+    for (size_t i = 0; i < node->child_count; ++i) {
+        node_free(node->children[i]);
+    }
+    node_free(node->param_child);
+    free(node->children);
+    free(node->segment);
+    free(node->param_name);
+    free(node);
+}
+
+// segment에 해당하는 자식을 찾고 없으면 만든다.
+static route_node_t *node_child(route_node_t *node, const char *segment, size_t len, const char *pattern) {
+    if (segment[0] == ':') {
+        if (node->param_child) {
+            if (strlen(node->param_child->param_name) != len - 1 ||
+                strncmp(node->param_child->param_name, segment + 1, len - 1) != 0) {
+                log_error("Route %s: conflicting parameter name at the same position", pattern);
+                return NULL;
+            }
+            return node->param_child;
+        }
+        route_node_t *child = calloc(1, sizeof(*child));
+        if (!child || !(child->param_name = strndup(segment + 1, len - 1))) {
+            free(child);
+            return NULL;
+        }
+        node->param_child = child;
+        return child;
+    }
+    for (size_t i = 0; i < node->child_count; ++i) {
+        route_node_t *child = node->children[i];
+        if (child->segment_len == len && memcmp(child->segment, segment, len) == 0) {
+            return child;
+        }
+    }
+    route_node_t **grown = realloc(node->children, (node->child_count + 1) * sizeof(*grown));
+    if (!grown) {
+        return NULL;
+    }
+    node->children = grown;
+    route_node_t *child = calloc(1, sizeof(*child));
+    if (!child || !(child->segment = strndup(segment, len))) {
+        free(child);
+        return NULL;
+    }
+    child->segment_len = len;
+    node->children[node->child_count++] = child;
+    return child;
+}
+
+// 서버 부팅 시 라우팅 테이블을 트라이로 컴파일해 등록한다.
+int router_set_routes(const route_entry_t *routes, size_t count) {
+    route_node_t *root = calloc(1, sizeof(*root));
+    if (!root) {
+        return -1;
+    }
+    for (size_t i = 0; i < count; ++i) {
+        const char *pattern = routes[i].path;
+        route_node_t *node = root;
+        const char *cursor = pattern;
+        while (node && *cursor) {
+            if (*cursor == '/') {
+                cursor++;
+                continue;
+            }
+            const char *end = strchrnul(cursor, '/');
+            node = node_child(node, cursor, (size_t)(end - cursor), pattern);
+            cursor = end;
+        }
+        if (!node || routes[i].method >= HTTP_UNKNOWN || node->handlers[routes[i].method]) {
+            if (node) {
+                log_error("Route %s: duplicate or invalid method", pattern);
+            }
+            node_free(root);
+            return -1;
+        }
+        node->handlers[routes[i].method] = routes[i].handler;
+        node->route_ids[routes[i].method] = metrics_register_route(k_method_names[routes[i].method], pattern);
+        node->bulk[routes[i].method] = routes[i].bulk != 0;
+        node->has_handler = 1;
+    }
+    node_free(g_root);
+    g_root = root;
+    return 0;
+}
+
+void router_shutdown(void) {
+    node_free(g_root);
+    g_root = NULL;
+}
+
+// 숫자로만 된 segment를 int로 바꾼다. 범위를 넘거나 숫자가 아니면 0
+static int segment_to_int(const char *s, size_t len, int *out) {
+    if (len == 0 || len > 10) {
+        return 0;
+    }
+    long long v = 0;
+    for (size_t i = 0; i < len; ++i) {
+        if (s[i] < '0' || s[i] > '9') {
+            return 0;
+        }
+        v = v * 10 + (s[i] - '0');
+    }
+    if (v > INT_MAX) {
+        return 0;
+    }
+    *out = (int)v;
+    return 1;
+}
+
+// 요청 경로를 복사 없이 segment 단위로 따라 내려간다. 리터럴을 먼저 보고 실패하면 파라미터로 되돌아간다.
+// method 핸들러가 있는 노드를 돌려주고, 경로만 맞는 첫 노드는 *path_match에 남겨 405 판단에 쓴다.
+static const route_node_t *match_node(const route_node_t *node, const char *cursor, http_method_t method,
+                                      request_ctx_t *ctx, const route_node_t **path_match) {
+    while (*cursor == '/') {
+        cursor++;
+    }
+    if (!*cursor) {
+        if (!node->has_handler) {
+            return NULL;
+        }
+        if (method < HTTP_UNKNOWN && node->handlers[method]) {
+            return node;
+        }
+        if (!*path_match) {
+            *path_match = node;
+        }
+        return NULL;
+    }
+    const char *end = strchrnul(cursor, '/');
+    size_t len = (size_t)(end - cursor);
+    for (size_t i = 0; i < node->child_count; ++i) {
+        const route_node_t *child = node->children[i];
+        if (child->segment_len == len && memcmp(child->segment, cursor, len) == 0) {
+            const route_node_t *found = match_node(child, end, method, ctx, path_match);
+            if (found) {
+                return found;
+            }
+            break;
+        }
+    }
+    if (node->param_child && !ctx) {
+        // 라우트 분류만 할 때는 파라미터를 기록하지 않는다.
+        return match_node(node->param_child, end, method, NULL, path_match);
+    }
+    if (node->param_child && ctx->param_count < ARRAY_SIZE(ctx->params)) {
+        struct route_param *param = &ctx->params[ctx->param_count++];
+        param->key = node->param_child->param_name;
+        param->value = cursor;
+        param->length = len;
+        param->is_int = segment_to_int(cursor, len, &param->int_value);
+        const route_node_t *found = match_node(node->param_child, end, method, ctx, path_match);
+        if (found) {
+            return found;
+        }
+        ctx->param_count--;
+    }
+    return NULL;
+}
+
+int router_route_is_bulk(http_method_t method, const char *path) {
+    const route_node_t *path_match = NULL;
+    const route_node_t *node = g_root && path ? match_node(g_root, path, method, NULL, &path_match) : NULL;
+    return node ? node->bulk[method] : 0;
 }
 
 // path parameter(":id" 등)를 조회한다.
-const char *router_get_param(const request_ctx_t *ctx, const char *name) {
+const char *router_get_param(const request_ctx_t *ctx, const char *name, size_t *length_out) {
     for (size_t i = 0; i < ctx->param_count; ++i) {
         if (strcmp(ctx->params[i].key, name) == 0) {
+            if (length_out) {
+                *length_out = ctx->params[i].length;
+            }
             return ctx->params[i].value;
         }
     }
     return NULL;
 }
 
-// 라우트 segment와 실제 경로 segment가 일치하는지 비교한다.
-static int segment_match(const char *route_seg, const char *path_seg, request_ctx_t *ctx) {
-    if (route_seg[0] == ':' && ctx) {
-        if (ctx->param_count < sizeof(ctx->params) / sizeof(ctx->params[0])) {
-            strncpy(ctx->params[ctx->param_count].key, route_seg + 1,
-                    sizeof(ctx->params[ctx->param_count].key) - 1);
-            strncpy(ctx->params[ctx->param_count].value, path_seg,
-                    sizeof(ctx->params[ctx->param_count].value) - 1);
-            ctx->param_count++;
-            return 1;
+// 매칭 때 변환해 둔 정수 파라미터를 돌려준다.
+int router_get_param_int(const request_ctx_t *ctx, const char *name, int *value_out) {
+    for (size_t i = 0; i < ctx->param_count; ++i) {
+        if (strcmp(ctx->params[i].key, name) == 0) {
+            if (!ctx->params[i].is_int) {
+                return -1;
+            }
+            *value_out = ctx->params[i].int_value;
+            return 0;
         }
-        return 0;
     }
-    return strcmp(route_seg, path_seg) == 0;
+    return -1;
 }
 
-// 전체 경로(`/api/videos/:id`)와 요청 경로(`/api/videos/10`)를 비교한다.
-static int path_matches(const char *route_path, const char *request_path, request_ctx_t *ctx) {
-    char route_buf[512];
-    char path_buf[512];
-    strncpy(route_buf, route_path, sizeof(route_buf) - 1);
-    route_buf[sizeof(route_buf) - 1] = '\0';
-    strncpy(path_buf, request_path, sizeof(path_buf) - 1);
-    path_buf[sizeof(path_buf) - 1] = '\0';
+// URL 인코딩 해석을 위한 헥사 문자 → 값 변환
+static int hex_value(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
 
-    char *route_save = NULL;
-    char *path_save = NULL;
-    char *route_seg = strtok_r(route_buf, "/", &route_save);
-    char *path_seg = strtok_r(path_buf, "/", &path_save);
-    while (route_seg || path_seg) {
-        if (!route_seg || !path_seg) {
-            return 0;
+// 쿼리 파라미터에 있는 %XX 표현을 실제 문자로 되돌린다.
+static int url_decode_component(const char *src, size_t len, char *dst, size_t dst_len) {
+    if (!src || !dst || dst_len == 0) {
+        return -1;
+    }
+    size_t di = 0;
+    for (size_t si = 0; si < len; ++si) {
+        char c = src[si];
+        if (c == '+') {
+            c = ' ';
+        } else if (c == '%' && si + 2 < len) {
+            int hi = hex_value(src[si + 1]);
+            int lo = hex_value(src[si + 2]);
+            if (hi >= 0 && lo >= 0) {
+                c = (char)((hi << 4) | lo);
+                si += 2;
+            }
         }
-        if (!segment_match(route_seg, path_seg, ctx)) {
-            return 0;
+        if (di + 1 >= dst_len) {
+            return -1;
         }
-        route_seg = strtok_r(NULL, "/", &route_save);
-        path_seg = strtok_r(NULL, "/", &path_save);
+        dst[di++] = c;
     }
-    return 1;
+    dst[di] = '\0';
+    return 0;
 }
 
-// 라우팅 테이블을 순회하며 첫 번째 일치 항목을 찾아 실행한다.
+// 쿼리 문자열에서 name 파라미터를 찾아 URL 디코딩한 값을 out에 담는다.
+int router_get_query(const request_ctx_t *ctx, const char *name, char *out, size_t out_len) {
+    const char *query = ctx && ctx->request ? ctx->request->query : NULL;
+    if (!query || !*query || !name || !out || out_len == 0) {
+        return -1;
+    }
+    size_t name_len = strlen(name);
+    const char *cursor = query;
+    while (*cursor) {
+        const char *amp = strchr(cursor, '&');
+        size_t pair_len = amp ? (size_t)(amp - cursor) : strlen(cursor);
+        const char *eq = memchr(cursor, '=', pair_len);
+        size_t key_len = eq ? (size_t)(eq - cursor) : pair_len;
+        if (key_len == name_len && strncmp(cursor, name, name_len) == 0) {
+            const char *value_start = eq ? eq + 1 : cursor + key_len;
+            size_t value_len = eq ? pair_len - key_len - 1 : 0;
+            if (value_len == 0) {
+                out[0] = '\0';
+                return 0;
+            }
+            return url_decode_component(value_start, value_len, out, out_len);
+        }
+        if (!amp) {
+            break;
+        }
+        cursor = amp + 1;
+    }
+    return -1;
+}
+
+// 정수 쿼리 파라미터를 파싱한다.
+int router_get_query_int(const request_ctx_t *ctx, const char *name, int *value_out) {
+    char buf[32];
+    if (router_get_query(ctx, name, buf, sizeof(buf)) != 0) {
+        return -1;
+    }
+    char *end = NULL;
+    long v = strtol(buf, &end, 10);
+    if (!end || *end != '\0') {
+        return -1;
+    }
+    *value_out = (int)v;
+    return 0;
+}
+
+// 트라이에서 경로와 메서드에 맞는 핸들러를 찾아 실행한다.
+// 경로는 있지만 메서드가 다르면 Allow 헤더와 함께 405, 경로가 없으면 404를 보낸다.
 void router_handle(request_ctx_t *ctx) {
     ctx->param_count = 0;
-    for (size_t i = 0; i < g_route_count; ++i) {
-        request_ctx_t temp_ctx = *ctx;
-        temp_ctx.param_count = 0;
-        if (g_routes[i].method == ctx->request->method &&
-            path_matches(g_routes[i].path, ctx->request->path, &temp_ctx)) {
-            *ctx = temp_ctx;
-            g_routes[i].handler(ctx);
-            return;
+    const route_node_t *path_match = NULL;
+    const route_node_t *node = g_root ? match_node(g_root, ctx->request->path, ctx->request->method, ctx, &path_match)
+                                      : NULL;
+    if (node) {
+        ctx->route_id = node->route_ids[ctx->request->method];
+        node->handlers[ctx->request->method](ctx);
+        return;
+    }
+    ctx->param_count = 0;
+    ctx->route_id = METRICS_ROUTE_UNMATCHED;
+    if (path_match) {
+        char allow[96] = "Allow: ";
+        size_t used = strlen(allow);
+        for (int m = 0; m < HTTP_UNKNOWN; ++m) {
+            if (path_match->handlers[m]) {
+                used += (size_t)snprintf(allow + used, sizeof(allow) - used, "%s%s",
+                                         used > 7 ? ", " : "", k_method_names[m]);
+            }
         }
+        snprintf(allow + used, sizeof(allow) - used, "\r\n");
+        router_send_json(ctx, 405, "{\"error\":\"Method Not Allowed\"}", allow);
+        return;
     }
     const char body[] = "{\"error\":\"Not Found\"}";
     http_send_response(ctx->client_fd, 404, "Not Found", "application/json",
-                       body, sizeof(body) - 1, ctx->server->security_headers);
+                       body, sizeof(body) - 1, ctx->server->security_headers, ctx->keep_alive);
 }
 
 // JSON 응답을 표준 보안 헤더와 함께 내려준다.
@@ -90,18 +342,10 @@ int router_send_json(request_ctx_t *ctx, int status, const char *json_body, cons
     if (!json_body) {
         json_body = "{}";
     }
-    size_t json_len = strlen(json_body);
-    const char *base = ctx->server->security_headers[0] ? ctx->server->security_headers : "";
-    const char *headers = base;
-    char combined[1024];
-    if (extra_headers && *extra_headers) {
-        if (snprintf(combined, sizeof(combined), "%s%s", base, extra_headers) >= (int)sizeof(combined)) {
-            return -1;
-        }
-        headers = combined;
-    }
-    return http_send_response(ctx->client_fd, status, http_status_text(status), "application/json",
-                              json_body, json_len, headers);
+    // 보안 헤더는 시작 시 만든 문자열을 그대로 가리키고, 추가 헤더와 함께 writev 한 번에 나간다.
+    return http_send_response_blocks(ctx->client_fd, status, http_status_text(status), "application/json", json_body,
+                                     strlen(json_body), ctx->server->security_headers, extra_headers,
+                                     ctx->keep_alive);
 }
 
 // 에러 메시지를 JSON 형태로 감싸는 헬퍼
@@ -115,3 +359,21 @@ int router_send_json_error(request_ctx_t *ctx, int status, const char *message)
     }
     return router_send_json(ctx, status, body, NULL);
 }
+
+// 관리자 엔드포인트 공통 검사: X-Admin-Token이 ADMIN_TOKEN과 일치하지 않으면 에러를 보내고 -1.
+// ADMIN_TOKEN이 비어 있으면 엔드포인트가 없는 것처럼 404를 돌려준다.
+int router_require_admin(request_ctx_t *ctx) {
+    const char *expected = ctx->server->admin_token;
+    if (!expected[0]) {
+        router_send_json_error(ctx, 404, "Not Found");
+        return -1;
+    }
+    const char *provided = http_get_header(ctx->request, "X-Admin-Token");
+    size_t expected_len = strlen(expected);
+    if (!provided || strlen(provided) != expected_len ||
+        CRYPTO_memcmp(provided, expected, expected_len) != 0) {
+        router_send_json_error(ctx, 403, "Forbidden");
+        return -1;
+    }
+    return 0;
+}
@@ -0,0 +1,207 @@
+// 인증 경로에서 SQLite 조회를 피하기 위한 세션 캐시: 토큰 해시로 샤드를 나눠 잠금 경합을 줄인다.
+#include "session_cache.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// FNV-1a 64비트 해시 (토큰은 이미 난수이므로 분산만 고르면 충분하다)
+static uint64_t token_hash(const char *token) {
+    uint64_t h = 1469598103934665603ULL;
+    for (const unsigned char *p = (const unsigned char *)token; *p; ++p) {
+        h ^= *p;
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+static session_cache_shard_t *shard_for(session_cache_t *cache, uint64_t hash) {
+    return &cache->shards[hash % SESSION_CACHE_SHARDS];
+}
+
+static size_t bucket_for(uint64_t hash) {
+    return (size_t)((hash / SESSION_CACHE_SHARDS) % SESSION_CACHE_BUCKETS);
+}
+
+// 캐시를 초기화한다. capacity는 전체 최대 항목 수, ttl_sec는 항목 재검증 주기.
+int session_cache_init(session_cache_t *cache, size_t capacity, int ttl_sec) {
+    if (!cache) return -1;
+    memset(cache, 0, sizeof(*cache));
+    cache->shard_capacity = capacity / SESSION_CACHE_SHARDS;
+    if (cache->shard_capacity == 0) {
+        cache->shard_capacity = 1;
+    }
+    cache->ttl_sec = ttl_sec > 0 ? ttl_sec : 300;
+    atomic_init(&cache->hits, 0);
+    atomic_init(&cache->misses, 0);
+    for (size_t i = 0; i < SESSION_CACHE_SHARDS; ++i) {
+        if (pthread_mutex_init(&cache->shards[i].lock, NULL) != 0) {
+            while (i-- > 0) {
+                pthread_mutex_destroy(&cache->shards[i].lock);
+            }
+            return -1;
+        }
+    }
+    cache->initialized = 1;
+    return 0;
+}
+
+// 샤드에서 만료된 항목을 모두 제거한다. 샤드 잠금을 잡은 상태에서 호출한다.
+static void shard_evict_expired(session_cache_shard_t *shard, time_t now) {
+    for (size_t b = 0; b < SESSION_CACHE_BUCKETS; ++b) {
+        session_cache_entry_t **link = &shard->buckets[b];
+        while (*link) {
+            session_cache_entry_t *entry = *link;
+            if (entry->cached_until <= now) {
+                *link = entry->next;
+                free(entry);
+                shard->count--;
+            } else {
+                link = &entry->next;
+            }
+        }
+    }
+}
+
+// 공간이 없을 때 버킷 하나의 마지막 항목을 내보낸다. 샤드 잠금을 잡은 상태에서 호출한다.
+static void shard_evict_one(session_cache_shard_t *shard, size_t preferred_bucket) {
+    for (size_t i = 0; i < SESSION_CACHE_BUCKETS; ++i) {
+        session_cache_entry_t **link = &shard->buckets[(preferred_bucket + i) % SESSION_CACHE_BUCKETS];
+        if (!*link) continue;
+        while ((*link)->next) {
+            link = &(*link)->next;
+        }
+        free(*link);
+        *link = NULL;
+        shard->count--;
+        return;
+    }
+}
+
+// 토큰으로 캐시를 조회한다. 적중하면 0, 없거나 만료되었으면 -1.
+int session_cache_lookup(session_cache_t *cache, const char *token, time_t now,
+                         int *user_id_out, char *username_out, size_t username_len) {
+    if (!cache || !cache->initialized || !token) return -1;
+    uint64_t hash = token_hash(token);
+    session_cache_shard_t *shard = shard_for(cache, hash);
+    int found = -1;
+    pthread_mutex_lock(&shard->lock);
+    session_cache_entry_t **link = &shard->buckets[bucket_for(hash)];
+    while (*link) {
+        session_cache_entry_t *entry = *link;
+        if (strcmp(entry->token, token) == 0) {
+            if (entry->cached_until <= now) {
+                // 세션 만료 또는 재검증 시점: 항목을 버리고 DB 경로로 돌린다.
+                *link = entry->next;
+                free(entry);
+                shard->count--;
+            } else {
+                if (user_id_out) *user_id_out = entry->user_id;
+                if (username_out && username_len > 0) {
+                    snprintf(username_out, username_len, "%s", entry->username);
+                }
+                found = 0;
+            }
+            break;
+        }
+        link = &entry->next;
+    }
+    pthread_mutex_unlock(&shard->lock);
+    atomic_fetch_add(found == 0 ? &cache->hits : &cache->misses, 1);
+    return found;
+}
+
+// DB에서 확인한 세션을 캐시에 넣는다. 같은 토큰이 있으면 덮어쓴다.
+void session_cache_store(session_cache_t *cache, const char *token, int user_id,
+                         const char *username, time_t expires_at, time_t now) {
+    if (!cache || !cache->initialized || !token || expires_at <= now) return;
+    if (strlen(token) >= sizeof(((session_cache_entry_t *)0)->token)) return;
+    uint64_t hash = token_hash(token);
+    session_cache_shard_t *shard = shard_for(cache, hash);
+    size_t bucket = bucket_for(hash);
+    time_t cached_until = now + cache->ttl_sec;
+    if (cached_until > expires_at) {
+        cached_until = expires_at;
+    }
+    pthread_mutex_lock(&shard->lock);
+    session_cache_entry_t *entry = shard->buckets[bucket];
+    while (entry && strcmp(entry->token, token) != 0) {
+        entry = entry->next;
+    }
+    if (!entry) {
+        if (shard->count >= cache->shard_capacity) {
+            shard_evict_expired(shard, now);
+            if (shard->count >= cache->shard_capacity) {
+                shard_evict_one(shard, bucket);
+            }
+        }
+        entry = calloc(1, sizeof(*entry));
+        if (!entry) {
+            pthread_mutex_unlock(&shard->lock);
+            return;
+        }
+        snprintf(entry->token, sizeof(entry->token), "%s", token);
+        entry->next = shard->buckets[bucket];
+        shard->buckets[bucket] = entry;
+        shard->count++;
+    }
+    entry->user_id = user_id;
+    snprintf(entry->username, sizeof(entry->username), "%s", username ? username : "");
+    entry->expires_at = expires_at;
+    entry->cached_until = cached_until;
+    pthread_mutex_unlock(&shard->lock);
+}
+
+// 로그아웃 등으로 무효화된 토큰을 캐시에서 제거한다.
+void session_cache_remove(session_cache_t *cache, const char *token) {
+    if (!cache || !cache->initialized || !token) return;
+    uint64_t hash = token_hash(token);
+    session_cache_shard_t *shard = shard_for(cache, hash);
+    pthread_mutex_lock(&shard->lock);
+    session_cache_entry_t **link = &shard->buckets[bucket_for(hash)];
+    while (*link) {
+        session_cache_entry_t *entry = *link;
+        if (strcmp(entry->token, token) == 0) {
+            *link = entry->next;
+            free(entry);
+            shard->count--;
+            break;
+        }
+        link = &entry->next;
+    }
+    pthread_mutex_unlock(&shard->lock);
+}
+
+// 적중/미스 카운터와 현재 항목 수를 모은다.
+void session_cache_get_stats(session_cache_t *cache, session_cache_stats_t *stats) {
+    if (!stats) return;
+    memset(stats, 0, sizeof(*stats));
+    if (!cache || !cache->initialized) return;
+    stats->hits = atomic_load(&cache->hits);
+    stats->misses = atomic_load(&cache->misses);
+    for (size_t i = 0; i < SESSION_CACHE_SHARDS; ++i) {
+        pthread_mutex_lock(&cache->shards[i].lock);
+        stats->entries += cache->shards[i].count;
+        pthread_mutex_unlock(&cache->shards[i].lock);
+    }
+}
+
+// 모든 항목과 샤드 잠금을 해제한다.
+void session_cache_destroy(session_cache_t *cache) {
+    if (!cache || !cache->initialized) return;
+    for (size_t i = 0; i < SESSION_CACHE_SHARDS; ++i) {
+        session_cache_shard_t *shard = &cache->shards[i];
+        for (size_t b = 0; b < SESSION_CACHE_BUCKETS; ++b) {
+            session_cache_entry_t *entry = shard->buckets[b];
+            while (entry) {
+                session_cache_entry_t *next = entry->next;
+                free(entry);
+                entry = next;
+            }
+            shard->buckets[b] = NULL;
+        }
+        shard->count = 0;
+        pthread_mutex_destroy(&shard->lock);
+    }
+    cache->initialized = 0;
+}
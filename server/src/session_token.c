@@ -0,0 +1,265 @@
+// 무상태 세션 토큰. 토큰은 아래 바이트열을 base64url로 인코딩한 것이다 (정수는 빅엔디안).
+//   [버전 1][키 ID 1][user_id 4][만료 시각 8][토큰 ID 8][사용자 이름 길이 1][사용자 이름] + HMAC-SHA256 앞 16바이트
+// 검증은 디코딩, HMAC 한 번, 만료/폐기 확인뿐이라 DB나 다른 노드를 보지 않는다.
+#include "session_token.h"
+
+#include <openssl/crypto.h>
+#include <openssl/evp.h>
+#include <openssl/hmac.h>
+#include <openssl/rand.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "utils.h"
+
+#define TOKEN_VERSION 1
+#define TOKEN_HEADER_LEN 23 // 버전부터 사용자 이름 길이까지
+#define TOKEN_MAC_LEN 16
+#define TOKEN_BYTES_MAX (TOKEN_HEADER_LEN + SESSION_TOKEN_USERNAME_MAX + TOKEN_MAC_LEN)
+#define TOKEN_SECRET_MIN 16
+
+static void put_be(unsigned char *p, uint64_t value, int bytes) {
+    for (int i = bytes - 1; i >= 0; --i) {
+        p[i] = (unsigned char)(value & 0xFF);
+        value >>= 8;
+    }
+}
+
+static uint64_t get_be(const unsigned char *p, int bytes) {
+    uint64_t value = 0;
+    for (int i = 0; i < bytes; ++i) {
+        value = (value << 8) | p[i];
+    }
+    return value;
+}
+
+static int compute_mac(const session_token_key_t *key, const unsigned char *data, size_t len,
+                       unsigned char out[TOKEN_MAC_LEN]) {
+    unsigned char digest[EVP_MAX_MD_SIZE];
+    unsigned int digest_len = 0;
+    if (!HMAC(EVP_sha256(), key->secret, (int)key->secret_len, data, len, digest, &digest_len) ||
+        digest_len < TOKEN_MAC_LEN) {
+        return -1;
+    }
+    memcpy(out, digest, TOKEN_MAC_LEN);
+    OPENSSL_cleanse(digest, sizeof(digest));
+    return 0;
+}
+
+// "kid:secret" 목록을 읽는다. 키 ID가 겹치거나 비밀이 너무 짧으면 -1.
+static int parse_keys(session_tokens_t *tokens, const char *spec) {
+    const char *p = spec;
+    while (p && *p) {
+        const char *end = strchr(p, ',');
+        size_t len = end ? (size_t)(end - p) : strlen(p);
+        const char *colon = memchr(p, ':', len);
+        if (len > 0) {
+            if (!colon || tokens->key_count >= SESSION_TOKEN_MAX_KEYS) {
+                return -1;
+            }
+            char *id_end = NULL;
+            long id = strtol(p, &id_end, 10);
+            size_t secret_len = len - (size_t)(colon + 1 - p);
+            if (id_end != colon || id < 0 || id > 255 || secret_len < TOKEN_SECRET_MIN ||
+                secret_len > SESSION_TOKEN_SECRET_MAX) {
+                return -1;
+            }
+            for (size_t i = 0; i < tokens->key_count; ++i) {
+                if (tokens->keys[i].id == (uint8_t)id) {
+                    return -1;
+                }
+            }
+            session_token_key_t *key = &tokens->keys[tokens->key_count++];
+            key->id = (uint8_t)id;
+            memcpy(key->secret, colon + 1, secret_len);
+            key->secret_len = secret_len;
+        }
+        p = end ? end + 1 : NULL;
+    }
+    return tokens->key_count > 0 ? 0 : -1;
+}
+
+int session_tokens_init(session_tokens_t *tokens, const char *keys_spec, size_t revoked_limit) {
+    if (!tokens || !keys_spec) {
+        return -1;
+    }
+    memset(tokens, 0, sizeof(*tokens));
+    if (parse_keys(tokens, keys_spec) != 0) {
+        OPENSSL_cleanse(tokens->keys, sizeof(tokens->keys));
+        return -1;
+    }
+    tokens->revoked_limit = revoked_limit > 0 ? revoked_limit : 1;
+    size_t slots = 16;
+    while (slots < tokens->revoked_limit * 2) {
+        slots *= 2;
+    }
+    tokens->revoked = calloc(slots, sizeof(*tokens->revoked));
+    if (!tokens->revoked) {
+        OPENSSL_cleanse(tokens->keys, sizeof(tokens->keys));
+        return -1;
+    }
+    tokens->revoked_slots = slots;
+    atomic_init(&tokens->revoked_count, 0);
+    pthread_mutex_init(&tokens->revoked_lock, NULL);
+    tokens->initialized = 1;
+    return 0;
+}
+
+int session_token_issue(session_tokens_t *tokens, int user_id, const char *username, time_t expires_at,
+                        char *out, size_t out_len) {
+    if (!tokens || !tokens->initialized || !username || !out || user_id <= 0) {
+        return -1;
+    }
+    size_t name_len = strlen(username);
+    if (name_len > SESSION_TOKEN_USERNAME_MAX) {
+        return -1;
+    }
+    unsigned char raw[TOKEN_BYTES_MAX];
+    unsigned char token_id[8];
+    if (RAND_bytes(token_id, sizeof(token_id)) != 1) {
+        return -1;
+    }
+    const session_token_key_t *key = &tokens->keys[0];
+    raw[0] = TOKEN_VERSION;
+    raw[1] = key->id;
+    put_be(raw + 2, (uint32_t)user_id, 4);
+    put_be(raw + 6, (uint64_t)expires_at, 8);
+    memcpy(raw + 14, token_id, sizeof(token_id));
+    raw[22] = (unsigned char)name_len;
+    memcpy(raw + TOKEN_HEADER_LEN, username, name_len);
+    size_t signed_len = TOKEN_HEADER_LEN + name_len;
+    if (compute_mac(key, raw, signed_len, raw + signed_len) != 0) {
+        return -1;
+    }
+    return base64url_encode(raw, signed_len + TOKEN_MAC_LEN, out, out_len) > 0 ? 0 : -1;
+}
+
+// 폐기 목록에서 token_id의 칸을 찾는다 (없으면 처음 만난 빈 칸). 잠금을 쥔 채 호출한다.
+static session_token_revoked_t *revoked_slot(session_token_revoked_t *table, size_t slots, uint64_t token_id) {
+    size_t mask = slots - 1;
+    for (size_t i = (size_t)token_id & mask;; i = (i + 1) & mask) {
+        if (table[i].token_id == 0 || table[i].token_id == token_id) {
+            return &table[i];
+        }
+    }
+}
+
+static int is_revoked(session_tokens_t *tokens, uint64_t token_id) {
+    // 로그아웃이 한 번도 없었으면 잠금 없이 끝난다.
+    if (atomic_load_explicit(&tokens->revoked_count, memory_order_acquire) == 0) {
+        return 0;
+    }
+    pthread_mutex_lock(&tokens->revoked_lock);
+    int found = revoked_slot(tokens->revoked, tokens->revoked_slots, token_id)->token_id == token_id;
+    pthread_mutex_unlock(&tokens->revoked_lock);
+    return found;
+}
+
+// 서명과 형식만 확인해 claims를 채운다 (만료/폐기는 보지 않는다).
+static int decode_token(session_tokens_t *tokens, const char *token, session_token_claims_t *claims) {
+    unsigned char raw[TOKEN_BYTES_MAX + 3];
+    if (!tokens || !tokens->initialized || !token || strlen(token) > (TOKEN_BYTES_MAX * 4 + 2) / 3) {
+        return -1;
+    }
+    int len = base64url_decode(token, raw, sizeof(raw));
+    if (len < TOKEN_HEADER_LEN + TOKEN_MAC_LEN || raw[0] != TOKEN_VERSION) {
+        return -1;
+    }
+    size_t name_len = raw[22];
+    size_t signed_len = TOKEN_HEADER_LEN + name_len;
+    if (name_len > SESSION_TOKEN_USERNAME_MAX || (size_t)len != signed_len + TOKEN_MAC_LEN) {
+        return -1;
+    }
+    const session_token_key_t *key = NULL;
+    for (size_t i = 0; i < tokens->key_count; ++i) {
+        if (tokens->keys[i].id == raw[1]) {
+            key = &tokens->keys[i];
+            break;
+        }
+    }
+    unsigned char mac[TOKEN_MAC_LEN];
+    if (!key || compute_mac(key, raw, signed_len, mac) != 0 ||
+        CRYPTO_memcmp(mac, raw + signed_len, TOKEN_MAC_LEN) != 0) {
+        return -1;
+    }
+    claims->user_id = (int)get_be(raw + 2, 4);
+    claims->expires_at = (time_t)get_be(raw + 6, 8);
+    claims->token_id = get_be(raw + 14, 8);
+    memcpy(claims->username, raw + TOKEN_HEADER_LEN, name_len);
+    claims->username[name_len] = '\0';
+    return claims->user_id > 0 && claims->token_id != 0 ? 0 : -1;
+}
+
+int session_token_verify(session_tokens_t *tokens, const char *token, time_t now,
+                         session_token_claims_t *claims) {
+    session_token_claims_t decoded;
+    if (decode_token(tokens, token, &decoded) != 0 || decoded.expires_at <= now ||
+        is_revoked(tokens, decoded.token_id)) {
+        return -1;
+    }
+    if (claims) {
+        *claims = decoded;
+    }
+    return 0;
+}
+
+// 만료된 폐기 항목을 걸러 표를 다시 만든다. 잠금을 쥔 채 호출한다.
+static void purge_revoked(session_tokens_t *tokens, time_t now) {
+    session_token_revoked_t *fresh = calloc(tokens->revoked_slots, sizeof(*fresh));
+    if (!fresh) {
+        return;
+    }
+    size_t kept = 0;
+    for (size_t i = 0; i < tokens->revoked_slots; ++i) {
+        const session_token_revoked_t *entry = &tokens->revoked[i];
+        if (entry->token_id != 0 && entry->expires_at > now) {
+            *revoked_slot(fresh, tokens->revoked_slots, entry->token_id) = *entry;
+            kept++;
+        }
+    }
+    free(tokens->revoked);
+    tokens->revoked = fresh;
+    atomic_store_explicit(&tokens->revoked_count, kept, memory_order_release);
+}
+
+int session_token_revoke(session_tokens_t *tokens, const char *token, time_t now) {
+    session_token_claims_t claims;
+    if (decode_token(tokens, token, &claims) != 0 || claims.expires_at <= now) {
+        return 0; // 이미 통과할 수 없는 토큰
+    }
+    pthread_mutex_lock(&tokens->revoked_lock);
+    size_t count = atomic_load_explicit(&tokens->revoked_count, memory_order_relaxed);
+    if (count >= tokens->revoked_limit) {
+        purge_revoked(tokens, now);
+        count = atomic_load_explicit(&tokens->revoked_count, memory_order_relaxed);
+    }
+    int rc = 0;
+    session_token_revoked_t *slot = revoked_slot(tokens->revoked, tokens->revoked_slots, claims.token_id);
+    if (slot->token_id == claims.token_id) {
+        rc = 0;
+    } else if (count >= tokens->revoked_limit) {
+        rc = -1;
+    } else {
+        slot->token_id = claims.token_id;
+        slot->expires_at = claims.expires_at;
+        atomic_store_explicit(&tokens->revoked_count, count + 1, memory_order_release);
+    }
+    pthread_mutex_unlock(&tokens->revoked_lock);
+    return rc;
+}
+
+size_t session_tokens_revoked_count(session_tokens_t *tokens) {
+    return tokens && tokens->initialized ? atomic_load(&tokens->revoked_count) : 0;
+}
+
+void session_tokens_destroy(session_tokens_t *tokens) {
+    if (!tokens || !tokens->initialized) {
+        return;
+    }
+    pthread_mutex_destroy(&tokens->revoked_lock);
+    free(tokens->revoked);
+    tokens->revoked = NULL;
+    OPENSSL_cleanse(tokens->keys, sizeof(tokens->keys));
+    tokens->initialized = 0;
+}
@@ -0,0 +1,483 @@
+// 정적 자산 캐시: 시작 시 static_dir을 읽어 변하지 않는 테이블을 만들고, 파일이 바뀌면 새 테이블로 바꾼다.
+// 항목마다 원본/gzip/br 본문과 200/304 응답 헤더를 미리 만들어 두어 적중 시 writev 한 번으로 끝난다.
+#include "static_cache.h"
+
+#include <dirent.h>
+#include <errno.h>
+#include <limits.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <zlib.h>
+
+#ifdef HAVE_BROTLI
+#include <brotli/encode.h>
+#endif
+
+#include "utils.h"
+
+#define STATIC_MAX_DEPTH 8
+
+typedef enum {
+    STATIC_IDENTITY,
+    STATIC_GZIP,
+    STATIC_BROTLI,
+    STATIC_VARIANT_COUNT
+} static_encoding_t;
+
+// 인코딩 하나의 완성된 응답 조각. body가 NULL이면 그 인코딩은 없다.
+typedef struct {
+    char *body;
+    size_t length;
+    char *headers;          // 200 응답의 상태 줄/Connection 뒤 나머지 헤더 (빈 줄 포함)
+    size_t headers_length;
+    char *not_modified;     // 304 응답의 나머지 헤더 (빈 줄 포함)
+    size_t not_modified_length;
+    http_validator_t validator;
+} static_variant_t;
+
+typedef struct static_entry {
+    char *path; // static_dir 기준 상대 경로 ("js/videos.js")
+    static_variant_t variants[STATIC_VARIANT_COUNT];
+    struct static_entry *next;
+} static_entry_t;
+
+// 한 번 만들어진 뒤에는 바뀌지 않는 테이블. 요청은 참조를 잡고 읽고, 교체는 새 테이블로 한다.
+typedef struct {
+    atomic_int refs;
+    static_entry_t **buckets;
+    size_t bucket_count;
+    size_t file_count;
+    size_t total_bytes;
+} static_table_t;
+
+typedef struct {
+    pthread_mutex_t lock; // current 포인터 교체/참조 획득용
+    static_table_t *current;
+    uint64_t fingerprint;  // current를 만들 때의 디렉터리 지문
+    pthread_t thread;
+    int running;
+    atomic_int stop;
+    server_ctx_t *server;
+} static_cache_t;
+
+static static_cache_t g_static = {.lock = PTHREAD_MUTEX_INITIALIZER};
+
+static const char *const k_encoding_names[STATIC_VARIANT_COUNT] = {NULL, "gzip", "br"};
+static const char *const k_etag_suffix[STATIC_VARIANT_COUNT] = {"", "-gz", "-br"};
+
+static uint64_t fnv1a(uint64_t h, const void *data, size_t len) {
+    const unsigned char *p = data;
+    for (size_t i = 0; i < len; ++i) {
+        h ^= p[i];
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+static size_t path_bucket(const char *path, size_t bucket_count) {
+    return (size_t)(fnv1a(1469598103934665603ULL, path, strlen(path)) % bucket_count);
+}
+
+// HTML은 파일명이 바뀌지 않으므로 매번 검증자로 재확인하게 하고, 나머지는 설정된 정책을 따른다.
+const char *static_cache_control_for(const server_ctx_t *server, const char *mime) {
+    return strncmp(mime, "text/html", 9) == 0 ? "no-cache" : server->static_cache_control;
+}
+
+// 압축해서 이득이 있는 텍스트 계열인지 판단한다. 이미지/영상은 이미 압축되어 있다.
+static int is_compressible(const char *mime) {
+    return strncmp(mime, "text/", 5) == 0 || strncmp(mime, "application/javascript", 22) == 0 ||
+           strncmp(mime, "application/json", 16) == 0 || strncmp(mime, "image/svg+xml", 13) == 0;
+}
+
+// 최고 압축률의 gzip 본문을 만든다. 원본보다 작지 않으면 -1.
+static int compress_gzip(const char *data, size_t len, char **out, size_t *out_len) {
+    z_stream zs;
+    memset(&zs, 0, sizeof(zs));
+    if (deflateInit2(&zs, Z_BEST_COMPRESSION, Z_DEFLATED, 15 + 16, 9, Z_DEFAULT_STRATEGY) != Z_OK) {
+        return -1;
+    }
+    uLong bound = deflateBound(&zs, (uLong)len);
+    char *buf = malloc(bound);
+    if (!buf) {
+        deflateEnd(&zs);
+        return -1;
+    }
+    zs.next_in = (Bytef *)data;
+    zs.avail_in = (uInt)len;
+    zs.next_out = (Bytef *)buf;
+    zs.avail_out = (uInt)bound;
+    int rc = deflate(&zs, Z_FINISH);
+    size_t produced = zs.total_out;
+    deflateEnd(&zs);
+    if (rc != Z_STREAM_END || produced >= len) {
+        free(buf);
+        return -1;
+    }
+    *out = buf;
+    *out_len = produced;
+    return 0;
+}
+
+#ifdef HAVE_BROTLI
+// 최고 품질의 brotli 본문을 만든다. 원본보다 작지 않으면 -1.
+static int compress_brotli(const char *data, size_t len, char **out, size_t *out_len) {
+    size_t bound = BrotliEncoderMaxCompressedSize(len);
+    if (bound == 0) {
+        return -1;
+    }
+    char *buf = malloc(bound);
+    if (!buf) {
+        return -1;
+    }
+    size_t produced = bound;
+    if (!BrotliEncoderCompress(BROTLI_MAX_QUALITY, BROTLI_DEFAULT_WINDOW, BROTLI_MODE_TEXT, len,
+                               (const uint8_t *)data, &produced, (uint8_t *)buf) ||
+        produced >= len) {
+        free(buf);
+        return -1;
+    }
+    *out = buf;
+    *out_len = produced;
+    return 0;
+}
+#endif
+
+// 변형 하나의 200/304 헤더를 만든다. 상태 줄과 Connection 줄은 요청마다 앞에 붙인다.
+static int build_variant_headers(static_variant_t *variant, static_encoding_t encoding, const char *mime,
+                                 const char *cache_control, const char *security_headers) {
+    char validators[256];
+    if (http_format_validator_headers(&variant->validator, cache_control, validators, sizeof(validators)) != 0) {
+        return -1;
+    }
+    const char *vary = is_compressible(mime) ? "Vary: Accept-Encoding\r\n" : "";
+    char encoding_line[64] = "";
+    if (k_encoding_names[encoding]) {
+        snprintf(encoding_line, sizeof(encoding_line), "Content-Encoding: %s\r\n", k_encoding_names[encoding]);
+    }
+    char buf[2048];
+    int n = snprintf(buf, sizeof(buf), "Content-Length: %zu\r\nContent-Type: %s\r\n%s%s%s%s\r\n",
+                     variant->length, mime, encoding_line, vary, security_headers, validators);
+    if (n < 0 || (size_t)n >= sizeof(buf)) {
+        return -1;
+    }
+    variant->headers = strdup(buf);
+    variant->headers_length = (size_t)n;
+    n = snprintf(buf, sizeof(buf), "%s%s%s\r\n", vary, security_headers, validators);
+    if (n < 0 || (size_t)n >= sizeof(buf)) {
+        return -1;
+    }
+    variant->not_modified = strdup(buf);
+    variant->not_modified_length = (size_t)n;
+    return variant->headers && variant->not_modified ? 0 : -1;
+}
+
+static void free_entry(static_entry_t *entry) {
+    for (int v = 0; v < STATIC_VARIANT_COUNT; ++v) {
+        free(entry->variants[v].body);
+        free(entry->variants[v].headers);
+        free(entry->variants[v].not_modified);
+    }
+    free(entry->path);
+    free(entry);
+}
+
+static void free_table(static_table_t *table) {
+    if (!table) return;
+    for (size_t b = 0; b < table->bucket_count; ++b) {
+        static_entry_t *entry = table->buckets[b];
+        while (entry) {
+            static_entry_t *next = entry->next;
+            free_entry(entry);
+            entry = next;
+        }
+    }
+    free(table->buckets);
+    free(table);
+}
+
+static void release_table(static_table_t *table) {
+    if (table && atomic_fetch_sub(&table->refs, 1) == 1) {
+        free_table(table);
+    }
+}
+
+static static_table_t *acquire_table(void) {
+    pthread_mutex_lock(&g_static.lock);
+    static_table_t *table = g_static.current;
+    if (table) {
+        atomic_fetch_add(&table->refs, 1);
+    }
+    pthread_mutex_unlock(&g_static.lock);
+    return table;
+}
+
+// 파일 하나를 읽어 원본과 압축 변형, 미리 만든 헤더를 갖춘 항목으로 만든다.
+static static_entry_t *load_entry(server_ctx_t *server, const char *full_path, const char *relative,
+                                  const struct stat *st) {
+    size_t length = 0;
+    char *data = read_file(full_path, &length);
+    if (!data) {
+        return NULL;
+    }
+    static_entry_t *entry = calloc(1, sizeof(*entry));
+    if (!entry || !(entry->path = strdup(relative))) {
+        free(entry);
+        free(data);
+        return NULL;
+    }
+    const char *mime = mime_type_for_path(relative);
+    const char *cache_control = static_cache_control_for(server, mime);
+    entry->variants[STATIC_IDENTITY].body = data;
+    entry->variants[STATIC_IDENTITY].length = length;
+    if (is_compressible(mime) && length > 0) {
+        static_variant_t *gz = &entry->variants[STATIC_GZIP];
+        if (compress_gzip(data, length, &gz->body, &gz->length) != 0) {
+            gz->body = NULL;
+        }
+#ifdef HAVE_BROTLI
+        static_variant_t *br = &entry->variants[STATIC_BROTLI];
+        if (compress_brotli(data, length, &br->body, &br->length) != 0) {
+            br->body = NULL;
+        }
+#endif
+    }
+    http_validator_t base;
+    http_validator_from_stat(st, &base);
+    for (int v = 0; v < STATIC_VARIANT_COUNT; ++v) {
+        static_variant_t *variant = &entry->variants[v];
+        if (!variant->body) continue;
+        variant->validator = base;
+        // 인코딩마다 바이트가 다르므로 강한 ETag도 달라야 한다. 닫는 따옴표 앞에 접미사를 붙인다.
+        size_t etag_len = strlen(base.etag);
+        snprintf(variant->validator.etag, sizeof(variant->validator.etag), "%.*s%s\"",
+                 (int)(etag_len - 1), base.etag, k_etag_suffix[v]);
+        if (build_variant_headers(variant, (static_encoding_t)v, mime, cache_control,
+                                  server->security_headers) != 0) {
+            free_entry(entry);
+            return NULL;
+        }
+    }
+    return entry;
+}
+
+// 디렉터리를 재귀로 훑는다. table이 NULL이면 지문만 계산하고, 아니면 항목을 채운다.
+static void scan_directory(server_ctx_t *server, const char *dir, const char *prefix, int depth,
+                           uint64_t *fingerprint, static_table_t *table) {
+    DIR *d = opendir(dir);
+    if (!d) {
+        return;
+    }
+    struct dirent *de;
+    while ((de = readdir(d)) != NULL) {
+        if (de->d_name[0] == '.') continue; // 숨김 파일과 ., ..
+        char full_path[PATH_MAX];
+        char relative[PATH_MAX];
+        if (snprintf(full_path, sizeof(full_path), "%s/%s", dir, de->d_name) >= (int)sizeof(full_path) ||
+            snprintf(relative, sizeof(relative), "%s%s", prefix, de->d_name) >= (int)sizeof(relative)) {
+            continue;
+        }
+        struct stat st;
+        if (stat(full_path, &st) != 0) continue;
+        if (S_ISDIR(st.st_mode)) {
+            if (depth < STATIC_MAX_DEPTH && strlen(relative) + 1 < sizeof(relative)) {
+                strcat(relative, "/");
+                scan_directory(server, full_path, relative, depth + 1, fingerprint, table);
+            }
+            continue;
+        }
+        if (!S_ISREG(st.st_mode) || st.st_size > STATIC_CACHE_MAX_FILE) continue;
+        long long key[4] = {(long long)st.st_ino, (long long)st.st_size, (long long)st.st_mtim.tv_sec,
+                            (long long)st.st_mtim.tv_nsec};
+        *fingerprint = fnv1a(*fingerprint, relative, strlen(relative) + 1);
+        *fingerprint = fnv1a(*fingerprint, key, sizeof(key));
+        if (!table || table->total_bytes + (size_t)st.st_size > STATIC_CACHE_MAX_TOTAL) continue;
+        static_entry_t *entry = load_entry(server, full_path, relative, &st);
+        if (!entry) continue;
+        for (int v = 0; v < STATIC_VARIANT_COUNT; ++v) {
+            table->total_bytes += entry->variants[v].length;
+        }
+        size_t bucket = path_bucket(relative, table->bucket_count);
+        entry->next = table->buckets[bucket];
+        table->buckets[bucket] = entry;
+        table->file_count++;
+    }
+    closedir(d);
+}
+
+static uint64_t directory_fingerprint(server_ctx_t *server) {
+    uint64_t fingerprint = 1469598103934665603ULL;
+    scan_directory(server, server->static_dir, "", 0, &fingerprint, NULL);
+    return fingerprint;
+}
+
+// 새 테이블을 만들어 현재 테이블과 바꾼다. 이전 테이블은 마지막 요청이 놓을 때 해제된다.
+static int rebuild_table(server_ctx_t *server) {
+    static_table_t *table = calloc(1, sizeof(*table));
+    if (!table) return -1;
+    table->bucket_count = 256;
+    table->buckets = calloc(table->bucket_count, sizeof(*table->buckets));
+    if (!table->buckets) {
+        free(table);
+        return -1;
+    }
+    atomic_init(&table->refs, 1);
+    uint64_t fingerprint = 1469598103934665603ULL;
+    scan_directory(server, server->static_dir, "", 0, &fingerprint, table);
+    pthread_mutex_lock(&g_static.lock);
+    static_table_t *old = g_static.current;
+    g_static.current = table;
+    g_static.fingerprint = fingerprint;
+    pthread_mutex_unlock(&g_static.lock);
+    release_table(old);
+    log_info("Static cache: %zu files, %zu bytes (including compressed variants)",
+             table->file_count, table->total_bytes);
+    return 0;
+}
+
+// 주기적으로 디렉터리 지문(stat 결과)만 계산하고, 달라졌을 때만 읽고 압축해 테이블을 다시 만든다.
+static void *static_watch_loop(void *arg) {
+    server_ctx_t *server = arg;
+    int interval_ms = server->static_cache_refresh_sec > 0 ? server->static_cache_refresh_sec * 1000 : 2000;
+    int waited_ms = 0;
+    while (!g_static.stop) {
+        poll(NULL, 0, 100);
+        waited_ms += 100;
+        if (waited_ms < interval_ms) continue;
+        waited_ms = 0;
+        uint64_t fingerprint = directory_fingerprint(server);
+        pthread_mutex_lock(&g_static.lock);
+        int changed = fingerprint != g_static.fingerprint;
+        pthread_mutex_unlock(&g_static.lock);
+        if (changed) {
+            rebuild_table(server);
+        }
+    }
+    return NULL;
+}
+
+// 시작 시 테이블을 만들고 변경 감시 스레드를 띄운다. 실패해도 디스크 경로로 계속 서비스한다.
+int static_cache_initialize(server_ctx_t *server) {
+    if (!server) return -1;
+    g_static.server = server;
+    if (rebuild_table(server) != 0) {
+        log_warn("Static cache unavailable; serving assets from disk");
+        return -1;
+    }
+    g_static.stop = 0;
+    if (pthread_create(&g_static.thread, NULL, static_watch_loop, server) != 0) {
+        log_warn("Static cache watcher is not running; asset changes need a restart");
+        return 0;
+    }
+    g_static.running = 1;
+    return 0;
+}
+
+// Accept-Encoding이 coding을 q>0으로 받는지 확인한다. 명시된 coding의 q가 "*"보다 우선한다.
+static int accepts_encoding(const char *header, const char *coding) {
+    if (!header) return 0;
+    size_t coding_len = strlen(coding);
+    double explicit_q = -1.0;
+    double star_q = -1.0;
+    const char *p = header;
+    while (*p) {
+        while (*p == ' ' || *p == '\t' || *p == ',') p++;
+        const char *token = p;
+        while (*p && *p != ',' && *p != ';' && *p != ' ' && *p != '\t') p++;
+        size_t token_len = (size_t)(p - token);
+        double q = 1.0;
+        while (*p && *p != ',') {
+            if (*p == ';') {
+                const char *param = p + 1;
+                while (*param == ' ' || *param == '\t') param++;
+                if ((param[0] == 'q' || param[0] == 'Q') && param[1] == '=') {
+                    q = strtod(param + 2, NULL);
+                }
+            }
+            p++;
+        }
+        if (token_len == coding_len && strncasecmp(token, coding, coding_len) == 0) {
+            explicit_q = q;
+        } else if (token_len == 1 && token[0] == '*') {
+            star_q = q;
+        }
+    }
+    if (explicit_q >= 0.0) return explicit_q > 0.0;
+    return star_q > 0.0;
+}
+
+static const char *status_line(int status, int keep_alive) {
+    if (status == 304) {
+        return keep_alive ? "HTTP/1.1 304 Not Modified\r\nConnection: keep-alive\r\n"
+                          : "HTTP/1.1 304 Not Modified\r\nConnection: close\r\n";
+    }
+    return keep_alive ? "HTTP/1.1 200 OK\r\nConnection: keep-alive\r\n"
+                      : "HTTP/1.1 200 OK\r\nConnection: close\r\n";
+}
+
+// 캐시에 있는 자산이면 Accept-Encoding에 맞는 변형을 골라 writev 한 번으로 보낸다.
+int static_cache_serve(int fd, const http_request_t *req, const char *relative_path, int keep_alive) {
+    static_table_t *table = acquire_table();
+    if (!table) {
+        return 1;
+    }
+    const static_entry_t *entry = table->buckets[path_bucket(relative_path, table->bucket_count)];
+    while (entry && strcmp(entry->path, relative_path) != 0) {
+        entry = entry->next;
+    }
+    if (!entry) {
+        release_table(table);
+        return 1;
+    }
+    const char *accept = http_get_known_header(req, HTTP_HDR_ACCEPT_ENCODING);
+    const static_variant_t *variant = &entry->variants[STATIC_IDENTITY];
+    if (entry->variants[STATIC_BROTLI].body && accepts_encoding(accept, "br")) {
+        variant = &entry->variants[STATIC_BROTLI];
+    } else if (entry->variants[STATIC_GZIP].body && accepts_encoding(accept, "gzip")) {
+        variant = &entry->variants[STATIC_GZIP];
+    }
+    struct iovec iov[3];
+    int iovcnt;
+    int not_modified = http_request_not_modified(req, &variant->validator);
+    http_note_response(not_modified ? 304 : 200, not_modified ? 0 : variant->length);
+    if (not_modified) {
+        const char *line = status_line(304, keep_alive);
+        iov[0].iov_base = (void *)line;
+        iov[0].iov_len = strlen(line);
+        iov[1].iov_base = variant->not_modified;
+        iov[1].iov_len = variant->not_modified_length;
+        iovcnt = 2;
+    } else {
+        const char *line = status_line(200, keep_alive);
+        iov[0].iov_base = (void *)line;
+        iov[0].iov_len = strlen(line);
+        iov[1].iov_base = variant->headers;
+        iov[1].iov_len = variant->headers_length;
+        iov[2].iov_base = variant->body;
+        iov[2].iov_len = variant->length;
+        iovcnt = 3;
+    }
+    int rc = http_send_iov(fd, iov, iovcnt);
+    release_table(table);
+    return rc == 0 ? 0 : -1;
+}
+
+// 감시 스레드를 멈추고 현재 테이블을 놓는다.
+void static_cache_shutdown(void) {
+    if (g_static.running) {
+        g_static.stop = 1;
+        pthread_join(g_static.thread, NULL);
+        g_static.running = 0;
+    }
+    pthread_mutex_lock(&g_static.lock);
+    static_table_t *table = g_static.current;
+    g_static.current = NULL;
+    pthread_mutex_unlock(&g_static.lock);
+    release_table(table);
+}
@@ -1,42 +1,158 @@
-// 간단한 작업 큐를 기반으로 한 pthread 워커 풀 구현
+// 워커별 유계 링 큐와 작업 훔치기를 기반으로 한 pthread 워커 풀 구현
 #include "threadpool.h"
 
-#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 
-// 각 워커 스레드는 큐에 작업이 들어올 때까지 대기했다가 실행한다.
+// 링 큐를 capacity(2의 거듭제곱) 칸으로 만든다. 각 칸의 sequence는 자기 위치에서 시작한다.
+static int queue_init(thread_pool_queue_t *queue, size_t capacity) {
+    queue->cells = calloc(capacity, sizeof(*queue->cells));
+    if (!queue->cells) {
+        return -1;
+    }
+    for (size_t i = 0; i < capacity; ++i) {
+        atomic_init(&queue->cells[i].sequence, i);
+    }
+    queue->mask = capacity - 1;
+    atomic_init(&queue->enqueue_pos, 0);
+    atomic_init(&queue->dequeue_pos, 0);
+    return 0;
+}
+
+// 칸의 sequence가 pos와 같으면 비어 있는 칸이다. 다른 생산자와는 enqueue_pos CAS로 경쟁한다.
+static int queue_push(thread_pool_queue_t *queue, thread_job_fn fn, void *arg) {
+    size_t pos = atomic_load_explicit(&queue->enqueue_pos, memory_order_relaxed);
+    for (;;) {
+        thread_pool_cell_t *cell = &queue->cells[pos & queue->mask];
+        size_t seq = atomic_load_explicit(&cell->sequence, memory_order_acquire);
+        intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+        if (diff == 0) {
+            if (atomic_compare_exchange_weak_explicit(&queue->enqueue_pos, &pos, pos + 1,
+                                                      memory_order_relaxed, memory_order_relaxed)) {
+                cell->fn = fn;
+                cell->arg = arg;
+                atomic_store_explicit(&cell->sequence, pos + 1, memory_order_release);
+                return 0;
+            }
+        } else if (diff < 0) {
+            return -1; // 가득 참
+        } else {
+            pos = atomic_load_explicit(&queue->enqueue_pos, memory_order_relaxed);
+        }
+    }
+}
+
+// 칸의 sequence가 pos+1이면 채워진 칸이다. 주인과 훔치는 워커는 dequeue_pos CAS로 경쟁한다.
+static int queue_pop(thread_pool_queue_t *queue, thread_job_fn *fn, void **arg) {
+    size_t pos = atomic_load_explicit(&queue->dequeue_pos, memory_order_relaxed);
+    for (;;) {
+        thread_pool_cell_t *cell = &queue->cells[pos & queue->mask];
+        size_t seq = atomic_load_explicit(&cell->sequence, memory_order_acquire);
+        intptr_t diff = (intptr_t)seq - (intptr_t)(pos + 1);
+        if (diff == 0) {
+            if (atomic_compare_exchange_weak_explicit(&queue->dequeue_pos, &pos, pos + 1,
+                                                      memory_order_relaxed, memory_order_relaxed)) {
+                *fn = cell->fn;
+                *arg = cell->arg;
+                atomic_store_explicit(&cell->sequence, pos + queue->mask + 1, memory_order_release);
+                return 0;
+            }
+        } else if (diff < 0) {
+            return -1; // 비어 있음
+        } else {
+            pos = atomic_load_explicit(&queue->dequeue_pos, memory_order_relaxed);
+        }
+    }
+}
+
+// 우선순위가 높은 lane부터, 자기 큐를 먼저 본 뒤 다른 워커의 큐에서 훔친다.
+static int take_job(thread_pool_t *pool, size_t self, thread_job_fn *fn, void **arg) {
+    for (int lane = 0; lane < THREAD_POOL_LANE_COUNT; ++lane) {
+        for (size_t i = 0; i < pool->worker_count; ++i) {
+            thread_pool_queue_t *queue = &pool->queues[(self + i) % pool->worker_count].lanes[lane];
+            if (queue_pop(queue, fn, arg) == 0) {
+                atomic_fetch_sub(&pool->queued, 1);
+                return 0;
+            }
+        }
+    }
+    return -1;
+}
+
+// 각 워커 스레드는 큐에서 작업을 꺼내 실행하고, 어느 큐에도 작업이 없을 때만 잠든다.
 static void *worker_main(void *arg) {
     thread_pool_t *pool = (thread_pool_t *)arg;
+    size_t self = atomic_fetch_add(&pool->next_worker_id, 1) % pool->worker_count;
+#if defined(__linux__)
+    if (pool->pin_cpus && pool->cpu_count > 0) {
+        // 같은 코어에 고정된 리액터가 이 워커의 큐로 연결을 넘기므로 캐시가 코어를 옮겨 다니지 않는다.
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET((int)(self % (size_t)pool->cpu_count), &set);
+        pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+    }
+#endif
     for (;;) {
-        pthread_mutex_lock(&pool->mutex);
-        while (!pool->stop && pool->head == NULL) {
-            pthread_cond_wait(&pool->cond, &pool->mutex);
+        thread_job_fn fn = NULL;
+        void *job_arg = NULL;
+        if (take_job(pool, self, &fn, &job_arg) == 0) {
+            atomic_fetch_add_explicit(&pool->active, 1, memory_order_relaxed);
+            fn(job_arg);
+            atomic_fetch_sub_explicit(&pool->active, 1, memory_order_relaxed);
+            continue;
         }
-        if (pool->stop) {
-            pthread_mutex_unlock(&pool->mutex);
+        if (atomic_load(&pool->stop)) {
             break;
         }
-        thread_job_t *job = pool->head;
-        if (job) {
-            pool->head = job->next;
-            if (pool->head == NULL) {
-                pool->tail = NULL;
-            }
+        if (atomic_load(&pool->queued) > 0) {
+            // 제출자가 개수를 올린 뒤 칸을 채우는 중이다. 잠들지 않고 곧 다시 본다.
+            sched_yield();
+            continue;
         }
-        pthread_mutex_unlock(&pool->mutex);
-        if (job) {
-            job->fn(job->arg);
-            free(job);
+        pthread_mutex_lock(&pool->mutex);
+        // idle을 올린 뒤 queued를 다시 보므로, 그 사이의 submit은 이 워커를 깨우거나 여기서 보인다.
+        atomic_fetch_add(&pool->idle, 1);
+        while (!atomic_load(&pool->stop) && atomic_load(&pool->queued) == 0) {
+            pthread_cond_wait(&pool->cond, &pool->mutex);
         }
+        atomic_fetch_sub(&pool->idle, 1);
+        pthread_mutex_unlock(&pool->mutex);
     }
     return NULL;
 }
 
-// 지정한 개수의 워커 스레드를 생성한다.
-int thread_pool_init(thread_pool_t *pool, size_t worker_count) {
+static void free_queues(thread_pool_t *pool) {
+    if (!pool->queues) {
+        return;
+    }
+    for (size_t i = 0; i < pool->worker_count; ++i) {
+        for (int lane = 0; lane < THREAD_POOL_LANE_COUNT; ++lane) {
+            free(pool->queues[i].lanes[lane].cells);
+        }
+    }
+    free(pool->queues);
+    pool->queues = NULL;
+}
+
+// 지정한 개수의 워커 스레드와 워커별 큐를 만든다. 링 하나가 queue_limit 전체를 담을 수 있게 잡아
+// 분배가 한쪽으로 몰려도 상한 이전에 칸이 모자라지 않는다.
+int thread_pool_init(thread_pool_t *pool, size_t worker_count, size_t queue_limit, int pin_cpus) {
     memset(pool, 0, sizeof(*pool));
+    if (worker_count == 0 || queue_limit == 0) {
+        return -1;
+    }
     pool->worker_count = worker_count;
+    pool->queue_limit = queue_limit;
+    pool->pin_cpus = pin_cpus;
+    pool->cpu_count = sysconf(_SC_NPROCESSORS_ONLN);
+    size_t capacity = 2;
+    while (capacity < queue_limit) {
+        capacity <<= 1;
+    }
     if (pthread_mutex_init(&pool->mutex, NULL) != 0) {
         return -1;
     }
@@ -44,19 +160,31 @@ int thread_pool_init(thread_pool_t *pool, size_t worker_count) {
         pthread_mutex_destroy(&pool->mutex);
         return -1;
     }
+    pool->queues = calloc(worker_count, sizeof(*pool->queues));
     pool->workers = calloc(worker_count, sizeof(pthread_t));
-    if (!pool->workers) {
+    int ok = pool->queues && pool->workers;
+    for (size_t i = 0; ok && i < worker_count; ++i) {
+        for (int lane = 0; ok && lane < THREAD_POOL_LANE_COUNT; ++lane) {
+            ok = queue_init(&pool->queues[i].lanes[lane], capacity) == 0;
+        }
+    }
+    if (!ok) {
+        free_queues(pool);
+        free(pool->workers);
         pthread_cond_destroy(&pool->cond);
         pthread_mutex_destroy(&pool->mutex);
         return -1;
     }
     for (size_t i = 0; i < worker_count; ++i) {
         if (pthread_create(&pool->workers[i], NULL, worker_main, pool) != 0) {
-            pool->stop = 1;
+            pthread_mutex_lock(&pool->mutex);
+            atomic_store(&pool->stop, 1);
+            pthread_cond_broadcast(&pool->cond);
+            pthread_mutex_unlock(&pool->mutex);
             for (size_t j = 0; j < i; ++j) {
-                pthread_cond_broadcast(&pool->cond);
                 pthread_join(pool->workers[j], NULL);
             }
+            free_queues(pool);
             free(pool->workers);
             pthread_cond_destroy(&pool->cond);
             pthread_mutex_destroy(&pool->mutex);
@@ -66,41 +194,55 @@ int thread_pool_init(thread_pool_t *pool, size_t worker_count) {
     return 0;
 }
 
-// 작업을 큐 끝에 추가하고 워커 하나를 깨운다.
-void thread_pool_submit(thread_pool_t *pool, thread_job_fn fn, void *arg) {
-    thread_job_t *job = calloc(1, sizeof(thread_job_t));
-    if (!job) {
-        return;
+// 작업을 preferred 워커 큐부터 넣고, 잠든 워커가 있을 때만 하나를 깨운다.
+// 대기 작업이 queue_limit에 도달하면 넣지 않고 바로 -1을 돌려준다.
+int thread_pool_submit_to(thread_pool_t *pool, size_t preferred, thread_pool_lane_t lane,
+                          thread_job_fn fn, void *arg) {
+    if (lane >= THREAD_POOL_LANE_COUNT) {
+        lane = THREAD_POOL_LANE_BULK;
     }
-    job->fn = fn;
-    job->arg = arg;
-    pthread_mutex_lock(&pool->mutex);
-    if (pool->tail) {
-        pool->tail->next = job;
-    } else {
-        pool->head = job;
+    if (atomic_fetch_add(&pool->queued, 1) >= pool->queue_limit) {
+        atomic_fetch_sub(&pool->queued, 1);
+        atomic_fetch_add(&pool->rejected, 1);
+        return -1;
     }
-    pool->tail = job;
-    pthread_cond_signal(&pool->cond);
-    pthread_mutex_unlock(&pool->mutex);
+    size_t start = preferred;
+    int pushed = -1;
+    for (size_t i = 0; i < pool->worker_count && pushed != 0; ++i) {
+        pushed = queue_push(&pool->queues[(start + i) % pool->worker_count].lanes[lane], fn, arg);
+    }
+    if (pushed != 0) {
+        // 링 용량이 queue_limit 이상이므로 도달하지 않지만, 방어적으로 거절 처리한다.
+        atomic_fetch_sub(&pool->queued, 1);
+        atomic_fetch_add(&pool->rejected, 1);
+        return -1;
+    }
+    if (atomic_load(&pool->idle) > 0) {
+        pthread_mutex_lock(&pool->mutex);
+        pthread_cond_signal(&pool->cond);
+        pthread_mutex_unlock(&pool->mutex);
+    }
+    return 0;
 }
 
-// 모든 스레드를 종료시키고 남은 작업을 정리한다.
+// 워커 큐에 돌아가며 넣는다.
+int thread_pool_submit(thread_pool_t *pool, thread_pool_lane_t lane, thread_job_fn fn, void *arg) {
+    size_t start = atomic_fetch_add_explicit(&pool->next_queue, 1, memory_order_relaxed);
+    return thread_pool_submit_to(pool, start, lane, fn, arg);
+}
+
+// 모든 스레드를 종료시킨다. 워커는 큐에 남은 작업을 마저 실행한 뒤 빠져나온다.
 void thread_pool_destroy(thread_pool_t *pool) {
     pthread_mutex_lock(&pool->mutex);
-    pool->stop = 1;
+    atomic_store(&pool->stop, 1);
     pthread_cond_broadcast(&pool->cond);
     pthread_mutex_unlock(&pool->mutex);
     for (size_t i = 0; i < pool->worker_count; ++i) {
         pthread_join(pool->workers[i], NULL);
     }
-    thread_job_t *job = pool->head;
-    while (job) {
-        thread_job_t *next = job->next;
-        free(job);
-        job = next;
-    }
+    free_queues(pool);
     free(pool->workers);
+    pool->workers = NULL;
     pthread_cond_destroy(&pool->cond);
     pthread_mutex_destroy(&pool->mutex);
 }
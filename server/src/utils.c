@@ -2,10 +2,12 @@
 #include "utils.h"
 
 #include <errno.h>
+#include <fcntl.h>
 #include <stdarg.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <strings.h>
 #include <sys/stat.h>
 #include <time.h>
 #include <unistd.h>
@@ -107,6 +109,50 @@ int base64url_encode(const uint8_t *input, size_t input_len, char *output, size_
     return (int)out_index;
 }
 
+// base64url(패딩 없음)을 디코딩한다. 잘못된 문자가 있거나 버퍼가 모자라면 -1.
+int base64url_decode(const char *input, uint8_t *output, size_t output_len) {
+    if (!input || !output) return -1;
+    size_t out_index = 0;
+    uint32_t chunk = 0;
+    int bits = 0;
+    for (const unsigned char *p = (const unsigned char *)input; *p; ++p) {
+        int v;
+        if (*p >= 'A' && *p <= 'Z') v = *p - 'A';
+        else if (*p >= 'a' && *p <= 'z') v = *p - 'a' + 26;
+        else if (*p >= '0' && *p <= '9') v = *p - '0' + 52;
+        else if (*p == '-') v = 62;
+        else if (*p == '_') v = 63;
+        else return -1;
+        chunk = (chunk << 6) | (uint32_t)v;
+        bits += 6;
+        if (bits >= 8) {
+            bits -= 8;
+            if (out_index >= output_len) {
+                return -1;
+            }
+            output[out_index++] = (uint8_t)((chunk >> bits) & 0xFF);
+        }
+    }
+    return (int)out_index;
+}
+
+// 정적 파일 확장자에 맞춰 심플한 MIME 타입을 선택한다.
+const char *mime_type_for_path(const char *path) {
+    const char *ext = strrchr(path, '.');
+    if (!ext) return "application/octet-stream";
+    ext++;
+    if (strcasecmp(ext, "html") == 0) return "text/html; charset=utf-8";
+    if (strcasecmp(ext, "css") == 0) return "text/css; charset=utf-8";
+    if (strcasecmp(ext, "js") == 0) return "application/javascript";
+    if (strcasecmp(ext, "json") == 0) return "application/json";
+    if (strcasecmp(ext, "png") == 0) return "image/png";
+    if (strcasecmp(ext, "jpg") == 0 || strcasecmp(ext, "jpeg") == 0) return "image/jpeg";
+    if (strcasecmp(ext, "svg") == 0) return "image/svg+xml";
+    if (strcasecmp(ext, "ico") == 0) return "image/x-icon";
+    if (strcasecmp(ext, "mp4") == 0) return "video/mp4";
+    return "application/octet-stream";
+}
+
 // 시스템 uptime을 밀리초 단위로 반환한다.
 uint64_t get_monotonic_ms(void) {
     struct timespec ts;
@@ -114,32 +160,16 @@ uint64_t get_monotonic_ms(void) {
     return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
 }
 
-// 공통 포맷터: STDERR로 로그를 출력한다.
-static void vlog_at_level(const char *level, const char *fmt, va_list ap) {
-    fprintf(stderr, "[%s] ", level);
-    vfprintf(stderr, fmt, ap);
-    fputc('\n', stderr);
-}
-
-void log_info(const char *fmt, ...) {
-    va_list ap;
-    va_start(ap, fmt);
-    vlog_at_level("INFO", fmt, ap);
-    va_end(ap);
-}
-
-void log_warn(const char *fmt, ...) {
-    va_list ap;
-    va_start(ap, fmt);
-    vlog_at_level("WARN", fmt, ap);
-    va_end(ap);
-}
-
-void log_error(const char *fmt, ...) {
-    va_list ap;
-    va_start(ap, fmt);
-    vlog_at_level("ERROR", fmt, ap);
-    va_end(ap);
+// 소켓/파이프를 논블로킹 모드로 전환한다.
+int make_nonblocking(int fd) {
+    int flags = fcntl(fd, F_GETFL, 0);
+    if (flags == -1) {
+        return -1;
+    }
+    if (fcntl(fd, F_SETFL, flags | O_NONBLOCK) == -1) {
+        return -1;
+    }
+    return 0;
 }
 
 // string_builder 초기화 및 버퍼 할당
@@ -158,6 +188,25 @@ int sb_init(string_builder_t *sb, size_t initial_capacity) {
     return 0;
 }
 
+// 최소 extra 바이트(+널 종료)를 더 쓸 수 있도록 버퍼를 늘린다.
+static int sb_reserve(string_builder_t *sb, size_t extra) {
+    size_t required = sb->length + extra + 1;
+    if (required <= sb->capacity) {
+        return 0;
+    }
+    size_t new_cap = sb->capacity;
+    while (new_cap < required) {
+        new_cap *= 2;
+    }
+    char *new_data = realloc(sb->data, new_cap);
+    if (!new_data) {
+        return -1;
+    }
+    sb->data = new_data;
+    sb->capacity = new_cap;
+    return 0;
+}
+
 // printf 스타일 포맷으로 문자열을 이어 붙인다.
 int sb_append(string_builder_t *sb, const char *fmt, ...) {
     if (!sb || !fmt) return -1;
@@ -167,24 +216,10 @@ int sb_append(string_builder_t *sb, const char *fmt, ...) {
     va_copy(ap_copy, ap);
     int needed = vsnprintf(NULL, 0, fmt, ap_copy);
     va_end(ap_copy);
-    if (needed < 0) {
+    if (needed < 0 || sb_reserve(sb, (size_t)needed) != 0) {
         va_end(ap);
         return -1;
     }
-    size_t required = sb->length + (size_t)needed + 1;
-    if (required > sb->capacity) {
-        size_t new_cap = sb->capacity;
-        while (new_cap < required) {
-            new_cap *= 2;
-        }
-        char *new_data = realloc(sb->data, new_cap);
-        if (!new_data) {
-            va_end(ap);
-            return -1;
-        }
-        sb->data = new_data;
-        sb->capacity = new_cap;
-    }
     int written = vsnprintf(sb->data + sb->length, sb->capacity - sb->length, fmt, ap);
     va_end(ap);
     if (written < 0) {
@@ -194,6 +229,18 @@ int sb_append(string_builder_t *sb, const char *fmt, ...) {
     return 0;
 }
 
+// 포맷 해석 없이 len 바이트를 그대로 복사해 붙인다. 미리 만들어 둔 조각을 이어 붙일 때 쓴다.
+int sb_append_raw(string_builder_t *sb, const char *data, size_t len) {
+    if (!sb || (!data && len > 0)) return -1;
+    if (sb_reserve(sb, len) != 0) {
+        return -1;
+    }
+    memcpy(sb->data + sb->length, data, len);
+    sb->length += len;
+    sb->data[sb->length] = '\0';
+    return 0;
+}
+
 void sb_free(string_builder_t *sb) {
     if (!sb) return;
     free(sb->data);
@@ -203,41 +250,40 @@ void sb_free(string_builder_t *sb) {
 }
 
 // JSON 특수 문자를 escape 처리하며 문자열을 추가한다.
+// escape가 필요 없는 구간은 한 번에 복사한다.
 int sb_append_json_string(string_builder_t *sb, const char *value) {
     if (!sb) return -1;
     if (!value) {
         value = "";
     }
-    if (sb_append(sb, "\"") != 0) {
+    if (sb_append_raw(sb, "\"", 1) != 0) {
         return -1;
     }
-    for (const unsigned char *p = (const unsigned char *)value; *p; ++p) {
+    const unsigned char *run = (const unsigned char *)value;
+    const unsigned char *p = run;
+    for (; *p; ++p) {
+        const char *escape = NULL;
+        char unicode[8];
         switch (*p) {
-            case '"':
-                if (sb_append(sb, "\\\"") != 0) return -1;
-                break;
-            case '\\':
-                if (sb_append(sb, "\\\\") != 0) return -1;
-                break;
-            case '\n':
-                if (sb_append(sb, "\\n") != 0) return -1;
-                break;
-            case '\r':
-                if (sb_append(sb, "\\r") != 0) return -1;
-                break;
-            case '\t':
-                if (sb_append(sb, "\\t") != 0) return -1;
-                break;
+            case '"': escape = "\\\""; break;
+            case '\\': escape = "\\\\"; break;
+            case '\n': escape = "\\n"; break;
+            case '\r': escape = "\\r"; break;
+            case '\t': escape = "\\t"; break;
             default:
                 if (*p < 0x20) {
-                    if (sb_append(sb, "\\u%04x", *p) != 0) return -1;
-                } else {
-                    if (sb_append(sb, "%c", *p) != 0) return -1;
+                    snprintf(unicode, sizeof(unicode), "\\u%04x", *p);
+                    escape = unicode;
                 }
                 break;
         }
+        if (!escape) continue;
+        if (sb_append_raw(sb, (const char *)run, (size_t)(p - run)) != 0) return -1;
+        if (sb_append_raw(sb, escape, strlen(escape)) != 0) return -1;
+        run = p + 1;
     }
-    if (sb_append(sb, "\"") != 0) {
+    if (sb_append_raw(sb, (const char *)run, (size_t)(p - run)) != 0) return -1;
+    if (sb_append_raw(sb, "\"", 1) != 0) {
         return -1;
     }
     return 0;
@@ -1,22 +1,21 @@
-// 비디오 라이브러리 동기화, 스트리밍, 썸네일 API를 담당하는 모듈
+// 비디오 목록, 스트리밍, 썸네일 API를 담당하는 모듈
 #include "video.h"
 
 #include <ctype.h>
-#include <dirent.h>
 #include <errno.h>
 #include <limits.h>
-#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <strings.h>
 #include <sys/stat.h>
-#include <time.h>
-#include <unistd.h>
 
+#include "catalog_cache.h"
 #include "db.h"
 #include "ffmpeg.h"
+#include "history.h"
 #include "http.h"
+#include "library.h"
+#include "media_cache.h"
 #include "utils.h"
 
 // 공통 보안 헤더에 추가 헤더를 덧붙여 응답용 문자열을 만든다.
@@ -30,87 +29,12 @@ static void build_header(char *dest, size_t len, server_ctx_t *server, const cha
 }
 
 #define VIDEO_DEFAULT_LIMIT 12
+// 스트림은 크고 Range로 나눠 받으므로 저장은 허용하되 쓰기 전에 항상 검증자로 재확인하게 한다.
+#define VIDEO_STREAM_CACHE_CONTROL "private, no-cache"
+#define VIDEO_PACE_MIN_RATE (64 * 1024)          // 비트레이트가 낮게 잡혀도 초당 이보다 늦추지 않는다
+#define VIDEO_PACE_BURST_MAX (32 * 1024 * 1024)  // 연결의 첫 버스트 상한
 #define VIDEO_MAX_LIMIT 50
 
-// URL 인코딩 해석을 위한 헥사 문자 → 값 변환
-static int hex_value(char c) {
-    if (c >= '0' && c <= '9') return c - '0';
-    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
-    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
-    return -1;
-}
-
-// 쿼리 파라미터에 있는 %XX 표현을 실제 문자로 되돌린다.
-static int url_decode_component(const char *src, size_t len, char *dst, size_t dst_len) {
-    if (!src || !dst || dst_len == 0) {
-        return -1;
-    }
-    size_t di = 0;
-    for (size_t si = 0; si < len; ++si) {
-        char c = src[si];
-        if (c == '+') {
-            c = ' ';
-        } else if (c == '%' && si + 2 < len) {
-            int hi = hex_value(src[si + 1]);
-            int lo = hex_value(src[si + 2]);
-            if (hi >= 0 && lo >= 0) {
-                c = (char)((hi << 4) | lo);
-                si += 2;
-            }
-        }
-        if (di + 1 >= dst_len) {
-            return -1;
-        }
-        dst[di++] = c;
-    }
-    dst[di] = '\0';
-    return 0;
-}
-
-// name=value 쌍에서 원하는 파라미터를 추출한다.
-static int query_get_param(const char *query, const char *name, char *out, size_t out_len) {
-    if (!query || !*query || !name || !out || out_len == 0) {
-        return -1;
-    }
-    size_t name_len = strlen(name);
-    const char *cursor = query;
-    while (*cursor) {
-        const char *amp = strchr(cursor, '&');
-        size_t pair_len = amp ? (size_t)(amp - cursor) : strlen(cursor);
-        const char *eq = memchr(cursor, '=', pair_len);
-        size_t key_len = eq ? (size_t)(eq - cursor) : pair_len;
-        if (key_len == name_len && strncmp(cursor, name, name_len) == 0) {
-            const char *value_start = eq ? eq + 1 : cursor + key_len;
-            size_t value_len = eq ? pair_len - key_len - 1 : 0;
-            if (value_len == 0) {
-                out[0] = '\0';
-                return 0;
-            }
-            return url_decode_component(value_start, value_len, out, out_len);
-        }
-        if (!amp) {
-            break;
-        }
-        cursor = amp + 1;
-    }
-    return -1;
-}
-
-// 정수 쿼리 파라미터를 파싱한다.
-static int query_get_int(const char *query, const char *name, int *value_out) {
-    char buf[32];
-    if (query_get_param(query, name, buf, sizeof(buf)) != 0) {
-        return -1;
-    }
-    char *end = NULL;
-    long v = strtol(buf, &end, 10);
-    if (!end || *end != '\0') {
-        return -1;
-    }
-    *value_out = (int)v;
-    return 0;
-}
-
 // 검색어 앞뒤 공백 제거
 static void trim_spaces(char *s) {
     if (!s) return;
@@ -129,92 +53,7 @@ static void trim_spaces(char *s) {
     s[end - start] = '\0';
 }
 
-// 환경 변수에서 정수를 읽되 파싱 오류 시 기본값을 돌려준다.
-static int getenv_int(const char *name, int fallback) {
-    const char *value = getenv(name);
-    if (!value || !*value) {
-        return fallback;
-    }
-    char *end = NULL;
-    long v = strtol(value, &end, 10);
-    if (!end || *end != '\0') {
-        return fallback;
-    }
-    if (v < 0 || v > INT_MAX) {
-        return fallback;
-    }
-    return (int)v;
-}
-
-// media 디렉터리 변경을 감지하기 위한 상태 구조체
-typedef struct {
-    pthread_t thread;
-    int running;
-    int stop;
-    time_t last_mtime;
-    int interval_sec;
-    server_ctx_t *server;
-} media_watch_state_t;
-
-static media_watch_state_t g_media_watch = {0};
-
-// 디렉터리의 mtime을 가져온다. 실패 시 0을 반환한다.
-static time_t dir_mtime(const char *path) {
-    struct stat st;
-    if (stat(path, &st) != 0) {
-        return 0;
-    }
-    return st.st_mtime;
-}
-
-// usleep 대신 짧게 여러 번 슬립해서 stop 플래그를 빠르게 반영한다.
-static void sleep_with_stop(media_watch_state_t *state) {
-    if (!state || state->interval_sec <= 0) return;
-    int slices = state->interval_sec * 10; // 100ms x interval_sec
-    for (int i = 0; i < slices && !state->stop; ++i) {
-        usleep(100000);
-    }
-}
-
-// media 디렉터리 변경 시 자동으로 DB와 동기화하는 백그라운드 루프
-static void *media_watch_loop(void *arg) {
-    media_watch_state_t *state = (media_watch_state_t *)arg;
-    while (!state->stop) {
-        time_t current = dir_mtime(state->server->media_dir);
-        if (current > 0 && current != state->last_mtime) {
-            if (sync_media_directory(state->server) == 0) {
-                state->last_mtime = dir_mtime(state->server->media_dir);
-                log_info("Media hot-reload: detected change, library synchronized");
-            } else {
-                log_warn("Media hot-reload: sync failed (will retry)");
-            }
-        }
-        sleep_with_stop(state);
-    }
-    return NULL;
-}
-
-// 핫리로드 워처를 시작한다. 실패해도 서버는 계속 동작한다.
-static int start_media_watcher(server_ctx_t *server) {
-    if (!server) return -1;
-    if (g_media_watch.running) return 0;
-    g_media_watch.server = server;
-    g_media_watch.interval_sec = getenv_int("MEDIA_WATCH_INTERVAL_SEC", 2);
-    if (g_media_watch.interval_sec <= 0) {
-        g_media_watch.interval_sec = 2;
-    }
-    g_media_watch.last_mtime = dir_mtime(server->media_dir);
-    g_media_watch.stop = 0;
-    if (pthread_create(&g_media_watch.thread, NULL, media_watch_loop, &g_media_watch) != 0) {
-        log_warn("Media hot-reload watcher disabled (thread creation failed)");
-        memset(&g_media_watch, 0, sizeof(g_media_watch));
-        return -1;
-    }
-    g_media_watch.running = 1;
-    return 0;
-}
-
-// 사용자별 재생 위치를 보관하는 맵 구조체
+// 사용자별 재생 위치를 보관하는 맵 구조체 (video_id 키의 열린 주소 해시, 0은 빈 슬롯)
 typedef struct {
     int video_id;
     double position;
@@ -223,16 +62,9 @@ typedef struct {
 typedef struct {
     resume_entry_t *items;
     size_t count;
-    size_t capacity;
+    size_t capacity; // 항상 2의 거듭제곱
 } resume_map_t;
 
-// 디렉터리 스캔 시 파일명을 임시로 저장하는 동적 배열
-typedef struct {
-    char **items;
-    size_t count;
-    size_t capacity;
-} filename_list_t;
-
 static void resume_map_free(resume_map_t *map) {
     if (!map) return;
     free(map->items);
@@ -241,71 +73,48 @@ static void resume_map_free(resume_map_t *map) {
     map->capacity = 0;
 }
 
-static void filename_list_free(filename_list_t *list) {
-    if (!list) return;
-    for (size_t i = 0; i < list->count; ++i) {
-        free(list->items[i]);
-    }
-    free(list->items);
-    list->items = NULL;
-    list->count = 0;
-    list->capacity = 0;
-}
-
-// realloc을 이용해 파일명 배열 크기를 자동 확장한다.
-static int filename_list_add(filename_list_t *list, const char *name) {
-    if (!list || !name) return -1;
-    if (list->count == list->capacity) {
-        size_t new_cap = list->capacity == 0 ? 8 : list->capacity * 2;
-        char **new_items = realloc(list->items, new_cap * sizeof(char *));
-        if (!new_items) {
-            return -1;
-        }
-        list->items = new_items;
-        list->capacity = new_cap;
-    }
-    size_t len = strlen(name);
-    char *copy = malloc(len + 1);
-    if (!copy) {
-        return -1;
+static size_t resume_slot(const resume_map_t *map, int video_id) {
+    size_t mask = map->capacity - 1;
+    size_t i = ((unsigned)video_id * 2654435761u) & mask;
+    while (map->items[i].video_id != 0 && map->items[i].video_id != video_id) {
+        i = (i + 1) & mask;
     }
-    memcpy(copy, name, len + 1);
-    list->items[list->count++] = copy;
-    return 0;
+    return i;
 }
 
 // 비디오 ID별 마지막 재생 지점을 저장한다.
 static int resume_map_add(resume_map_t *map, int video_id, double position) {
-    if (!map) return -1;
-    for (size_t i = 0; i < map->count; ++i) {
-        if (map->items[i].video_id == video_id) {
-            map->items[i].position = position;
-            return 0;
-        }
-    }
-    if (map->count == map->capacity) {
-        size_t new_cap = map->capacity == 0 ? 8 : map->capacity * 2;
-        resume_entry_t *new_items = realloc(map->items, new_cap * sizeof(resume_entry_t));
+    if (!map || video_id <= 0) return -1;
+    // 적재율을 1/2 이하로 유지해 탐사 길이를 짧게 둔다.
+    if ((map->count + 1) * 2 > map->capacity) {
+        size_t new_cap = map->capacity == 0 ? 16 : map->capacity * 2;
+        resume_entry_t *new_items = calloc(new_cap, sizeof(resume_entry_t));
         if (!new_items) {
             return -1;
         }
-        map->items = new_items;
-        map->capacity = new_cap;
+        resume_map_t grown = {.items = new_items, .count = 0, .capacity = new_cap};
+        for (size_t i = 0; i < map->capacity; ++i) {
+            if (map->items[i].video_id != 0) {
+                grown.items[resume_slot(&grown, map->items[i].video_id)] = map->items[i];
+                grown.count++;
+            }
+        }
+        free(map->items);
+        *map = grown;
     }
-    map->items[map->count].video_id = video_id;
-    map->items[map->count].position = position;
-    map->count++;
+    resume_entry_t *slot = &map->items[resume_slot(map, video_id)];
+    if (slot->video_id == 0) {
+        slot->video_id = video_id;
+        map->count++;
+    }
+    slot->position = position;
     return 0;
 }
 
 static const resume_entry_t *resume_map_find(const resume_map_t *map, int video_id) {
-    if (!map) return NULL;
-    for (size_t i = 0; i < map->count; ++i) {
-        if (map->items[i].video_id == video_id) {
-            return &map->items[i];
-        }
-    }
-    return NULL;
+    if (!map || map->capacity == 0 || video_id <= 0) return NULL;
+    const resume_entry_t *slot = &map->items[resume_slot(map, video_id)];
+    return slot->video_id == video_id ? slot : NULL;
 }
 
 // db_list_watch_history 콜백에서 resume_map을 채운다.
@@ -315,155 +124,105 @@ static int collect_resume(void *userdata, int video_id, double position_seconds,
     return resume_map_add(map, video_id, position_seconds);
 }
 
-static int has_mp4_extension(const char *name) {
-    const char *ext = strrchr(name, '.');
-    if (!ext) return 0;
-    return strcasecmp(ext, ".mp4") == 0;
-}
-
-// 파일명에서 확장자와 언더스코어를 제거해 사람이 읽을 제목을 만든다.
-static void make_title(const char *filename, char *title, size_t len) {
-    if (!filename || !title || len == 0) return;
-    const char *base = filename;
-    const char *slash = strrchr(filename, '/');
-    if (slash) base = slash + 1;
-    char tmp[256];
-    snprintf(tmp, sizeof(tmp), "%s", base);
-    char *dot = strrchr(tmp, '.');
-    if (dot) *dot = '\0';
-    for (char *p = tmp; *p; ++p) {
-        if (*p == '_' || *p == '-') {
-            *p = ' ';
-        }
-    }
-    if (tmp[0] == '\0') {
-        snprintf(title, len, "%s", filename);
-    } else {
-        snprintf(title, len, "%s", tmp);
-    }
-}
-
-// media 디렉터리를 스캔하여 DB와 동기화한다.
-static int sync_media_directory(server_ctx_t *server) {
-    DIR *dir = opendir(server->media_dir);
-    if (!dir) {
-        log_warn("Failed to open media directory %s: %s", server->media_dir, strerror(errno));
-        return -1;
-    }
-    filename_list_t files = {0};
-    int result = 0;
-    struct dirent *ent;
-    while ((ent = readdir(dir)) != NULL) {
-        if (ent->d_name[0] == '.') continue;
-        if (!has_mp4_extension(ent->d_name)) continue;
-        // 비디오 파일명에서 자동으로 제목을 만들어 DB에 upsert 한다.
-        char title[256];
-        make_title(ent->d_name, title, sizeof(title));
-        if (db_upsert_video(&server->db, title, ent->d_name, NULL, 0, NULL) != 0) {
-            log_warn("Failed to upsert video %s", ent->d_name);
-            result = -1;
-            break;
-        }
-        if (filename_list_add(&files, ent->d_name) != 0) {
-            log_warn("Failed to track media filename %s", ent->d_name);
-            result = -1;
-            break;
-        }
-    }
-    closedir(dir);
-    if (result != 0) {
-        log_error("Media synchronization aborted; see warnings above for details");
-        filename_list_free(&files);
-        return -1;
-    }
-    if (db_prune_missing_videos(&server->db, (const char *const *)files.items, files.count) != 0) {
-        log_warn("Failed to prune missing videos; stale entries may remain");
-    }
-    filename_list_free(&files);
-    return 0;
+// history_overlay_user 콜백: 아직 DB에 쓰이지 않은 위치로 덮어쓴다.
+static int overlay_resume(void *userdata, int video_id, double position_seconds, time_t updated_at) {
+    (void)updated_at;
+    return resume_map_add(userdata, video_id, position_seconds);
 }
 
-// 서버 시작 시 미디어 디렉터리를 한 번 동기화한다.
+// 서버 시작 시 카탈로그를 맞추고 media 디렉터리 워처를 시작한다.
 int video_initialize(server_ctx_t *server) {
-    if (!server) return -1;
-    int rc = sync_media_directory(server);
-    if (rc != 0) {
-        return rc;
-    }
-    if (start_media_watcher(server) != 0) {
-        log_warn("Media hot-reload watcher is not running; new files will appear on next API call");
-    }
-    return 0;
+    return library_start(server);
 }
 
 typedef struct {
-    request_ctx_t *ctx;
     string_builder_t *sb;
     int first;
     const resume_map_t *history;
-    size_t emitted;
 } list_ctx_t;
 
-// 비디오 리스트 JSON 배열에 한 항목을 추가한다.
-static int append_video_row(void *userdata, int id, const char *title,
-                            const char *filename, const char *description,
-                            int duration_seconds) {
+// db_query_videos 콜백: 캐시에 넣을 사용자 무관 조각을 만든다.
+static int collect_video_row(void *userdata, int id, const char *title,
+                             const char *filename, const char *description,
+                             int duration_seconds) {
+    return catalog_page_add_row(userdata, id, title, filename, description, duration_seconds);
+}
+
+// 캐시된 조각 하나에 이 사용자의 재생 지점을 붙여 JSON 배열 항목으로 추가한다.
+static int append_video_row(void *userdata, int video_id, const char *json, size_t length) {
     list_ctx_t *data = userdata;
-    request_ctx_t *ctx = data->ctx;
-    double resume = 0;
-    int has_resume = 0;
     // history map에서 이 비디오에 대한 마지막 재생 지점을 찾는다.
-    const resume_entry_t *entry = resume_map_find(data->history, id);
-    if (entry) {
-        resume = entry->position;
-        has_resume = 1;
-    }
-    const char *prefix = data->first ? "" : ",";
-    if (sb_append(data->sb, "%s{\"id\":%d,\"title\":", prefix, id) != 0) return -1;
-    if (sb_append_json_string(data->sb, title) != 0) return -1;
-    if (sb_append(data->sb, ",\"filename\":") != 0) return -1;
-    if (sb_append_json_string(data->sb, filename) != 0) return -1;
-    if (sb_append(data->sb, ",\"description\":") != 0) return -1;
-    if (sb_append_json_string(data->sb, description) != 0) return -1;
-    if (sb_append(data->sb, ",\"duration\":%d", duration_seconds) != 0) return -1;
-    char thumb_url[128];
-    snprintf(thumb_url, sizeof(thumb_url), "/api/videos/%d/thumbnail", id);
-    if (sb_append(data->sb, ",\"thumbnailUrl\":") != 0) return -1;
-    if (sb_append_json_string(data->sb, thumb_url) != 0) return -1;
-    char stream_url[128];
-    snprintf(stream_url, sizeof(stream_url), "/api/videos/%d/stream", id);
-    if (sb_append(data->sb, ",\"streamUrl\":") != 0) return -1;
-    if (sb_append_json_string(data->sb, stream_url) != 0) return -1;
-    if (sb_append(data->sb, ",\"resumeSeconds\":%.3f", has_resume ? resume : 0.0) != 0) return -1;
-    if (sb_append(data->sb, "}") != 0) return -1;
+    const resume_entry_t *entry = resume_map_find(data->history, video_id);
+    if (!data->first && sb_append_raw(data->sb, ",", 1) != 0) return -1;
+    if (sb_append_raw(data->sb, json, length) != 0) return -1;
+    if (sb_append(data->sb, ",\"resumeSeconds\":%.3f}", entry ? entry->position : 0.0) != 0) return -1;
     data->first = 0;
-    data->emitted++;
     return 0;
 }
 
+// 목록 커서를 불투명 토큰으로 만든다: base64url("<id>" 또는 "<id>:<rank>").
+static void video_cursor_encode(const db_video_cursor_t *cursor, char *out, size_t out_len) {
+    char plain[64];
+    int n = cursor->rank != 0.0 ? snprintf(plain, sizeof(plain), "%d:%.17g", cursor->id, cursor->rank)
+                                : snprintf(plain, sizeof(plain), "%d", cursor->id);
+    if (n <= 0 || (size_t)n >= sizeof(plain) ||
+        base64url_encode((const uint8_t *)plain, (size_t)n, out, out_len) < 0) {
+        out[0] = '\0';
+    }
+}
+
+// video_cursor_encode의 역변환. 형식이 맞지 않으면 -1.
+static int video_cursor_decode(const char *token, db_video_cursor_t *cursor) {
+    uint8_t plain[64];
+    int n = base64url_decode(token, plain, sizeof(plain) - 1);
+    if (n <= 0) return -1;
+    plain[n] = '\0';
+    char *end = NULL;
+    long id = strtol((const char *)plain, &end, 10);
+    if (end == (const char *)plain || id <= 0 || id > INT_MAX) return -1;
+    cursor->id = (int)id;
+    cursor->rank = 0.0;
+    if (*end == ':') {
+        const char *rank_str = end + 1;
+        cursor->rank = strtod(rank_str, &end);
+        if (end == rank_str) return -1;
+    }
+    return *end == '\0' ? 0 : -1;
+}
+
 // /api/videos: 페이지네이션, 검색, 재생 위치를 포함한 목록을 반환한다.
+// 디렉터리 동기화는 워처/관리자 재스캔이 담당하므로 여기서는 카탈로그만 읽는다.
 void video_handle_list(request_ctx_t *ctx) {
     if (!ctx->authenticated) {
         router_send_json_error(ctx, 401, "Unauthorized");
         return;
     }
-    sync_media_directory(ctx->server);
+    // 목록을 만드는 동안 세대가 바뀌어도 클라이언트가 다시 확인하도록 먼저 읽어 둔다.
+    unsigned long generation = library_generation();
     int limit = VIDEO_DEFAULT_LIMIT;
-    int cursor = 0;
-    if (query_get_int(ctx->request->query, "limit", &limit) == 0) {
+    if (router_get_query_int(ctx, "limit", &limit) == 0) {
         if (limit < 1) limit = VIDEO_DEFAULT_LIMIT;
         if (limit > VIDEO_MAX_LIMIT) limit = VIDEO_MAX_LIMIT;
     } else {
         limit = VIDEO_DEFAULT_LIMIT;
     }
-    if (query_get_int(ctx->request->query, "cursor", &cursor) == 0) {
-        if (cursor < 0) cursor = 0;
+    // cursor는 이전 응답의 nextCursor를 그대로 돌려받는 불투명 토큰이다. 없거나 "0"이면 첫 페이지.
+    char cursor[CATALOG_CURSOR_MAX] = {0};
+    db_video_cursor_t after;
+    int has_cursor = 0;
+    if (router_get_query(ctx, "cursor", cursor, sizeof(cursor)) == 0 &&
+        cursor[0] != '\0' && strcmp(cursor, "0") != 0) {
+        if (video_cursor_decode(cursor, &after) != 0) {
+            router_send_json_error(ctx, 400, "Invalid cursor");
+            return;
+        }
+        has_cursor = 1;
     } else {
-        cursor = 0;
+        cursor[0] = '\0';
     }
     char search_term[128] = {0};
     int has_query = 0;
-    if (query_get_param(ctx->request->query, "q", search_term, sizeof(search_term)) == 0) {
+    if (router_get_query(ctx, "q", search_term, sizeof(search_term)) == 0) {
         trim_spaces(search_term);
         if (search_term[0] != '\0') {
             has_query = 1;
@@ -476,6 +235,11 @@ void video_handle_list(request_ctx_t *ctx) {
         router_send_json_error(ctx, 500, "Failed to load history");
         return;
     }
+    if (history_overlay_user(ctx->user_id, overlay_resume, &map) != 0) {
+        resume_map_free(&map);
+        router_send_json_error(ctx, 500, "Allocation failed");
+        return;
+    }
     string_builder_t sb;
     if (sb_init(&sb, 512) != 0) {
         resume_map_free(&map);
@@ -487,19 +251,43 @@ void video_handle_list(request_ctx_t *ctx) {
         router_send_json_error(ctx, 500, "Allocation failed");
         return;
     }
-    list_ctx_t data = {.ctx = ctx, .sb = &sb, .first = 1, .history = &map, .emitted = 0};
+    list_ctx_t data = {.sb = &sb, .first = 1, .history = &map};
     int has_more = 0;
-    if (db_query_videos(&ctx->server->db, has_query ? search_term : NULL, limit, cursor,
-                        append_video_row, &data, &has_more) != 0) {
+    const char *query = has_query ? search_term : NULL;
+    // 같은 세대에 본 페이지면 캐시된 조각만 이어 붙이고, 아니면 DB에서 조각을 만들어 캐시에 넣는다.
+    char next_cursor[CATALOG_CURSOR_MAX] = {0};
+    int cached = catalog_cache_get(generation, query, cursor, limit, append_video_row, &data,
+                                   NULL, &has_more, next_cursor, sizeof(next_cursor));
+    if (cached == 1) {
+        catalog_page_t page = {0};
+        db_video_cursor_t last = {0};
+        if (db_query_videos(&ctx->server->db, query, limit, has_cursor ? &after : NULL,
+                            collect_video_row, &page, &has_more, &last) != 0) {
+            catalog_page_free(&page);
+            sb_free(&sb);
+            resume_map_free(&map);
+            router_send_json_error(ctx, 500, "Failed to query videos");
+            return;
+        }
+        page.has_more = has_more;
+        if (has_more && page.count > 0) {
+            video_cursor_encode(&last, page.next_cursor, sizeof(page.next_cursor));
+        }
+        snprintf(next_cursor, sizeof(next_cursor), "%s", page.next_cursor);
+        cached = catalog_page_emit(&page, append_video_row, &data);
+        catalog_cache_put(generation, query, cursor, limit, &page);
+    }
+    if (cached != 0) {
         sb_free(&sb);
         resume_map_free(&map);
-        router_send_json_error(ctx, 500, "Failed to query videos");
+        router_send_json_error(ctx, 500, "Allocation failed");
         return;
     }
-    // 다음 페이지 커서 및 쿼리 문자열을 응답 본문에 포함시킨다.
-    int next_cursor = cursor + (int)data.emitted;
-    if (sb_append(&sb, "],\"cursor\":%d,\"limit\":%d,\"nextCursor\":%d,\"hasMore\":%s,\"query\":",
-                  cursor, limit, next_cursor, has_more ? "true" : "false") != 0) {
+    // 다음 페이지 커서 및 쿼리 문자열을 응답 본문에 포함시킨다. (토큰은 base64url이라 escape가 필요 없다)
+    if (sb_append(&sb, "],\"cursor\":%s%s%s,\"limit\":%d,\"nextCursor\":%s%s%s,\"hasMore\":%s,\"query\":",
+                  cursor[0] ? "\"" : "", cursor[0] ? cursor : "null", cursor[0] ? "\"" : "", limit,
+                  next_cursor[0] ? "\"" : "", next_cursor[0] ? next_cursor : "null",
+                  next_cursor[0] ? "\"" : "", has_more ? "true" : "false") != 0) {
         sb_free(&sb);
         resume_map_free(&map);
         router_send_json_error(ctx, 500, "Allocation failed");
@@ -520,28 +308,70 @@ void video_handle_list(request_ctx_t *ctx) {
             return;
         }
     }
-    if (sb_append(&sb, "}") != 0) {
+    if (sb_append(&sb, ",\"generation\":%lu}", generation) != 0) {
         sb_free(&sb);
         resume_map_free(&map);
         router_send_json_error(ctx, 500, "Allocation failed");
         return;
     }
-    router_send_json(ctx, 200, sb.data, NULL);
+    char extra[64];
+    snprintf(extra, sizeof(extra), "X-Catalog-Generation: %lu\r\n", generation);
+    router_send_json(ctx, 200, sb.data, extra);
     sb_free(&sb);
     resume_map_free(&map);
 }
 
-static int parse_int(const char *s) {
-    if (!s) return -1;
-    char *end = NULL;
-    long v = strtol(s, &end, 10);
-    if (!end || *end != '\0') {
-        return -1;
+// POST /api/admin/rescan: ADMIN_TOKEN으로 보호되는 수동 라이브러리 동기화 트리거
+void video_handle_rescan(request_ctx_t *ctx) {
+    if (router_require_admin(ctx) != 0) {
+        return;
     }
-    if (v < 0 || v > INT_MAX) {
-        return -1;
+    int changed = 0;
+    if (library_sync(ctx->server, &changed) != 0) {
+        router_send_json_error(ctx, 500, "Media synchronization failed");
+        return;
+    }
+    if (changed) {
+        log_info("Admin rescan: library synchronized (generation %lu)", library_generation());
     }
-    return (int)v;
+    char body[96];
+    snprintf(body, sizeof(body), "{\"changed\":%s,\"generation\":%lu}",
+             changed ? "true" : "false", library_generation());
+    router_send_json(ctx, 200, body, NULL);
+}
+
+// GET /api/admin/media: 파일 핸들 캐시 적중률과 타이틀별 전송량, 메모리 고정 상태를 반환한다.
+void video_handle_media_stats(request_ctx_t *ctx) {
+    if (router_require_admin(ctx) != 0) {
+        return;
+    }
+    media_cache_stats_t stats;
+    media_cache_get_stats(&stats);
+    string_builder_t sb;
+    if (sb_init(&sb, 512) != 0) {
+        router_send_json_error(ctx, 500, "Allocation failed");
+        return;
+    }
+    int error = sb_append(&sb,
+                          "{\"entries\":%zu,\"inUse\":%zu,\"capacity\":%zu,\"hits\":%llu,\"misses\":%llu,"
+                          "\"evictions\":%llu,\"bytesServed\":%llu,\"pinnedTitles\":%zu,\"pinnedBytes\":%llu,"
+                          "\"pinBudgetBytes\":%llu,\"topTitles\":[",
+                          stats.entries, stats.in_use, stats.capacity, (unsigned long long)stats.hits,
+                          (unsigned long long)stats.misses, (unsigned long long)stats.evictions,
+                          (unsigned long long)stats.bytes_served, stats.pinned_titles,
+                          (unsigned long long)stats.pinned_bytes, (unsigned long long)stats.pin_budget_bytes) != 0;
+    for (size_t i = 0; i < stats.top_count && !error; ++i) {
+        error = sb_append(&sb, "%s{\"videoId\":%d,\"bytesServed\":%llu,\"pinned\":%s}", i ? "," : "",
+                          stats.top[i].video_id, (unsigned long long)stats.top[i].bytes_served,
+                          stats.top[i].pinned ? "true" : "false") != 0;
+    }
+    if (error || sb_append(&sb, "]}") != 0) {
+        sb_free(&sb);
+        router_send_json_error(ctx, 500, "Allocation failed");
+        return;
+    }
+    router_send_json(ctx, 200, sb.data, NULL);
+    sb_free(&sb);
 }
 
 // HTTP Range 헤더를 파싱해 시작/끝 바이트를 계산한다.
@@ -577,20 +407,57 @@ static int parse_range_header(const char *header, off_t file_size, off_t *start_
     return 0;
 }
 
+// 타이틀 평균 비트레이트(크기/길이)로 본문 송신 속도와 연결의 첫 버스트를 정한다. 길이를 모르면 제한하지 않는다.
+static void plan_stream_pacing(const server_ctx_t *server, http_file_stream_t *stream, off_t size, int duration) {
+    if (server->stream_pacing_factor <= 0 || duration <= 0 || size <= 0) {
+        return;
+    }
+    double bitrate = (double)size / duration;
+    double rate = bitrate * server->stream_pacing_factor;
+    double burst = bitrate * server->stream_burst_sec;
+    stream->pace_rate = rate > VIDEO_PACE_MIN_RATE ? (uint64_t)rate : VIDEO_PACE_MIN_RATE;
+    stream->pace_burst = burst < VIDEO_PACE_BURST_MAX ? (uint64_t)burst : VIDEO_PACE_BURST_MAX;
+}
+
+// 헤더만 워커에서 보내고 본문은 이벤트 루프가 논블로킹으로 이어 보내게 한다.
+// 이벤트 루프가 없는 호출 경로에서는 기존처럼 끝까지 블로킹 송신한다.
+static int send_video_file(request_ctx_t *ctx, int status, const char *path, const struct stat *st,
+                           int video_id, int duration, off_t offset, size_t length, const char *headers) {
+    if (ctx->stream) {
+        // 핸들 캐시가 같은 파일을 열어 두었으면 그 FD를 빌려 쓰고, 캐시를 못 쓰면 요청마다 연다.
+        media_file_t *media = media_cache_acquire(path, st, video_id, duration);
+        if (!media) {
+            if (http_begin_file_response(ctx->client_fd, status, http_status_text(status), "video/mp4", path,
+                                         offset, length, 1, headers, ctx->keep_alive, ctx->stream) != 0) {
+                return -1;
+            }
+        } else if (http_begin_media_response(ctx->client_fd, status, http_status_text(status), "video/mp4",
+                                             media, offset, length, headers, ctx->keep_alive, ctx->stream) != 0) {
+            media_cache_release(media);
+            return -1;
+        }
+        plan_stream_pacing(ctx->server, ctx->stream, st->st_size, duration);
+        return 0;
+    }
+    return http_send_file_response(ctx->client_fd, status, http_status_text(status), "video/mp4",
+                                   path, offset, length, 1, headers, ctx->keep_alive);
+}
+
 // /api/videos/:id/stream: MP4 파일을 Range 스트리밍한다.
 void video_handle_stream(request_ctx_t *ctx) {
     if (!ctx->authenticated) {
         router_send_json_error(ctx, 401, "Unauthorized");
         return;
     }
-    const char *id_str = router_get_param(ctx, "id");
-    int video_id = parse_int(id_str);
-    if (video_id <= 0) {
+    int video_id = 0;
+    if (router_get_param_int(ctx, "id", &video_id) != 0 || video_id <= 0) {
         router_send_json_error(ctx, 400, "Invalid video id");
         return;
     }
     char filename[256];
-    if (db_get_video_by_id(&ctx->server->db, video_id, NULL, 0, filename, sizeof(filename), NULL, 0, NULL) != 0) {
+    int duration = 0;
+    if (db_get_video_by_id(&ctx->server->db, video_id, NULL, 0, filename, sizeof(filename), NULL, 0,
+                           &duration) != 0) {
         router_send_json_error(ctx, 404, "Video not found");
         return;
     }
@@ -605,8 +472,24 @@ void video_handle_stream(request_ctx_t *ctx) {
         return;
     }
     off_t file_size = st.st_size;
-    const char *range = http_get_header(ctx->request, "Range");
-    char headers[512];
+    http_validator_t validator;
+    http_validator_from_stat(&st, &validator);
+    char validators[256];
+    if (http_format_validator_headers(&validator, VIDEO_STREAM_CACHE_CONTROL, validators, sizeof(validators)) != 0) {
+        validators[0] = '\0';
+    }
+    char headers[1024];
+    if (http_request_not_modified(ctx->request, &validator)) {
+        build_header(headers, sizeof(headers), ctx->server, validators);
+        if (http_send_not_modified(ctx->client_fd, headers, ctx->keep_alive) != 0) {
+            log_warn("Failed to send 304 for video %d", video_id);
+        }
+        return;
+    }
+    const char *range = http_get_known_header(ctx->request, HTTP_HDR_RANGE);
+    if (range && !http_if_range_allows(ctx->request, &validator)) {
+        range = NULL; // 캐시된 부분이 현재 파일과 다르면 전체를 다시 보낸다.
+    }
     if (range) {
         off_t start = 0, end = 0;
         if (parse_range_header(range, file_size, &start, &end) != 0) {
@@ -614,33 +497,39 @@ void video_handle_stream(request_ctx_t *ctx) {
             return;
         }
         size_t length = (size_t)(end - start + 1);
-        char extra[256];
+        char extra[512];
         snprintf(extra, sizeof(extra),
-                 "Accept-Ranges: bytes\r\nContent-Range: bytes %lld-%lld/%lld\r\n",
-                 (long long)start, (long long)end, (long long)file_size);
+                 "Accept-Ranges: bytes\r\nContent-Range: bytes %lld-%lld/%lld\r\n%s",
+                 (long long)start, (long long)end, (long long)file_size, validators);
         build_header(headers, sizeof(headers), ctx->server, extra);
-        if (http_send_file_response(ctx->client_fd, 206, http_status_text(206), "video/mp4",
-                                    path, start, length, 1, headers) != 0) {
+        if (send_video_file(ctx, 206, path, &st, video_id, duration, start, length, headers) != 0) {
             log_warn("Failed to stream range for video %d", video_id);
         }
     } else {
-        build_header(headers, sizeof(headers), ctx->server, "Accept-Ranges: bytes\r\n");
-        if (http_send_file_response(ctx->client_fd, 200, http_status_text(200), "video/mp4",
-                                    path, 0, 0, 1, headers) != 0) {
+        char extra[512];
+        snprintf(extra, sizeof(extra), "Accept-Ranges: bytes\r\n%s", validators);
+        build_header(headers, sizeof(headers), ctx->server, extra);
+        if (send_video_file(ctx, 200, path, &st, video_id, duration, 0, 0, headers) != 0) {
             log_warn("Failed to stream video %d", video_id);
         }
     }
 }
 
+// 썸네일이 아직 만들어지는 중일 때 내려주는 회색 자리 표시 이미지
+static const char THUMBNAIL_PLACEHOLDER_SVG[] =
+    "<svg xmlns=\"http://www.w3.org/2000/svg\" width=\"320\" height=\"180\" viewBox=\"0 0 320 180\">"
+    "<rect width=\"320\" height=\"180\" fill=\"#2b2b2b\"/>"
+    "<path d=\"M140 65v50l40-25z\" fill=\"#5a5a5a\"/></svg>";
+
 // /api/videos/:id/thumbnail: 캐시된 썸네일 이미지를 내려준다.
+// 썸네일이 없으면 생성 작업만 예약하고 202와 자리 표시 이미지를 즉시 돌려준다.
 void video_handle_thumbnail(request_ctx_t *ctx) {
     if (!ctx->authenticated) {
         router_send_json_error(ctx, 401, "Unauthorized");
         return;
     }
-    const char *id_str = router_get_param(ctx, "id");
-    int video_id = parse_int(id_str);
-    if (video_id <= 0) {
+    int video_id = 0;
+    if (router_get_param_int(ctx, "id", &video_id) != 0 || video_id <= 0) {
         router_send_json_error(ctx, 400, "Invalid video id");
         return;
     }
@@ -655,24 +544,111 @@ void video_handle_thumbnail(request_ctx_t *ctx) {
         return;
     }
     char thumb_path[PATH_MAX];
-    if (ffmpeg_ensure_thumbnail(ctx->server, video_id, video_path, thumb_path, sizeof(thumb_path)) != 0) {
+    int status = ffmpeg_request_thumbnail(ctx->server, video_id, video_path, thumb_path, sizeof(thumb_path));
+    if (status < 0) {
         router_send_json_error(ctx, 500, "Thumbnail error");
         return;
     }
-    char headers[256];
-    build_header(headers, sizeof(headers), ctx->server, NULL);
-    if (http_send_file_response(ctx->client_fd, 200, http_status_text(200), "image/jpeg",
-                                thumb_path, 0, 0, 0, headers) != 0) {
+    if (status > 0) {
+        // 보안 헤더와 추가 헤더는 합치지 않고 따로 넘겨 writev 한 번에 보낸다.
+        if (http_send_response_blocks(ctx->client_fd, 202, http_status_text(202), "image/svg+xml",
+                                      THUMBNAIL_PLACEHOLDER_SVG, sizeof(THUMBNAIL_PLACEHOLDER_SVG) - 1,
+                                      ctx->server->security_headers,
+                                      "Cache-Control: no-store\r\nRetry-After: 2\r\n", ctx->keep_alive) != 0) {
+            log_warn("Failed to send thumbnail placeholder for video %d", video_id);
+        }
+        return;
+    }
+    if (http_send_cacheable_file(ctx->client_fd, ctx->request, "image/jpeg", thumb_path,
+                                 ctx->server->thumb_cache_control, ctx->server->security_headers,
+                                 ctx->keep_alive) != 0) {
         log_warn("Failed to send thumbnail for video %d", video_id);
     }
 }
 
-// 서버 종료 시 백그라운드 워처 스레드를 정리한다.
-void video_shutdown(void) {
-    if (!g_media_watch.running) {
+// 미리보기 요청의 비디오를 찾아 경로를 만들고 미리보기 작업 상태를 돌려준다.
+// 오류 응답은 여기서 보내고 -2를 돌려준다. 나머지 값은 ffmpeg_request_previews와 같다.
+static int request_previews(request_ctx_t *ctx, int *video_id_out, char *vtt_path, size_t vtt_path_len,
+                            char *sprite_path, size_t sprite_path_len) {
+    if (!ctx->authenticated) {
+        router_send_json_error(ctx, 401, "Unauthorized");
+        return -2;
+    }
+    int video_id = 0;
+    if (router_get_param_int(ctx, "id", &video_id) != 0 || video_id <= 0) {
+        router_send_json_error(ctx, 400, "Invalid video id");
+        return -2;
+    }
+    char filename[256];
+    int duration = 0;
+    if (db_get_video_by_id(&ctx->server->db, video_id, NULL, 0, filename, sizeof(filename), NULL, 0,
+                           &duration) != 0) {
+        router_send_json_error(ctx, 404, "Video not found");
+        return -2;
+    }
+    char video_path[PATH_MAX];
+    if (snprintf(video_path, sizeof(video_path), "%s/%s", ctx->server->media_dir, filename) >= (int)sizeof(video_path)) {
+        router_send_json_error(ctx, 500, "Path too long");
+        return -2;
+    }
+    int status = ffmpeg_request_previews(ctx->server, video_id, duration, video_path,
+                                         vtt_path, vtt_path_len, sprite_path, sprite_path_len);
+    if (status < 0) {
+        router_send_json_error(ctx, 500, "Preview error");
+        return -2;
+    }
+    *video_id_out = video_id;
+    return status;
+}
+
+// /api/videos/:id/previews: 탐색 미리보기 WebVTT 트랙을 내려준다.
+// 큐마다 스프라이트 시트의 타일 좌표(#xywh)를 가리킨다. 아직 만드는 중이면 빈 트랙과 202.
+void video_handle_previews(request_ctx_t *ctx) {
+    char vtt_path[PATH_MAX];
+    char sprite_path[PATH_MAX];
+    int video_id = 0;
+    int status = request_previews(ctx, &video_id, vtt_path, sizeof(vtt_path), sprite_path, sizeof(sprite_path));
+    if (status == -2) {
+        return;
+    }
+    if (status > 0) {
+        static const char empty_track[] = "WEBVTT\n";
+        if (http_send_response_blocks(ctx->client_fd, 202, http_status_text(202), "text/vtt; charset=utf-8",
+                                      empty_track, sizeof(empty_track) - 1, ctx->server->security_headers,
+                                      "Cache-Control: no-store\r\nRetry-After: 5\r\n", ctx->keep_alive) != 0) {
+            log_warn("Failed to send pending previews for video %d", video_id);
+        }
         return;
     }
-    g_media_watch.stop = 1;
-    pthread_join(g_media_watch.thread, NULL);
-    memset(&g_media_watch, 0, sizeof(g_media_watch));
+    if (http_send_cacheable_file(ctx->client_fd, ctx->request, "text/vtt; charset=utf-8", vtt_path,
+                                 ctx->server->thumb_cache_control, ctx->server->security_headers,
+                                 ctx->keep_alive) != 0) {
+        log_warn("Failed to send previews for video %d", video_id);
+    }
+}
+
+// /api/videos/:id/previews/sprite.jpg: VTT 큐가 가리키는 스프라이트 시트 이미지
+void video_handle_preview_sprite(request_ctx_t *ctx) {
+    char vtt_path[PATH_MAX];
+    char sprite_path[PATH_MAX];
+    int video_id = 0;
+    int status = request_previews(ctx, &video_id, vtt_path, sizeof(vtt_path), sprite_path, sizeof(sprite_path));
+    if (status == -2) {
+        return;
+    }
+    if (status > 0) {
+        router_send_json_error(ctx, 404, "Previews not ready");
+        return;
+    }
+    if (http_send_cacheable_file(ctx->client_fd, ctx->request, "image/jpeg", sprite_path,
+                                 ctx->server->thumb_cache_control, ctx->server->security_headers,
+                                 ctx->keep_alive) != 0) {
+        log_warn("Failed to send preview sprite for video %d", video_id);
+    }
+}
+
+// 서버 종료 시 백그라운드 워처 스레드를 정리한다.
+void video_shutdown(void) {
+    library_stop();
+    catalog_cache_clear();
 }
@@ -19,6 +19,9 @@
   const player = document.getElementById('player');
   const logoutBtn = document.getElementById('logout-btn');
   const meta = document.getElementById('video-meta');
+  const scrubBar = document.getElementById('scrub-bar');
+  const scrubThumb = document.getElementById('scrub-thumb');
+  const scrubTime = document.getElementById('scrub-time');
 
   if (logoutBtn) {
     // 다른 페이지와 동일하게 로그아웃 후 로그인 화면으로 보낸다.
@@ -36,21 +39,35 @@
     return;
   }
 
-  let videosData;
-  let historyData;
+  // 커서 페이지를 nextCursor를 따라 넘기며 match를 만족하는 첫 항목을 찾는다. 끝까지 없으면 null.
+  async function findInPages(path, key, match) {
+    let cursor = null;
+    do {
+      const data = await api.get(cursor ? `${path}&cursor=${encodeURIComponent(cursor)}` : path);
+      const items = Array.isArray(data[key]) ? data[key] : [];
+      const found = items.find(match);
+      if (found) {
+        return found;
+      }
+      cursor = data.hasMore && typeof data.nextCursor === 'string' ? data.nextCursor : null;
+    } while (cursor);
+    return null;
+  }
+
+  let video;
+  let historyEntry;
   try {
     // 비디오 목록과 히스토리를 병렬 요청해 로딩 시간을 단축한다.
-    [videosData, historyData] = await Promise.all([
-      api.get('/api/videos'),
-      api.get('/api/history').catch(() => ({ history: [] })),
+    // 둘 다 페이지 단위로 오므로 이 비디오가 나올 때까지 다음 페이지를 따라간다.
+    [video, historyEntry] = await Promise.all([
+      findInPages('/api/videos?limit=50', 'videos', (item) => item.id === videoId),
+      findInPages('/api/history?limit=200', 'history', (item) => item.videoId === videoId).catch(() => null),
     ]);
   } catch (err) {
     statusText.textContent = err.message || 'Unable to load video metadata.';
     return;
   }
 
-  const videoList = Array.isArray(videosData.videos) ? videosData.videos : [];
-  const video = videoList.find((item) => item.id === videoId);
   if (!video) {
     statusText.textContent = 'Video not found.';
     return;
@@ -59,8 +76,92 @@
   meta.textContent = `${video.title}${video.duration ? ` · ${Math.round(video.duration / 60)} min` : ''}`;
   player.src = `/api/videos/${videoId}/stream`;
   player.poster = `/api/videos/${videoId}/thumbnail`;
+  setupScrubPreview(videoId);
+
+  // 탐색 미리보기: 큐마다 스프라이트 시트의 타일 좌표(#xywh)를 담은 WebVTT 메타데이터 트랙을 읽어
+  // 탐색 막대 위에 마우스를 올린 시점의 타일을 보여준다. 아직 생성 중(202, 빈 트랙)이면 잠시 뒤 다시 받는다.
+  function setupScrubPreview(id, attempt = 0) {
+    const trackEl = document.createElement('track');
+    trackEl.kind = 'metadata';
+    trackEl.label = 'thumbnails';
+    trackEl.src = `/api/videos/${id}/previews${attempt > 0 ? `?attempt=${attempt}` : ''}`;
+    trackEl.addEventListener('load', () => {
+      const cues = trackEl.track.cues;
+      if (cues && cues.length > 0) {
+        bindScrubBar(trackEl.track);
+      } else if (attempt < 24) {
+        trackEl.remove();
+        setTimeout(() => setupScrubPreview(id, attempt + 1), 5000);
+      }
+    });
+    player.appendChild(trackEl);
+    // metadata 트랙은 기본이 disabled라 hidden으로 바꿔야 브라우저가 큐를 받아 온다.
+    trackEl.track.mode = 'hidden';
+  }
+
+  // 큐는 시작 시각 순이므로 이진 탐색으로 time이 속한 큐를 찾는다.
+  function findCue(cues, time) {
+    let lo = 0;
+    let hi = cues.length - 1;
+    while (lo < hi) {
+      const mid = (lo + hi + 1) >> 1;
+      if (cues[mid].startTime <= time) {
+        lo = mid;
+      } else {
+        hi = mid - 1;
+      }
+    }
+    return cues[lo];
+  }
+
+  function bindScrubBar(track) {
+    if (!scrubBar || scrubBar.dataset.bound) return;
+    scrubBar.dataset.bound = '1';
+    scrubBar.hidden = false;
+
+    const timeAt = (event) => {
+      const rect = scrubBar.getBoundingClientRect();
+      const ratio = Math.min(Math.max((event.clientX - rect.left) / rect.width, 0), 1);
+      const duration = Number.isFinite(player.duration) ? player.duration : video.duration || 0;
+      return { ratio, time: ratio * duration, width: rect.width };
+    };
+
+    scrubBar.addEventListener('mousemove', (event) => {
+      const { ratio, time, width } = timeAt(event);
+      const cue = findCue(track.cues, time);
+      const match = cue && /^(.*)#xywh=(\d+),(\d+),(\d+),(\d+)$/.exec(cue.text.trim());
+      if (!match) {
+        scrubThumb.style.display = 'none';
+        return;
+      }
+      const [, url, x, y, w, h] = match;
+      scrubThumb.style.display = 'block';
+      scrubThumb.style.width = `${w}px`;
+      scrubThumb.style.height = `${h}px`;
+      scrubThumb.style.backgroundImage = `url("${url}")`;
+      scrubThumb.style.backgroundPosition = `-${x}px -${y}px`;
+      // 미리보기가 막대 밖으로 나가지 않도록 가장자리에서 멈춘다.
+      const left = Math.min(Math.max(ratio * width - w / 2, 0), Math.max(width - w, 0));
+      scrubThumb.style.left = `${left}px`;
+      scrubTime.textContent = formatSeconds(time);
+    });
+    scrubBar.addEventListener('mouseleave', () => {
+      scrubThumb.style.display = 'none';
+    });
+    scrubBar.addEventListener('click', (event) => {
+      const { time } = timeAt(event);
+      if (Number.isFinite(time)) {
+        player.currentTime = time;
+      }
+    });
+    // 재생 위치를 막대에 표시한다.
+    player.addEventListener('timeupdate', () => {
+      const duration = Number.isFinite(player.duration) ? player.duration : 0;
+      const ratio = duration > 0 ? player.currentTime / duration : 0;
+      scrubBar.style.setProperty('--scrub-progress', `${(ratio * 100).toFixed(2)}%`);
+    });
+  }
 
-  const historyEntry = (historyData.history || []).find((item) => item.videoId === videoId);
   let resumeSeconds = 0;
   if (historyEntry && historyEntry.position && historyEntry.position > 0) {
     resumeSeconds = historyEntry.position;
@@ -26,7 +26,7 @@
   const logoutBtn = document.getElementById('logout-btn');
 
   const state = {
-    cursor: 0,
+    cursor: null,
     limit: 12,
     isLoading: false,
     hasMore: true,
@@ -94,7 +94,7 @@
       loader.style.display = 'flex';
     }
     if (reset) {
-      state.cursor = 0;
+      state.cursor = null;
       state.hasMore = true;
       if (grid) {
         grid.innerHTML = '';
@@ -104,18 +104,21 @@
       }
     }
     try {
-      // limit/cursor를 쿼리로 전달해 서버에서 페이지네이션
-      const params = new URLSearchParams({ limit: state.limit.toString(), cursor: state.cursor.toString() });
+      // limit/cursor를 쿼리로 전달해 서버에서 페이지네이션 (cursor는 서버가 준 불투명 토큰)
+      const params = new URLSearchParams({ limit: state.limit.toString() });
+      const isFirstPage = !state.cursor;
+      if (state.cursor) {
+        params.set('cursor', state.cursor);
+      }
       if (state.query) {
         params.set('q', state.query);
       }
       const data = await api.get(`/api/videos?${params.toString()}`);
       const videos = Array.isArray(data.videos) ? data.videos : [];
       renderVideos(videos);
-      const nextCursor = typeof data.nextCursor === 'number' ? data.nextCursor : state.cursor + videos.length;
-      state.cursor = nextCursor;
-      state.hasMore = typeof data.hasMore === 'boolean' ? data.hasMore : videos.length >= state.limit;
-      if (!videos.length && state.cursor === 0) {
+      state.cursor = typeof data.nextCursor === 'string' ? data.nextCursor : null;
+      state.hasMore = Boolean(data.hasMore) && Boolean(state.cursor);
+      if (!videos.length && isFirstPage) {
         const message = state.query
           ? `No videos matched "${state.query}".`
           : 'No videos found. Add MP4 files to the media directory to get started.';